@@ -23,6 +23,7 @@
 #include <vector>
 #include <time.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "object.h"
 #include "option.h"
@@ -191,6 +192,21 @@ class App:public Object
 
 		virtual LogStream logStream (messageType_t in_messageType);
 
+		/**
+		 * Returns true if called from the thread which created the application.
+		 */
+		bool isMainThread () { return pthread_equal (pthread_self (), mainThread); }
+
+		/**
+		 * Pass message logged by thread other than the main thread.
+		 * Applications running event loop queue the message and send
+		 * it from the loop. Default implementation calls sendMessage.
+		 *
+		 * @param in_messageType   Message type.
+		 * @param in_messageString Message.
+		 */
+		virtual void sendThreadMessage (messageType_t in_messageType, const char *in_messageString) { sendMessage (in_messageType, in_messageString); }
+
 		/**
 		 * Called on SIGHUP signal.
 		 * This method is called from static signal routine.
@@ -302,6 +318,9 @@ class App:public Object
 
 		// use local time
 		bool useLocalTime;
+
+		// thread which created the application
+		pthread_t mainThread;
 };
 
 }
@@ -80,7 +80,7 @@
 #define PROTO_DATA             "D"
 //** Kill binary connection prematurely. @ingroup RTS2Protocol */
 #define PROTO_BINARY_KILLED    "H"
-/** Shared memory segment key, which holds data. @ingroup RTS2Protocol */
+/** Name of POSIX shared memory object and segments, which holds data. @ingroup RTS2Protocol */
 #define PROTO_SHARED           "I"
 /** Full shared data received. @ingroup RTS2Protocol */
 #define PROTO_SHARED_FULL      "J"
@@ -201,6 +201,156 @@ class Block: public App
 		 */
 		virtual void selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 
+		/**
+		 * Switch block to epoll based event loop. Connections are
+		 * then registered with EventPoll and only ready descriptors
+		 * are dispatched. Timers are handled by timerfd.
+		 *
+		 * @return -1 on error (epoll not available, or the block does not support it), 0 on success
+		 *
+		 * @see canEventPoll
+		 */
+		int enableEventPoll ();
+
+		/**
+		 * Returns event poll, if block is running epoll based loop.
+		 *
+		 * @return NULL if block uses select call
+		 */
+		EventPoll *getEventPoll () { return eventPoll; }
+
+		/**
+		 * Returns true if block can run epoll based loop. Blocks
+		 * which add sockets in addSelectSocks without registering
+		 * them with addPollSocket shall return false.
+		 */
+		virtual bool canEventPoll () { return true; }
+
+		/**
+		 * Add socket, which does not belong to any connection, to
+		 * the event poll. Block pollSuccess method will be called when
+		 * the socket is ready. Does nothing when select loop is used.
+		 *
+		 * @param fd     socket file descriptor
+		 * @param write  if true, socket is watched for writing as well
+		 */
+		void addPollSocket (int fd, bool write = false);
+
+		/**
+		 * Remove socket from event poll.
+		 *
+		 * @param fd     socket file descriptor
+		 */
+		void removePollSocket (int fd);
+
+		/**
+		 * Called when socket added with addPollSocket is ready.
+		 *
+		 * @param fd      socket file descriptor
+		 * @param events  EventPoll::READ and/or EventPoll::WRITE
+		 */
+		virtual void pollSuccess (int fd, uint32_t events) {}
+
+		/**
+		 * Called before main loop starts to wait for events. Blocks
+		 * sharing data with other threads can release their lock here,
+		 * as the main loop does not touch any data while it waits.
+		 *
+		 * @see loopWake
+		 */
+		virtual void loopSleep () {}
+
+		/**
+		 * Called after main loop wakes up, before events are processed.
+		 *
+		 * @see loopSleep
+		 */
+		virtual void loopWake () {}
+
+		/**
+		 * Enable or disable coalescing of outgoing messages. When
+		 * enabled, messages send by Connection::sendMsg are collected
+		 * in per-connection buffer and written with single call at the
+		 * end of event loop iteration, or when the buffer grows over
+		 * CONN_OUTPUT_FLUSH bytes.
+		 */
+		void setOutputCoalescing (bool enable) { outputCoalescing = enable; }
+
+		bool getOutputCoalescing () { return outputCoalescing; }
+
+		/**
+		 * Register connection with non-empty output buffer. Called by
+		 * connection when the first message is put to its buffer.
+		 */
+		void addPendingOutput (Connection *conn) { pendingOutput.push_back (conn); }
+
+		/**
+		 * Remove connection from list of connections with pending output.
+		 */
+		void removePendingOutput (Connection *conn);
+
+		/**
+		 * Write out output buffers of all connections.
+		 */
+		void flushPendingOutput ();
+
+		/**
+		 * Register connection which put data to its write queue. Event
+		 * loop then watches its socket for writability. Connections
+		 * which start to watch other descriptors without changing their
+		 * state or socket shall call it as well, as epoll loop registers
+		 * them again only when state or socket changes.
+		 */
+		void addWriteWatch (Connection *conn) { writeWatch.push_back (conn); }
+
+		/**
+		 * Remove connection from list of connections with new write queue.
+		 */
+		void removeWriteWatch (Connection *conn);
+
+		/**
+		 * Queue message logged by other thread, and wake up event
+		 * loop, which will send it.
+		 */
+		virtual void sendThreadMessage (messageType_t in_messageType, const char *in_messageString);
+
+		/**
+		 * Queue event posted by other thread, and wake up event loop,
+		 * which will pass it to postEvent. Use it to hand objects
+		 * (e.g. new connections) from worker threads to the main loop.
+		 */
+		void postThreadEvent (Event *event);
+
+		/**
+		 * Called by connection after its output buffer was written.
+		 *
+		 * @param messages  number of messages written
+		 * @param bytes     number of bytes written
+		 */
+		void outputFlushed (unsigned long messages, unsigned long bytes)
+		{
+			outputMessages += messages;
+			outputBytes += bytes;
+			outputWrites++;
+		}
+
+		/**
+		 * Returns number of messages send through output buffers.
+		 */
+		unsigned long getOutputMessages () { return outputMessages; }
+
+		/**
+		 * Returns number of bytes send through output buffers.
+		 */
+		unsigned long getOutputBytes () { return outputBytes; }
+
+		/**
+		 * Returns number of write calls used to flush output buffers.
+		 * Difference between getOutputMessages and getOutputWrites is
+		 * number of saved write calls.
+		 */
+		unsigned long getOutputWrites () { return outputWrites; }
+
 		int callIdle () { return idle (); }
 
 		/**
@@ -656,8 +806,9 @@ class Block: public App
 		 * Remove timer with a given type from the list of timers.
 		 *
 		 * @param event_type Type of event.
+		 * @param arg        If not NULL, remove only timers with this event argument.
 		 */
-		void deleteTimers (int event_type);
+		void deleteTimers (int event_type, Object *arg = NULL);
 
 		/**
 		 * Updates metainformation about given value.
@@ -676,6 +827,8 @@ class Block: public App
 		 */
 		 virtual void fileModified (struct inotify_event *event) {};
 
+		virtual void forkedInstance ();
+
 	protected:
 
 		virtual Connection *createClientConnection (NetworkAddress * in_addr) = 0;
@@ -779,6 +932,33 @@ class Block: public App
 		// timers - time when they should be executed, event which should be triggered
 		std::map <double, Event*> timers;
 
+		// epoll event loop, NULL if select is used
+		EventPoll *eventPoll;
+
+		// output coalescing
+		bool outputCoalescing;
+		connections_t pendingOutput;
+		// connections which started to queue data since the last loop iteration
+		connections_t writeWatch;
+		unsigned long outputMessages;
+		unsigned long outputBytes;
+		unsigned long outputWrites;
+
+		// messages logged by other threads, waiting to be send from the event loop
+		std::list <std::pair <messageType_t, std::string> > threadMessages;
+		pthread_mutex_t threadMessagesMutex;
+		// events posted by other threads, protected by threadMessagesMutex
+		std::list <Event *> threadEvents;
+		// wakes up event loop when thread message or event is queued
+		int threadMessagesPipe[2];
+
+		void wakeUpLoop ();
+
+		/**
+		 * Send messages and post events queued by other threads.
+		 */
+		void processThreadMessages ();
+
 		connections_t connections;
 		
 		// vector which holds connections which were recently added - idle loop will move them to connections
@@ -810,6 +990,21 @@ class Block: public App
                  * @return true if timer entry was deleted, false if it was already found in vector to delete.
 		 */
 		bool pushToDelete (const std::map <double, Event *>::iterator &iter);
+
+		/**
+		 * Register connection descriptors with event poll.
+		 */
+		void pollRegister (Connection *conn);
+
+		/**
+		 * Called when descriptor registered by connection is reported ready by event poll.
+		 */
+		void pollConnectionReady (Connection *conn, int fd, uint32_t events);
+
+		/**
+		 * Delete connection after error in epoll based loop.
+		 */
+		void pollDeleteConnection (Connection *conn);
 };
 
 }
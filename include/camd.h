@@ -25,6 +25,7 @@
 
 #include "scriptdevice.h"
 #include "imghdr.h"
+#include "pixelstat.h"
 
 #define MAX_CHIPS  3
 #define MAX_DATA_RETRY 100
@@ -997,6 +998,26 @@ class Camera:public rts2core::ScriptDevice
 		int sharedMemNum;
 		rts2core::DataSharedWrite *sharedData;
 
+		// connections which receive all images through shared memory, mapped to their current data connection ID
+		std::map <rts2core::Connection *, int> dataTaps;
+
+		// shared memory statistics
+		rts2core::ValueInteger *shmFree;
+		rts2core::StringArray *shmReaders;
+		rts2core::DoubleArray *shmLag;
+		rts2core::IntegerArray *shmHeld;
+
+		/**
+		 * Update shared memory statistics - number of free segments, and
+		 * bytes and segments held by the readers.
+		 */
+		void updateSharedStat ();
+
+		/**
+		 * End shared data connections of data taps.
+		 */
+		void endDataTaps (bool complete);
+
 		// number of exposures camera takes
 		rts2core::ValueLong *exposureNumber;
 		// exposure number inside script
@@ -1026,8 +1047,8 @@ class Camera:public rts2core::ScriptDevice
 		rts2core::ValueDouble *sum;
 		rts2core::ValueDouble *image_mode;
 
-		uint32_t *modeCount;
-		long long unsigned int modeCountSize;
+		// single pass sum, min, max and mode computation
+		rts2core::PixelStatistics pixelStat;
 
 		rts2core::ValueLong *computedPix;
 
@@ -1066,41 +1087,6 @@ class Camera:public rts2core::ScriptDevice
 		rts2core::ValueDouble *centerAvg;
 		rts2core::ValueDoubleStat *centerAvgStat;
 
-		// update statistics
-		template <typename t> int updateStatistics (t *data, size_t dataSize)
-		{
-			long double tSum = 0;
-			double tMin = min->getValueDouble ();
-			double tMax = max->getValueDouble ();
-			int pixNum = 0;
-			t *tData = data;
-			if (modeCountSize < (((long long unsigned int) 1) << (sizeof (t) * 8)))
-			{
-				delete[] modeCount;
-				modeCountSize = ((long long unsigned int) 1) << (sizeof (t) * 8);
-				modeCount = new uint32_t[modeCountSize];
-				memset (modeCount, 0, modeCountSize * sizeof (uint32_t));
-			}
-			while (((char *) tData) < ((char *) data) + dataSize)
-			{
-				t tD = *tData;
-				tSum += tD;
-				if (tD < tMin)
-					tMin = tD;
-				if (tD > tMax)
-				  	tMax = tD;
-				modeCount[(long) tD]++;
-				tData++;
-				pixNum++;
-			}
-			sum->setValueDouble (sum->getValueDouble () + tSum);
-			if (tMin < min->getValueDouble ())
-				min->setValueDouble (tMin);
-			if (tMax > max->getValueDouble ())
-				max->setValueDouble (tMax);
-			return pixNum;
-		}
-
 		// update center box
 		template <typename t> int updateCenter (t *data, size_t dataSize)
 		{
@@ -628,10 +628,17 @@ class CommandExecNow:public Command
  *
  * @ingroup RTS2Command
  */
+/**
+ * Ask executor to observe GRB target.
+ */
 class CommandExecGrb:public Command
 {
 	public:
-		CommandExecGrb (Block * _master, int _grb_id);
+		/**
+		 * @param _grb_id    GRB target ID
+		 * @param received   ctime when GCN packet was received, used by executor to report alert latency; ignored if NAN
+		 */
+		CommandExecGrb (Block * _master, int _grb_id, double received = NAN);
 
 		int getGrbID () { return grb_id; }
 	private:
@@ -74,6 +74,11 @@ class Configuration:public IniParser
 		 */
 		bool getStoreSexadecimals () { return storeSexadecimals; }
 
+		/**
+		 * Write median, MAD and sigma-clipped mean of image data to FITS headers.
+		 */
+		bool getRobustStatistics () { return robustStatistics; }
+
 		/**
 		 * Returns airmass callibration distance, which is used for callibartion observations.
 		 */
@@ -373,6 +378,7 @@ class Configuration:public IniParser
 		float utOffset;
 		double observatoryAltitude;
 		bool storeSexadecimals;
+		bool robustStatistics;
 		ObjectCheck *checker;
 		int astrometryTimeout;
 		double minFlatHeigh;
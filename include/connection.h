@@ -31,6 +31,7 @@
 #include <time.h>
 #include <list>
 #include <netinet/in.h>
+#include <sys/uio.h>
 
 #include <status.h>
 
@@ -41,6 +42,7 @@
 #include "message.h"
 #include "logstream.h"
 #include "valuelist.h"
+#include "eventpoll.h"
 
 #define MAX_DATA    200
 
@@ -80,6 +82,23 @@ typedef enum
 } conn_state_t;
 
 
+/**
+ * Output buffer is flushed when it grows over this size (in bytes).
+ */
+#define CONN_OUTPUT_FLUSH       65536
+
+/**
+ * High-water mark of connection write queue (in bytes). When more data
+ * wait in the queue, writes wait for the other side to accept them, and
+ * the connection is closed if it does not accept them in connection timeout.
+ */
+#define CONN_WRITE_QUEUE_MAX    (64 * 1024 * 1024)
+
+/**
+ * Maximal time (in seconds) spent writing queued data when application ends.
+ */
+#define BLOCK_DRAIN_TIMEOUT     2
+
 namespace rts2core
 {
 
@@ -144,6 +163,33 @@ class Connection:public Object
 		 */
 		virtual int add (fd_set * readset, fd_set * writeset, fd_set * expset);
 
+		/**
+		 * Register sockets identifiers which belong to current
+		 * connection with event poll. This is an equivalent of the add
+		 * call for Block running epoll based event loop. Connections
+		 * which override add to watch other descriptors than sock must
+		 * override this method as well.
+		 *
+		 * @param poll  Event poll. Call its watch method for every descriptor the connection is interested in.
+		 */
+		virtual void addPoll (EventPoll *poll);
+
+		/**
+		 * Called by epoll based event loop when descriptor registered
+		 * in addPoll is ready. Connection socket is read and written
+		 * directly, without fd_set, so descriptors above FD_SETSIZE
+		 * can be served. Connections which override receive or
+		 * writable must override this method as well, either with
+		 * direct handling of their descriptors, or by calling
+		 * pollReadySelect.
+		 *
+		 * @param fd      ready descriptor
+		 * @param events  EventPoll::READ and/or EventPoll::WRITE
+		 *
+		 * @return -1 on error (connection will be deleted), 0 on success.
+		 */
+		virtual int pollReady (int fd, uint32_t events);
+
 		/**
 		 * Set if command is in progress.
 		 *
@@ -222,6 +268,37 @@ class Connection:public Object
 		int sendMsg (std::string msg);
 		int sendMsg (std::ostringstream &_os);
 
+		/**
+		 * Write out messages collected in output buffer. Messages are
+		 * collected only if output coalescing is enabled in the master
+		 * block.
+		 *
+		 * @return -1 on error, 0 on sucess
+		 *
+		 * @see Block::setOutputCoalescing
+		 */
+		int flushOutput ();
+
+		/**
+		 * Returns true if some data wait in the write queue for the socket to become writable.
+		 */
+		bool writePending () { return !writeQueue.empty (); }
+
+		/**
+		 * Write as much of the write queue as the socket accepts, without blocking.
+		 *
+		 * @return -1 on error, 0 on success
+		 */
+		int flushWriteQueue ();
+
+		/**
+		 * Wait until the write queue is written. Used only at shutdown,
+		 * when event loop does not run.
+		 *
+		 * @param timeout  maximal wait in milliseconds
+		 */
+		void drainWriteQueue (int timeout) { waitWriteQueue (0, timeout); }
+
 		/**
 		 * Switch connection to binary connection.
 		 *
@@ -240,6 +317,9 @@ class Connection:public Object
 		 * @param chan       data channel
 		 * @param data       data to send
 		 * @param dataSize   size of data to send (in bytes)
+		 *
+		 * Data header and data are send with a single writev call, directly
+		 * from the data buffer, without intermediate copy.
 		 */
 		int sendBinaryData (int data_conn, int chan, char *data, size_t dataSize);
 
@@ -288,6 +368,11 @@ class Connection:public Object
 		 */
 		int receivedData (fd_set *read_set) { return FD_ISSET (sock, read_set); }
 
+		/**
+		 * Returns connection socket, -1 if socket is not opened.
+		 */
+		int getSocket () { return sock; }
+
 		/**
 		 * Called when select call indicates that socket holds new
 		 * data for reading.
@@ -668,6 +753,28 @@ class Connection:public Object
 		 */
 		int sock;
 
+		/**
+		 * Read data from connection socket. Called when socket is ready for reading.
+		 *
+		 * @return -1 on error, 0 or size of data in buffer on success.
+		 */
+		int readSocket ();
+
+		/**
+		 * Write queued data or finish non-blocking connect. Called when socket is ready for writing.
+		 *
+		 * @return -1 on error, 0 on success.
+		 */
+		int writeSocket ();
+
+		/**
+		 * Pass descriptor reported by event poll to receive and
+		 * writable through fd_set. Intended for pollReady of
+		 * connections which implement only fd_set interface.
+		 * Descriptor above FD_SETSIZE cannot be passed, -1 is returned for it.
+		 */
+		int pollReadySelect (int fd, uint32_t events);
+
 		/**
 		 * Check if buffer is fully filled. If that's the case, increase buffer size.
 		 */
@@ -786,6 +893,54 @@ class Connection:public Object
 		// ID of outgoing data connection
 		int dataConn;
 
+		// coalesced outgoing messages
+		std::string outputBuffer;
+		unsigned long outputBufferMessages;
+
+		// data which were not accepted by non-blocking socket, written when socket becomes writable
+		std::string writeQueue;
+		// start of unwritten data in writeQueue; written data are removed only when they form larger part of the queue
+		size_t writeQueueOffset;
+		// time of the last write progress while writeQueue was not empty
+		time_t writeQueueProgress;
+
+		/**
+		 * Write all data from I/O vector to connection socket. Handles
+		 * partial writes and EINTR. If the socket is non-blocking and its
+		 * buffer is full, the rest of data is put to the write queue and
+		 * written when the socket becomes writable. Data are queued as well
+		 * if the write queue is not empty, so their order is kept. Blocks
+		 * only if more than CONN_WRITE_QUEUE_MAX bytes are queued, until
+		 * the other side accepts data below that mark; fails if it does not
+		 * happen in connection timeout. I/O vector is modified during the call.
+		 *
+		 * @param iov     I/O vector
+		 * @param iovcnt  number of I/O vector entries
+		 *
+		 * @return -1 on error, otherwise number of bytes written or queued
+		 */
+		ssize_t writeVector (struct iovec *iov, int iovcnt);
+
+		/**
+		 * Returns number of bytes waiting in the write queue.
+		 */
+		size_t writeQueueSize () { return writeQueue.size () - writeQueueOffset; }
+
+		/**
+		 * Remove all data from the write queue.
+		 */
+		void clearWriteQueue ();
+
+		/**
+		 * Block until at most limit bytes wait in the write queue.
+		 *
+		 * @param limit    number of bytes which can stay in the queue
+		 * @param timeout  maximal wait in milliseconds
+		 *
+		 * @return -1 on error or timeout, 0 on success
+		 */
+		int waitWriteQueue (size_t limit, int timeout);
+
 		// connectionTimeout in seconds
 		int connectionTimeout;
 		conn_state_t conn_state;
@@ -821,6 +976,11 @@ class Connection:public Object
 		 */
 		ValueVector values;
 
+		/**
+		 * Index of connection values by name.
+		 */
+		std::map <std::string, Value *, ValueNameCompare> valueIndex;
+
 		/**
 		 * Time when last information was received.
 		 */
@@ -842,6 +1002,13 @@ class Connection:public Object
 		 * Called when some data were sucessfully received.
 		 */
 		void dataReceived ();
+
+		/**
+		 * Pass new data written by the camera to shared memory to the
+		 * other device, and report them as read, so the camera sees
+		 * actual reader lag.
+		 */
+		void processSharedData ();
 };
 
 }
@@ -43,6 +43,7 @@ class BAIT: public ConnTCP
 		virtual int idle ();
 		
 		virtual int receive (fd_set *fset);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		/**
 		 * Sends command, wait for reply.
@@ -64,14 +64,18 @@ class ConnFork:public ConnNoSend
 		 */
 		virtual void processLine ();
 
-		void setInput (std::string _input) { input = _input; }
+		void setInput (std::string _input);
 
 		virtual int add (fd_set * readset, fd_set * writeset, fd_set * expset);
 
+		virtual void addPoll (rts2core::EventPoll *poll);
+
 		virtual int receive (fd_set * readset);
 
 		virtual int writable (fd_set * writeset);
 
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
+
 		/**
 		 * Create and execute processing.
 		 *
@@ -72,6 +72,7 @@ class OpenTpl: public ConnTCP
 		virtual int idle ();
 		
 		virtual int receive (fd_set *fset);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		int set (const char *_name, double value, int *tpl_status, bool wait=true);
 		int get (const char *_name, double &value, int *tpl_status);
@@ -40,6 +40,7 @@ class ConnUDP:public ConnNoSend
 		ConnUDP (int _port, rts2core::Block * _master, size_t _maxSize = 500);
 		virtual int init ();
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 	protected:
 		/**
 		 * Process received data. Data are stored in buf member variable.
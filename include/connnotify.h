@@ -73,6 +73,7 @@ class ConnNotify:public ConnNoSend
 		 * @return -1 on error, 0 on success.
 		 */
 		virtual int receive (fd_set * readset);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		bool getDebug () { return debug; }
 
@@ -129,6 +129,7 @@ class Daemon:public rts2core::Block
 
 		virtual void addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 		virtual void selectSuccess (fd_set &_read_set, fd_set &_write_set, fd_set &_exp_set);
+		virtual void pollSuccess (int fd, uint32_t events);
 
 		virtual int setValue (Connection * conn);
 
@@ -627,6 +628,9 @@ class Daemon:public rts2core::Block
 		pid_t watched_child;
 		int listen_sock;
 		void addConnectionSock (int in_sock);
+
+		// use epoll based event loop
+		bool useEventPoll;
 		const char * lock_fname;
 		int lock_file;
 
@@ -642,6 +646,11 @@ class Daemon:public rts2core::Block
 
 		ValueTime *info_time;
 
+		// output coalescing statistics, NULL if coalescing is not enabled
+		ValueLong *outputMessages;
+		ValueLong *outputWrites;
+		ValueLong *outputBytes;
+
 		double idleInfoInterval;
 
 		bool doHupIdleLoop;
@@ -21,11 +21,14 @@
 #define __RTS2_DATA__
 
 #include <errno.h>
+#include <map>
+#include <stdint.h>
+#include <string>
 #include <unistd.h>
 #include <vector>
 
-// maximal number of shared clients
-#define MAX_SHARED_CLIENTS       10
+// maximal number of shared clients reading single segment
+#define MAX_SHARED_CLIENTS       64
 
 namespace rts2core
 {
@@ -175,24 +178,31 @@ struct SharedDataHeader
 {
 	// number of data buffers.
 	int nseg;
-	// semaphore associated with data; it has nbuffers values, each associated with a single buffer
-	int shared_sem;
-	// shared client IDs, segment sizes - SharedData - follows immediately this field
+	// segment which will be tried first in next allocation; segments are used as a ring
+	int nextseg;
+	// segment headers - SharedDataSegment - follows immediately this field
 };
 
 /**
  * Shared data segment header. Described segments of shared data.
  *
+ * Segment is owned by the writer (camera) and can be reused only when all
+ * client_ids slots are empty. Only writer fills client_ids slots, and only
+ * when all of them are empty; readers only clear their slot. All slot
+ * updates are atomic, so no lock is needed.
+ *
  * @author Petr Kubanek <petr@kubanek.net>
  */
 struct SharedDataSegment
 {
-	// ID of client connection reading data. Data cannot be reused if this field is non-empty.
-	int client_ids[MAX_SHARED_CLIENTS];
+	// ID of client connections reading data. Data cannot be reused if any of this fields is non-zero.
+	volatile int32_t client_ids[MAX_SHARED_CLIENTS];
+	// number of bytes read (processed) by client in the slot
+	volatile uint64_t client_read[MAX_SHARED_CLIENTS];
 	// segment size
 	size_t size;
 	// size of written data (so far; process can update this as new data arrives
-	size_t bytesSoFar;
+	volatile size_t bytesSoFar;
 	// segment offset
 	size_t offset;
 };
@@ -200,15 +210,21 @@ struct SharedDataSegment
 /**
  * Encampulates basic shared data management functions.
  *
+ * Data are stored in POSIX shared memory object, which readers open by
+ * its name.
+ *
  * @author Petr Kubanek <petr@kubanek.net>
  */
 class DataAbstractShared
 {
 	public:
-		DataAbstractShared () { data = NULL; shm_id = -1; }
-		DataAbstractShared (DataAbstractShared *d) { data = d->data; shm_id = -1; }
+		DataAbstractShared () { data = NULL; mapSize = 0; }
+		DataAbstractShared (DataAbstractShared *d) { data = d->data; shm_name = d->shm_name; mapSize = 0; }
 
-		int getShmId () { return shm_id; }
+		/**
+		 * Returns name of POSIX shared memory object.
+		 */
+		const char *getShmName () { return shm_name.c_str (); }
 
 		/**
 		 * Remove client from reader set.
@@ -218,12 +234,15 @@ class DataAbstractShared
 	protected:
 		struct SharedDataSegment *getSegment (int segnum) { return (struct SharedDataSegment *) (((char *) data) + sizeof (struct SharedDataHeader) + segnum * sizeof (struct SharedDataSegment)); }
 
-		// semaphore op
-		int lockSegment (int seg);
-		int unlockSegment (int seg);
+		/**
+		 * Unmap shared memory, if it was mapped by this instance.
+		 */
+		void unmap ();
 
 		struct SharedDataHeader *data;
-		int shm_id;
+		std::string shm_name;
+		// size of mapped memory, 0 for shallow copies
+		size_t mapSize;
 };
 
 /**
@@ -237,7 +256,7 @@ class DataSharedRead: public DataAbstractRead, public DataAbstractShared
 		/**
 		 * Crate new DataSharedRead structure, prepare it for attach call.
 		 */
-		DataSharedRead () { data = NULL; segment = -1; activeSegment = NULL; shm_id = -1; }
+		DataSharedRead () { data = NULL; segment = -1; activeSegment = NULL; consumed = 0; }
 
 
 		/**
@@ -246,11 +265,18 @@ class DataSharedRead: public DataAbstractRead, public DataAbstractShared
 		 * @param _data   
 		 * @param _seg
 		 */
-		DataSharedRead (DataSharedRead *_data, int _seg) { data = _data->data; segment = _seg; activeSegment = getSegment (_seg); shm_id = -1; }
+		DataSharedRead (DataSharedRead *_data, int _seg):DataAbstractShared (_data) { segment = _seg; activeSegment = getSegment (_seg); consumed = 0; }
 
 		virtual ~DataSharedRead ();
 
-		int attach (int _shm_id);
+		/**
+		 * Map shared memory object.
+		 *
+		 * @param _shm_name  name of POSIX shared memory object
+		 *
+		 * @return -1 on error, 0 on success
+		 */
+		int attach (const char *_shm_name);
 
 		virtual int readDataSize (Connection *conn) { return 0; }
 		virtual ssize_t addData (char *_data, ssize_t _data_size) { return -1; }
@@ -261,12 +287,26 @@ class DataSharedRead: public DataAbstractRead, public DataAbstractShared
 		virtual size_t getChunkSize () { return getRestSize (); }
 
 		int confirmClient (int segnum, int client_id);
+
+		/**
+		 * Report number of bytes processed by the client. Used by
+		 * writer to calculate reader lag.
+		 */
+		void markRead (int client_id, size_t bytes);
+
+		/**
+		 * Returns true if writer added data since the last markRead call.
+		 */
+		bool hasNewData () { return (size_t) (getDataTop () - getDataBuff ()) > consumed; }
+
 		int removeActiveClient (int client_id) { return removeClient (segment, client_id); }
 
 	private:
 		// shared data segment
 		struct SharedDataSegment *activeSegment;
 		int segment;
+		// bytes reported by markRead
+		size_t consumed;
 };
 
 /**
@@ -334,21 +374,59 @@ class DataSharedWrite:public DataAbstractWrite, public DataAbstractShared
 
 		virtual size_t getDataSize ();
 		virtual size_t getChannelSize (int chan) { return chan2seg[chan]->size - chan2seg[chan]->bytesSoFar; }
-		virtual void dataWritten (int chan, size_t size) { chan2seg[chan]->bytesSoFar += size; }
+		virtual void dataWritten (int chan, size_t size);
 
 		/**
 		 * Find unused segment, allocate it for a single client.
 		 *
 		 * @param segsize   segment size
 		 * @param chan      channel for which segment is allocated
+		 * @param client    client ID
+		 */
+		int addClient (size_t segsize, int chan, int client) { std::vector <int> clients; clients.push_back (client); return addClients (segsize, chan, clients); }
+
+		/**
+		 * Find unused segment, allocate it for set of clients. Segments
+		 * are searched as a ring, starting after the last allocated segment,
+		 * so recently released segments are reused last.
+		 *
+		 * @param segsize   segment size
+		 * @param chan      channel for which segment is allocated
+		 * @param clients   IDs of clients which will read the segment
+		 *
+		 * @return -1 if there isn't any free segment, or number of allocated segment
 		 */
-		int addClient (size_t segsize, int chan, int client);
+		int addClients (size_t segsize, int chan, const std::vector <int> &clients);
 
 		virtual void endChannels ();
 		void clearChan2Seg () { chan2seg.clear (); }
 
 		void *getChannelData (int chan) { return ((char *) data) + chan2seg[chan]->offset; }
 
+		/**
+		 * Returns number of segments.
+		 */
+		int getSegmentNumber () { return data ? data->nseg : 0; }
+
+		/**
+		 * Returns number of segments which are not read by any client.
+		 */
+		int getFreeSegments ();
+
+		/**
+		 * Remove shared memory objects left by writers which are not
+		 * running, e.g. after a camera crash.
+		 */
+		static void removeStale ();
+
+		/**
+		 * Returns unread data of all clients holding segments.
+		 *
+		 * @param lag   map of client IDs to number of bytes written, but not yet processed by the client
+		 * @param held  map of client IDs to number of segments the client holds
+		 */
+		void getClientLag (std::map <int, size_t> &lag, std::map <int, int> &held);
+
 	private:
 		// maps channels to segments
 		std::map <int, struct SharedDataSegment *> chan2seg;
@@ -362,9 +440,14 @@ class DataSharedWrite:public DataAbstractWrite, public DataAbstractShared
 class DataChannels:public std::vector <DataAbstractRead *>
 {
 	public:
-		DataChannels () {}
+		DataChannels () { shared = false; }
 		~DataChannels ();
 
+		/**
+		 * Returns true if channels are read from shared memory.
+		 */
+		bool isShared () { return shared; }
+
 		/**
 		 * Initiliaze data channels from connection. Expect to receive number of channels and their size.
 		 *
@@ -395,6 +478,9 @@ class DataChannels:public std::vector <DataAbstractRead *>
 		size_t getChunkSize (int chan) { return at(chan)->getChunkSize (); }
 
 		size_t getRestSize ();
+
+	private:
+		bool shared;
 };
 
 }
@@ -0,0 +1,213 @@
+/*
+ * epoll/timerfd based event engine.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_EVENTPOLL__
+#define __RTS2_EVENTPOLL__
+
+#include "rts2-config.h"
+
+#include <map>
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+namespace rts2core
+{
+
+class Connection;
+
+/**
+ * Event engine based on Linux epoll and timerfd calls.
+ *
+ * Descriptors are registered once and kept registered in kernel. Owners
+ * (connections) are asked to report descriptors they are interested in
+ * between beginOwner and endOwner calls; EventPoll issues epoll_ctl only
+ * when the interest changes. wait then returns only descriptors which are
+ * ready, so the dispatch costs depends only on number of active
+ * descriptors. Ready descriptors are passed to Connection::pollReady,
+ * so there isn't FD_SETSIZE limit on descriptor number.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class EventPoll
+{
+	public:
+		/**
+		 * Descriptor is ready for reading (or is closed).
+		 */
+		static const uint32_t READ = 0x01;
+
+		/**
+		 * Descriptor is ready for writing.
+		 */
+		static const uint32_t WRITE = 0x02;
+
+		EventPoll ();
+		~EventPoll ();
+
+		/**
+		 * Creates epoll and timer descriptors.
+		 *
+		 * @return -1 on error, 0 on success
+		 */
+		int init ();
+
+		/**
+		 * Returns true if epoll support was compiled in.
+		 */
+		static bool available ();
+
+		/**
+		 * Register interest for a descriptor. Does not issue system
+		 * call if the descriptor is already registered with the same
+		 * owner and interest mask.
+		 *
+		 * @param fd      file descriptor
+		 * @param events  combination of READ and WRITE
+		 * @param owner   connection owning descriptor, NULL for descriptors owned by the block
+		 */
+		void watch (int fd, uint32_t events, Connection *owner = NULL);
+
+		/**
+		 * Removes descriptor from the watched set. If owner is
+		 * specified, descriptor is removed only if it is still
+		 * registered with the owner.
+		 */
+		void unwatch (int fd, Connection *owner = NULL);
+
+		/**
+		 * Start registration round for an owner. All watch calls
+		 * up to endOwner are recorded. If state or socket differs
+		 * from the one recorded in last round, all descriptors are
+		 * registered again - that catches descriptors closed and
+		 * reopened with the same number.
+		 */
+		void beginOwner (Connection *owner, int state, int sock);
+
+		/**
+		 * Returns true if owner was not registered yet, or its state
+		 * or socket changed since the last registration round.
+		 */
+		bool ownerChanged (Connection *owner, int state, int sock);
+
+		/**
+		 * Ends registration round. Descriptors registered in previous
+		 * round, which were not reported in this round, are removed.
+		 */
+		void endOwner (Connection *owner);
+
+		/**
+		 * Removes all descriptors owned by the owner.
+		 */
+		void removeOwner (Connection *owner);
+
+		/**
+		 * Arm timer to fire at given time.
+		 *
+		 * @param at  time (ctime, as returned by getNow) when the timer shall fire; NAN to disarm
+		 */
+		void setTimer (double at);
+
+		/**
+		 * Wait for events.
+		 *
+		 * @param usec_timeout  timeout in usec
+		 *
+		 * @return number of ready descriptors, -1 on error
+		 */
+		int wait (long usec_timeout);
+
+		/**
+		 * Returns number of ready descriptors from last wait call.
+		 */
+		size_t readySize () { return ready.size (); }
+
+		int readyFd (size_t i) { return ready[i].fd; }
+
+		uint32_t readyEvents (size_t i) { return ready[i].events; }
+
+		/**
+		 * Returns owner of the descriptor. Returns NULL if the
+		 * descriptor is owned by the block or is not registered.
+		 */
+		Connection *getOwner (int fd);
+
+		/**
+		 * Returns true if descriptor is registered.
+		 */
+		bool isWatched (int fd) { return fds.find (fd) != fds.end (); }
+
+		/**
+		 * Returns timer file descriptor.
+		 */
+		int getTimerFd () { return timer_fd; }
+
+		/**
+		 * Close descriptors. Called in forked child, so it will not modify epoll set of the parent.
+		 */
+		void closeFds ();
+
+	private:
+		int epoll_fd;
+		int timer_fd;
+		double timer_armed;
+
+		struct PollEntry
+		{
+			Connection *owner;
+			uint32_t events;
+			unsigned int round;
+		};
+
+		struct ReadyEntry
+		{
+			int fd;
+			uint32_t events;
+		};
+
+		struct OwnerEntry
+		{
+			int state;
+			int sock;
+			unsigned int round;
+			bool force;
+			std::vector <int> fds;
+		};
+
+		std::map <int, PollEntry> fds;
+		std::map <Connection *, OwnerEntry> owners;
+		std::vector <ReadyEntry> ready;
+
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+		std::vector <struct epoll_event> events_buf;
+#endif
+
+		// currently running owner round
+		OwnerEntry *current;
+
+		int ctl (int op, int fd, uint32_t events);
+};
+
+}
+
+#endif // !__RTS2_EVENTPOLL__
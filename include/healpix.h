@@ -0,0 +1,220 @@
+/*
+ * HEALPix nested pixelisation routines.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_HEALPIX__
+#define __RTS2_HEALPIX__
+
+/**
+ * @file
+ * Minimal implementation of HEALPix (Gorski et al., 2005) nested scheme,
+ * used to index target positions. Header is plain C, so it can be included
+ * in the PostgreSQL extension as well as in C++ code.
+ *
+ * Pixels of order o (nside = 2^o) are numbered so that pixel p of order o
+ * contains pixels p * 4 .. p * 4 + 3 of order o + 1. Pixels of a cell of
+ * lower order thus form a continuous range of higher order pixel numbers.
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * Order of pixel stored in targets table (tar_hpix column). Pixels are
+ * about 3.4 arcmin across.
+ */
+#define HEALPIX_TARGET_ORDER   10
+
+/**
+ * Maximal supported order.
+ */
+#define HEALPIX_MAX_ORDER      29
+
+static inline int64_t healpix_spread_bits (int64_t v)
+{
+	v &= 0xffffffffLL;
+	v = (v | (v << 16)) & 0x0000ffff0000ffffLL;
+	v = (v | (v << 8)) & 0x00ff00ff00ff00ffLL;
+	v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fLL;
+	v = (v | (v << 2)) & 0x3333333333333333LL;
+	v = (v | (v << 1)) & 0x5555555555555555LL;
+	return v;
+}
+
+static inline int64_t healpix_compress_bits (int64_t v)
+{
+	v &= 0x5555555555555555LL;
+	v = (v | (v >> 1)) & 0x3333333333333333LL;
+	v = (v | (v >> 2)) & 0x0f0f0f0f0f0f0f0fLL;
+	v = (v | (v >> 4)) & 0x00ff00ff00ff00ffLL;
+	v = (v | (v >> 8)) & 0x0000ffff0000ffffLL;
+	v = (v | (v >> 16)) & 0x00000000ffffffffLL;
+	return v;
+}
+
+/**
+ * Number of pixels of the given order.
+ */
+static inline int64_t healpix_npix (int order)
+{
+	return 12LL << (2 * order);
+}
+
+/**
+ * Returns nested pixel number containing given position.
+ *
+ * @param order  pixel order, 0 - HEALPIX_MAX_ORDER
+ * @param ra     right ascension (degrees)
+ * @param dec    declination (degrees)
+ */
+static inline int64_t healpix_ang2pix_nest (int order, double ra, double dec)
+{
+	int64_t nside = 1LL << order;
+	double z = sin (dec * M_PI / 180.0);
+	double za = fabs (z);
+	double tt = fmod (ra / 90.0, 4.0);
+	int64_t ix, iy, face;
+
+	if (tt < 0)
+		tt += 4.0;
+
+	if (za <= 2.0 / 3.0)
+	{
+		double temp1 = nside * (0.5 + tt);
+		double temp2 = nside * z * 0.75;
+		int64_t jp = (int64_t) (temp1 - temp2);
+		int64_t jm = (int64_t) (temp1 + temp2);
+		int64_t ifp = jp >> order;
+		int64_t ifm = jm >> order;
+		if (ifp == ifm)
+			face = ifp | 4;
+		else if (ifp < ifm)
+			face = ifp;
+		else
+			face = ifm + 8;
+		ix = jm & (nside - 1);
+		iy = nside - (jp & (nside - 1)) - 1;
+	}
+	else
+	{
+		int ntt = (int) tt;
+		double tp, tmp;
+		int64_t jp, jm;
+		if (ntt >= 4)
+			ntt = 3;
+		tp = tt - ntt;
+		tmp = nside * sqrt (3 * (1 - za));
+		jp = (int64_t) (tp * tmp);
+		jm = (int64_t) ((1.0 - tp) * tmp);
+		if (jp >= nside)
+			jp = nside - 1;
+		if (jm >= nside)
+			jm = nside - 1;
+		if (z >= 0)
+		{
+			face = ntt;
+			ix = nside - jm - 1;
+			iy = nside - jp - 1;
+		}
+		else
+		{
+			face = ntt + 8;
+			ix = jp;
+			iy = jm;
+		}
+	}
+
+	return (face << (2 * order)) + healpix_spread_bits (ix) + (healpix_spread_bits (iy) << 1);
+}
+
+/**
+ * Returns position of the nested pixel center.
+ *
+ * @param order  pixel order
+ * @param pix    pixel number
+ * @param ra     returned right ascension (degrees, 0 - 360)
+ * @param dec    returned declination (degrees)
+ */
+static inline void healpix_pix2ang_nest (int order, int64_t pix, double *ra, double *dec)
+{
+	static const int jrll[12] = {2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4};
+	static const int jpll[12] = {1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7};
+
+	int64_t nside = 1LL << order;
+	int64_t npface = nside * nside;
+	int face = (int) (pix >> (2 * order));
+	int64_t ipf = pix & (npface - 1);
+	int64_t ix = healpix_compress_bits (ipf);
+	int64_t iy = healpix_compress_bits (ipf >> 1);
+	int64_t jr = ((int64_t) jrll[face] << order) - ix - iy - 1;
+	int64_t nr, jp;
+	int kshift;
+	double z;
+
+	if (jr < nside)
+	{
+		nr = jr;
+		z = 1 - (double) (nr * nr) / (3.0 * npface);
+		kshift = 0;
+	}
+	else if (jr > 3 * nside)
+	{
+		nr = 4 * nside - jr;
+		z = (double) (nr * nr) / (3.0 * npface) - 1;
+		kshift = 0;
+	}
+	else
+	{
+		nr = nside;
+		z = (2 * nside - jr) * 2.0 / (3.0 * nside);
+		kshift = (jr - nside) & 1;
+	}
+
+	jp = (jpll[face] * nr + ix - iy + 1 + kshift) / 2;
+	if (jp > 4 * nside)
+		jp -= 4 * nside;
+	if (jp < 1)
+		jp += 4 * nside;
+
+	*ra = (jp - (kshift + 1) * 0.5) * (90.0 / nr);
+	*dec = asin (z) * 180.0 / M_PI;
+}
+
+/**
+ * Returns upper limit of angular distance between pixel center and any
+ * point of the pixel (degrees).
+ */
+static inline double healpix_max_pixrad (int order)
+{
+	double nside = (double) (1LL << order);
+	/* between (z = 2/3, phi = pi / (4 nside)) and (z = 1 - t1 / 3, phi = 0) */
+	double z1 = 2.0 / 3.0;
+	double phi1 = M_PI / (4.0 * nside);
+	double t1 = 1.0 - 1.0 / nside;
+	double z2, s1, s2, c;
+	t1 *= t1;
+	z2 = 1 - t1 / 3.0;
+	s1 = sqrt ((1 - z1) * (1 + z1));
+	s2 = sqrt ((1 - z2) * (1 + z2));
+	c = z1 * z2 + s1 * s2 * cos (phi1);
+	if (c > 1)
+		c = 1;
+	return acos (c) * 180.0 / M_PI;
+}
+
+#endif /* !__RTS2_HEALPIX__ */
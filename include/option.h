@@ -58,6 +58,10 @@
 
 #define OPT_DEFAULTS        1015
 
+#define OPT_EPOLL           1016
+
+#define OPT_COALESCE        1017
+
 /**
  * Start of local option number playground.
  */
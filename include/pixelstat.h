@@ -0,0 +1,217 @@
+/*
+ * Single pass pixel statistics (sum, min, max, variance, mode).
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_PIXELSTAT__
+#define __RTS2_PIXELSTAT__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Number of bins in mode histogram.
+ */
+#define PIXELSTAT_HISTOGRAM_SIZE   65536
+
+namespace rts2core
+{
+
+/**
+ * Computes sum, minimum, maximum and mode of pixel data in a single pass.
+ * Statistics are accumulated over multiple update calls, so it can be fed
+ * with readout chunks as they arrive.
+ *
+ * Sum, minimum and maximum are computed with SSE2/AVX2 instructions for 8,
+ * 16 and 32 bit integer, float and double data, if the compiler targets
+ * those instruction sets. 64 bit integers use scalar loop, as do floating
+ * point data when histogram is filled.
+ *
+ * Sum of squared deviations from the mean can be accumulated in the same
+ * pass. It is exact for 8 and 16 bit data. Other types accumulate squares of
+ * deviations from the running mean (or from the mean of a few first pixels),
+ * and moments of update calls are merged with Chan's formula.
+ *
+ * Mode is computed from bounded histogram of PIXELSTAT_HISTOGRAM_SIZE
+ * bins. For 8 and 16 bit data every value has its own bin. For other data
+ * types, values are rounded to integers, and only values between 0 and
+ * PIXELSTAT_HISTOGRAM_SIZE - 1 are counted. Mode is tracked incrementally
+ * while the histogram is filled, so it is known without histogram scan.
+ * Histogram can be disabled when only sum, minimum and maximum are needed.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class PixelStatistics
+{
+	public:
+		/**
+		 * @param _mode     if false, mode histogram is not allocated and filled
+		 * @param _squares  if true, sum of squared deviations from the mean is accumulated
+		 */
+		PixelStatistics (bool _mode = true, bool _squares = false);
+		~PixelStatistics ();
+
+		/**
+		 * Reset statistics, including mode histogram.
+		 */
+		void reset ();
+
+		/**
+		 * Reset sum, sum of squares, minimum, maximum and pixel count. Histogram is
+		 * kept, so it can be accumulated over data processed in
+		 * smaller blocks.
+		 */
+		void resetSums ();
+
+		/**
+		 * Update statistics with new data.
+		 *
+		 * @param dataType  data type, one of the RTS2_DATA_xxx constants
+		 * @param data      pixel data
+		 * @param dataSize  data size in bytes
+		 *
+		 * @return number of pixels processed
+		 */
+		size_t update (int dataType, const char *data, size_t dataSize);
+
+		size_t update (const uint8_t *data, size_t n);
+		size_t update (const int8_t *data, size_t n);
+		size_t update (const uint16_t *data, size_t n);
+		size_t update (const int16_t *data, size_t n);
+		size_t update (const uint32_t *data, size_t n);
+		size_t update (const int32_t *data, size_t n);
+		size_t update (const int64_t *data, size_t n);
+		size_t update (const float *data, size_t n);
+		size_t update (const double *data, size_t n);
+
+		double getSum () { return sum; }
+		double getMin () { return min; }
+		double getMax () { return max; }
+
+		/**
+		 * Sum of squared deviations of pixel values from their mean.
+		 * Accumulated only if squares were enabled in constructor.
+		 */
+		double getM2 () { return m2; }
+
+		/**
+		 * Number of pixels processed since last reset.
+		 */
+		size_t getCount () { return count; }
+
+		double getAverage ();
+
+		/**
+		 * Returns most often pixel value, NAN if no pixel was counted in the histogram.
+		 */
+		double getMode ();
+
+		/**
+		 * Returns histogram of pixel values, NULL if histogram is
+		 * disabled or empty. Bin i holds count of pixel value i + getHistogramOffset ().
+		 */
+		const uint32_t *getHistogram () { return histUsed ? histogram : NULL; }
+		long getHistogramOffset () { return histOffset; }
+
+		/**
+		 * Returns name of the vectorized kernel compiled in - AVX2, SSE2 or scalar.
+		 */
+		static const char *getKernelName ();
+
+	private:
+		double sum;
+		double min;
+		double max;
+		size_t count;
+
+		bool squares;
+		double m2;
+
+		uint32_t *histogram;
+		// value of the first histogram bin
+		long histOffset;
+		// true if histogram holds some values
+		bool histUsed;
+
+		uint32_t modeCount;
+		long modeBin;
+
+		/**
+		 * Prepare histogram for a data type with given offset.
+		 */
+		void setHistogramOffset (long offset);
+
+		void histAdd (long bin)
+		{
+			if (histogram != NULL && (unsigned long) bin < PIXELSTAT_HISTOGRAM_SIZE)
+			{
+				uint32_t c = ++histogram[bin];
+				if (c > modeCount)
+				{
+					modeCount = c;
+					modeBin = bin;
+				}
+			}
+		}
+
+		void updateMinMax (double tMin, double tMax)
+		{
+			if (tMin < min)
+				min = tMin;
+			if (tMax > max)
+				max = tMax;
+		}
+
+		/**
+		 * Merge moments of new pixels. Must be called before sum and count are updated.
+		 *
+		 * @param n   number of new pixels
+		 * @param s   sum of new pixel values
+		 * @param q   sum of squared deviations of new pixel values from their mean
+		 */
+		void addMoments (size_t n, double s, double q);
+
+		/**
+		 * Value subtracted from pixels before squares are accumulated -
+		 * running mean, or mean of a few first valid pixels.
+		 */
+		template <typename t> double getShift (const t *data, size_t n);
+
+		template <bool sq> size_t kernel (const uint8_t *data, size_t n);
+		template <bool sq> size_t kernel (const int8_t *data, size_t n);
+		template <bool sq> size_t kernel (const uint16_t *data, size_t n);
+		template <bool sq> size_t kernel (const int16_t *data, size_t n);
+		template <bool sq> size_t kernel (const uint32_t *data, size_t n);
+		template <bool sq> size_t kernel (const int32_t *data, size_t n);
+		template <bool sq> size_t kernel (const float *data, size_t n);
+		template <bool sq> size_t kernel (const double *data, size_t n);
+
+		/**
+		 * Kernels for floating point data without NaN. NaN propagates to
+		 * the sums, in that case statistics are not updated and false is
+		 * returned.
+		 */
+		template <bool sq> bool kernelNoNaN (const float *data, size_t n);
+		template <bool sq> bool kernelNoNaN (const double *data, size_t n);
+
+		template <typename t, bool sq> size_t updateScalarFloat (const t *data, size_t n);
+		template <typename t, typename sum_t, bool sq> size_t updateScalarInt (const t *data, size_t n, long offset);
+};
+
+}
+
+#endif // !__RTS2_PIXELSTAT__
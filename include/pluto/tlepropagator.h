@@ -0,0 +1,165 @@
+/*
+ * Propagator of satellite position from two line elements.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_TLEPROPAGATOR__
+#define __RTS2_TLEPROPAGATOR__
+
+#include "pluto/norad.h"
+
+#include <stddef.h>
+
+// ephemeris models, as used by tle_ephem
+#define TLE_SGP     0
+#define TLE_SGP4    1
+#define TLE_SGP8    2
+#define TLE_SDP4    3
+#define TLE_SDP8    4
+
+/**
+ * Calculates satellite position from two line elements. Model parameters
+ * are initialised once, when elements are loaded or model is changed, and
+ * reused for all positions. Position calculations do not change propagator
+ * state, so they can be called from multiple threads.
+ *
+ * All angles are in radians, all times are julian dates.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class TLEPropagator
+{
+	public:
+		TLEPropagator ();
+
+		/**
+		 * Parse two line elements and initialise model. SGP4 or SDP4
+		 * is selected, depending on satellite period.
+		 *
+		 * @return 0 on success, parse_elements error code otherwise
+		 */
+		int load (const char *line1, const char *line2);
+
+		/**
+		 * Set ephemeris model (TLE_SGP, ..). Near-Earth models are switched to deep space
+		 * models and vice versa, depending on satellite period.
+		 *
+		 * @return selected model
+		 */
+		int setEphem (int _ephem);
+		int getEphem () { return ephem; }
+
+		bool isLoaded () { return loaded; }
+
+		const tle_t *getTLE () { return &tle; }
+
+		/**
+		 * Set observer position.
+		 *
+		 * @param _lng      longitude (east positive)
+		 * @param _lat      latitude
+		 * @param altitude  altitude above sea level in meters
+		 */
+		void setObserver (double _lng, double _lat, double altitude);
+
+		/**
+		 * Set observer position from precalculated parallax constants.
+		 */
+		void setObserver (double _lng, double _lat, double _rho_cos_phi, double _rho_sin_phi);
+
+		/**
+		 * Calculate topocentric position of the satellite.
+		 *
+		 * @param JD        date
+		 * @param ra        right ascension (of date)
+		 * @param dec       declination (of date)
+		 * @param distance  distance from observer in km
+		 * @param alt       if not NULL, altitude above horizon
+		 *
+		 * @return 0 on success, SXPX_ERR_ code when position cannot be calculated
+		 */
+		int getPosition (double JD, double &ra, double &dec, double &distance, double *alt = NULL);
+
+		/**
+		 * Calculate positions on regular time grid. Any of output
+		 * arrays can be NULL.
+		 *
+		 * @param JD    date of the first position
+		 * @param step  time between positions, in days
+		 * @param n     number of positions
+		 *
+		 * @return 0 on success, SXPX_ERR_ code when any of positions cannot be calculated
+		 */
+		int getPositions (double JD, double step, size_t n, double *ra, double *dec, double *distance, double *alt);
+
+		/**
+		 * Calculate positions of many satellites for the same date. Observer
+		 * position is taken from the first satellite. Any of output arrays can be NULL.
+		 *
+		 * @return number of satellites whose position cannot be calculated; their positions are NAN
+		 */
+		static int getPositions (TLEPropagator **sats, size_t n, double JD, double *ra, double *dec, double *distance, double *alt);
+
+		/**
+		 * Find next pass of the satellite over horizon. Altitudes are
+		 * sampled on grid with given step, crossings and culmination
+		 * are then refined to better than a second.
+		 *
+		 * @param JD       search start
+		 * @param horizon  horizon altitude
+		 * @param rise     next rise after JD, NAN if not found
+		 * @param set      next set after JD, NAN if not found
+		 * @param transit  next culmination after JD, NAN if not found
+		 * @param span     search length, in days
+		 * @param step     sampling step, in days; shall be shorter than the shortest pass
+		 *
+		 * @return 0 if satellite crosses horizon, 1 if it is above horizon whole time, -1 if it is bellow horizon or cannot be calculated
+		 */
+		int getRST (double JD, double horizon, double &rise, double &set, double &transit, double span = 1, double step = 60 / 86400.0);
+
+	private:
+		tle_t tle;
+		int ephem;
+		bool loaded;
+		double params[N_SAT_PARAMS];
+
+		double lng;
+		double lat;
+		double rho_cos_phi;
+		double rho_sin_phi;
+
+		void init ();
+
+		/**
+		 * Propagate satellite to given date, calculate inertial position in km.
+		 */
+		int propagate (double JD, double *sat_pos);
+
+		/**
+		 * Calculate position of the satellite relative to the observer.
+		 */
+		void topocentric (const double *observer_loc, const double *sat_pos, double &ra, double &dec, double &distance, double *alt);
+
+		double getAltitude (double JD);
+
+		// refine horizon crossing between two dates by bisection
+		double findCrossing (double jd1, double jd2, double horizon);
+		// refine culmination between two dates by golden section search
+		double findTransit (double jd1, double jd2);
+};
+
+#endif // !__RTS2_TLEPROPAGATOR__
@@ -98,13 +98,26 @@ class Constraint
 		 *
 		 * @param tar  target which is checked for constraint
 		 * @param JD   date (Julian Day) checked
-		 * @param nextJD  returned hint about next time a change in satisfy/violated might occur; nan if the hint is not available, 0 if it cannot be computed
+		 * @param nextJD  returned time (Julian Day) before which satisfaction does not change; nan if it does not change, 0 if the time cannot be estimated
 		 *
 		 * @return true if constraint is satisfied
 		 *
 		 */
 		virtual bool satisfy (Target *tar, double JD, double *nextJD) = 0;
 
+		/**
+		 * Check if constraint is satisfied at given time, using
+		 * target values from ephemeris tables where possible.
+		 *
+		 * @param tar  target which is checked for constraint
+		 * @param eph  target ephemeris
+		 * @param JD   date (Julian Day) checked
+		 * @param nextJD  returned hint about next time a change in satisfy/violated might occur, see satisfy
+		 *
+		 * @return true if constraint is satisfied
+		 */
+		virtual bool satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD) { return satisfy (tar, JD, nextJD); }
+
 		Constraint *th () { return this; }
 
 		/**
@@ -196,6 +209,16 @@ class ConstraintInterval: public Constraint
 		void addInterval (double lower, double upper) { intervals.push_back (ConstraintDoubleInterval (lower, upper)); }
 		virtual bool isBetween (double JD);
 
+		/**
+		 * Check if value is inside intervals. Undefined (nan) value satisfies the constraint.
+		 *
+		 * @param val     constraint value
+		 * @param JD      date (Julian Day) of the value
+		 * @param rate    maximal change of the value per day, nan if it is not known
+		 * @param nextJD  returned time before which satisfaction does not change, see Constraint::satisfy
+		 */
+		bool satisfyValue (double val, double JD, double rate, double *nextJD);
+
 		std::list <ConstraintDoubleInterval> intervals;
 };
 
@@ -219,16 +242,21 @@ class ConstraintAirmass:public ConstraintInterval
 {
 	public:
 		virtual bool satisfy (Target *tar, double JD, double *nextJD);
+		virtual bool satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD);
 
 		virtual const char* getName () { return CONSTRAINT_AIRMASS; }
 
 		virtual void getAltitudeIntervals (std::vector <ConstraintDoubleInterval> &ac);
+
+	private:
+		bool satisfyAirmass (Target *tar, double airmass, double JD, double *nextJD);
 };
 
 class ConstraintZenithDistance:public ConstraintInterval
 {
 	public:
 		virtual bool satisfy (Target *tar, double JD, double *nextJD);
+		virtual bool satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD);
 
 		virtual const char* getName () { return CONSTRAINT_ZENITH_DIST; }
 
@@ -239,14 +267,19 @@ class ConstraintHA:public ConstraintInterval
 {
 	public:
 		virtual bool satisfy (Target *tar, double JD, double *nextJD);
+		virtual bool satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD);
 
 		virtual const char* getName () { return CONSTRAINT_HA; }
+
+	private:
+		bool satisfyHA (Target *tar, double ha, double JD, double *nextJD);
 };
 
 class ConstraintLunarDistance:public ConstraintInterval
 {
 	public:
 		virtual bool satisfy (Target *tar, double JD, double *nextJD);
+		virtual bool satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD);
 
 		virtual const char* getName () { return CONSTRAINT_LDISTANCE; }
 
@@ -372,10 +405,11 @@ class Constraints:public std::map <std::string, ConstraintPtr >
 		/**
 		 * Check if constrains are satisfied.
 		 *
-		 * @param tar   target for which constraints will be checked
-		 * @param JD    Julian date of constraints check
+		 * @param tar     target for which constraints will be checked
+		 * @param JD      Julian date of constraints check
+		 * @param nextJD  if constraints are satisfied, returned time before which none of them can be violated, see Constraint::satisfy; 0 if they are violated
 		 */
-		bool satisfy (Target *tar, double JD);
+		bool satisfy (Target *tar, double JD, double *nextJD = NULL);
 
 		/**
 		 * Return number of violated constainst.
@@ -467,7 +501,16 @@ class MasterConstraints
 		static Constraints & getConstraint ();
 
 		static Constraints * getTargetConstraints (int tar_id);
-		static void setTargetConstraints (int tar_id, Constraints * _constraints);
+
+		/**
+		 * Put target constraints to cache. If cache already holds
+		 * constraints for the target, loaded by other thread, the new
+		 * constraints are deleted and the cached ones are returned.
+		 * Passing NULL removes target constraints from cache.
+		 *
+		 * @return constraints stored in cache
+		 */
+		static Constraints * setTargetConstraints (int tar_id, Constraints * _constraints);
 
 		static void setNotifyConnection (rts2core::ConnNotify *_watchConn);
 		static rts2core::ConnNotify *getNotifyConnection ();
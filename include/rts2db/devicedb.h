@@ -54,6 +54,23 @@ class DeviceDb:public rts2core::Device
 		 */
 		int initDB (const char *conn_name);
 
+		/**
+		 * Open new database connection, without loading any data.
+		 * Can be called from a thread, to get connection used by
+		 * the thread.
+		 *
+		 * @param conn_name   connection name
+		 *
+		 * @return -1 on error, 0 on sucess.
+		 */
+		int connectDB (const char *conn_name);
+
+		/**
+		 * Close database connection of calling thread, opened with
+		 * connectDB.
+		 */
+		void disconnectDB ();
+
 	protected:
 		virtual int willConnect (rts2core::NetworkAddress * in_addr);
 		virtual int processOption (int in_opt);
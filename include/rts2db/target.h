@@ -36,6 +36,7 @@
 #include "counted_ptr.h"
 
 #include "targetset.h"
+#include "targetephemeris.h"
 #include "labels.h"
 
 #include "scriptcommands.h"
@@ -539,6 +540,45 @@ class Target:public Rts2Target
 		 */
 		bool isGood (double JD);
 
+		/**
+		 * Returns ephemeris tables covering given interval. Tables are
+		 * calculated for whole nights and kept until the target is
+		 * changed, or ephemeris for different night is requested.
+		 *
+		 * @param from  interval start (JD)
+		 * @param to    interval end (JD)
+		 *
+		 * @return ephemeris, NULL if the interval is longer than EPHEMERIS_MAX_DAYS
+		 * or the target moves too fast for interpolation (see isFastMoving)
+		 */
+		TargetEphemeris *getEphemeris (double from, double to);
+
+		/**
+		 * Returns ephemeris calculated by the last getEphemeris call,
+		 * NULL if there isn't any. Does not calculate anything, so it
+		 * can be called from multiple threads.
+		 */
+		TargetEphemeris *getLoadedEphemeris () { return ephemeris; }
+
+		/**
+		 * Returns already calculated ephemeris if it covers given date,
+		 * otherwise NULL. Never builds new tables, so single point
+		 * queries do not pay for the whole night.
+		 */
+		TargetEphemeris *getLoadedEphemeris (double JD) { return (ephemeris && ephemeris->covers (JD, JD)) ? ephemeris : NULL; }
+
+		/**
+		 * Returns true if the target position changes too fast for
+		 * linear interpolation between EPHEMERIS_STEP samples.
+		 * Ephemeris tables are not used for such targets.
+		 */
+		virtual bool isFastMoving (double JD) { return false; }
+
+		/**
+		 * Drop cached ephemeris. Must be called when target position is changed.
+		 */
+		void invalidateEphemeris ();
+
 		/**
 		 *   Return -1 if target is not suitable for observing,
 		 *   otherwise return 0.
@@ -547,6 +587,12 @@ class Target:public Rts2Target
 		virtual int dropBonus ();
 		float getBonus () { return getBonus (ln_get_julian_from_sys ()); }
 		virtual float getBonus (double JD);
+
+		/**
+		 * Returns true if target bonus does not change with time.
+		 */
+		virtual bool hasConstantBonus () { return true; }
+
 		virtual int changePriority (int pri_change, time_t * time_ch);
 		int changePriority (int pri_change, double validJD);
 
@@ -782,8 +828,10 @@ class Target:public Rts2Target
 		 * constraints, if they are needed.
 		 *
 		 * @param watchID   ID of watch which was changed
+		 *
+		 * @return true if the watch is associated with the target
 		 */
-		void revalidateConstraints (int watchID);
+		bool revalidateConstraints (int watchID);
 
 		/**
 		 * Retrieve list of target labels.
@@ -877,6 +925,8 @@ class Target:public Rts2Target
 		double satisfiedFrom;
 		double satisfiedTo;
 		double satisfiedProbedUntil;
+
+		TargetEphemeris *ephemeris;
 };
 
 /**
@@ -905,9 +955,11 @@ class ConstTarget:public Target
 		virtual int compareWithTarget (Target * in_target, double grb_sep_limit);
 		virtual void printExtra (Rts2InfoValStream & _os, double JD);
 
-		void setPosition (double ra, double dec) { position.ra = ra; position.dec = dec; }
-		void setProperMotion (double pm_ra, double pm_dec) { proper_motion.ra = pm_ra; proper_motion.dec = pm_dec; }
-		void setProperMotion (struct ln_equ_posn *pm) { proper_motion.ra = pm->ra; proper_motion.dec = pm->dec; }
+		virtual bool hasConstantPosition () { return true; }
+
+		void setPosition (double ra, double dec) { position.ra = ra; position.dec = dec; invalidateEphemeris (); }
+		void setProperMotion (double pm_ra, double pm_dec) { proper_motion.ra = pm_ra; proper_motion.dec = pm_dec; invalidateEphemeris (); }
+		void setProperMotion (struct ln_equ_posn *pm) { proper_motion.ra = pm->ra; proper_motion.dec = pm->dec; invalidateEphemeris (); }
 
 	protected:
 		// get called when target was selected to update bonuses, target position etc..
@@ -946,6 +998,8 @@ class FlatTarget:public ConstTarget
 		virtual int considerForObserving (double JD);
 		virtual int isContinues () { return 1; }
 		virtual void printExtra (Rts2InfoValStream & _os, double JD);
+
+		virtual bool hasConstantPosition () { return false; }
 	private:
 		void getAntiSolarPos (struct ln_equ_posn *pos, double JD);
 };
@@ -1001,6 +1055,9 @@ class CalibrationTarget:public ConstTarget
 		virtual int changePriority (int pri_change, time_t * time_ch) { return 0; }
 		virtual float getBonus (double JD);
 		virtual int isContinues () { return 2; }
+
+		virtual bool hasConstantPosition () { return false; }
+		virtual bool hasConstantBonus () { return false; }
 	private:
 		struct ln_equ_posn airmassPosition;
 		time_t lastImage;
@@ -1045,6 +1102,8 @@ class ModelTarget:public ConstTarget
 		virtual int endObservation (int in_next_id);
 		virtual void getPosition (struct ln_equ_posn *pos, double JD);
 
+		virtual bool hasConstantPosition () { return false; }
+
 		/**
 	         * Returns minimal target altitude.
 		 */
@@ -1061,7 +1120,7 @@ class OportunityTarget:public ConstTarget
 		virtual float getBonus (double JD);
 		virtual int isContinues () { return 1; }
 
-		virtual bool hasConstantPosition () { return true; }
+		virtual bool hasConstantBonus () { return false; }
 };
 
 class LunarTarget:public Target
@@ -1106,6 +1165,7 @@ class TargetSwiftFOV:public Target
 		virtual int considerForObserving (double JD);
 		virtual int beforeMove ();
 		virtual float getBonus (double JD);
+		virtual bool hasConstantBonus () { return false; }
 		virtual int isContinues ();
 
 		virtual void printExtra (Rts2InfoValStream & _os, double JD);
@@ -1131,6 +1191,7 @@ class TargetIntegralFOV:public Target
 		virtual int considerForObserving (double JD);
 		virtual int beforeMove ();
 		virtual float getBonus (double JD);
+		virtual bool hasConstantBonus () { return false; }
 		virtual int isContinues ();
 
 		virtual void printExtra (Rts2InfoValStream & _os, double JD);
@@ -1141,6 +1202,7 @@ class TargetGps:public ConstTarget
 	public:
 		TargetGps (int in_tar_id, struct ln_lnlat_posn *in_obs, double in_altitude);
 		virtual float getBonus (double JD);
+		virtual bool hasConstantBonus () { return false; }
 };
 
 class TargetSkySurvey:public ConstTarget
@@ -1148,6 +1210,7 @@ class TargetSkySurvey:public ConstTarget
 	public:
 		TargetSkySurvey (int in_tar_id, struct ln_lnlat_posn *in_obs, double in_altitude);
 		virtual float getBonus (double JD);
+		virtual bool hasConstantBonus () { return false; }
 };
 
 class TargetTerestial:public ConstTarget
@@ -1156,6 +1219,7 @@ class TargetTerestial:public ConstTarget
 		TargetTerestial (int in_tar_id, struct ln_lnlat_posn *in_obs, double in_altitude);
 		virtual int considerForObserving (double JD);
 		virtual float getBonus (double JD);
+		virtual bool hasConstantBonus () { return false; }
 		virtual moveType afterSlewProcessed ();
 };
 
@@ -1174,6 +1238,7 @@ class TargetPlan:public Target
 		virtual int getObsTargetID ();
 		virtual int considerForObserving (double JD);
 		virtual float getBonus (double JD);
+		virtual bool hasConstantBonus () { return false; }
 		virtual int isContinues ();
 		virtual int beforeMove ();
 		virtual moveType startSlew (struct ln_equ_posn *position, bool update_position, int plan_id = -1);
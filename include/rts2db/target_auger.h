@@ -63,6 +63,8 @@ class TargetAuger:public rts2db::ConstTarget
 
 		virtual bool getScript (const char *device_name, std::string & buf);
 		virtual float getBonus (double JD);
+		virtual bool hasConstantPosition () { return false; }
+		virtual bool hasConstantBonus () { return false; }
 		virtual moveType afterSlewProcessed ();
 		virtual int considerForObserving (double JD);
 		virtual int changePriority (int pri_change, time_t * time_ch)
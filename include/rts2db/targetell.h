@@ -22,6 +22,11 @@
 
 #include "target.h"
 
+/**
+ * Earth distance (in AU) below which elliptical targets are considered fast moving.
+ */
+#define ELL_FAST_DISTANCE     0.1
+
 namespace rts2db
 {
 
@@ -55,6 +60,12 @@ class EllTarget:public Target
 
 		virtual void writeToImage (rts2image::Image * image, double JD);
 
+		/**
+		 * Bodies closer than ELL_FAST_DISTANCE move too fast for
+		 * interpolated ephemeris.
+		 */
+		virtual bool isFastMoving (double JD) { return getEarthDistance (JD) < ELL_FAST_DISTANCE; }
+
 		double getEarthDistance (double JD);
 		double getSolarDistance (double JD);
 
@@ -0,0 +1,139 @@
+/*
+ * Sampled target ephemeris for a night.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_TARGETEPHEMERIS__
+#define __RTS2_TARGETEPHEMERIS__
+
+#include <libnova/libnova.h>
+#include <vector>
+
+/**
+ * Default ephemeris sampling step (in seconds).
+ */
+#define EPHEMERIS_STEP        300
+
+/**
+ * Maximal length of ephemeris table (in days). Longer intervals are calculated directly.
+ */
+#define EPHEMERIS_MAX_DAYS    3
+
+namespace rts2db
+{
+
+class Target;
+
+/**
+ * Tables of target altitude, azimuth, hour angle and lunar distance,
+ * sampled with fixed step. Values between samples are linearly
+ * interpolated. Airmass and zenith distance are calculated from the
+ * interpolated altitude. Queries outside of the table are passed to the
+ * target.
+ *
+ * With the default 5 minutes step, altitude interpolation error is below
+ * 0.005 degree. Tables are build from whole nights, which starts at local
+ * noon, so all users querying the same night share the same table.
+ *
+ * Lunar positions are shared by all ephemerides with the same sampling,
+ * access to them is serialized by a mutex, so ephemerides of different
+ * targets can be build from multiple threads. Once build, they can be
+ * queried concurrently.
+ *
+ * Targets which move too fast for interpolation (satellites, close
+ * approaching bodies) do not use ephemeris tables, see Target::isFastMoving.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class TargetEphemeris
+{
+	public:
+		/**
+		 * Calculate ephemeris tables.
+		 *
+		 * @param _target  target for which tables are calculated
+		 * @param _from    tables start (JD)
+		 * @param _to      tables end (JD)
+		 * @param _step    sampling step in seconds
+		 */
+		TargetEphemeris (Target *_target, double _from, double _to, double _step = EPHEMERIS_STEP);
+
+		/**
+		 * Returns true if the ephemeris covers given interval.
+		 */
+		bool covers (double _from, double _to) { return _from >= from && _to <= to; }
+
+		double getFrom () { return from; }
+		double getTo () { return to; }
+
+		void getAltAz (struct ln_hrz_posn *hrz, double JD);
+
+		double getAltitude (double JD);
+
+		double getAirmass (double JD);
+
+		double getZenitDistance (double JD);
+
+		/**
+		 * Returns hour angle in degrees (-180..180).
+		 */
+		double getHourAngle (double JD);
+
+		double getLunarDistance (double JD);
+
+		/**
+		 * Returns true if the target is above horizon, see Target::isAboveHorizon.
+		 */
+		bool isAboveHorizon (double JD);
+
+		/**
+		 * Minimal and maximal altitude during given interval, see Target::getMinMaxAlt.
+		 */
+		void getMinMaxAlt (double _start, double _end, double &_min, double &_max);
+
+		/**
+		 * Returns start of the night (local noon) for given date.
+		 *
+		 * @param JD   date
+		 * @param lng  observer longitude (east positive)
+		 */
+		static double getNightStart (double JD, double lng);
+
+	private:
+		Target *target;
+
+		double from;
+		double to;
+		// step in days
+		double step;
+
+		std::vector <double> alt;
+		std::vector <double> az;
+		std::vector <double> ha;
+		std::vector <double> lunarDistance;
+
+		/**
+		 * Find sample index and fraction for given date.
+		 *
+		 * @return false if JD is outside of tables
+		 */
+		bool getIndex (double JD, size_t &i, double &frac);
+};
+
+}
+
+#endif // !__RTS2_TARGETEPHEMERIS__
@@ -37,6 +37,8 @@ class TargetGRB:public ConstTarget
 		virtual bool getScript (const char *deviceName, std::string & buf);
 		virtual int beforeMove ();
 		virtual float getBonus (double JD);
+		virtual bool hasConstantPosition () { return false; }
+		virtual bool hasConstantBonus () { return false; }
 		// some logic needed to distinguish states when GRB position change
 		// from last observation. there was update etc..
 		virtual int isContinues ();
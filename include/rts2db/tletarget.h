@@ -22,7 +22,7 @@
 
 #include "target.h"
 
-#include "pluto/norad.h"
+#include "pluto/tlepropagator.h"
 
 namespace rts2db
 {
@@ -41,12 +41,22 @@ class TLETarget:public Target
 		virtual void load ();
 
 		virtual void getPosition (struct ln_equ_posn *pos, double JD);
+		/**
+		 * Next satellite pass over horizon, searched during one day after jd.
+		 *
+		 * @return 0 if satellite crosses horizon, 1 if it stays above horizon, -1 if it stays bellow horizon
+		 */
 		virtual int getRST (struct ln_rst_time *rst, double jd, double horizon);
 
 		virtual void printExtra (Rts2InfoValStream & _os, double JD);
 
 		virtual void writeToImage (rts2image::Image * image, double JD);
 
+		/**
+		 * Satellites move by degrees between ephemeris samples.
+		 */
+		virtual bool isFastMoving (double JD) { return true; }
+
 		double getEarthDistance (double JD);
 		double getSolarDistance (double JD);
 
@@ -54,10 +64,7 @@ class TLETarget:public Target
 		std::string tle1;
 		std::string tle2;
 
-		tle_t tle;
-
-		int ephem;
-		int is_deep;
+		TLEPropagator propagator;
 
 		void getPosition (struct ln_equ_posn *pos, double JD, struct ln_equ_posn *parallax);
 };
@@ -22,6 +22,7 @@
 
 #include "rts2fits/image.h"
 
+#include <list>
 #include <map>
 #include <vector>
 
@@ -76,6 +77,7 @@ class CameraImage
 			exEnd = NAN;
 			dataWriten = false;
 			prematurelyReceived = _prematurelyReceived;
+			writing = false;
 		}
 		virtual ~ CameraImage (void);
 
@@ -93,6 +95,20 @@ class CameraImage
 
 		bool canDelete ();
 
+		/**
+		 * Mark image as being written by ImageWriter thread. Metadata
+		 * received while the image is written are copied and queued,
+		 * and written to the image header by flushMetaData. Called only
+		 * from the main thread.
+		 */
+		void setWriting (bool _writing) { writing = _writing; }
+		bool isWriting () { return writing; }
+
+		/**
+		 * Write metadata queued while the image was written.
+		 */
+		void flushMetaData ();
+
 		/**
 		 * Return true if the image is waiting for some of the metadata.
 		 */
@@ -101,6 +117,12 @@ class CameraImage
 		std::vector < ImageDeviceWait * > deviceWaits;
 		std::vector < rts2core::DevClient * > triggerWaits;
 		std::vector < rts2core::DevClient * > prematurelyReceived;
+
+		bool writing;
+		// copies of values received while the image was written
+		std::list < std::pair < rts2core::Connection *, std::vector < rts2core::Value * > > > pendingValues;
+
+		void writeConn (rts2core::Connection * conn, imageWriteWhich_t which);
 };
 
 /**
@@ -27,6 +27,24 @@
 namespace rts2image
 {
 
+class Channel;
+
+/**
+ * Interface of classes which load channel data on demand.
+ */
+class ChannelLoader
+{
+	public:
+		virtual ~ChannelLoader () {}
+
+		/**
+		 * Load channel data. Shall call Channel::setData.
+		 *
+		 * @throw rts2core::Error when data cannot be loaded
+		 */
+		virtual void loadChannelData (Channel *ch) = 0;
+};
+
 /**
  * Single channel of an image.
  *
@@ -61,6 +79,18 @@ class Channel
 		 */
 		Channel (int ch, char *_data, long dataSize, int _naxis, long *_sizes, int16_t _dataType);
 
+		/**
+		 * Creates channel without data. Data are loaded by loader on the first access.
+		 *
+		 * @param ch         channel number
+		 * @param _naxis     number of axis in channel
+		 * @param _sizes     size of image (size of this array must be equal to _naxis parameter)
+		 * @param _dataType  type of data in channel. Uses FITS datatype notation
+		 * @param _loader    loader of channel data
+		 * @param _hdu       number of HDU with channel data
+		 */
+		Channel (int ch, int _naxis, long *_sizes, int16_t _dataType, ChannelLoader *_loader, int _hdu);
+
 		~Channel ();
 
 		/**
@@ -75,8 +105,18 @@ class Channel
 		double getAverage () { return average; }
 		double getStDev () { return stdev; }
 
+		// robust statistics, NAN unless computeStatistics was called with robust set to true
+		double getMedian () { return median; }
+		double getMAD () { return mad; }
+		double getClippedMean () { return clippedMean; }
+
 		const int16_t getDataType () { return dataType; }
 
+		/**
+		 * Return size of a single pixel in bytes.
+		 */
+		int getPixelByteSize ();
+
 		/**
 		 * Return number of axes in channel.
 		 */
@@ -88,9 +128,42 @@ class Channel
 		const long getHeight () { return naxis > 1 ? sizes[1] : 0; }
 		const long getNPixels () { return getWidth () * getHeight (); }
 
-		const char *getData () { return (char *) data; }
+		/**
+		 * Returns channel data. Loads data of lazy channel.
+		 *
+		 * @throw rts2core::Error when data of lazy channel cannot be loaded
+		 */
+		const char *getData ();
+
+		/**
+		 * Returns true if channel data are in memory.
+		 */
+		bool isLoaded () { return data != NULL; }
+
+		/**
+		 * Returns number of HDU holding channel data, -1 if channel was not created from a file.
+		 */
+		int getHDU () { return hdu; }
 
-		void computeStatistics (size_t _from = 0, size_t _dataSize = 0);
+		void setLoader (ChannelLoader *_loader) { loader = _loader; }
+
+		/**
+		 * Set channel data.
+		 *
+		 * @param dealloc   whenever to deallocate data at destruction
+		 */
+		void setData (char *_data, bool dealloc);
+
+
+		/**
+		 * Compute pixel sum, average and standard deviation of channel
+		 * data. Large channels are split to chunks processed in parallel.
+		 *
+		 * @param _from      first pixel
+		 * @param _dataSize  number of pixels, 0 for all pixels of the channel
+		 * @param robust     compute as well median, median absolute deviation and sigma-clipped mean
+		 */
+		void computeStatistics (size_t _from = 0, size_t _dataSize = 0, bool robust = false);
 
 	private:
 		char *data;
@@ -98,14 +171,27 @@ class Channel
 		long *sizes;
 		bool allocated;
 
+		ChannelLoader *loader;
+		int hdu;
+
+		void releaseData ();
+
+		void setStatistics (long double _pixelSum, double _average, double _stdev, double _median, double _mad, double _clippedMean);
+
 		int16_t dataType;
 
 		long double pixelSum;
 		double average;
 		double stdev;
 
+		double median;
+		double mad;
+		double clippedMean;
+
 		// channel number
 		int channelnum;
+
+		friend class Channels;
 };
 
 class Channels:public std::vector<Channel *>
@@ -113,6 +199,15 @@ class Channels:public std::vector<Channel *>
 	public:
 		Channels ();
 		~Channels ();
+
+		/**
+		 * Compute statistics of all channels. Channels and chunks of
+		 * large channels are processed in parallel. Results do not
+		 * depend on number of threads.
+		 *
+		 * @see Channel::computeStatistics
+		 */
+		void computeStatistics (size_t _from = 0, size_t _dataSize = 0, bool robust = false);
 };
 
 }
@@ -0,0 +1,148 @@
+/*
+ * Tile compression of FITS images.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_COMPRESSION__
+#define __RTS2_COMPRESSION__
+
+#include <fitsio.h>
+#include <stddef.h>
+#include <vector>
+
+namespace rts2image
+{
+
+/**
+ * Returns CFITSIO compression type from its name - none, rice, gzip, gzip2,
+ * hcompress or plio.
+ *
+ * @return compression type, 0 for none, -1 if name is not known
+ */
+int compressionType (const char *name);
+
+/**
+ * Parameters of FITS tile compression.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class FitsCompression
+{
+	public:
+		FitsCompression ()
+		{
+			type = 0;
+			tileWidth = 0;
+			tileHeight = 0;
+			quantize = 0;
+		}
+
+		/**
+		 * Load compression parameters from compress, compress_tile_width,
+		 * compress_tile_height and compress_quantize options of the
+		 * given configuration section.
+		 *
+		 * @return -1 if compression type is invalid
+		 */
+		int load (const char *section);
+
+		bool isEnabled () const { return type > 0; }
+
+		// CFITSIO compression type, 0 for uncompressed images
+		int type;
+
+		// tile size, 0 for CFITSIO default (tile is single image row)
+		long tileWidth;
+		long tileHeight;
+
+		// quantization level of floating point data, 0 for CFITSIO default
+		float quantize;
+};
+
+/**
+ * Channel data compressed into FITS file held in memory. Compressed HDU is
+ * then copied to the image file without recompression, so channels can be
+ * compressed in parallel.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class CompressedChannel
+{
+	public:
+		CompressedChannel ();
+		~CompressedChannel ();
+
+		/**
+		 * Compress channel data.
+		 *
+		 * @param dataType  RTS2_DATA_ type of data
+		 * @param sizes     image dimensions
+		 *
+		 * @return CFITSIO status, 0 on success
+		 */
+		int compress (const FitsCompression &compression, int dataType, long sizes[2], void *data);
+
+		/**
+		 * Append compressed HDU to the file. Appended HDU becomes file current HDU.
+		 */
+		int copyTo (fitsfile *ffile, int *status);
+
+	private:
+		fitsfile *mem;
+		void *buf;
+		size_t bufSize;
+};
+
+/**
+ * Channel to be compressed by compressChannels.
+ */
+struct ChannelData
+{
+	CompressedChannel *compressed;
+	int dataType;
+	long sizes[2];
+	void *data;
+	int status;
+};
+
+/**
+ * Returns CFITSIO data type (TBYTE, TSHORT,..) used to read and write data
+ * of the given RTS2_DATA_ type, -1 for unknown type.
+ */
+int fitsDataType (int dataType);
+
+/**
+ * Compress channels, in parallel when CFITSIO is reentrant. Number of
+ * threads is the same as number of threads used to scale images.
+ */
+void compressChannels (const FitsCompression &compression, std::vector <ChannelData> &channels);
+
+/**
+ * Convert FITS file to tile compressed, or decompress it.
+ *
+ * @param path          file path
+ * @param compressType  CFITSIO compression type, 0 to decompress the file
+ * @param data          converted file, allocated with new[]
+ * @param length        length of converted file
+ *
+ * @return CFITSIO status, 0 on success
+ */
+int convertCompression (const char *path, int compressType, char* &data, size_t &length);
+
+}
+
+#endif // !__RTS2_COMPRESSION__
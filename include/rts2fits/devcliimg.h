@@ -26,13 +26,20 @@
 
 #include "image.h"
 #include "cameraimage.h"
+#include "imagewriter.h"
+#include "previewcache.h"
 #include "valuerectangle.h"
 
 #include <libnova/libnova.h>
+#include <list>
 
 #define EVENT_ALL_IMAGES_WRITTEN      RTS2_LOCAL_EVENT + 525
 #define EVENT_KILL_ALL                RTS2_LOCAL_EVENT + 526
 #define EVENT_METADATA_TIMEOUT        RTS2_LOCAL_EVENT + 537
+#define EVENT_IMAGE_WRITTEN           RTS2_LOCAL_EVENT + 538
+
+// interval in seconds between checks for images written by ImageWriter
+#define WRITER_CHECK_INTERVAL         0.05
 
 namespace rts2image
 {
@@ -141,6 +148,29 @@ class DevClientCameraImage:public rts2core::DevClientCamera
 		 */
 		void fits2DataChannels (Image *img, rts2core::DataChannels *&data);
 
+		/**
+		 * Write channel WCS and detector headers. Current HDU must be the channel HDU.
+		 */
+		void writeChannelHeaders (CameraImage *ci, struct imghdr *imgh);
+
+		/**
+		 * Called when image data were written. Process image or wait for its metadata.
+		 */
+		void imageWritten (CameraImages::iterator iter);
+
+		// images being written by ImageWriter
+		std::list <ImageWriteJob *> writeJobs;
+
+		/**
+		 * Finish images written by ImageWriter.
+		 */
+		void checkWriteJobs ();
+
+		/**
+		 * Wait for all images queued to ImageWriter.
+		 */
+		void waitWriteJobs ();
+
 
 		void writeFilter (Image *img);
 
@@ -159,6 +189,15 @@ class DevClientCameraImage:public rts2core::DevClientCamera
 
 		bool triggered;
 
+		// tile compression of written images
+		FitsCompression compression;
+
+#if defined(RTS2_HAVE_LIBJPEG) && RTS2_HAVE_LIBJPEG == 1
+		// cache where preview pyramids of written images are generated, NULL if pyramids shall not be generated
+		PreviewCache *previewCache;
+		int previewChannel;
+#endif
+
 		// already received informations from those devices..
 		std::vector < rts2core::DevClient * > prematurelyReceived;
 };
@@ -30,6 +30,7 @@
 
 #include "rts2fits/fitsfile.h"
 #include "rts2fits/channel.h"
+#include "rts2fits/compression.h"
 
 #include "libnova_cpp.h"
 #include "devclient.h"
@@ -47,20 +48,7 @@
 double ln_get_heliocentric_time_diff (double JD, struct ln_equ_posn *object);
 #endif
 
-#define PSEUDOCOLOUR_VARIANT_GREY		0
-#define PSEUDOCOLOUR_VARIANT_GREY_INV		1
-#define PSEUDOCOLOUR_VARIANT_BLUE		2
-#define PSEUDOCOLOUR_VARIANT_BLUE_INV		3
-#define PSEUDOCOLOUR_VARIANT_RED		4
-#define PSEUDOCOLOUR_VARIANT_RED_INV		5
-#define PSEUDOCOLOUR_VARIANT_GREEN		6
-#define PSEUDOCOLOUR_VARIANT_GREEN_INV		7
-#define PSEUDOCOLOUR_VARIANT_VIOLET		8
-#define PSEUDOCOLOUR_VARIANT_VIOLET_INV		9
-#define PSEUDOCOLOUR_VARIANT_MAGENTA		10
-#define PSEUDOCOLOUR_VARIANT_MAGENTA_INV	11
-#define PSEUDOCOLOUR_VARIANT_MALACHIT		12
-#define PSEUDOCOLOUR_VARIANT_MALACHIT_INV	13
+#include "imagescale.h"
 
 namespace rts2image
 {
@@ -108,7 +96,7 @@ const void * getScaledData (int dataType, const void *data, size_t numpix, long
  *
  * @author Petr Kubanek <petr@kubanek.net>
  */
-class Image:public FitsFile
+class Image:public FitsFile, public ChannelLoader
 {
 	public:
 		// list of sex results..
@@ -263,6 +251,26 @@ class Image:public FitsFile
 
 		int writeData (char *in_data, char *fullTop, int nchan);
 
+		/**
+		 * Write data of all image channels. When compression is
+		 * enabled, channels are compressed in parallel.
+		 *
+		 * @param nchan  number of channels
+		 * @param data   channel data, starting with struct imghdr
+		 * @param tops   ends of channel data
+		 * @param hdus   if not NULL, receives HDU numbers of channels
+		 *
+		 * @return -1 if some channel cannot be written
+		 */
+		int writeChannels (int nchan, char **data, char **tops, int *hdus = NULL);
+
+		/**
+		 * Set tile compression of image data. Compressed channels
+		 * are always stored in extensions, primary HDU holds only
+		 * header.
+		 */
+		void setCompression (const FitsCompression &_compression) { compression = _compression; }
+
 		/**
 		 * Fill image header structure.
 		 */
@@ -444,7 +452,14 @@ class Image:public FitsFile
 
 		int getFilterNum () { return filter_i; }
 
-		void computeStatistics (size_t _from = 0, size_t _dataSize = 0);
+		/**
+		 * Compute statistics of all channels, in parallel.
+		 *
+		 * @param robust  compute as well channels median, MAD and sigma-clipped mean
+		 *
+		 * @see Channel::computeStatistics
+		 */
+		void computeStatistics (size_t _from = 0, size_t _dataSize = 0, bool robust = false);
 
 		double getAverage () { return average; }
 
@@ -469,13 +484,44 @@ class Image:public FitsFile
 		void deallocate () { channels.clear (); }
 
 		/**
+		 * Find image channels in the file. Only channel headers are
+		 * read, channel data are loaded on the first access.
+		 *
 		 * @throw rts2core::Error
 		 */
 		void loadChannels ();
 
+		/**
+		 * Load channel data. Called on the first access to channel data.
+		 *
+		 * @throw rts2core::Error
+		 */
+		virtual void loadChannelData (Channel *ch);
+
+		/**
+		 * Returns channel data, loads them if needed.
+		 *
+		 * @return NULL if channel data cannot be read
+		 */
 		const void *getChannelData (int chan);
+
 		const void *getChannelDataScaled (int chan, long smin, long smax, scaling_type scaling, int newType);
 
+		/**
+		 * Read rectangular region of the channel. If channel data
+		 * are not loaded, only the region is read from the file.
+		 *
+		 * @param chan  channel number
+		 * @param x     X of the first pixel, starting from 0
+		 * @param y     Y of the first pixel, starting from 0
+		 * @param w     region width
+		 * @param h     region height
+		 * @param buf   buffer for w * h pixels of channel data type
+		 *
+		 * @return 0 on success, -1 on error
+		 */
+		int getChannelSubset (int chan, long x, long y, long w, long h, void *buf);
+
 		int getPixelByteSize ()
 		{
 			if (dataType == RTS2_DATA_ULONG)
@@ -649,6 +695,22 @@ class Image:public FitsFile
 
 		void writeConn (rts2core::Connection * conn, imageWriteWhich_t which = EXPOSURE_START);
 
+		/**
+		 * Copy connection values, which writeConn will write for INFO_CALLED or
+		 * TRIGGERED. Used while the image is being written by ImageWriter, so
+		 * values are recorded as they were received.
+		 *
+		 * @param conn     connection holding values
+		 * @param which    INFO_CALLED or TRIGGERED
+		 * @param copies   vector to which value copies are appended
+		 */
+		void copyConnValues (rts2core::Connection * conn, imageWriteWhich_t which, std::vector <rts2core::Value *> &copies);
+
+		/**
+		 * Write values copied by copyConnValues to the image header. Copies are deleted.
+		 */
+		void writeConnValues (rts2core::Connection * conn, std::vector <rts2core::Value *> &copies);
+
 		/**
 		 * Sets image errors.
 		 */
@@ -760,6 +822,10 @@ class Image:public FitsFile
 
 		rts2image::Channels channels;
 		int16_t dataType;
+
+		FitsCompression compression;
+
+		int writeChannel (char *in_data, char *fullTop, int nchan, CompressedChannel *compressed);
 		int focPos;
 		float signalNoise;
 		int getFailed;
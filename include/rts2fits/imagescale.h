@@ -0,0 +1,136 @@
+/*
+ * Scaling of image data for display.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_IMAGESCALE__
+#define __RTS2_IMAGESCALE__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PSEUDOCOLOUR_VARIANT_GREY		0
+#define PSEUDOCOLOUR_VARIANT_GREY_INV		1
+#define PSEUDOCOLOUR_VARIANT_BLUE		2
+#define PSEUDOCOLOUR_VARIANT_BLUE_INV		3
+#define PSEUDOCOLOUR_VARIANT_RED		4
+#define PSEUDOCOLOUR_VARIANT_RED_INV		5
+#define PSEUDOCOLOUR_VARIANT_GREEN		6
+#define PSEUDOCOLOUR_VARIANT_GREEN_INV		7
+#define PSEUDOCOLOUR_VARIANT_VIOLET		8
+#define PSEUDOCOLOUR_VARIANT_VIOLET_INV		9
+#define PSEUDOCOLOUR_VARIANT_MAGENTA		10
+#define PSEUDOCOLOUR_VARIANT_MAGENTA_INV	11
+#define PSEUDOCOLOUR_VARIANT_MALACHIT		12
+#define PSEUDOCOLOUR_VARIANT_MALACHIT_INV	13
+
+// images with less pixels are scaled in the calling thread
+#define SCALE_THREAD_MIN_PIXELS    (1 << 20)
+
+// number of entries in palette used for pseudocolour scaling of 32 and 64 bit data
+#define SCALE_PALETTE_SIZE         4096
+
+namespace rts2image
+{
+
+/**
+ * Set number of threads used to scale large images. Default is number of
+ * online processors, limited to 8.
+ *
+ * @param threads  number of threads, 1 to scale in the calling thread
+ */
+void setScalingThreads (int threads);
+
+int getScalingThreads ();
+
+/**
+ * Returns name of the vector kernel used for grayscale scaling of float data
+ * (AVX2, SSE2 or scalar), selected at compile time like PixelStatistics kernels.
+ */
+const char *getScalingKernelName ();
+
+/**
+ * Function processing part of the range.
+ */
+typedef void (*partFunction) (void *arg, size_t start, size_t end);
+
+/**
+ * Split 0 - n range to parts, and process them in parallel by
+ * getScalingThreads () threads. The calling thread process the first part.
+ *
+ * @param pixels  number of pixels processed, small images are processed in the calling thread
+ */
+void runParts (partFunction fn, void *arg, size_t n, size_t pixels);
+
+/**
+ * Calculate histogram of 16 bit unsigned data. Histogram is not
+ * zeroed, values are added to it.
+ *
+ * @param data       image data
+ * @param n          number of pixels
+ * @param histogram  histogram
+ * @param nbins      number of histogram bins, must divide 65536
+ */
+void histogramUShort (const uint16_t *data, size_t n, long *histogram, long nbins);
+
+/**
+ * Calculate histogram of float data, truncated to 16 bit unsigned integer.
+ * Histogram is not zeroed, values are added to it.
+ */
+void histogramFloat (const float *data, size_t n, long *histogram, long nbins);
+
+/**
+ * Linear scaling of image data to grayscale. Pixels bellow or equal to low
+ * are set to black, pixels above or equal to high are set to 0. 8 and 16 bit
+ * data are scaled through lookup table, float data by SSE2 or AVX2 kernel
+ * when available, other types by scalar loop.
+ * Large images are split by rows between scaling threads.
+ *
+ * @param data      image data
+ * @param width     image width
+ * @param height    image height
+ * @param buf       output buffer, must hold (width + offset) * height pixels
+ * @param black     value of black pixel
+ * @param low       low limit
+ * @param high      high limit
+ * @param offset    offset after each output line
+ * @param invert_y  when true, first row of data is written to the last output row
+ */
+template <typename bt, typename dt> void scaleGrayscale (const dt *data, int width, int height, bt *buf, bt black, dt low, dt high, size_t offset, bool invert_y);
+
+/**
+ * Scale image data to pseudocolour. Output buffer holds 3 values (red, green,
+ * blue) per pixel. Arguments are the same as for scaleGrayscale.
+ *
+ * @param colourVariant  PSEUDOCOLOUR_VARIANT_ constant
+ */
+template <typename bt, typename dt> void scalePseudocolour (const dt *data, int width, int height, bt *buf, dt low, dt high, size_t offset, bool invert_y, int colourVariant);
+
+/**
+ * Returns pseudocolour of the value.
+ *
+ * @param colourVariant  PSEUDOCOLOUR_VARIANT_ constant
+ * @param value          value, in 0 - range interval
+ * @param range          range of values
+ *
+ * @return false if colour variant is not known
+ */
+bool pseudocolour (int colourVariant, double value, double range, unsigned char &r, unsigned char &g, unsigned char &b);
+
+}
+
+#endif // !__RTS2_IMAGESCALE__
@@ -0,0 +1,165 @@
+/*
+ * Background writer of FITS image data.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_IMAGEWRITER__
+#define __RTS2_IMAGEWRITER__
+
+#include "data.h"
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+// data are left in system buffers
+#define WRITER_FSYNC_NONE     0
+// file data are synced to disk once image is written
+#define WRITER_FSYNC_DATA     1
+// file data and metadata are synced, together with directory holding the file
+#define WRITER_FSYNC_FULL     2
+
+namespace rts2image
+{
+
+class CameraImage;
+
+/**
+ * Image data waiting to be written by the writer thread. Holds copy of data
+ * channels, as data received on connection are deleted right after they are
+ * passed to DevClient.
+ */
+class ImageWriteJob
+{
+	public:
+		ImageWriteJob (CameraImage *_ci, rts2core::DataChannels *data);
+		~ImageWriteJob ();
+
+		CameraImage *ci;
+
+		// channel data, starting with struct imghdr
+		std::vector <char *> buffers;
+		std::vector <size_t> sizes;
+
+		// HDU holding channel data, filled by writer thread
+		std::vector <int> hdus;
+
+		size_t totalSize;
+
+		// true once writer thread finished with the image
+		bool done;
+		// return of Image::writeChannels, checked by the main thread
+		int ret;
+};
+
+/**
+ * Writes image data to FITS files in the background thread, so the
+ * process main loop is not blocked by FITS encoding and disk writes of large
+ * images.
+ *
+ * Number of images queued for writing is limited. Images are written in
+ * order in which they were queued. The main thread does not touch image
+ * being written - metadata received during write are queued in CameraImage
+ * and written once the main thread finds the write completed, together with
+ * channel headers. Messages logged by the writer thread are passed to the main
+ * loop by Block::sendThreadMessage.
+ *
+ * Configured by write_queue and write_fsync options in [observatory] section.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class ImageWriter
+{
+	public:
+		/**
+		 * Returns writer shared by all camera clients.
+		 */
+		static ImageWriter *instance ();
+
+		/**
+		 * Returns true if images shall be written by the writer thread.
+		 */
+		bool isEnabled () { return maxQueue > 0; }
+
+		/**
+		 * Set maximal number of images waiting for write. 0 disables writer thread.
+		 */
+		void setMaxQueue (int _maxQueue);
+		int getMaxQueue () { return maxQueue; }
+
+		void setFsync (int _fsyncPolicy) { fsyncPolicy = _fsyncPolicy; }
+		int getFsync () { return fsyncPolicy; }
+
+		/**
+		 * Queue image data for writing. Blocks when maximal number of
+		 * images is already waiting for write.
+		 *
+		 * @return job, which shall be checked with isDone and deleted
+		 * by caller once finished
+		 */
+		ImageWriteJob *queue (CameraImage *ci, rts2core::DataChannels *data);
+
+		bool isDone (ImageWriteJob *job);
+
+		/**
+		 * Wait until job is finished.
+		 */
+		void wait (ImageWriteJob *job);
+
+		/**
+		 * Number of images waiting for write, including image being written.
+		 */
+		int getQueueDepth ();
+
+		/**
+		 * Throughput of the last written image, in MB/s.
+		 */
+		double getThroughput ();
+
+		/**
+		 * Total number of bytes written.
+		 */
+		double getBytesWritten ();
+
+	private:
+		ImageWriter ();
+
+		static ImageWriter *pInstance;
+
+		int maxQueue;
+		int fsyncPolicy;
+
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		pthread_t thread;
+		bool threadRunning;
+
+		std::deque <ImageWriteJob *> jobs;
+
+		double throughput;
+		double bytesWritten;
+
+		void writeJob (ImageWriteJob *job);
+		void syncFile (const char *fn);
+
+		static void *writerThread (void *arg);
+		void writer ();
+};
+
+}
+
+#endif // !__RTS2_IMAGEWRITER__
@@ -0,0 +1,226 @@
+/*
+ * Persistent cache of image previews and tile pyramids.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_PREVIEWCACHE__
+#define __RTS2_PREVIEWCACHE__
+
+#include "rts2-config.h"
+
+#if defined(RTS2_HAVE_LIBJPEG) && RTS2_HAVE_LIBJPEG == 1
+
+#include <Magick++.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <pthread.h>
+
+// size of pyramid tile in pixels
+#define PREVIEW_TILE_SIZE      256
+
+// pyramid levels up to this size are stored also as a single image, used to scale previews
+#define PREVIEW_LEVEL_MAX      2048
+
+// access time of cache entries is updated when older than this number of seconds
+#define PREVIEW_ATIME_RESOLUTION  3600
+
+// interval between cache prunes in seconds
+#define PREVIEW_PRUNE_INTERVAL    3600
+
+namespace rts2image
+{
+
+/**
+ * Persistent cache of JPEG previews generated from FITS images, and of
+ * multi-resolution tile pyramids.
+ *
+ * Entries are stored in the cache directory, in subdirectory named by hash of
+ * the absolute file path and rendering parameters, under name derived from
+ * hash of file inode, size and modification time. Entries of modified files
+ * are thus never returned. When entry of the modified file is written, entries
+ * of its previous versions are deleted. Entries not accessed for the given time
+ * and least recently accessed entries exceeding the cache size limit are
+ * deleted by prune.
+ *
+ * Pyramid is generated once per (file, quantiles, channel, colour variant)
+ * combination. Level 0 is the most zoomed out level, fitting into a single
+ * tile. Each following level doubles image size, the last level has full
+ * image resolution. Tiles are named z/x_y.jpg.
+ *
+ * Entries are written to temporary files, which are renamed once complete, so
+ * the cache can be shared by multiple threads and processes.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class PreviewCache
+{
+	public:
+		PreviewCache (const char *_cacheDir = NULL);
+		~PreviewCache ();
+
+		/**
+		 * Set cache directory. Empty or NULL disables cache.
+		 */
+		void setCacheDir (const char *_cacheDir);
+
+		bool isEnabled () { return !cacheDir.empty (); }
+
+		/**
+		 * Set limits of cache entries, enforced by prune.
+		 *
+		 * @param _maxSize  maximal size of the cache in bytes, 0 for unlimited size
+		 * @param _maxAge   maximal time in seconds from the last access of the entry, 0 for unlimited age
+		 */
+		void setLimits (long long _maxSize, double _maxAge);
+
+		/**
+		 * Returns name of the cache entry.
+		 *
+		 * @param path    path to FITS file
+		 * @param params  rendering parameters, as string
+		 *
+		 * @throw rts2core::Error if file does not exist
+		 */
+		std::string entryName (const char *path, const std::string &params);
+
+		/**
+		 * Read cache entry.
+		 *
+		 * @param data    entry data, allocated with new[]
+		 * @param length  entry length
+		 *
+		 * @return true if entry was found
+		 */
+		bool get (const std::string &entry, char* &data, size_t &length);
+
+		/**
+		 * Store cache entry. Does nothing if cache is disabled.
+		 */
+		void put (const std::string &entry, const void *data, size_t length);
+
+		/**
+		 * Returns pyramid level which can be scaled to preview of given
+		 * size, without reading and scaling image data again.
+		 *
+		 * @param minSize  minimal size of the longer axis
+		 *
+		 * @return NULL if pyramid is not available, otherwise image which
+		 * shall be deleted by caller
+		 */
+		Magick::Image *getLevelImage (const char *path, float quantiles, int chan, int colourVariant, int minSize);
+
+		/**
+		 * Returns size of full image and number of pyramid levels.
+		 * Generates pyramid if it is not cached.
+		 */
+		void getPyramidInfo (const char *path, float quantiles, int chan, int colourVariant, int &width, int &height, int &levels);
+
+		/**
+		 * Returns pyramid tile as JPEG. Generates pyramid if it is not
+		 * cached. If cache is disabled, renders only the tile.
+		 *
+		 * @param data    tile data, allocated with new[]
+		 *
+		 * @throw rts2core::Error on invalid tile coordinates or when image cannot be read
+		 */
+		void getTile (const char *path, float quantiles, int chan, int colourVariant, int z, int x, int y, char* &data, size_t &length);
+
+		/**
+		 * Generate pyramid, if it is not already cached.
+		 */
+		void generatePyramid (const char *path, float quantiles, int chan, int colourVariant);
+
+		/**
+		 * Queue pyramid generation, which will be carried in the
+		 * background thread. Used to generate pyramid right after image
+		 * is written.
+		 */
+		void queuePyramid (const char *path, float quantiles, int chan, int colourVariant);
+
+		/**
+		 * Delete entries not accessed for more than maximal age, and the
+		 * least recently accessed entries until cache size is below the
+		 * size limit. Walks the whole cache directory, so it shall not be
+		 * called from the main loop.
+		 */
+		void prune ();
+
+		/**
+		 * Queue prune, which will be carried in the background thread.
+		 */
+		void queuePrune ();
+
+	private:
+		std::string cacheDir;
+
+		long long maxSize;
+		double maxAge;
+
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+
+		// pyramids being generated
+		std::set <std::string> generating;
+
+		struct PyramidJob
+		{
+			std::string path;
+			float quantiles;
+			int chan;
+			int colourVariant;
+		};
+
+		std::deque <PyramidJob> jobs;
+		pthread_t thread;
+		bool threadRunning;
+		bool stopThread;
+		bool pruneRequested;
+
+		// shall be called with mutex locked
+		bool startThread ();
+
+		std::string pyramidName (const char *path, float quantiles, int chan, int colourVariant);
+
+		/**
+		 * Write data to the file, through temporary file renamed once complete.
+		 */
+		bool writeFile (const std::string &file, const void *data, size_t length);
+
+		/**
+		 * Delete entries of previous versions of the file with the same
+		 * rendering parameters.
+		 */
+		void removeStale (const std::string &entry);
+
+		bool readInfo (const std::string &pyramid, int &width, int &height, int &levels);
+
+		/**
+		 * Generate pyramid to the given directory.
+		 */
+		void writePyramid (const char *path, float quantiles, int chan, int colourVariant, const std::string &dir);
+
+		static void *generatorThread (void *arg);
+		void generator ();
+};
+
+}
+
+#endif // RTS2_HAVE_LIBJPEG
+
+#endif // !__RTS2_PREVIEWCACHE__
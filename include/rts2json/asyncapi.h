@@ -24,7 +24,11 @@
 #include "httpreq.h"
 #include "rts2fits/image.h"
 #include "xmlrpc++/XmlRpc.h"
+#include "xmlrpc++/XmlRpcWebSocket.h"
 #include "device.h"
+#include "message.h"
+
+#include <map>
 
 namespace rts2json
 {
@@ -32,9 +36,13 @@ namespace rts2json
 /**
  * Contain code exacuted when async command returns.
  *
+ * If client asked for upgrade to WebSocket, connection is switched to
+ * WebSocket protocol. Replies are then send as WebSocket frames, and
+ * connection is closed with close frame when call finishes.
+ *
  * @author Petr Kubanek, Institute of Physics <kubanek@fzu.cz>
  */
-class AsyncAPI:public rts2core::Object
+class AsyncAPI:public rts2core::Object, public XmlRpc::XmlRpcWebSocketHandler
 {
 	public:
 		AsyncAPI (JSONRequest *_req, rts2core::Connection *_conn, XmlRpc::XmlRpcServerConnection *_source, bool _ext);
@@ -50,6 +58,28 @@ class AsyncAPI:public rts2core::Object
 
 		virtual void stateChanged (rts2core::Connection *_conn) {};
 		virtual void valueChanged (rts2core::Connection *_conn, rts2core::Value *_value) {};
+		virtual void message (rts2core::Message &msg) {};
+
+		/**
+		 * Handle message received from WebSocket client. Default
+		 * implementation ignores messages.
+		 */
+		virtual void webSocketMessage (XmlRpc::XmlRpcServerConnection *_source, int opcode, const std::string &message) {}
+
+		/**
+		 * Returns true if there are updates waiting for flush call.
+		 */
+		virtual bool hasPending () { return false; }
+
+		/**
+		 * Send updates collected since the last call.
+		 */
+		virtual void flush () {}
+
+		/**
+		 * Returns true if API communicates over WebSocket.
+		 */
+		bool isWebSocket () { return source != NULL && source->isWebSocket (); }
 
 		/**
 		 * Check if the request is for connection or source..
@@ -75,15 +105,24 @@ class AsyncAPI:public rts2core::Object
 		 *
 		 * @return 0 if AsyncAPI is still active, otherwise AsyncAPI will be deleted
 		 */
-		virtual int idle () { return source == NULL; }
+		virtual int idle ();
 
 	protected:
 		JSONRequest *req;
 		XmlRpc::XmlRpcServerConnection *source;
 		rts2core::Connection *conn;
 
+		/**
+		 * Send JSON reply. Reply is send as text frame on WebSocket,
+		 * otherwise as HTTP response.
+		 */
+		void sendJSON (std::ostringstream &_os);
+
 	private:
 		bool ext;
+
+		// time of the last ping send to WebSocket client
+		time_t lastPing;
 };
 
 /**
@@ -110,6 +149,18 @@ class AsyncState
 /**
  * Asynchronous class for value and state changes. Used to handle the "push" method.
  *
+ * Parameters are device=value pairs. Value __S__ subscribes to device
+ * state, * to state and all device values, and __M__ to messages from the
+ * device (* as device name subscribes to messages from all components).
+ *
+ * Over HTTP, each update is send as separate chunk. Over WebSocket, updates
+ * are collected and send as JSON array in a single frame on flush call,
+ * with only the last change of a value being send. If the client is too
+ * slow, only the newest messages are kept and number of dropped messages
+ * is reported as {"m_dropped":n} array member. Client can change
+ * subscriptions by sending text messages "subscribe?device=value&.." and
+ * "unsubscribe?device=value&..".
+ *
  * @author Petr Kubanek <kubanek@fzu.cz>
  */
 class AsyncValueAPI:public AsyncAPI
@@ -120,6 +171,15 @@ class AsyncValueAPI:public AsyncAPI
 		virtual void stateChanged (rts2core::Connection *_conn);
 
 		virtual void valueChanged (rts2core::Connection *_conn, rts2core::Value *_value);
+
+		virtual void message (rts2core::Message &msg);
+
+		virtual void webSocketMessage (XmlRpc::XmlRpcServerConnection *_source, int opcode, const std::string &message);
+
+		virtual bool hasPending () { return !pending.empty () || !pendingMessages.empty (); }
+
+		virtual void flush ();
+
 		/**
 		 * Send all registered values and states on JSON connection. Throw an error if value/connection
 		 * cannot be found.
@@ -131,9 +191,25 @@ class AsyncValueAPI:public AsyncAPI
 		std::list <AsyncState> states;
 		std::vector <std::string> devices;
 		std::vector <std::pair <std::string, std::string> > values;
+		std::vector <std::string> messages;
+
+		// device used to resolve subscriptions
+		rts2core::Device *master;
+
+		// updates waiting for flush, indexed by device and value name
+		std::map <std::string, std::string> pending;
+		// messages waiting for flush, only the newest WS_MAX_MESSAGES are kept
+		std::list <std::string> pendingMessages;
+		// number of messages dropped since the last flush
+		size_t droppedMessages;
+
+		void addSubscriptions (XmlRpc::HttpParams *params);
+		void removeSubscriptions (XmlRpc::HttpParams *params);
 
 		void sendState (std::list <AsyncState>::iterator astate, rts2core::Connection *_conn);
 		void sendValue (const std::string &device, rts2core::Value *_value);
+
+		void sendUpdate (const std::string &key, const std::string &update);
 };
 
 /**
@@ -176,11 +252,26 @@ class AsyncDataAPI:public AsyncAPI
 
 		void sendData ();
 
+		/**
+		 * Send rest of the data and finish the call.
+		 */
+		void sendRest (char *buf, size_t bufs);
+
 	private:
 		bool headerSend;
 
+		void sendDataHeader (size_t ds);
+
 		void doSendData (void *buf, size_t bufs)
 		{
+			if (isWebSocket ())
+			{
+				if (source->sendWebSocket ((const char *) buf, bufs, WS_BINARY) == false)
+					asyncFinished ();
+				else
+					bytesSoFar += bufs;
+				return;
+			}
 			ssize_t ret = send (source->getfd (), buf, bufs, 0);
 			if (ret < 0)
 			{
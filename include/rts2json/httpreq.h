@@ -63,6 +63,34 @@ class GetRequestAuthorized: public XmlRpc::XmlRpcServerGetRequest
 
 		virtual void execute (XmlRpc::XmlRpcSource *source, struct ::sockaddr_in *saddr, std::string path, XmlRpc::HttpParams *params, int &http_code, const char* &response_type, char* &response, size_t &response_length);
 
+		/**
+		 * Returns true if request with given path can be executed by
+		 * a worker thread. Offloadable requests must not access data
+		 * owned by the main thread (device connections, values,..),
+		 * and must not use asynchronous or chunked responses. They
+		 * will typically query database, or convert images.
+		 *
+		 * Offloaded requests run concurrently with other requests
+		 * handled by the same object, so they must not use its
+		 * per-request members (connection, authorization, user
+		 * permissions). Source passed to authorizedExecute is NULL,
+		 * headers added by addExtraHeader are passed to the
+		 * connection with the response.
+		 *
+		 * @param path    request path, excluding prefix
+		 * @param params  request parameters
+		 */
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params) { return false; }
+
+		/**
+		 * Execute already authorized request. Called from a worker
+		 * thread for offloadable requests, with NULL source.
+		 */
+		void offloadedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length)
+		{
+			authorizedExecute (source, path, params, response_type, response, response_length);
+		}
+
 	protected:
 		/**
 		 * Received exact path and HTTP params. Returns response - MIME
@@ -30,10 +30,22 @@
 #include "userpermissions.h"
 #include "rts2db/camlist.h"
 
+namespace XmlRpc
+{
+class XmlRpcServerConnection;
+class HttpParams;
+}
+
+namespace rts2image
+{
+class PreviewCache;
+}
+
 namespace rts2json
 {
 
 class AsyncAPI;
+class GetRequestAuthorized;
 
 /**
  * Interface for HTTP server. Declares methods needed by user authorization.
@@ -93,11 +105,32 @@ class HTTPServer
 		 */
 		virtual int getDefaultChannel () { return 0; }
 
+		/**
+		 * Return cache of image previews. NULL if server does not
+		 * provide cache.
+		 */
+		virtual rts2image::PreviewCache *getPreviewCache () { return NULL; }
+
 		/**
 		 * Verify user credentials.
 		 */
 		virtual bool verifyDBUser (std::string username, std::string pass, rts2core::UserPermissions *userPermissions = NULL) = 0;
 
+		/**
+		 * Execute authorized request outside of the main thread.
+		 * Server shall call request offloadedExecute from a worker
+		 * thread, and pass result to connection offloadFinished method
+		 * in the main thread.
+		 *
+		 * @param request     request to execute
+		 * @param connection  connection which will receive the response
+		 * @param path        request path
+		 * @param params      request parameters, must be copied
+		 *
+		 * @return false if request cannot be offloaded and shall be executed immediately
+		 */
+		virtual bool offloadRequest (GetRequestAuthorized *request, XmlRpc::XmlRpcServerConnection *connection, const std::string &path, XmlRpc::HttpParams *params) { return false; }
+
 		/**
 		 * Register asynchronous API call.
 		 */
@@ -105,6 +138,16 @@ class HTTPServer
 
 		void asyncIdle ();
 
+		/**
+		 * Returns true if some asynchronous API has updates waiting for flush.
+		 */
+		bool asyncPending ();
+
+		/**
+		 * Send updates collected by asynchronous APIs.
+		 */
+		void asyncFlush ();
+
 	protected:
 		rts2core::ValueInteger *numberAsyncAPIs;
 		rts2core::ValueInteger *sumAsync;
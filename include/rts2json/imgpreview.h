@@ -21,6 +21,8 @@
 #include "httpreq.h"
 #include "httpserver.h"
 
+#include <fitsio.h>
+
 #define DEFAULT_QUANTILES    0.005
 #define DEFAULT_COLOURVARIANT    0
 // number of channels in image
@@ -91,6 +93,8 @@ class JpegImageRequest: public rts2json::GetRequestAuthorized
 	public:
 		JpegImageRequest (const char* prefix, rts2json::HTTPServer *_http_server, XmlRpc::XmlRpcServer* s):rts2json::GetRequestAuthorized (prefix, _http_server, NULL, s) {}
 
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params) { return fits_is_reentrant (); }
+
 		virtual void authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length);
 };
 
@@ -104,15 +108,34 @@ class JpegPreview:public rts2json::GetRequestAuthorized
 	public:
 		JpegPreview (const char* prefix, rts2json::HTTPServer *_http_server, const char *_dirPath, XmlRpc::XmlRpcServer *s):rts2json::GetRequestAuthorized (prefix, _http_server, "JPEG image preview", s) { dirPath = _dirPath; }
 
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params) { return fits_is_reentrant (); }
+
 		virtual void authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length);
 	private:
 		const char *dirPath;
 };
 
+/**
+ * Returns tiles of multi-resolution pyramid generated from FITS file, or JSON
+ * with pyramid dimensions. Used to zoom and pan large images in web browsers.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class TileRequest: public rts2json::GetRequestAuthorized
+{
+	public:
+		TileRequest (const char* prefix, rts2json::HTTPServer *_http_server, XmlRpc::XmlRpcServer* s):rts2json::GetRequestAuthorized (prefix, _http_server, NULL, s) {}
+
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params) { return fits_is_reentrant (); }
+
+		virtual void authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length);
+};
+
 #endif // RTS2_HAVE_LIBJPEG
 
 /**
- * Returns raw FITS file as it is written on the disk.
+ * Returns raw FITS file as it is written on the disk, or its tile compressed
+ * or decompressed version.
  *
  * @author Petr Kubanek <petr@kubanek.net>
  */
@@ -121,6 +144,9 @@ class FitsImageRequest:public rts2json::GetRequestAuthorized
 	public:
 		FitsImageRequest (const char* prefix, rts2json::HTTPServer *_http_server, XmlRpc::XmlRpcServer* s):rts2json::GetRequestAuthorized (prefix, _http_server, NULL, s) {}
 
+		// compression and decompression are run in worker thread
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params) { return params->getString ("compress", NULL) != NULL && fits_is_reentrant (); }
+
 		virtual void authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length);
 };
 
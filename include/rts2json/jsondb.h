@@ -43,6 +43,12 @@ class JSONDBRequest:public JSONRequest
 		 */
 		void dbJSON (const std::vector <std::string> vals, XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, std::ostringstream &os);
 
+		/**
+		 * Returns true if dbJSON call only reads from database, and
+		 * can be executed by a worker thread.
+		 */
+		bool isOffloadableDB (const std::vector <std::string> &vals, XmlRpc::HttpParams *params);
+
 		void jsonTargets (rts2db::TargetSet &tar_set, std::ostringstream &os, XmlRpc::HttpParams *params, struct ln_equ_posn *dfrom = NULL, XmlRpc::XmlRpcServerConnection *chunked = NULL);
 		void jsonObservation (rts2db::Observation *obs, std::ostream &os);
 		void jsonObservations (rts2db::ObservationSet *obss, std::ostream &os);
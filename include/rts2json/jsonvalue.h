@@ -127,15 +127,81 @@ class JsonString
 class DevInterface
 {
 	public:
-		DevInterface ():changedTimes () {}
+		DevInterface ():changedTimes (), changedSequences (), cachedValues ()
+		{
+			lastSequence = 0;
+			snapshotValid[0] = snapshotValid[1] = false;
+		}
 
 		double getValueChangedTime (rts2core::Value *value);
 
+		/**
+		 * Returns change sequence of the last value change, 0 if value
+		 * change was not reported.
+		 */
+		unsigned long getValueChangedSequence (rts2core::Value *value);
+
+		/**
+		 * Returns change sequence of the last change of any connection value.
+		 */
+		unsigned long getLastSequence () { return lastSequence; }
+
+		/**
+		 * Append JSON encoded value to the stream. Values with reported
+		 * changes are encoded only once after the change, and the encoded
+		 * string is reused on the next calls.
+		 */
+		void jsonCachedValue (rts2core::Value *value, bool extended, std::ostringstream &os);
+
+		/**
+		 * Append JSON encoded values of all connection values to the
+		 * stream. Encoded string is kept, and reused until any value
+		 * of the connection changes.
+		 */
+		void jsonSnapshot (rts2core::Connection *conn, bool extended, std::ostringstream &os);
+
 	protected:
+		/**
+		 * Record value change. Must be called on every value change, so
+		 * cached encoding is invalidated.
+		 */
+		void markValueChanged (rts2core::Value *value);
+
+	private:
 		// value change times
 		std::map <rts2core::Value *, double> changedTimes;
+		std::map <rts2core::Value *, unsigned long> changedSequences;
+
+		unsigned long lastSequence;
+
+		struct CachedValue
+		{
+			std::string name;
+			int32_t flags;
+			unsigned long sequence;
+			std::string json[2];
+			bool valid[2];
+		};
+
+		std::map <rts2core::Value *, CachedValue> cachedValues;
+
+		// true if value encoding can be cached - value change was reported
+		bool isCacheable (rts2core::Value *value);
+
+		// encoded values of the whole connection
+		std::string snapshot[2];
+		unsigned long snapshotSequence[2];
+		// values included in snapshot - values can be added or replaced by metainfo
+		std::vector <rts2core::Value *> snapshotValues[2];
+		bool snapshotValid[2];
 };
 
+/**
+ * Returns the last value change sequence number. Sequence is increased
+ * on every change of any value of any connection.
+ */
+unsigned long getChangeSequence ();
+
 void sendArrayValue (rts2core::Value *value, std::ostringstream &os);
 
 void sendStatValue (rts2core::Value *value, std::ostringstream &os);
@@ -150,9 +216,11 @@ void jsonValue (rts2core::Value *value, bool extended, std::ostringstream & os);
 /**
  * Send connection values as JSON string to the client.
  *
- * @param time from which changed values will be reported. nan means that all values will be reported.
+ * @param from      time from which changed values will be reported. nan means that all values will be reported.
+ * @param extended  send extended value informations (flags, error, description)
+ * @param since     change sequence; if non-zero, only values changed after the sequence are reported
  */
-void sendConnectionValues (std::ostringstream &os, rts2core::Connection * conn, XmlRpc::HttpParams *params, double from = NAN, bool extended = false);
+void sendConnectionValues (std::ostringstream &os, rts2core::Connection * conn, XmlRpc::HttpParams *params, double from = NAN, bool extended = false, unsigned long since = 0);
 }
 
 #endif // !__RTS2_JSONVALUE__
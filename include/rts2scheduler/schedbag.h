@@ -19,6 +19,7 @@
 
 #include "schedule.h"
 #include "rts2db/accountset.h"
+#include "workerpool.h"
 
 #include <vector>
 
@@ -47,6 +48,22 @@ class Rts2SchedBag:public std::vector <Rts2Schedule *>
 		 */
 		unsigned int getEliteSize () { return eliteSize; }
 
+		/**
+		 * Set number of threads used to evaluate population merits.
+		 * Merits of the individual schedules are evaluated in
+		 * parallel, GA operators (selection, crossing and mutation)
+		 * are run in the calling thread, so results for given
+		 * random seed do not depend on number of threads.
+		 *
+		 * Merit functions use target ephemerides calculated for the
+		 * scheduling interval. Positions outside of the interval are
+		 * calculated by targets, so targets used in tickets must be
+		 * able to calculate their positions concurrently.
+		 *
+		 * @param threads  number of threads; 1 for sequential evaluation
+		 */
+		void setThreads (int threads);
+
 		/**
 		 * Construct schedules and add them to schedule bag.
 		 *
@@ -110,6 +127,12 @@ class Rts2SchedBag:public std::vector <Rts2Schedule *>
 		/**
 		 * Calculate ranks of the entire population. Ranks are assigned to schedule
 		 * with setNSGARank function.
+		 *
+		 * Uses efficient non-dominated sort (ENS-BS). Population is
+		 * sorted so that no schedule is dominated by schedule behind
+		 * it. Each schedule is then put to the first front which does
+		 * not contain schedule dominating it; binary search is used to
+		 * find the front.
 		 */
 		void calculateNSGARanks ();
 
@@ -152,6 +175,27 @@ class Rts2SchedBag:public std::vector <Rts2Schedule *>
 		rts2sched::TicketSet *ticketSet;
 		rts2db::TargetSet *tarSet;
 
+		// pool evaluating merits, NULL if evaluation is sequential
+		rts2core::WorkerPool *pool;
+
+		// constraints and objectives values of the population, used
+		// for NSGA ranking. Values for schedule i starts at i * NSGAvaluesSize
+		std::vector <double> NSGAvalues;
+		size_t NSGAvaluesSize;
+
+		/**
+		 * Calculate ephemerides of ticket targets for scheduling
+		 * interval. Merit functions then use ephemerides, and do
+		 * not calculate target positions.
+		 */
+		void prepareEphemerides ();
+
+		/**
+		 * Evaluate constraints and objectives of all schedules in
+		 * the population, and fill NSGAvalues.
+		 */
+		void evaluatePopulation ();
+
 		/**
 		 * The algorithm replace randomly selected observation with randomly picked new
 		 * one.
@@ -232,6 +276,21 @@ class Rts2SchedBag:public std::vector <Rts2Schedule *>
 		 */
 		int dominatesNSGA (Rts2Schedule *sched_1, Rts2Schedule *sched_2);
 
+		/**
+		 * Dominance operator working on values stored in NSGAvalues.
+		 * Returns the same value as dominatesNSGA.
+		 *
+		 * @param p  index of the first schedule
+		 * @param q  index of the second schedule
+		 */
+		int dominatesNSGAValues (size_t p, size_t q);
+
+		/**
+		 * Returns true if schedule with given index is dominated by
+		 * any member of the given front.
+		 */
+		bool dominatedByFront (std::vector <size_t> &front, size_t q);
+
 		/** 
 		 * Calculates crowding distance of each member in
 		 * the set and sort NSGAfronts by crowding distance.
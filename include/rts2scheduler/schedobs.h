@@ -143,14 +143,10 @@ class Rts2SchedObs
 		 */
 		bool isVisible ()
 		{
-			// determine if target is visible during whole period
-			if (getTarget()->isAboveHorizon (getJDStart ()) == false
-				|| getTarget ()->isAboveHorizon (getJDMid ()) == false
-				|| getTarget ()->isAboveHorizon (getJDEnd ()) == false)
-				return false;
-			double minA, maxA;
-			getTarget ()->getMinMaxAlt (getJDStart (), getJDEnd (), minA, maxA);
-			return minA > 0;
+			rts2db::TargetEphemeris *eph = getTarget ()->getLoadedEphemeris ();
+			if (eph)
+				return isVisible (eph);
+			return isVisible (getTarget ());
 		}
 
 		/**
@@ -183,6 +179,25 @@ class Rts2SchedObs
 		bool violateSchedule () { return ticket->violateSchedule (getJDStart (), getJDEnd ()); }
 
 	private:
+		/**
+		 * Visibility and altitude merit are calculated either from
+		 * target ephemeris, or directly from target if ephemeris is
+		 * not available.
+		 */
+		template <typename src> bool isVisible (src *pos)
+		{
+			// determine if target is visible during whole period
+			if (pos->isAboveHorizon (getJDStart ()) == false
+				|| pos->isAboveHorizon (getJDMid ()) == false
+				|| pos->isAboveHorizon (getJDEnd ()) == false)
+				return false;
+			double minA, maxA;
+			pos->getMinMaxAlt (getJDStart (), getJDEnd (), minA, maxA);
+			return minA > 0;
+		}
+
+		template <typename src> double altitudeMerit (src *pos, double _start, double _end);
+
 		Ticket *ticket;
 		// observation start in JD
 		double startJD;
@@ -56,6 +56,11 @@
 // slew to target, and do not wait for clearing of the block state
 #define EVENT_SLEW_TO_TARGET_NOW           RTS2_LOCAL_EVENT+68
 
+// telescope started to move, argument is telescope client
+#define EVENT_TEL_MOVE_STARTED             RTS2_LOCAL_EVENT+69
+// camera started exposure, argument is camera client
+#define EVENT_EXPOSURE_STARTED             RTS2_LOCAL_EVENT+70
+
 namespace rts2script
 {
 
@@ -161,6 +166,7 @@ class DevClientTelescopeExec:public rts2image::DevClientTelescopeImage
 		int syncTarget (bool now = false, int plan_id = -1);
 		void checkInterChange ();
 	protected:
+		virtual void moveStart (bool correcting);
 		virtual void moveEnd ();
 	public:
 		DevClientTelescopeExec (rts2core::Connection * in_connection);
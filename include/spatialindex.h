@@ -0,0 +1,114 @@
+/*
+ * HEALPix based spatial index.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_SPATIALINDEX__
+#define __RTS2_SPATIALINDEX__
+
+#include "healpix.h"
+
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace rts2core
+{
+
+/**
+ * Range of nested HEALPix pixels, both ends included.
+ */
+typedef std::pair <int64_t, int64_t> pixrange_t;
+
+/**
+ * Returns ranges of HEALPIX_TARGET_ORDER pixels which cover cone of given
+ * radius. Returned pixels might contain positions outside of the cone, so
+ * exact distance must be checked on candidates. Pixels are computed at
+ * coarser order for large cones, to keep number of ranges small.
+ *
+ * @param ra      cone center right ascension (degrees)
+ * @param dec     cone center declination (degrees)
+ * @param radius  cone radius (degrees)
+ * @param ranges  returned sorted, non-overlapping ranges
+ */
+void healpixQueryDisc (double ra, double dec, double radius, std::vector <pixrange_t> &ranges);
+
+/**
+ * Prints SQL condition selecting column values in ranges, e.g. (col
+ * BETWEEN 10 AND 20 OR col BETWEEN 30 AND 30).
+ */
+void healpixRangesSQL (std::ostream &_os, const char *column, std::vector <pixrange_t> &ranges);
+
+/**
+ * In-memory cone search index. Entries are identified by integer ID.
+ * Positions are kept in array sorted by HEALPIX_TARGET_ORDER pixel number,
+ * so cone search examines only entries in pixels touching the cone.
+ *
+ * Entries are first added with add call, and index is prepared with
+ * build. Index shall be rebuild after more entries are added.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class SpatialIndex
+{
+	public:
+		SpatialIndex ();
+
+		void clear ();
+
+		/**
+		 * Add entry to index.
+		 */
+		void add (int id, double ra, double dec);
+
+		/**
+		 * Sort entries, so cone call can be used.
+		 */
+		void build ();
+
+		size_t size () { return entries.size (); }
+
+		/**
+		 * Search for entries within radius from given position.
+		 *
+		 * @param ra      cone center right ascension (degrees)
+		 * @param dec     cone center declination (degrees)
+		 * @param radius  cone radius (degrees)
+		 * @param ids     IDs of entries within cone. Entries are appended
+		 *
+		 * @return number of entries examined
+		 */
+		size_t cone (double ra, double dec, double radius, std::vector <int> &ids);
+
+	private:
+		struct Entry
+		{
+			int64_t pix;
+			int id;
+			double ra;
+			double dec;
+
+			bool operator < (const Entry &e) const { return pix < e.pix || (pix == e.pix && id < e.id); }
+		};
+
+		std::vector <Entry> entries;
+		bool sorted;
+};
+
+}
+
+#endif /* !__RTS2_SPATIALINDEX__ */
@@ -23,10 +23,11 @@
 #include <libnova/libnova.h>
 #include <sys/time.h>
 #include <time.h>
-#include "pluto/norad.h"
+#include "pluto/tlepropagator.h"
 
 #include "device.h"
 #include "objectcheck.h"
+#include "trajectory.h"
 
 // pointing models
 #define POINTING_RADEC       0
@@ -338,6 +339,14 @@ class Telescope:public rts2core::Device
 		 */
 		void createTracking ();
 
+		/**
+		 * Telescope can follow trajectory streamed as position-velocity-time
+		 * points. Drivers calling this shall implement startTrajectory,
+		 * sendTrajectory and stopTrajectory. Must be called from driver
+		 * constructor, after tracking values were created.
+		 */
+		void createTrajectory ();
+
 		virtual int processOption (int in_opt);
 
 		virtual int init ();
@@ -872,6 +881,35 @@ class Telescope:public rts2core::Device
 		 */
 		virtual void runTracking ();
 
+		/**
+		 * Prepare mount to follow streamed trajectory. Called at the
+		 * beginning of tracking, when the mount is not moving.
+		 *
+		 * @param ac  current RA/HA axis counts, used as input for first calculateTarget call
+		 * @param dc  current DEC axis counts
+		 *
+		 * @return 0 on success, -1 if trajectory cannot be streamed and tracking shall use runTracking
+		 */
+		virtual int startTrajectory (int32_t &ac, int32_t &dc) { return -1; }
+
+		/**
+		 * Send trajectory points to the mount. Called from trajectory
+		 * thread, while daemon main loop waits for events, so driver can
+		 * use its connections and values. Points are in time order,
+		 * each point is send only once.
+		 *
+		 * @return 0 on success, -1 on error, which stops streaming and switches back to runTracking
+		 */
+		virtual int sendTrajectory (const std::vector <TrajectoryPoint> &points) { return -1; }
+
+		/**
+		 * Stop following streamed trajectory, discard points which were not yet reached.
+		 */
+		virtual void stopTrajectory () {}
+
+		virtual void loopSleep ();
+		virtual void loopWake ();
+
 		/**
 		 * Calculate TLE RA DEC for given time.
 		 */
@@ -943,10 +981,32 @@ class Telescope:public rts2core::Device
 		void setBlockMove () { blockMove->setValueBool (true); sendValueAll (blockMove); }
 		void unBlockMove () { blockMove->setValueBool (false); sendValueAll (blockMove); }
 	private:
+		friend class TrajectoryGenerator;
+
 		rts2core::Connection * move_connection;
 		int moveInfoCount;
 		int moveInfoMax;
 
+		TrajectoryGenerator *trajectoryGenerator;
+
+		rts2core::ValueBool *trajectory;
+		rts2core::ValueFloat *trajectoryAhead;
+		rts2core::ValueFloat *trajectoryStep;
+		rts2core::ValueLong *trajectoryPoints;
+		rts2core::ValueDouble *trajectoryMargin;
+
+		/**
+		 * Start or check trajectory streaming.
+		 *
+		 * @return true if mount follows streamed trajectory, false if runTracking shall be called
+		 */
+		bool runTrajectory ();
+
+		/**
+		 * Stop trajectory streaming, if it is running.
+		 */
+		void stopTrajectoryStream ();
+
 		/**
 		 * Last error.
 		 */
@@ -1191,7 +1251,8 @@ class Telescope:public rts2core::Device
 
 		rts2core::ValueDouble *tle_refresh;
 
-		tle_t tle;
+		// satellite model, initialised when TLE is received
+		TLEPropagator tlePropagator;
 
 		// Value for RA DEC differential tracking
 		rts2core::ValueRaDec *diffRaDec;
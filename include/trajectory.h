@@ -0,0 +1,152 @@
+/*
+ * Generator of telescope tracking trajectory.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_TRAJECTORY__
+#define __RTS2_TRAJECTORY__
+
+#include <libnova/libnova.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+namespace rts2teld
+{
+
+class Telescope;
+
+/**
+ * Time tagged point of the tracking trajectory.
+ */
+struct TrajectoryPoint
+{
+	// ctime of the point
+	double t;
+	// target sky position, with all corrections applied
+	struct ln_equ_posn pos;
+	// axis counts
+	int32_t ac;
+	int32_t dc;
+	// axis speed, in counts per second
+	double ac_speed;
+	double dc_speed;
+};
+
+/**
+ * Calculates tracking trajectory ahead of time in a separate thread and
+ * passes it to telescope driver, which streams it to the mount as
+ * position-velocity-time commands. Mount then follows the trajectory with
+ * its own clock, so tracking does not depend on latency of the daemon main
+ * loop.
+ *
+ * Trajectory is calculated by Telescope::calculateTarget, which uses
+ * values owned by the main loop. Main loop holds generator lock all the
+ * time except when it waits for events, so the generator thread calculates
+ * and sends points only while the main loop sleeps. Points are calculated
+ * ahead, so short blocking of the main loop does not starve the mount.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class TrajectoryGenerator
+{
+	public:
+		/**
+		 * Create generator. Must be called from the main thread,
+		 * which becomes owner of the generator lock.
+		 */
+		TrajectoryGenerator (Telescope *_telescope);
+		~TrajectoryGenerator ();
+
+		/**
+		 * Start streaming trajectory. Called with generator lock held.
+		 *
+		 * @param ac  current RA/HA axis counts
+		 * @param dc  current DEC axis counts
+		 */
+		void start (int32_t ac, int32_t dc);
+
+		/**
+		 * Stop streaming. Called with generator lock held.
+		 */
+		void stop ();
+
+		/**
+		 * Returns true if trajectory is streamed to the mount.
+		 */
+		bool isActive () { return active; }
+
+		/**
+		 * Returns true if streaming was stopped because of
+		 * calculation or communication error. Cleared by start.
+		 */
+		bool isFailed () { return failed; }
+
+		/**
+		 * Set how many seconds ahead trajectory is calculated, and
+		 * time between trajectory points.
+		 */
+		void setTiming (double _ahead, double _step);
+
+		/**
+		 * Returns time (in ctime) of the last point send to the mount.
+		 */
+		double getLastTime () { return lastPoint.t; }
+
+		/**
+		 * Returns number of points send to the mount since start.
+		 */
+		long getPointsSent () { return pointsSent; }
+
+		/**
+		 * Release generator lock. Called by the main loop before it waits for events.
+		 */
+		void unlock () { pthread_mutex_unlock (&mutex); }
+
+		/**
+		 * Acquire generator lock. Called by the main loop after it wakes up.
+		 */
+		void lock () { pthread_mutex_lock (&mutex); }
+
+	private:
+		Telescope *telescope;
+
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		pthread_t thread;
+		bool threadRunning;
+
+		bool active;
+		bool failed;
+		bool quit;
+
+		double ahead;
+		double step;
+
+		// last calculated point, its axis counts are used as input for next point
+		TrajectoryPoint lastPoint;
+		long pointsSent;
+
+		int calculatePoint (double t, TrajectoryPoint &point);
+
+		static void *generatorThread (void *arg);
+		void generator ();
+};
+
+}
+
+#endif // !__RTS2_TRAJECTORY__
@@ -333,6 +333,11 @@ class ProgressIndicator
  */
 double getNow ();
 
+/**
+ * Return CPU time (in seconds) used by the calling thread.
+ */
+double getCPUTime ();
+
 /**
  * Creates multiple WCS name from value name and suffix.
  */
@@ -1141,4 +1141,14 @@ class ValueAltAz: public Value
  */
 rts2core::Value *newValue (int rts2Type, std::string name, std::string desc);
 
+/**
+ * Duplicate variable.
+ *
+ * @param old_value Old value of variable.
+ * @param withVal When set to true, variable will be duplicated with value.
+ *
+ * @return Duplicate of old_value, NULL if value type is not known.
+ */
+rts2core::Value *duplicateValue (rts2core::Value * old_value, bool withVal = false);
+
 #endif							 /* !__RTS2_VALUE__ */
@@ -20,6 +20,9 @@
 #ifndef __RTS2_VALUELIST__
 #define __RTS2_VALUELIST__
 
+#include <map>
+#include <string>
+#include <strings.h>
 #include <vector>
 
 #include "value.h"
@@ -28,6 +31,17 @@
 namespace rts2core
 {
 
+/**
+ * Case insensitive ordering of value names, as used by Value::isValue.
+ * Used to index values by name.
+ *
+ * @ingroup RTS2Value
+ */
+struct ValueNameCompare
+{
+	bool operator () (const std::string &a, const std::string &b) const { return strcasecmp (a.c_str (), b.c_str ()) < 0; }
+};
+
 /**
  * Represent set of Values. It's used to store values which shall
  * be reseted when new script starts etc..
@@ -151,6 +165,48 @@ class CondValueVector:public std::vector < CondValue * >
 			for (CondValueVector::iterator iter = begin (); iter != end (); iter++)
 				delete *iter;
 		}
+
+		/**
+		 * Add value to the vector, and to name and value indices. Values
+		 * must be added through this call to be found by getCondValue.
+		 */
+		void addCondValue (CondValue *c_val)
+		{
+			push_back (c_val);
+			// first value with the given name is found, as with linear search
+			nameIndex.insert (std::pair <std::string, CondValue *> (c_val->getValue ()->getName (), c_val));
+			valueIndex[c_val->getValue ()] = c_val;
+		}
+
+		/**
+		 * Find value by name. Name comparison is case insensitive.
+		 *
+		 * @return CondValue with given name, NULL if it does not exists.
+		 */
+		CondValue *getCondValue (const char *v_name)
+		{
+			std::map <std::string, CondValue *, ValueNameCompare>::iterator iter = nameIndex.find (std::string (v_name));
+			if (iter == nameIndex.end ())
+				return NULL;
+			return iter->second;
+		}
+
+		/**
+		 * Find CondValue holding given value.
+		 *
+		 * @return CondValue holding the value, NULL if the value is not in the vector.
+		 */
+		CondValue *getCondValue (const Value *val)
+		{
+			std::map <const Value *, CondValue *>::iterator iter = valueIndex.find (val);
+			if (iter == valueIndex.end ())
+				return NULL;
+			return iter->second;
+		}
+
+	private:
+		std::map <std::string, CondValue *, ValueNameCompare> nameIndex;
+		std::map <const Value *, CondValue *> valueIndex;
 };
 
 /**
@@ -0,0 +1,112 @@
+/*
+ * Pool of worker threads for data parallel loops.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_WORKERPOOL__
+#define __RTS2_WORKERPOOL__
+
+#include <pthread.h>
+#include <stddef.h>
+#include <vector>
+
+namespace rts2core
+{
+
+/**
+ * Job processed by the worker pool. Items of the job are processed in
+ * arbitrary order by arbitrary thread, so processItem must be safe to call
+ * concurrently for different items.
+ */
+class WorkerJob
+{
+	public:
+		virtual ~WorkerJob () {}
+
+		/**
+		 * Process single item of the job.
+		 *
+		 * @param i  item index (0 .. number of items - 1)
+		 */
+		virtual void processItem (size_t i) = 0;
+};
+
+/**
+ * Fixed size pool of threads, which runs loops over items in parallel.
+ * Threads are started once and sleep between jobs. The calling thread
+ * takes part in the processing, so pool of size 1 does not start any
+ * thread and processes items sequentially.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class WorkerPool
+{
+	public:
+		/**
+		 * Creates pool.
+		 *
+		 * @param threads  number of threads processing jobs, including calling thread
+		 */
+		WorkerPool (int threads);
+		~WorkerPool ();
+
+		/**
+		 * Process all items of the job. Returns after all items were processed.
+		 *
+		 * @param job     job to process
+		 * @param items   number of items in the job
+		 * @param chunk   number of consecutive items taken by a thread at once
+		 */
+		void run (WorkerJob *job, size_t items, size_t chunk = 1);
+
+		/**
+		 * Returns number of threads processing jobs, including calling thread.
+		 */
+		int getThreads () { return workers.size () + 1; }
+
+		/**
+		 * Returns number of online processors, which is good default for pool size.
+		 */
+		static int getOnlineCPUs ();
+
+	private:
+		std::vector <pthread_t> workers;
+
+		pthread_mutex_t mutex;
+		pthread_cond_t startCond;
+		pthread_cond_t doneCond;
+
+		WorkerJob *job;
+		size_t items;
+		size_t chunk;
+		// next item to process, accessed with atomic operations
+		volatile size_t nextItem;
+
+		// incremented with every job
+		unsigned int generation;
+		// number of workers which still process current job
+		int running;
+		bool quit;
+
+		void processItems ();
+
+		static void *workerThread (void *arg);
+};
+
+}
+
+#endif // !__RTS2_WORKERPOOL__
@@ -8,8 +8,11 @@
 # pragma warning(disable:4786)	 // identifier was truncated in debug info
 #endif
 
+#include "rts2-config.h"
+
 #ifndef MAKEDEPEND
 # include <list>
+# include <map>
 #endif
 
 #include <malloc.h>
@@ -74,6 +77,18 @@ namespace XmlRpc
 
 			void checkFd (fd_set *inFd, fd_set *outFd, fd_set *excFd, XmlRpcSource *chunkWait = NULL);
 
+			//! Watch sources with epoll instead of select. Sources are registered
+			//! once, and only sources reported ready are processed in checkPoll.
+			//!  @return -1 on error, 0 on success
+			int enablePoll();
+
+			//! Return epoll descriptor. It becomes readable when some source is ready,
+			//! so it can be watched by other event loop. -1 if epoll is not used.
+			int getPollFd() { return _pollFd; }
+
+			//! Process sources which are ready. Does not block.
+			void checkPoll(XmlRpcSource *chunkWait = NULL);
+
 			//! Exit from work routine
 			void exitWork();
 
@@ -98,9 +113,21 @@ namespace XmlRpc
 			// A list of sources to monitor
 			typedef std::list< MonitoredSource > SourceList;
 
+			// Process events on a single source
+			void handleSource(SourceList::iterator thisIt, bool readable, bool writable, bool exc, XmlRpcSource *chunkWait);
+
+			// Update epoll registration of the source
+			void pollCtl(int op, XmlRpcSource *source, unsigned mask);
+
 			// Sources being monitored
 			SourceList _sources;
 
+			// epoll descriptor, -1 if select is used
+			int _pollFd;
+
+			// sources registered with epoll
+			std::map< XmlRpcSource*, SourceList::iterator > _pollSources;
+
 			// When work should stop (-1 implies wait forever, or until exit is called)
 			double _endTime;
 
@@ -108,6 +108,38 @@ namespace XmlRpc
 			//! Check if it should server any of the modified sockets
 			void checkFd (fd_set *inFd, fd_set *outFd, fd_set *excFd);
 
+			//! Watch client connections with epoll. Returns descriptor which
+			//! shall be watched for reading by the caller event loop, -1 on error.
+			int enablePoll ();
+
+			//! Process client connections reported ready by epoll
+			void checkPoll ();
+
+			//! Return epoll descriptor, -1 if epoll is not used
+			int getPollFd () { return _disp.getPollFd (); }
+
+			//! Compress GET responses of at least minLength bytes, if client accepts
+			//! gzip or deflate encoding. 0 disables compression.
+			void setCompressMinLength (size_t minLength) { _compressMinLength = minLength; }
+
+			size_t getCompressMinLength () { return _compressMinLength; }
+
+			//! Record compressed response, for statistics
+			void responseCompressed (size_t originalLength, size_t compressedLength)
+			{
+				_compressedResponses++;
+				_compressedOriginal += originalLength;
+				_compressedLength += compressedLength;
+			}
+
+			//! Return number of compressed responses, and their total size before and after compression
+			void getCompressStatistics (long &responses, long long &original, long long &compressed)
+			{
+				responses = _compressedResponses;
+				original = _compressedOriginal;
+				compressed = _compressedLength;
+			}
+
 			//! Temporarily stop processing client requests and exit the work() method.
 			void exitWork();
 
@@ -157,6 +189,11 @@ namespace XmlRpc
 			XmlRpcServerMethod* _methodHelp;
 		private:
 			XmlRpcServerGetRequest* _defaultGetRequest;
+
+			size_t _compressMinLength;
+			long _compressedResponses;
+			long long _compressedOriginal;
+			long long _compressedLength;
 	};
 }								 // namespace XmlRpc
 #endif							 //_XMLRPCSERVER_H_
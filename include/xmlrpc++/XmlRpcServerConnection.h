@@ -13,10 +13,12 @@
 
 #include <list>
 #include <utility>
+#include <time.h>
 
 #include "XmlRpcValue.h"
 #include "XmlRpcSocket.h"
 #include "XmlRpcSource.h"
+#include "XmlRpcWebSocket.h"
 
 namespace XmlRpc
 {
@@ -60,7 +62,7 @@ namespace XmlRpc
 			/**
 			 * Go to async mode.
 			 */
-			virtual void goAsync () { _connectionState = WAIT_ASYNC; }
+			virtual void goAsync ();
 
 			/**
 			 * Send chunked data.
@@ -95,6 +97,73 @@ namespace XmlRpc
 			// return true if connection is in chunged mode
 			bool isChunked () { return _contentLength == -1; }
 
+			/**
+			 * Returns true if client asked for upgrade to WebSocket protocol.
+			 */
+			bool isWebSocketRequest () { return _webSocketKey.length () > 0; }
+
+			/**
+			 * Returns true if connection was switched to WebSocket protocol.
+			 */
+			bool isWebSocket () { return _connectionState == WEBSOCKET || _connectionState == WEBSOCKET_CLOSING; }
+
+			/**
+			 * Finish WebSocket handshake and switch connection to WebSocket
+			 * protocol. Request handler shall then throw XmlRpcAsynchronous,
+			 * connection will be monitored for incoming frames.
+			 *
+			 * @param handler  handler receiving client messages, can be NULL
+			 *
+			 * @return false if client did not asked for WebSocket
+			 */
+			bool acceptWebSocket (XmlRpcWebSocketHandler *handler);
+
+			/**
+			 * Send WebSocket frame. Frames are queued and written as
+			 * socket is ready to accept them.
+			 *
+			 * @return false if frame cannot be send - connection is not
+			 * WebSocket, is closing or socket error occured
+			 */
+			bool sendWebSocket (const char *data, size_t len, int opcode = WS_TEXT);
+			bool sendWebSocket (const std::string &data, int opcode = WS_TEXT) { return sendWebSocket (data.c_str (), data.length (), opcode); }
+
+			/**
+			 * Send ping frame to client.
+			 */
+			bool pingWebSocket () { return sendWebSocket (NULL, 0, WS_PING); }
+
+			/**
+			 * Send close frame. Connection is closed after frame is written.
+			 */
+			void closeWebSocket (int code = WS_CLOSE_NORMAL);
+
+			/**
+			 * Returns number of bytes queued for sending on WebSocket.
+			 */
+			size_t getWebSocketPending () { return _wsOut.length () - _wsWritten; }
+
+			/**
+			 * Returns time of the last data received on WebSocket.
+			 */
+			time_t getWebSocketLastReceived () { return _wsLastReceived; }
+
+			/**
+			 * Send response of GET request executed outside of the
+			 * main thread. Connection takes ownership of response.
+			 */
+			void offloadFinished (int http_code, const char *response_type, char *response, size_t response_length);
+
+			/**
+			 * Send error response of GET request executed outside of
+			 * the main thread.
+			 *
+			 * @param json     if true, error is send as JSON error
+			 * @param code     HTTP error code
+			 * @param message  error message
+			 */
+			void offloadFailed (bool json, int code, const std::string &message);
+
 		protected:
 
 			bool readHeader();
@@ -129,7 +198,7 @@ namespace XmlRpc
 			XmlRpcServer* _server;
 
 			// Possible IO states for the connection
-			enum ServerConnectionState { READ_HEADER, READ_REQUEST, READ_GET_REQUEST, READ_POST_REQUEST, GET_REQUEST, POST_REQUEST, WRITE_RESPONSE, WAIT_ASYNC, WRITE_ASYNC_RESPONSE };
+			enum ServerConnectionState { READ_HEADER, READ_REQUEST, READ_GET_REQUEST, READ_POST_REQUEST, GET_REQUEST, POST_REQUEST, WRITE_RESPONSE, WAIT_ASYNC, WRITE_ASYNC_RESPONSE, WEBSOCKET, WEBSOCKET_CLOSING };
 			ServerConnectionState _connectionState;
 
 			// Request headers
@@ -174,6 +243,9 @@ namespace XmlRpc
 
 			// Whether to keep the current client connection open for further requests
 			bool _keepAlive;
+
+			// Encodings accepted by client (ACCEPT_GZIP, ACCEPT_DEFLATE)
+			int _acceptEncoding;
 		private:
 			struct sockaddr_in _saddr;
 #ifdef _WINDOWS
@@ -183,6 +255,31 @@ namespace XmlRpc
 #endif
 			// prepare to receive next data
 			void prepareForNext ();
+
+			// compress GET response, if client accepts compressed data
+			void compressResponse (const char *response_type);
+
+			// prepare HTTP headers for GET response
+			void finishGet (int http_code, const char *response_type);
+
+			// value of Sec-WebSocket-Key, if client asked for upgrade to WebSocket
+			std::string _webSocketKey;
+			XmlRpcWebSocketHandler *_webSocketHandler;
+
+			// received data and partial message
+			std::string _wsIn;
+			std::string _wsMessage;
+			int _wsMessageOpcode;
+
+			// frames waiting to be written
+			std::string _wsOut;
+			size_t _wsWritten;
+
+			time_t _wsLastReceived;
+
+			unsigned handleWebSocket (unsigned eventType);
+			bool readWebSocket ();
+			bool writeWebSocket ();
 	};
 
 
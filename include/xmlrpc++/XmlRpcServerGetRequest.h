@@ -10,6 +10,7 @@
 #endif
 
 #ifndef MAKEDEPEND
+# include <list>
 # include <string>
 # include <vector>
 #endif
@@ -120,12 +121,23 @@ namespace XmlRpc
 			//! Send header for data with a given size. After all data are send, the calling code must call source->asyncFinished to re-enable connection for commands.
 			void sendAsyncDataHeader (size_t contentLength, XmlRpcServerConnection *source, const char *dataType = "binary/data");
 
+			/**
+			 * Collect extra headers added by requests executed by the
+			 * calling thread in the given list, instead of adding them
+			 * to the request connection. Used by threads executing
+			 * requests outside of the main thread, as the request
+			 * connection member belongs to the main thread. Pass NULL to
+			 * restore the default.
+			 */
+			static void setThreadHeaders (std::list <std::pair <const char *, std::string> > *headers);
+
 		protected:
 			XmlRpcServer* _server;
 
 			XmlRpcServerConnection *connection;
 
-			void addExtraHeader (const char *name, const char *value) { connection->addExtraHeader (name, value); }
+			void addExtraHeader (const char *name, const char *value) { addExtraHeader (name, std::string (value)); }
+			void addExtraHeader (const char *name, std::string value);
 			/**
 			 * Specify max age in seconds. For this time cached response will be valid. This method
 			 * is provide for convinient setting of cache timeout.
@@ -136,7 +148,7 @@ namespace XmlRpc
 			{
 				std::ostringstream _os;
 				_os << "max-age=" << maxage;
-				connection->addExtraHeader ("Cache-Control", _os.str ());
+				addExtraHeader ("Cache-Control", _os.str ());
 			}
 		private:
 			std::string _prefix;
@@ -46,6 +46,9 @@ namespace XmlRpc
 			//! Convert raw text to encoded xml.
 			static std::string xmlEncode(const std::string& raw);
 
+			//! Convert raw text to quoted JSON string, escaping special characters.
+			static std::string jsonEncode(const std::string& raw);
+
 			//! Convert encoded xml to raw text
 			static std::string xmlDecode(const std::string& encoded);
 
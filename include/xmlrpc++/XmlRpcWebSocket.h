@@ -0,0 +1,85 @@
+/*
+ * WebSocket (RFC 6455) support for XML-RPC/HTTP server.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef _XMLRPCWEBSOCKET_H_
+#define _XMLRPCWEBSOCKET_H_
+
+#include <string>
+#include <stddef.h>
+
+// WebSocket frame opcodes
+#define WS_CONTINUATION     0x00
+#define WS_TEXT             0x01
+#define WS_BINARY           0x02
+#define WS_CLOSE            0x08
+#define WS_PING             0x09
+#define WS_PONG             0x0A
+
+// WebSocket close status codes
+#define WS_CLOSE_NORMAL     1000
+#define WS_CLOSE_GOING_AWAY 1001
+#define WS_CLOSE_PROTOCOL   1002
+#define WS_CLOSE_TOO_BIG    1009
+
+// maximal size of message accepted from client
+#define WS_MAX_MESSAGE      65536
+
+namespace XmlRpc
+{
+	class XmlRpcServerConnection;
+
+	/**
+	 * Receives messages send by client over WebSocket connection.
+	 *
+	 * @author Petr Kubanek <petr@kubanek.net>
+	 */
+	class XmlRpcWebSocketHandler
+	{
+		public:
+			XmlRpcWebSocketHandler () {}
+			virtual ~XmlRpcWebSocketHandler () {}
+
+			/**
+			 * Called when complete text or binary message was received.
+			 *
+			 * @param source   connection which received the message
+			 * @param opcode   WS_TEXT or WS_BINARY
+			 * @param message  message payload (unmasked)
+			 */
+			virtual void webSocketMessage (XmlRpcServerConnection *source, int opcode, const std::string &message) = 0;
+	};
+
+	/**
+	 * Returns value of Sec-WebSocket-Accept header for given
+	 * Sec-WebSocket-Key.
+	 */
+	std::string webSocketAccept (const std::string &key);
+
+	/**
+	 * Append server (unmasked) frame to buffer.
+	 *
+	 * @param buf     buffer where frame will be appended
+	 * @param opcode  frame opcode
+	 * @param data    frame payload
+	 * @param len     payload length
+	 */
+	void webSocketFrame (std::string &buf, int opcode, const char *data, size_t len);
+}
+
+#endif // !_XMLRPCWEBSOCKET_H_
@@ -0,0 +1,325 @@
+/*
+ * Propagator of satellite position from two line elements.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "pluto/tlepropagator.h"
+#include "pluto/observe.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// refine crossings and culminations to half a second
+#define RST_PRECISION    (0.5 / 86400.0)
+
+// errors, as opposed to warnings, of SxPx functions
+static bool isError (int ret)
+{
+	return ret == SXPX_ERR_NEARLY_PARABOLIC || ret == SXPX_ERR_NEGATIVE_MAJOR_AXIS || ret == SXPX_ERR_NEGATIVE_XN;
+}
+
+TLEPropagator::TLEPropagator ()
+{
+	ephem = TLE_SGP4;
+	loaded = false;
+
+	lng = 0;
+	lat = 0;
+	rho_cos_phi = 1;
+	rho_sin_phi = 0;
+}
+
+int TLEPropagator::load (const char *line1, const char *line2)
+{
+	loaded = false;
+	int ret = parse_elements (line1, line2, &tle);
+	if (ret != 0)
+		return ret;
+	loaded = true;
+	setEphem (TLE_SGP4);
+	return 0;
+}
+
+int TLEPropagator::setEphem (int _ephem)
+{
+	ephem = _ephem;
+	if (loaded)
+	{
+		int is_deep = select_ephemeris (&tle);
+		if (is_deep && (ephem == TLE_SGP4 || ephem == TLE_SGP8))
+			ephem += 2;    /* switch to an SDx */
+		if (!is_deep && (ephem == TLE_SDP4 || ephem == TLE_SDP8))
+			ephem -= 2;    /* switch to an SGx */
+		init ();
+	}
+	return ephem;
+}
+
+void TLEPropagator::setObserver (double _lng, double _lat, double altitude)
+{
+	double r_c, r_s;
+	lat_alt_to_parallax (_lat, altitude, &r_c, &r_s);
+	setObserver (_lng, _lat, r_c, r_s);
+}
+
+void TLEPropagator::setObserver (double _lng, double _lat, double _rho_cos_phi, double _rho_sin_phi)
+{
+	lng = _lng;
+	lat = _lat;
+	rho_cos_phi = _rho_cos_phi;
+	rho_sin_phi = _rho_sin_phi;
+}
+
+int TLEPropagator::getPosition (double JD, double &ra, double &dec, double &distance, double *alt)
+{
+	double observer_loc[3];
+	double sat_pos[3];
+
+	int ret = propagate (JD, sat_pos);
+	if (isError (ret))
+		return ret;
+
+	observer_cartesian_coords (JD, lng, rho_cos_phi, rho_sin_phi, observer_loc);
+	topocentric (observer_loc, sat_pos, ra, dec, distance, alt);
+	return 0;
+}
+
+int TLEPropagator::getPositions (double JD, double step, size_t n, double *ra, double *dec, double *distance, double *alt)
+{
+	int ret = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		double r, d, dist, a;
+		int pr = getPosition (JD + i * step, r, d, dist, alt ? &a : NULL);
+		if (pr)
+		{
+			r = d = dist = a = NAN;
+			ret = pr;
+		}
+		if (ra)
+			ra[i] = r;
+		if (dec)
+			dec[i] = d;
+		if (distance)
+			distance[i] = dist;
+		if (alt)
+			alt[i] = a;
+	}
+	return ret;
+}
+
+int TLEPropagator::getPositions (TLEPropagator **sats, size_t n, double JD, double *ra, double *dec, double *distance, double *alt)
+{
+	if (n == 0)
+		return 0;
+
+	// observer position is calculated only once
+	double observer_loc[3];
+	observer_cartesian_coords (JD, sats[0]->lng, sats[0]->rho_cos_phi, sats[0]->rho_sin_phi, observer_loc);
+
+	int failed = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		double sat_pos[3];
+		double r, d, dist, a;
+		if (isError (sats[i]->propagate (JD, sat_pos)))
+		{
+			r = d = dist = a = NAN;
+			failed++;
+		}
+		else
+		{
+			sats[0]->topocentric (observer_loc, sat_pos, r, d, dist, &a);
+		}
+		if (ra)
+			ra[i] = r;
+		if (dec)
+			dec[i] = d;
+		if (distance)
+			distance[i] = dist;
+		if (alt)
+			alt[i] = a;
+	}
+	return failed;
+}
+
+int TLEPropagator::getRST (double JD, double horizon, double &rise, double &set, double &transit, double span, double step)
+{
+	rise = set = transit = NAN;
+
+	if (!loaded || step <= 0)
+		return -1;
+
+	size_t n = ceil (span / step) + 1;
+	std::vector <double> alt (n);
+
+	getPositions (JD, step, n, NULL, NULL, NULL, &(alt[0]));
+
+	bool above = false;
+	bool below = false;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (alt[i] > horizon)
+			above = true;
+		else
+			below = true;
+	}
+
+	if (!above)
+		return -1;
+	if (!below)
+		return 1;
+
+	for (size_t i = 1; i < n; i++)
+	{
+		double jd1 = JD + (i - 1) * step;
+		double jd2 = JD + i * step;
+		if (isnan (rise) && alt[i - 1] <= horizon && alt[i] > horizon)
+			rise = findCrossing (jd1, jd2, horizon);
+		if (isnan (set) && alt[i - 1] > horizon && alt[i] <= horizon)
+			set = findCrossing (jd1, jd2, horizon);
+		// culmination is local maximum above horizon
+		if (isnan (transit) && i + 1 < n && alt[i] > horizon && alt[i] >= alt[i - 1] && alt[i] >= alt[i + 1])
+			transit = findTransit (jd1, jd2 + step);
+		if (!(isnan (rise) || isnan (set) || isnan (transit)))
+			break;
+	}
+	return 0;
+}
+
+void TLEPropagator::init ()
+{
+	switch (ephem)
+	{
+		case TLE_SGP:
+			SGP_init (params, &tle);
+			break;
+		case TLE_SGP4:
+			SGP4_init (params, &tle);
+			break;
+		case TLE_SGP8:
+			SGP8_init (params, &tle);
+			break;
+		case TLE_SDP4:
+			SDP4_init (params, &tle);
+			break;
+		case TLE_SDP8:
+			SDP8_init (params, &tle);
+			break;
+	}
+}
+
+int TLEPropagator::propagate (double JD, double *sat_pos)
+{
+	if (!loaded)
+		return SXPX_ERR_NEGATIVE_MAJOR_AXIS;
+
+	double t_since = (JD - tle.epoch) * 1440.;
+
+	// deep space models store integrator state in parameters; copying them is
+	// much cheaper than initialisation, and keeps results independent of previous calls
+	double deep_params[N_SAT_PARAMS];
+	if (ephem == TLE_SDP4 || ephem == TLE_SDP8)
+		memcpy (deep_params, params, sizeof (params));
+
+	switch (ephem)
+	{
+		case TLE_SGP:
+			SGP (t_since, &tle, params, sat_pos, NULL);
+			return 0;
+		case TLE_SGP4:
+			return SGP4 (t_since, &tle, params, sat_pos, NULL);
+		case TLE_SGP8:
+			return SGP8 (t_since, &tle, params, sat_pos, NULL);
+		case TLE_SDP4:
+			return SDP4 (t_since, &tle, deep_params, sat_pos, NULL);
+		case TLE_SDP8:
+			return SDP8 (t_since, &tle, deep_params, sat_pos, NULL);
+	}
+	return SXPX_ERR_NEGATIVE_MAJOR_AXIS;
+}
+
+void TLEPropagator::topocentric (const double *observer_loc, const double *sat_pos, double &ra, double &dec, double &distance, double *alt)
+{
+	get_satellite_ra_dec_delta (observer_loc, sat_pos, &ra, &dec, &distance);
+	if (alt == NULL)
+		return;
+
+	// local zenith, observer_loc is rotated by local sidereal time
+	double lst = atan2 (observer_loc[1], observer_loc[0]);
+	double zenith[3];
+	zenith[0] = cos (lat) * cos (lst);
+	zenith[1] = cos (lat) * sin (lst);
+	zenith[2] = sin (lat);
+
+	double z = 0;
+	for (int i = 0; i < 3; i++)
+		z += (sat_pos[i] - observer_loc[i]) * zenith[i];
+	*alt = asin (z / distance);
+}
+
+double TLEPropagator::getAltitude (double JD)
+{
+	double ra, dec, distance, alt;
+	if (getPosition (JD, ra, dec, distance, &alt))
+		return NAN;
+	return alt;
+}
+
+double TLEPropagator::findCrossing (double jd1, double jd2, double horizon)
+{
+	bool rising = getAltitude (jd1) <= horizon;
+	while (jd2 - jd1 > RST_PRECISION)
+	{
+		double m = (jd1 + jd2) / 2.0;
+		if ((getAltitude (m) <= horizon) == rising)
+			jd1 = m;
+		else
+			jd2 = m;
+	}
+	return (jd1 + jd2) / 2.0;
+}
+
+double TLEPropagator::findTransit (double jd1, double jd2)
+{
+	const double g = (sqrt (5.0) - 1) / 2.0;
+	double c = jd2 - g * (jd2 - jd1);
+	double d = jd1 + g * (jd2 - jd1);
+	double fc = getAltitude (c);
+	double fd = getAltitude (d);
+	while (jd2 - jd1 > RST_PRECISION)
+	{
+		if (fc > fd)
+		{
+			jd2 = d;
+			d = c;
+			fd = fc;
+			c = jd2 - g * (jd2 - jd1);
+			fc = getAltitude (c);
+		}
+		else
+		{
+			jd1 = c;
+			c = d;
+			fc = fd;
+			d = jd1 + g * (jd2 - jd1);
+			fd = getAltitude (d);
+		}
+	}
+	return (jd1 + jd2) / 2.0;
+}
@@ -64,6 +64,8 @@ App::App (int argc, char **argv):Object ()
 
 	useLocalTime = true;
 
+	mainThread = pthread_self ();
+
 	tzset ();
 
 	addOption ('h', "help", 0, "write this help");
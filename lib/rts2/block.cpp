@@ -59,12 +59,39 @@ Block::Block (int in_argc, char **in_argv):App (in_argc, in_argv)
 	stateMasterConn = NULL;
 	// allocate ports dynamically
 	port = 0;
+
+	eventPoll = NULL;
+
+	outputCoalescing = false;
+	outputMessages = 0;
+	outputBytes = 0;
+	outputWrites = 0;
+
+	pthread_mutex_init (&threadMessagesMutex, NULL);
+	if (pipe (threadMessagesPipe))
+	{
+		threadMessagesPipe[0] = threadMessagesPipe[1] = -1;
+	}
+	else
+	{
+		fcntl (threadMessagesPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl (threadMessagesPipe[1], F_SETFL, O_NONBLOCK);
+	}
 }
 
 
 Block::~Block (void)
 {
 	connections_t::iterator iter;
+	// messages and data still waiting to be written are not lost at exit
+	processThreadMessages ();
+	flushPendingOutput ();
+	double drainEnd = getNow () + BLOCK_DRAIN_TIMEOUT;
+	for (iter = connections.begin (); iter != connections.end (); iter++)
+		(*iter)->drainWriteQueue ((drainEnd - getNow ()) * 1000);
+	for (iter = centraldConns.begin (); iter != centraldConns.end (); iter++)
+		(*iter)->drainWriteQueue ((drainEnd - getNow ()) * 1000);
+
 	for (iter = connections.begin (); iter != connections.end ();)
 	{
 		Connection *conn = *iter;
@@ -83,6 +110,14 @@ Block::~Block (void)
 	for (std::list <ConnUser *>::iterator iu = blockUsers.begin (); iu != blockUsers.end (); iu++)
 		delete *iu;
 	blockUsers.clear ();
+	delete eventPoll;
+
+	if (threadMessagesPipe[0] >= 0)
+	{
+		close (threadMessagesPipe[0]);
+		close (threadMessagesPipe[1]);
+	}
+	pthread_mutex_destroy (&threadMessagesMutex);
 }
 
 void Block::setPort (int in_port)
@@ -104,6 +139,127 @@ void Block::addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set
 		(*iter)->add (&read_set, &write_set, &exp_set);
 }
 
+int Block::enableEventPoll ()
+{
+	if (eventPoll != NULL)
+		return 0;
+	if (!EventPoll::available ())
+	{
+		logStream (MESSAGE_ERROR) << "epoll support was not compiled in, using select" << sendLog;
+		return -1;
+	}
+	if (!canEventPoll ())
+	{
+		logStream (MESSAGE_WARNING) << "this component watches sockets which are not supported by epoll, using select" << sendLog;
+		return -1;
+	}
+	eventPoll = new EventPoll ();
+	if (eventPoll->init ())
+	{
+		logStream (MESSAGE_ERROR) << "cannot initialize epoll: " << strerror (errno) << ", using select" << sendLog;
+		delete eventPoll;
+		eventPoll = NULL;
+		return -1;
+	}
+	if (threadMessagesPipe[0] >= 0)
+		eventPoll->watch (threadMessagesPipe[0], EventPoll::READ);
+	return 0;
+}
+
+void Block::addPollSocket (int fd, bool write)
+{
+	if (eventPoll)
+		eventPoll->watch (fd, write ? EventPoll::READ | EventPoll::WRITE : EventPoll::READ);
+}
+
+void Block::removePollSocket (int fd)
+{
+	if (eventPoll)
+		eventPoll->unwatch (fd);
+}
+
+void Block::forkedInstance ()
+{
+	// child must not modify epoll set shared with the parent
+	if (eventPoll)
+	{
+		eventPoll->closeFds ();
+		delete eventPoll;
+		eventPoll = NULL;
+	}
+	// buffers belong to the parent
+	pendingOutput.clear ();
+	writeWatch.clear ();
+	outputCoalescing = false;
+	App::forkedInstance ();
+}
+
+void Block::sendThreadMessage (messageType_t in_messageType, const char *in_messageString)
+{
+	pthread_mutex_lock (&threadMessagesMutex);
+	threadMessages.push_back (std::pair <messageType_t, std::string> (in_messageType, std::string (in_messageString)));
+	pthread_mutex_unlock (&threadMessagesMutex);
+	wakeUpLoop ();
+}
+
+void Block::postThreadEvent (Event *event)
+{
+	pthread_mutex_lock (&threadMessagesMutex);
+	threadEvents.push_back (event);
+	pthread_mutex_unlock (&threadMessagesMutex);
+	wakeUpLoop ();
+}
+
+void Block::wakeUpLoop ()
+{
+	// if pipe is full, loop was already woken
+	char c = 0;
+	if (threadMessagesPipe[1] >= 0 && write (threadMessagesPipe[1], &c, 1) != 1 && errno != EAGAIN)
+		std::cerr << "cannot wake up event loop: " << strerror (errno) << std::endl;
+}
+
+void Block::processThreadMessages ()
+{
+	char buf[100];
+	if (threadMessagesPipe[0] >= 0)
+		while (read (threadMessagesPipe[0], buf, sizeof (buf)) > 0)
+			;
+
+	std::list <std::pair <messageType_t, std::string> > messages;
+	std::list <Event *> events;
+	pthread_mutex_lock (&threadMessagesMutex);
+	messages.swap (threadMessages);
+	events.swap (threadEvents);
+	pthread_mutex_unlock (&threadMessagesMutex);
+
+	for (std::list <std::pair <messageType_t, std::string> >::iterator iter = messages.begin (); iter != messages.end (); iter++)
+		sendMessage (iter->first, iter->second.c_str ());
+	for (std::list <Event *>::iterator iter = events.begin (); iter != events.end (); iter++)
+		postEvent (*iter);
+}
+
+void Block::removePendingOutput (Connection *conn)
+{
+	connections_t::iterator iter = std::find (pendingOutput.begin (), pendingOutput.end (), conn);
+	if (iter != pendingOutput.end ())
+		pendingOutput.erase (iter);
+}
+
+void Block::removeWriteWatch (Connection *conn)
+{
+	writeWatch.erase (std::remove (writeWatch.begin (), writeWatch.end (), conn), writeWatch.end ());
+}
+
+void Block::flushPendingOutput ()
+{
+	while (!pendingOutput.empty ())
+	{
+		Connection *conn = *(pendingOutput.begin ());
+		pendingOutput.erase (pendingOutput.begin ());
+		conn->flushOutput ();
+	}
+}
+
 bool Block::commandQueEmpty ()
 {
 	connections_t::iterator iter;
@@ -159,6 +315,9 @@ void Block::removeConnection (Connection *_conn)
 		else
 			iter++;
 	}
+
+	if (eventPoll)
+		eventPoll->removeOwner (_conn);
 }
 
 void Block::addCentraldConnection (Connection *_conn, bool added)
@@ -258,22 +417,51 @@ int Block::idle ()
 		childReturned (ret);
 	}
 	connections_t::iterator iter;
+	// with epoll, connections which changed socket or state during idle call are registered again;
+	// write queues are registered through addWriteWatch
+	connections_t pollDeleted;
 	for (iter = connections.begin (); iter != connections.end (); iter++)
+	{
 		(*iter)->idle ();
+		if (eventPoll)
+		{
+			if (eventPoll->ownerChanged (*iter, (*iter)->getConnState (), (*iter)->getSocket ()))
+				pollRegister (*iter);
+			// select loop deletes those in selectSuccess; with epoll, there are no events for them
+			if ((*iter)->isConnState (CONN_DELETE))
+				pollDeleted.push_back (*iter);
+		}
+	}
 	for (iter = centraldConns.begin (); iter != centraldConns.end (); iter++)
+	{
 		(*iter)->idle ();
+		if (eventPoll)
+		{
+			if (eventPoll->ownerChanged (*iter, (*iter)->getConnState (), (*iter)->getSocket ()))
+				pollRegister (*iter);
+			if ((*iter)->isConnState (CONN_DELETE))
+				pollDeleted.push_back (*iter);
+		}
+	}
 
 	// add from connection queue..
 	for (iter = connections_added.begin (); iter != connections_added.end (); iter = connections_added.erase (iter))
 	{
 		connections.push_back (*iter);
+		if (eventPoll)
+			pollRegister (*iter);
 	}
 
 	for (iter = centraldConns_added.begin (); iter != centraldConns_added.end (); iter = centraldConns_added.erase (iter))
 	{
 		centraldConns.push_back (*iter);
+		if (eventPoll)
+			pollRegister (*iter);
 	}
 
+	for (iter = pollDeleted.begin (); iter != pollDeleted.end (); iter++)
+		pollDeleteConnection (*iter);
+
 	// test for any pending timers..
 	std::map <double, Event *>::iterator iter_t = timers.begin ();
 	while (iter_t != timers.end () && iter_t->first < getNow ())
@@ -356,6 +544,46 @@ void Block::selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set)
 	}
 }
 
+void Block::pollRegister (Connection *conn)
+{
+	eventPoll->beginOwner (conn, conn->getConnState (), conn->getSocket ());
+	conn->addPoll (eventPoll);
+	eventPoll->endOwner (conn);
+}
+
+void Block::pollConnectionReady (Connection *conn, int fd, uint32_t events)
+{
+	if (conn->pollReady (fd, events) == -1)
+		pollDeleteConnection (conn);
+	else
+		pollRegister (conn);
+}
+
+void Block::pollDeleteConnection (Connection *conn)
+{
+	// delete connection only when it really requested to be deleted..
+	if (deleteConnection (conn))
+	{
+		pollRegister (conn);
+		return;
+	}
+	connections_t::iterator iter = std::find (connections.begin (), connections.end (), conn);
+	if (iter != connections.end ())
+	{
+		connections.erase (iter);
+	}
+	else
+	{
+		iter = std::find (centraldConns.begin (), centraldConns.end (), conn);
+		if (iter == centraldConns.end ())
+			return;
+		centraldConns.erase (iter);
+	}
+	eventPoll->removeOwner (conn);
+	connectionRemoved (conn);
+	delete conn;
+}
+
 void Block::setMessageMask (int new_mask)
 {
 	connections_t::iterator iter;
@@ -373,6 +601,44 @@ void Block::oneRunLoop ()
 	fd_set write_set;
 	fd_set exp_set;
 
+	if (eventPoll)
+	{
+		// watch writability of sockets with queued data
+		for (connections_t::iterator iter = writeWatch.begin (); iter != writeWatch.end (); iter++)
+		{
+			if (std::find (connections.begin (), connections.end (), *iter) != connections.end ()
+				|| std::find (centraldConns.begin (), centraldConns.end (), *iter) != centraldConns.end ())
+				pollRegister (*iter);
+		}
+		writeWatch.clear ();
+		// timerfd wakes the loop for timers
+		eventPoll->setTimer (timers.empty () ? NAN : timers.begin ()->first);
+		loopSleep ();
+		ret = eventPoll->wait (idle_timeout);
+		loopWake ();
+		if (ret > 0)
+		{
+			for (size_t i = 0; i < eventPoll->readySize (); i++)
+			{
+				int fd = eventPoll->readyFd (i);
+				// descriptor was removed while processing previous events
+				if (!eventPoll->isWatched (fd) || fd == threadMessagesPipe[0])
+					continue;
+				Connection *conn = eventPoll->getOwner (fd);
+				if (conn)
+					pollConnectionReady (conn, fd, eventPoll->readyEvents (i));
+				else
+					pollSuccess (fd, eventPoll->readyEvents (i));
+			}
+		}
+		processThreadMessages ();
+		ret = idle ();
+		flushPendingOutput ();
+		if (ret == -1)
+			endRunLoop ();
+		return;
+	}
+
 	if (timers.begin () != timers.end () && (USEC_SEC * (t_diff = (timers.begin ()->first - getNow ()))) < idle_timeout)
 	{
 		if (t_diff <= 0)
@@ -404,10 +670,20 @@ void Block::oneRunLoop ()
 	FD_ZERO (&write_set);
 	FD_ZERO (&exp_set);
 
+	// select watches write queues through Connection::add
+	writeWatch.clear ();
+
 	addSelectSocks (read_set, write_set, exp_set);
-	if (select (FD_SETSIZE, &read_set, &write_set, &exp_set, &read_tout) > 0)
+	if (threadMessagesPipe[0] >= 0)
+		FD_SET (threadMessagesPipe[0], &read_set);
+	loopSleep ();
+	ret = select (FD_SETSIZE, &read_set, &write_set, &exp_set, &read_tout);
+	loopWake ();
+	if (ret > 0)
 		selectSuccess (read_set, write_set, exp_set);
+	processThreadMessages ();
 	ret = idle ();
+	flushPendingOutput ();
 	if (ret == -1)
 		endRunLoop ();
 }
@@ -960,11 +1236,11 @@ bool Block::commandOriginatorPending (Object * object, Connection * exclude_conn
 	return false;
 }
 
-void Block::deleteTimers (int event_type)
+void Block::deleteTimers (int event_type, Object *arg)
 {
 	for (std::map <double, Event *>::iterator iter = timers.begin (); iter != timers.end (); )
 	{
-		if (iter->second->getType () == event_type)
+		if (iter->second->getType () == event_type && (arg == NULL || iter->second->getArg () == arg))
 		{
 			if (pushToDelete (iter))
 				delete (iter->second);
@@ -21,8 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
+#include <sys/statvfs.h>
 #include <sys/time.h>
 #include <fcntl.h>
 #include <time.h>
@@ -164,8 +163,6 @@ long Camera::isExposing ()
 
 int Camera::endExposure (int ret)
 {
-	if (modeCount)
-		memset (modeCount, 0, modeCountSize * sizeof (uint32_t));
 	if (exposureConn)
 	{
 		logStream (MESSAGE_INFO) << "end exposure for " << exposureConn->getName () << sendLog;
@@ -217,6 +214,7 @@ int Camera::deleteConnection (rts2core::Connection * conn)
 		{
 			sharedData->removeClient (i, conn->getCentraldId (), false);
 		}
+		dataTaps.erase (conn);
 	}
 	return rts2core::ScriptDevice::deleteConnection (conn);
 }
@@ -247,6 +245,8 @@ int Camera::endReadout ()
 			exposureConn->endSharedData (currentImageData, true);
 			currentImageData = -1;
 		}
+		endDataTaps (true);
+		updateSharedStat ();
 	}
 	if (quedExpNumber->getValueInteger () > 0 && exposureConn)
 	{
@@ -287,21 +287,30 @@ void Camera::startImageData (rts2core::Connection * conn)
 	if (sharedData)
 	{
 		int segments[chnTot];
+		// all segments are read by the connection which requested the exposure, and by all data taps
+		std::vector <int> clients;
+		clients.push_back (conn->getCentraldId ());
+		for (std::map <rts2core::Connection *, int>::iterator iter = dataTaps.begin (); iter != dataTaps.end (); iter++)
+		{
+			if (iter->first != conn)
+				clients.push_back (iter->first->getCentraldId ());
+		}
 		sharedData->clearChan2Seg ();
 		// map channels
 		for (i = 0; i < chnTot; i++)
 		{
-			segments[i] = sharedData->addClient (chansize[i], i, conn->getCentraldId ());
+			segments[i] = sharedData->addClients (chansize[i], i, clients);
 			if (segments[i] < 0)
 				break;
 		}
 		// if there aren't segments left, send over TCP
 		if (i < chnTot)
 		{
-			// clear allocation we did with addClient above
+			// clear allocation we did with addClients above
 			for (int j = 0; j < i; j++)
 			{
-				sharedData->removeClient (segments[j], conn->getCentraldId ());
+				for (std::vector <int>::iterator iter = clients.begin (); iter != clients.end (); iter++)
+					sharedData->removeClient (segments[j], *iter);
 			}
 			sharedData->clearChan2Seg ();
 			logStream (MESSAGE_WARNING) << "starting binary connection instead of shared data connection" << sendLog;
@@ -312,7 +321,20 @@ void Camera::startImageData (rts2core::Connection * conn)
 		{
 			currentImageData = conn->startSharedData (sharedData, chnTot, segments);
 			currentImageTransfer = SHARED;
+			for (std::map <rts2core::Connection *, int>::iterator iter = dataTaps.begin (); iter != dataTaps.end (); iter++)
+			{
+				if (iter->first == conn)
+					continue;
+				iter->second = iter->first->startSharedData (sharedData, chnTot, segments);
+				// release segments, so they will not be held by the tap
+				if (iter->second < 0)
+				{
+					for (int j = 0; j < chnTot; j++)
+						sharedData->removeClient (segments[j], iter->first->getCentraldId (), false);
+				}
+			}
 		}
+		updateSharedStat ();
 	}
 	else
 	{
@@ -355,6 +377,7 @@ int Camera::sendFirstLine (int chan, int pchan)
 	max->setValueDouble (-LONG_MAX);
 	min->setValueDouble (LONG_MAX);
 	computedPix->setValueLong (0);
+	pixelStat.reset ();
 
 	switch (currentImageTransfer)
 	{
@@ -428,6 +451,11 @@ Camera::Camera (int in_argc, char **in_argv, rounding_t binning_rounding):rts2co
 	sharedData = NULL;
 	sharedMemNum = -1;
 
+	shmFree = NULL;
+	shmReaders = NULL;
+	shmLag = NULL;
+	shmHeld = NULL;
+
 	currentImageData = -1;
 	currentImageTransfer = TCPIP;
 
@@ -459,8 +487,6 @@ Camera::Camera (int in_argc, char **in_argv, rounding_t binning_rounding):rts2co
 	createValue (image_mode, "image_mode", "mode (most often pixel value)", false);
 
 	// mode histogram
-	modeCount = NULL;
-	modeCountSize = 0;
 
 	createValue (computedPix, "computed", "number of pixels so far computed", false);
 
@@ -572,7 +598,6 @@ Camera::~Camera ()
 	delete dataBuffers;
 	delete dataWritten;
 	
-	delete[] modeCount;
 }
 
 int Camera::willConnect (rts2core::NetworkAddress * in_addr)
@@ -671,6 +696,7 @@ int Camera::killAll (bool callScriptEnds)
 		{
 			case SHARED:
 				exposureConn->endSharedData (currentImageData, false);
+				endDataTaps (false);
 				currentImageTransfer = TCPIP;
 				break;
 			case TCPIP:
@@ -743,6 +769,7 @@ int Camera::info ()
 		viter->filter->setValueInteger (getFilterNum (*niter));
 	}
 	camFocVal->setValueInteger (getFocPos ());
+	updateSharedStat ();
 	return rts2core::ScriptDevice::info ();
 }
 
@@ -943,53 +970,21 @@ int Camera::sendReadoutData (char *data, size_t dataSize, int chan)
 	// calculated..
 	if (calculateStatistics->getValueInteger () != STATISTIC_NO)
 	{
-		int totPix;
-		// update sum. min and max
-		switch (getDataType ())
+		// update sum, min, max and mode
+		size_t totPix = pixelStat.update (getDataType (), data, dataSize);
+		computedPix->setValueLong (computedPix->getValueLong () + totPix);
+		if (pixelStat.getCount () > 0)
 		{
-			case RTS2_DATA_BYTE:
-				totPix = updateStatistics ((uint8_t *) data, dataSize);
-				break;
-			case RTS2_DATA_SHORT:
-				totPix = updateStatistics ((int16_t *) data, dataSize);
-				break;
-			case RTS2_DATA_LONG:
-				totPix = updateStatistics ((int32_t *) data, dataSize);
-				break;
-			case RTS2_DATA_LONGLONG:
-				totPix = updateStatistics ((int64_t *) data, dataSize);
-				break;
-			case RTS2_DATA_FLOAT:
-				totPix = updateStatistics ((float *) data, dataSize);
-				break;
-			case RTS2_DATA_DOUBLE:
-				totPix = updateStatistics ((double *) data, dataSize);
-				break;
-			case RTS2_DATA_SBYTE:
-				totPix = updateStatistics ((int8_t *) data, dataSize);
-				break;
-			case RTS2_DATA_USHORT:
-				totPix = updateStatistics ((uint16_t *) data, dataSize);
-				break;
-			case RTS2_DATA_ULONG:
-				totPix = updateStatistics ((uint32_t *) data, dataSize);
-				break;
+			sum->setValueDouble (pixelStat.getSum ());
+			average->setValueDouble (pixelStat.getAverage ());
+			min->setValueDouble (pixelStat.getMin ());
+			max->setValueDouble (pixelStat.getMax ());
 		}
-		computedPix->setValueLong (computedPix->getValueLong () + totPix);
-		average->setValueDouble (sum->getValueDouble () / computedPix->getValueLong ());
 
-		// find maximal mode value
-		if (modeCount != NULL)
+		// mode is tracked during histogram update, no need to scan the histogram
+		if (!isnan (pixelStat.getMode ()))
 		{
-			uint32_t modeNum = 0;
-			for (unsigned int i = 0; i < modeCountSize; i++)
-			{
-				if (modeCount[i] > modeNum)
-				{
-					image_mode->setValueInteger (i);
-					modeNum = modeCount[i];
-				}
-			}
+			image_mode->setValueDouble (pixelStat.getMode ());
 			sendValueAll (image_mode);
 		}
 
@@ -1175,54 +1170,44 @@ int Camera::initValues ()
 		// autoscale shared memory
 		if (sharedMemNum == 0)
 		{
-#ifdef __linux__
-			// read limit
-			std::ifstream ifs ("/proc/sys/kernel/shmmax");
-			long long shmax;
-			ifs >> shmax;
-			ifs.close ();
-			if (ifs.fail ())
+			// use half of free space in the shared memory file system
+			struct statvfs svfs;
+			if (statvfs ("/dev/shm", &svfs))
 			{
-				logStream (MESSAGE_ERROR) << "cannot read maximal shared memory size from /proc/sys/kernel/shmmax" << sendLog;
+				logStream (MESSAGE_ERROR) << "cannot get free space of /dev/shm, uses 10 for number of shared memory segments: " << strerror (errno) << sendLog;
 				sharedMemNum = 10;
 			}
 			else
 			{
-				double d = sizeof (struct rts2core::SharedDataHeader);
-				d *= d;
-				size_t a = sizeof (struct rts2core::SharedDataSegment) + dataBufferSize;
-				d += 4 * a * shmax;
-				d = (sqrt (d) - sizeof (struct rts2core::SharedDataHeader)) / (2 * a);
+				double d = ((double) svfs.f_bavail) * svfs.f_frsize / 2.0 - sizeof (struct rts2core::SharedDataHeader);
+				d /= sizeof (struct rts2core::SharedDataSegment) + dataBufferSize;
 				if (d > 1000)
 				{
 					sharedMemNum = 1000;
 				}
-				else if (d < 0)
-				{
-					logStream (MESSAGE_ERROR) << "invalid root of quadratic equation for maximal shared memory size " << d << sendLog;
-					return -1;
-				}
 				else
 				{
 					sharedMemNum = d;
-					if (sharedMemNum == 0)
+					if (sharedMemNum <= 0)
 					{
-						logStream (MESSAGE_ERROR) << "shared memory maximal size is insuficient for a single image. Please increase the memory limit - see man shmget for details" << sendLog;
+						logStream (MESSAGE_ERROR) << "free space in /dev/shm is insuficient for a single image. Please increase size of /dev/shm file system" << sendLog;
 						return -1;
 					}
 				}
 			}
-#else
-			logStream (MESSAGE_ERROR) << "unknow operating system, uses 10 for number of shared memory segments" << sendLog;
-			sharedMemNum = 10;
-#endif
 		}
 		sharedData = new rts2core::DataSharedWrite ();
 		if (sharedData->create (sharedMemNum, dataBufferSize) == NULL)
 		{
 			return -1;
 		}
-		logStream (MESSAGE_DEBUG) << "creating shared memory with " << sharedMemNum << " segments" << sendLog;
+		logStream (MESSAGE_DEBUG) << "creating shared memory " << sharedData->getShmName () << " with " << sharedMemNum << " segments" << sendLog;
+
+		createValue (shmFree, "shm_free", "number of free shared memory segments", false);
+		createValue (shmReaders, "shm_readers", "clients holding shared memory segments", false);
+		createValue (shmLag, "shm_lag", "[bytes] data written to shared memory, not yet processed by the client", false);
+		createValue (shmHeld, "shm_held", "number of shared memory segments held by the client", false);
+		updateSharedStat ();
 	}
 	fhd = new struct imghdr;
 	focusingHeader = NULL;
@@ -1880,6 +1865,58 @@ bool Camera::isIdle ()
 		(CAM_NOEXPOSURE | CAM_NOTREADING));
 }
 
+void Camera::updateSharedStat ()
+{
+	if (sharedData == NULL || shmFree == NULL)
+		return;
+	shmFree->setValueInteger (sharedData->getFreeSegments ());
+
+	std::map <int, size_t> lag;
+	std::map <int, int> held;
+	sharedData->getClientLag (lag, held);
+
+	std::vector <std::string> readers;
+	std::vector <double> lags;
+	std::vector <int> helds;
+	for (std::map <int, size_t>::iterator iter = lag.begin (); iter != lag.end (); iter++)
+	{
+		std::ostringstream _os;
+		_os << iter->first;
+		for (rts2core::connections_t::iterator citer = getConnections ()->begin (); citer != getConnections ()->end (); citer++)
+		{
+			if ((*citer)->getCentraldId () == iter->first && strlen ((*citer)->getName ()) > 0)
+			{
+				_os.str ("");
+				_os << (*citer)->getName ();
+				break;
+			}
+		}
+		readers.push_back (_os.str ());
+		lags.push_back (iter->second);
+		helds.push_back (held[iter->first]);
+	}
+	shmReaders->setValueArray (readers);
+	shmLag->setValueArray (lags);
+	shmHeld->setValueArray (helds);
+
+	sendValueAll (shmFree);
+	sendValueAll (shmReaders);
+	sendValueAll (shmLag);
+	sendValueAll (shmHeld);
+}
+
+void Camera::endDataTaps (bool complete)
+{
+	for (std::map <rts2core::Connection *, int>::iterator iter = dataTaps.begin (); iter != dataTaps.end (); iter++)
+	{
+		if (iter->second >= 0)
+		{
+			iter->first->endSharedData (iter->second, complete);
+			iter->second = -1;
+		}
+	}
+}
+
 int Camera::commandAuthorized (rts2core::Connection * conn)
 {
 	if (conn->isCommand ("help"))
@@ -1888,6 +1925,8 @@ int Camera::commandAuthorized (rts2core::Connection * conn)
 		conn->sendMsg ("expose - start exposition");
 		conn->sendMsg ("stopexpo <chip> - stop exposition on given chip");
 		conn->sendMsg ("stopread <chip> - stop reading given chip");
+		conn->sendMsg ("data_tap - receive data of all images through shared memory");
+		conn->sendMsg ("data_untap - stop receiving data of all images");
 		conn->sendMsg ("exit - exit from connection");
 		conn->sendMsg ("help - print, what you are reading just now");
 		return 0;
@@ -1939,6 +1978,31 @@ int Camera::commandAuthorized (rts2core::Connection * conn)
 		}
 		return camCenter (conn, w, h);
 	}
+	else if (conn->isCommand ("data_tap"))
+	{
+		if (!conn->paramEnd ())
+			return -2;
+		if (sharedData == NULL)
+		{
+			conn->sendCommandEnd (DEVDEM_E_SYSTEM, "camera does not use shared memory, start it with --with-shm");
+			return -1;
+		}
+		if (dataTaps.size () >= MAX_SHARED_CLIENTS - 1)
+		{
+			conn->sendCommandEnd (DEVDEM_E_SYSTEM, "too many data taps");
+			return -1;
+		}
+		if (dataTaps.find (conn) == dataTaps.end ())
+			dataTaps[conn] = -1;
+		return 0;
+	}
+	else if (conn->isCommand ("data_untap"))
+	{
+		if (!conn->paramEnd ())
+			return -2;
+		dataTaps.erase (conn);
+		return 0;
+	}
 	else if (conn->isCommand ("clear_center"))
 	{
 		if (!conn->paramEnd ())
@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 
 #include "command.h"
 
@@ -564,11 +565,13 @@ CommandExecNow::CommandExecNow (Block * _master, int now_id):Command (_master)
 	setCommand (_os);
 }
 
-CommandExecGrb::CommandExecGrb (Block * _master, int _grb_id):Command (_master)
+CommandExecGrb::CommandExecGrb (Block * _master, int _grb_id, double received):Command (_master)
 {
 	std::ostringstream _os;
 	grb_id = _grb_id;
 	_os << "grb " << grb_id;
+	if (!isnan (received))
+		_os << " " << std::fixed << std::setprecision (6) << received;
 	setCommand (_os);
 }
 
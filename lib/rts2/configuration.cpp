@@ -37,6 +37,7 @@ int Configuration::getSpecialValues ()
 	ret += getDouble ("observatory", "altitude", observatoryAltitude);
 
 	storeSexadecimals = getBoolean ("observatory", "sexadecimals", false);
+	robustStatistics = getBoolean ("observatory", "robust_statistics", false);
 
 	// load horizon file..
 	getString ("observatory", "horizon", horizon_file, "-");
@@ -93,6 +94,7 @@ Configuration::Configuration (bool defaultSection):IniParser (defaultSection)
 	observer.lat = 0;
 	observer.lng = 0;
 	storeSexadecimals = false;
+	robustStatistics = false;
 	checker = NULL;
 	// default to 120 seconds
 	astrometryTimeout = 120;
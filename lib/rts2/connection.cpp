@@ -32,8 +32,10 @@
 #include <iostream>
 
 #include <errno.h>
+#include <limits.h>
 #include <syslog.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -92,6 +94,9 @@ Connection::Connection (Block * in_master):Object ()
 
 	activeReadData = -1;
 	dataConn = 0;
+	outputBufferMessages = 0;
+	writeQueueOffset = 0;
+	writeQueueProgress = 0;
 
 	sharedReadMemory = NULL;
 }
@@ -132,12 +137,19 @@ Connection::Connection (int in_sock, Block * in_master):Object ()
 
 	activeReadData = -1;
 	dataConn = 0;
+	outputBufferMessages = 0;
+	writeQueueOffset = 0;
+	writeQueueProgress = 0;
 
 	sharedReadMemory = NULL;
 }
 
 Connection::~Connection (void)
 {
+	if (master && !outputBuffer.empty ())
+		master->removePendingOutput (this);
+	if (master && !writeQueue.empty ())
+		master->removeWriteWatch (this);
 	if (sock >= 0)
 		close (sock);
 	delete serverState;
@@ -153,12 +165,18 @@ int Connection::add (fd_set * readset, fd_set * writeset, fd_set * expset)
 	if (sock >= 0)
 	{
 		FD_SET (sock, readset);
-		if (isConnState (CONN_INPROGRESS))
+		if (isConnState (CONN_INPROGRESS) || !writeQueue.empty ())
 			FD_SET (sock, writeset);
 	}
 	return 0;
 }
 
+void Connection::addPoll (EventPoll *poll)
+{
+	if (sock >= 0)
+		poll->watch (sock, (isConnState (CONN_INPROGRESS) || !writeQueue.empty ()) ? EventPoll::READ | EventPoll::WRITE : EventPoll::READ, this);
+}
+
 std::string Connection::getCameraChipState (int chipN)
 {
 	int chip_state = (getRealState () & (CAM_MASK_CHIP << (chipN * 4))) >> (chipN * 4);
@@ -526,6 +544,13 @@ int Connection::idle ()
 			#endif				 /* DEBUG_EXTRA */
 			time (&lastSendReady);
 		}
+		if (!writeQueue.empty () && now > writeQueueProgress + getConnTimeout ())
+		{
+			logStream (MESSAGE_ERROR) << "connection " << getName () << " did not accept data for " << getConnTimeout () << " seconds, "
+				<< writeQueueSize () << " bytes wait in write queue" << sendLog;
+			connectionError (-1);
+			return 0;
+		}
 		if (now > (lastData + getConnTimeout () * 2))
 		{
 			logStream (MESSAGE_DEBUG) << "Connection timeout: " << lastGoodSend
@@ -534,11 +559,34 @@ int Connection::idle ()
 			connectionError (-1);
 		}
 	}
+	processSharedData ();
 	if (otherDevice != NULL)
 		otherDevice->idle ();
 	return 0;
 }
 
+void Connection::processSharedData ()
+{
+	int client_id = -1;
+	for (std::map <int, DataChannels *>::iterator iter = readChannels.begin (); iter != readChannels.end (); iter++)
+	{
+		if (!iter->second->isShared ())
+			continue;
+		for (DataChannels::iterator dch_iter = iter->second->begin (); dch_iter != iter->second->end (); dch_iter++)
+		{
+			DataSharedRead *dsr = (DataSharedRead *) (*dch_iter);
+			if (!dsr->hasNewData ())
+				continue;
+			size_t bytes = dsr->getDataTop () - dsr->getDataBuff ();
+			if (otherDevice)
+				otherDevice->dataReceived (dsr);
+			if (client_id < 0)
+				client_id = getMaster ()->getSingleCentralConn ()->getCentraldId ();
+			dsr->markRead (client_id, bytes);
+		}
+	}
+}
+
 int Connection::authorizationOK ()
 {
 	logStream (MESSAGE_ERROR) << "authorization called on wrong connection" <<
@@ -821,8 +869,8 @@ void Connection::processLine ()
 	else if (isCommand (PROTO_SHARED))
 	{
 		int dC;
-		int sharedMem;
-		if (paramNextInteger (&dC) || paramNextInteger (&sharedMem))
+		char *sharedMem;
+		if (paramNextInteger (&dC) || paramNextString (&sharedMem))
 		{
 			connectionError (-2);
 			ret = -2;
@@ -830,9 +878,9 @@ void Connection::processLine ()
 		else
 		{
 			ret = -1;
-			if (sharedReadMemory && sharedMem != sharedReadMemory->getShmId ())
+			if (sharedReadMemory && strcmp (sharedMem, sharedReadMemory->getShmName ()))
 			{
-				// unmap existing IPC, map new one
+				// unmap existing shared memory, map new one
 				delete sharedReadMemory;
 				sharedReadMemory = NULL;
 			}
@@ -842,6 +890,8 @@ void Connection::processLine ()
 				sharedReadMemory = new DataSharedRead ();
 				if (sharedReadMemory->attach (sharedMem))
 				{
+					delete sharedReadMemory;
+					sharedReadMemory = NULL;
 					connectionError (-2);
 					ret = -2;
 				}
@@ -868,13 +918,18 @@ void Connection::processLine ()
 			std::map <int, DataChannels *>::iterator iter = readChannels.find (dC);
 			if (iter != readChannels.end ())
 			{
+				// report the last part of data
+				processSharedData ();
 				if (otherDevice)
 				{
 					otherDevice->fullDataReceived (dC, iter->second);
 				}
+				int client_id = getMaster ()->getSingleCentralConn ()->getCentraldId ();
 				for (DataChannels::iterator dch_iter = iter->second->begin (); dch_iter != iter->second->end (); dch_iter++)
 				{
-					((DataSharedRead *) (*dch_iter))->removeActiveClient (getMaster ()->getSingleCentralConn ()->getCentraldId ());
+					DataSharedRead *dsr = (DataSharedRead *) (*dch_iter);
+					dsr->markRead (client_id, dsr->getDataTop () - dsr->getDataBuff ());
+					dsr->removeActiveClient (client_id);
 				}
 				delete iter->second;
 				readChannels.erase (iter);
@@ -991,61 +1046,113 @@ void Connection::processBuffer ()
 
 int Connection::receive (fd_set * readset)
 {
-	int data_size = 0;
 	// connections market for deletion
 	if (isConnState (CONN_DELETE))
 		return -1;
 	if ((sock >= 0) && FD_ISSET (sock, readset))
+		return readSocket ();
+	return 0;
+}
+
+int Connection::writable (fd_set * writeset)
+{
+	if (sock >= 0 && FD_ISSET (sock, writeset))
+		return writeSocket ();
+	return 0;
+}
+
+int Connection::pollReady (int fd, uint32_t events)
+{
+	if (isConnState (CONN_DELETE))
+		return -1;
+	if (fd != sock)
+		return 0;
+	if ((events & EventPoll::READ) && readSocket () == -1)
+		return -1;
+	// socket can be closed by read
+	if ((events & EventPoll::WRITE) && sock >= 0)
+		return writeSocket ();
+	return 0;
+}
+
+int Connection::pollReadySelect (int fd, uint32_t events)
+{
+	if (fd >= FD_SETSIZE)
 	{
-		if (isConnState (CONN_CONNECTING))
-		{
-			return acceptConn ();
-		}
-		// we are receiving binary data
-		if (activeReadData >= 0)
-		{
-			data_size = readChannels[activeReadData]->getData (activeReadChannel, sock);
-			if (data_size == -1)
-			{
-				connectionError (data_size);
-			}
-			if (data_size == 0)
-				return 0;
-			dataReceived ();
-			return data_size;
-		}
-		checkBufferSize ();
-		data_size = read (sock, buf_top, buf_size - (buf_top - buf));
-		// ignore EINTR
-		if (data_size == -1 && errno == EINTR)
-			return 0;
-		if (data_size <= 0)
+		logStream (MESSAGE_ERROR) << "descriptor " << fd << " of connection " << getName () << " is above FD_SETSIZE, closing connection" << sendLog;
+		endConnection ();
+		return -1;
+	}
+
+	fd_set read_set;
+	fd_set write_set;
+
+	FD_ZERO (&read_set);
+	FD_ZERO (&write_set);
+
+	if (events & EventPoll::READ)
+		FD_SET (fd, &read_set);
+	if (events & EventPoll::WRITE)
+		FD_SET (fd, &write_set);
+
+	if (receive (&read_set) == -1 || writable (&write_set) == -1)
+		return -1;
+	return 0;
+}
+
+int Connection::readSocket ()
+{
+	int data_size = 0;
+	if (isConnState (CONN_CONNECTING))
+	{
+		return acceptConn ();
+	}
+	// we are receiving binary data
+	if (activeReadData >= 0)
+	{
+		data_size = readChannels[activeReadData]->getData (activeReadChannel, sock);
+		if (data_size == -1)
 		{
 			connectionError (data_size);
-			return -1;
 		}
-		buf_top[data_size] = '\0';
-		successfullRead ();
-		#ifdef DEBUG_ALL
-		std::cout << "Connection::receive name " << getName ()
-			<< " reas: " << buf_top
-			<< " full_buf: " << buf
-			<< " size: " << data_size
-			<< " commandInProgress " << commandInProgress
-			<< " runningCommand " << runningCommand
-			<< std::endl;
-		#endif
-		// move buf_top to end of readed data
-		buf_top += data_size;
-		data_size += buf_top - buf;
-		processBuffer ();
+		if (data_size == 0)
+			return 0;
+		dataReceived ();
+		return data_size;
+	}
+	checkBufferSize ();
+	data_size = read (sock, buf_top, buf_size - (buf_top - buf));
+	// ignore EINTR
+	if (data_size == -1 && errno == EINTR)
+		return 0;
+	if (data_size <= 0)
+	{
+		connectionError (data_size);
+		return -1;
 	}
+	buf_top[data_size] = '\0';
+	successfullRead ();
+	#ifdef DEBUG_ALL
+	std::cout << "Connection::receive name " << getName ()
+		<< " reas: " << buf_top
+		<< " full_buf: " << buf
+		<< " size: " << data_size
+		<< " commandInProgress " << commandInProgress
+		<< " runningCommand " << runningCommand
+		<< std::endl;
+	#endif
+	// move buf_top to end of readed data
+	buf_top += data_size;
+	data_size += buf_top - buf;
+	processBuffer ();
 	return data_size;
 }
 
-int Connection::writable (fd_set * writeset)
+int Connection::writeSocket ()
 {
-	if (sock >=0 && FD_ISSET (sock, writeset) && isConnState (CONN_INPROGRESS))
+	if (!writeQueue.empty () && !isConnState (CONN_INPROGRESS))
+		return flushWriteQueue ();
+	if (isConnState (CONN_INPROGRESS))
 	{
 		int err = 0;
 		int ret;
@@ -1458,15 +1565,29 @@ int Connection::sendMsg (const char *msg)
 	int ret;
 	if (sock == -1)
 		return -1;
-	len = strlen (msg) + 1;
-	char *mbuf = new char[len + 1];
-	strcpy (mbuf, msg);
-	strcat (mbuf, "\n");
-	// ignore EINTR
-	do
+	len = strlen (msg);
+
+	if (master && master->getOutputCoalescing () && !isConnState (CONN_INPROGRESS))
 	{
-		ret = write (sock, mbuf, len);
-	} while (ret == -1 && errno == EINTR);
+		if (outputBuffer.empty ())
+			master->addPendingOutput (this);
+		outputBuffer.append (msg, len);
+		outputBuffer.append (1, '\n');
+		outputBufferMessages++;
+		if (outputBuffer.size () >= CONN_OUTPUT_FLUSH)
+			return flushOutput ();
+		return 0;
+	}
+
+	// message and new line are send from two buffers, without copy
+	struct iovec iov[2];
+	iov[0].iov_base = (void *) msg;
+	iov[0].iov_len = len;
+	iov[1].iov_base = (void *) "\n";
+	iov[1].iov_len = 1;
+	len++;
+
+	ret = writeVector (iov, 2);
 
 	if (ret != len)
 	{
@@ -1479,7 +1600,6 @@ int Connection::sendMsg (const char *msg)
 			<< sendLog;
 		#endif
 		connectionError (ret);
-		delete[] mbuf;
 		return -1;
 	}
 	#ifdef DEBUG_ALL
@@ -1488,7 +1608,47 @@ int Connection::sendMsg (const char *msg)
 		<< std::endl;
 	#endif
 
-	delete[] mbuf;
+	successfullSend ();
+	return 0;
+}
+
+int Connection::flushOutput ()
+{
+	if (outputBuffer.empty ())
+		return 0;
+	if (master)
+		master->removePendingOutput (this);
+
+	size_t len = outputBuffer.size ();
+	unsigned long messages = outputBufferMessages;
+
+	// buffer is cleared before write, as write error calls connectionError, which flushes buffer
+	std::string out;
+	out.swap (outputBuffer);
+	outputBufferMessages = 0;
+
+	if (sock == -1)
+		return -1;
+
+	struct iovec iov;
+	iov.iov_base = (void *) out.data ();
+	iov.iov_len = len;
+
+	ssize_t ret = writeVector (&iov, 1);
+	if (ret != (ssize_t) len)
+	{
+		syslog (LOG_ERR, "Cannot flush %lu messages to sock %i with len %lu, ret %li errno %i message %m",
+			messages, sock, (unsigned long) len, (long) ret, errno);
+		connectionError (ret);
+		return -1;
+	}
+	#ifdef DEBUG_ALL
+	std::cout << "Connection::flushOutput " << getName ()
+		<< " [" << getCentraldId () << ":" << sock << "] send " << messages << " messages, " << ret << " bytes" << std::endl;
+	#endif
+
+	if (master)
+		master->outputFlushed (messages, len);
 	successfullSend ();
 	return 0;
 }
@@ -1520,48 +1680,48 @@ int Connection::startBinaryData (int dataType, int channum, size_t *chansize)
 
 int Connection::sendBinaryData (int data_conn, int chan, char *data, size_t dataSize)
 {
-	char *binaryWriteTop, *binaryWriteBuff;
-	binaryWriteTop = binaryWriteBuff = data;
-	char *binaryEnd = data + dataSize;
+	if (sock == -1)
+		return -1;
 
-	std::ostringstream _os;
-	_os << PROTO_DATA " " << data_conn << " " << chan << " " << dataSize;
-	int ret;
-	ret = sendMsg (_os);
-	if (ret)
-		return ret;
+	// messages send before must be received before data
+	if (flushOutput ())
+		return -1;
 
-	while (binaryWriteTop < binaryEnd)
+	if (dataSize > getWriteBinaryDataSize (data_conn))
 	{
-		if (dataSize > getWriteBinaryDataSize (data_conn))
-		{
-			logStream (MESSAGE_ERROR) << "Attemp to send too much data - "
-				<< dataSize << "bytes, but there are only " << getWriteBinaryDataSize (data_conn) << " bytes remain to be send" << sendLog;
-			dataSize = getWriteBinaryDataSize (data_conn);
-		}
-		ret = send (sock, binaryWriteTop, dataSize, 0);
-		if (ret == -1)
-		{
-			if (errno != EINTR)
-			{
-				connectionError (ret);
-				return -1;
-			}
-		}
-		else
+		logStream (MESSAGE_ERROR) << "Attemp to send too much data - "
+			<< dataSize << "bytes, but there are only " << getWriteBinaryDataSize (data_conn) << " bytes remain to be send" << sendLog;
+		dataSize = getWriteBinaryDataSize (data_conn);
+	}
+
+	char header[100];
+	int hlen = snprintf (header, sizeof (header), PROTO_DATA " %i %i %lu\n", data_conn, chan, (unsigned long) dataSize);
+
+	// header and data in single call, data are send directly from caller buffer
+	struct iovec iov[2];
+	iov[0].iov_base = header;
+	iov[0].iov_len = hlen;
+	iov[1].iov_base = data;
+	iov[1].iov_len = dataSize;
+
+	ssize_t ret = writeVector (iov, 2);
+	if (ret != (ssize_t) (hlen + dataSize))
+	{
+		logStream (MESSAGE_ERROR) << "cannot send binary data: " << strerror (errno) << sendLog;
+		connectionError (-1);
+		return -1;
+	}
+
+	successfullSend ();
+
+	std::map <int, DataAbstractWrite *>::iterator iter = writeChannels.find (data_conn);
+	if (iter != writeChannels.end ())
+	{
+		((*iter).second)->dataWritten (chan, dataSize);
+		if (((*iter).second)->getDataSize () <= 0)
 		{
-			binaryWriteTop += ret;
-			dataSize -= ret;
-			std::map <int, DataAbstractWrite *>::iterator iter = writeChannels.find (data_conn);
-			if (iter != writeChannels.end ())
-			{
-				((*iter).second)->dataWritten (chan, ret);
-				if (((*iter).second)->getDataSize () <= 0)
-				{
-					delete ((*iter).second);
-					writeChannels.erase (iter);
-				}
-			}
+			delete ((*iter).second);
+			writeChannels.erase (iter);
 		}
 	}
 	return 0;
@@ -1580,7 +1740,7 @@ int Connection::startSharedData (DataSharedWrite *data, int channum, int *segnum
 {
 	std::ostringstream _os;
 	dataConn++;
-	_os << PROTO_SHARED " " << dataConn << " " << data->getShmId () << " " << channum;
+	_os << PROTO_SHARED " " << dataConn << " " << data->getShmName () << " " << channum;
 	for (int i = 0; i < channum; i++)
 		_os << " " << segnums[i];
 	int ret;
@@ -1619,6 +1779,151 @@ int Connection::fitsDataTransfer (const char *fn)
 	return 0;
 }
 
+ssize_t Connection::writeVector (struct iovec *iov, int iovcnt)
+{
+	ssize_t total = 0;
+	bool wasEmpty = writeQueue.empty ();
+	// data queued before must be written first
+	bool queue = !wasEmpty;
+	while (iovcnt > 0)
+	{
+		// skip empty or fully written entries
+		if (iov->iov_len == 0)
+		{
+			iov++;
+			iovcnt--;
+			continue;
+		}
+		if (queue)
+		{
+			// backpressure - bound memory held for slow clients
+			if (writeQueueSize () > CONN_WRITE_QUEUE_MAX)
+			{
+				if (waitWriteQueue (CONN_WRITE_QUEUE_MAX, getConnTimeout () * 1000))
+				{
+					logStream (MESSAGE_ERROR) << "connection " << getName () << " did not accept " << writeQueueSize () << " queued bytes, closing it" << sendLog;
+					return -1;
+				}
+				// queue was written, socket can accept data directly
+				if (writeQueue.empty ())
+				{
+					wasEmpty = true;
+					queue = false;
+					continue;
+				}
+			}
+			writeQueue.append ((char *) iov->iov_base, iov->iov_len);
+			total += iov->iov_len;
+			iov->iov_len = 0;
+			continue;
+		}
+		ssize_t ret = writev (sock, iov, iovcnt > IOV_MAX ? IOV_MAX : iovcnt);
+		if (ret == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				// socket buffer is full, rest is written when the socket becomes writable
+				queue = true;
+				continue;
+			}
+			return -1;
+		}
+		total += ret;
+		// advance over written data
+		while (ret > 0)
+		{
+			if ((size_t) ret >= iov->iov_len)
+			{
+				ret -= iov->iov_len;
+				iov->iov_len = 0;
+				iov++;
+				iovcnt--;
+			}
+			else
+			{
+				iov->iov_base = ((char *) iov->iov_base) + ret;
+				iov->iov_len -= ret;
+				ret = 0;
+			}
+		}
+	}
+	if (wasEmpty && !writeQueue.empty ())
+	{
+		time (&writeQueueProgress);
+		if (master)
+			master->addWriteWatch (this);
+	}
+	return total;
+}
+
+int Connection::flushWriteQueue ()
+{
+	size_t start = writeQueueOffset;
+	while (writeQueueOffset < writeQueue.size ())
+	{
+		ssize_t ret = write (sock, writeQueue.data () + writeQueueOffset, writeQueue.size () - writeQueueOffset);
+		if (ret == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			logStream (MESSAGE_ERROR) << "cannot write queued data to " << getName () << ": " << strerror (errno) << sendLog;
+			connectionError (-1);
+			return -1;
+		}
+		writeQueueOffset += ret;
+	}
+	if (writeQueueOffset > start)
+	{
+		time (&writeQueueProgress);
+		successfullSend ();
+	}
+	if (writeQueueOffset == writeQueue.size ())
+	{
+		clearWriteQueue ();
+	}
+	// move unwritten data to the front only when it is cheaper than the data already written
+	else if (writeQueueOffset >= CONN_OUTPUT_FLUSH && writeQueueOffset >= writeQueue.size () / 2)
+	{
+		writeQueue.erase (0, writeQueueOffset);
+		writeQueueOffset = 0;
+	}
+	return 0;
+}
+
+void Connection::clearWriteQueue ()
+{
+	// release memory held after large backlog
+	std::string ().swap (writeQueue);
+	writeQueueOffset = 0;
+	if (master)
+		master->removeWriteWatch (this);
+}
+
+int Connection::waitWriteQueue (size_t limit, int timeout)
+{
+	double end = getNow () + timeout / 1000.0;
+	while (sock >= 0 && writeQueueSize () > limit)
+	{
+		int rest = (end - getNow ()) * 1000;
+		if (rest <= 0)
+			return -1;
+		struct pollfd pfd;
+		pfd.fd = sock;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		int ret = poll (&pfd, 1, rest);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0 || flushWriteQueue ())
+			return -1;
+	}
+	return sock >= 0 ? 0 : -1;
+}
+
 void Connection::successfullSend ()
 {
 	time (&lastGoodSend);
@@ -1647,6 +1952,9 @@ void Connection::connConnected ()
 
 void Connection::connectionError (int last_data_size)
 {
+	// send buffered messages before socket is closed; if that fails, connectionError was already called
+	if (sock >= 0 && !outputBuffer.empty () && flushOutput ())
+		return;
 	activeReadData = -1;
 	if (canDelete ())
 		setConnState (CONN_DELETE);
@@ -1655,6 +1963,8 @@ void Connection::connectionError (int last_data_size)
 	if (sock >= 0)
 		close (sock);
 	sock = -1;
+	if (!writeQueue.empty ())
+		clearWriteQueue ();
 	if (strlen (getName ()))
 		master->deleteAddress (getCentraldNum (), getName ());
 }
@@ -2015,7 +2325,10 @@ void Connection::dataReceived ()
 
 Value * Connection::getValue (const char *value_name)
 {
-	return values.getValue (value_name);
+	std::map <std::string, Value *, ValueNameCompare>::iterator iter = valueIndex.find (std::string (value_name));
+	if (iter == valueIndex.end ())
+		return NULL;
+	return iter->second;
 }
 
 Value * Connection::getValueType (const char *value_name, int value_type)
@@ -2043,12 +2356,13 @@ void Connection::addValue (Value * value, const ValueVector::iterator eiter)
 	if (value->isValue (RTS2_VALUE_INFOTIME))
 		info_time = (ValueTime *) value;
 	values.insert (eiter, value);
+	valueIndex.insert (std::pair <std::string, Value *> (value->getName (), value));
 }
 
 int Connection::metaInfo (int rts2Type, std::string m_name, std::string desc)
 {
 	// if value exists, update it
-	Value *existing_value = values.getValue (m_name.c_str ());
+	Value *existing_value = getValue (m_name.c_str ());
 	ValueVector::iterator eiter;
 	if (existing_value)
 	{
@@ -2058,6 +2372,9 @@ int Connection::metaInfo (int rts2Type, std::string m_name, std::string desc)
 			existing_value->setDescription (desc);
 			return -1;
 		}
+		valueIndex.erase (m_name);
+		if (info_time == existing_value)
+			info_time = NULL;
 		eiter = values.removeValue (m_name.c_str ());
 	}
 	else
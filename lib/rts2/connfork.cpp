@@ -82,6 +82,14 @@ int ConnFork::writeToProcess (const char *msg)
 	return 0;	
 }
 
+void ConnFork::setInput (std::string _input)
+{
+	input = _input;
+	// epoll loop must watch sockwrite for writability
+	if (input.length () > 0)
+		master->addWriteWatch (this);
+}
+
 int ConnFork::writeToProcessInt (int msg)
 {
 	std::ostringstream os;
@@ -116,6 +124,15 @@ int ConnFork::add (fd_set * readset, fd_set * writeset, fd_set * expset)
 	return ConnNoSend::add (readset, writeset, expset);
 }
 
+void ConnFork::addPoll (rts2core::EventPoll *poll)
+{
+	if (sockerr > 0)
+		poll->watch (sockerr, EventPoll::READ, this);
+	if (input.length () > 0 && sockwrite >= 0)
+		poll->watch (sockwrite, EventPoll::WRITE, this);
+	ConnNoSend::addPoll (poll);
+}
+
 int ConnFork::receive (fd_set * readset)
 {
 	if (sockerr > 0 && FD_ISSET (sockerr, readset))
@@ -98,6 +98,12 @@ Daemon::Daemon (int _argc, char **_argv, int _init_state):rts2core::Block (_argc
 
 	idleInfoInterval = -1;
 
+	useEventPoll = false;
+
+	outputMessages = NULL;
+	outputWrites = NULL;
+	outputBytes = NULL;
+
 	addOption ('i', NULL, 0, "run in interactive mode, don't loose console");
 	addOption (OPT_AUTORESTART, "autorestart", 1, "seconds to wait for restart of crashed daemon");
 	addOption (OPT_LOCALPORT, "local-port", 1, "define local port on which we will listen to incoming requests");
@@ -107,6 +113,10 @@ Daemon::Daemon (int _argc, char **_argv, int _init_state):rts2core::Block (_argc
 	addOption (OPT_MODEFILE, "modefile", 1, "file holding device modes");
 	addOption (OPT_AUTOSAVE, "autosave", 1, "autosave file");
 	addOption (OPT_DEFAULTS, "defaults", 1, "file with default values");
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	addOption (OPT_EPOLL, "epoll", 0, "use epoll instead of select in the main event loop");
+#endif
+	addOption (OPT_COALESCE, "coalesce", 0, "coalesce messages send during one event loop iteration into single write");
 }
 
 Daemon::~Daemon (void)
@@ -151,6 +161,12 @@ int Daemon::processOption (int in_opt)
 		case OPT_VALUEFILE:
 			valueFile = optarg;
 			break;
+		case OPT_EPOLL:
+			useEventPoll = true;
+			break;
+		case OPT_COALESCE:
+			setOutputCoalescing (true);
+			break;
 		default:
 			return rts2core::Block::processOption (in_opt);
 	}
@@ -378,6 +394,14 @@ int Daemon::init ()
 		listen_sock = -1;
 		return -1;
 	}
+	if (useEventPoll && enableEventPoll () == 0)
+		addPollSocket (listen_sock);
+	if (getOutputCoalescing ())
+	{
+		createValue (outputMessages, "output_messages", "number of messages send through output buffers", false);
+		createValue (outputWrites, "output_writes", "number of writes used to send buffered messages", false);
+		createValue (outputBytes, "output_bytes", "number of bytes send through output buffers", false);
+	}
 	return 0;
 }
 
@@ -658,9 +682,25 @@ void Daemon::selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set
 	rts2core::Block::selectSuccess (read_set, write_set, exp_set);
 }
 
+void Daemon::pollSuccess (int fd, uint32_t events)
+{
+	if (fd == listen_sock)
+	{
+		struct sockaddr_in other_side;
+		socklen_t addr_size = sizeof (struct sockaddr_in);
+		int client = accept (listen_sock, (struct sockaddr *) &other_side, &addr_size);
+		if (client == -1)
+			logStream (MESSAGE_DEBUG) << "client accept: " << strerror (errno) << " " << listen_sock << sendLog;
+		else
+			addConnectionSock (client);
+		return;
+	}
+	rts2core::Block::pollSuccess (fd, events);
+}
+
 void Daemon::addValue (Value * value, int queCondition)
 {
-	values.push_back (new CondValue (value, queCondition));
+	values.addCondValue (new CondValue (value, queCondition));
 }
 
 Value * Daemon::getOwnValue (const char *v_name)
@@ -673,90 +713,17 @@ Value * Daemon::getOwnValue (const char *v_name)
 
 CondValue * Daemon::getCondValue (const char *v_name)
 {
-	CondValueVector::iterator iter;
-	for (iter = values.begin (); iter != values.end (); iter++)
-	{
-		CondValue *val = *iter;
-		if (val->getValue ()->isValue (v_name))
-			return val;
-	}
-	return NULL;
+	return values.getCondValue (v_name);
 }
 
 CondValue * Daemon::getCondValue (const Value *val)
 {
-	CondValueVector::iterator iter;
-	for (iter = values.begin (); iter != values.end (); iter++)
-	{
-		CondValue *c_val = *iter;
-		if (c_val->getValue () == val)
-			return c_val;
-	}
-	return NULL;
+	return values.getCondValue (val);
 }
 
 Value * Daemon::duplicateValue (Value * old_value, bool withVal)
 {
-	// create new value, which will be passed to hook
-	Value *dup_val = NULL;
-	switch (old_value->getValueExtType ())
-	{
-		case 0:
-			dup_val = newValue (old_value->getFlags (), old_value->getName (), old_value->getDescription ());
-			// do some extra settings
-			switch (old_value->getValueType ())
-			{
-				case RTS2_VALUE_SELECTION:
-					((ValueSelection *) dup_val)->copySel ((ValueSelection *) old_value);
-					break;
-			}
-			if (withVal)
-				((ValueString *) dup_val)->setFromValue (old_value);
-			break;
-		case RTS2_VALUE_STAT:
-			dup_val = new ValueDoubleStat (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits ());
-			break;
-		case RTS2_VALUE_MMAX:
-			dup_val = new ValueDoubleMinMax (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits ());
-			((ValueDoubleMinMax *) dup_val)->copyMinMax ((ValueDoubleMinMax *) old_value);
-			break;
-		case RTS2_VALUE_RECTANGLE:
-			dup_val = new ValueRectangle (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
-			break;
-		case RTS2_VALUE_ARRAY:
-			switch (old_value->getValueBaseType ())
-			{
-				case RTS2_VALUE_STRING:
-					dup_val = new StringArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
-					break;
-				case RTS2_VALUE_DOUBLE:
-					dup_val = new DoubleArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
-					break;
-				case RTS2_VALUE_TIME:
-					dup_val = new TimeArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
-					break;
-				case RTS2_VALUE_INTEGER:
-					dup_val = new IntegerArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
-					break;
-				case RTS2_VALUE_BOOL:
-					dup_val = new BoolArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
-					break;
-				default:
-					logStream (MESSAGE_ERROR) << "unknow array type: " << old_value->getValueBaseType () << sendLog;
-					break;
-			}
-			if (dup_val)
-				break;
-		case RTS2_VALUE_TIMESERIE:
-			dup_val = new ValueDoubleTimeserie (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits ());
-			break;
-		default:
-			logStream (MESSAGE_ERROR) << "unknow value type: " << old_value->getValueExtType () << sendLog;
-			return NULL;
-	}
-	if (withVal)
-		dup_val->setFromValue (old_value);
-	return dup_val;
+	return ::duplicateValue (old_value, withVal);
 }
 
 void Daemon::addConstValue (Value * value)
@@ -955,6 +922,12 @@ int Daemon::sendBaseInfo (Connection * conn)
 int Daemon::info ()
 {
 	updateInfoTime ();
+	if (outputMessages)
+	{
+		outputMessages->setValueLong (getOutputMessages ());
+		outputWrites->setValueLong (getOutputWrites ());
+		outputBytes->setValueLong (getOutputBytes ());
+	}
 	return 0;
 }
 
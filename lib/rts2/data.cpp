@@ -20,11 +20,14 @@
 #include "connection.h"
 #include "data.h"
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
 #include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
-#include <sys/sem.h>
 
 using namespace rts2core;
 
@@ -35,88 +38,85 @@ int DataRead::readDataSize (Connection *conn)
 
 int DataAbstractShared::removeClient (int segnum, int client_id, bool verbose)
 {
-	if (lockSegment (segnum))
-		return -1;
 	struct SharedDataSegment *sseg = getSegment (segnum);
 	for (int s = 0; s < MAX_SHARED_CLIENTS; s++)
 	{
-		if (sseg->client_ids[s] == client_id)
-		{
-			sseg->client_ids[s] = 0;
-			unlockSegment (segnum);
+		// only the owner can release the slot
+		if (__sync_bool_compare_and_swap (&(sseg->client_ids[s]), client_id, 0))
 			return 0;
-		}
 	}
-	unlockSegment (segnum);
 	if (verbose)
 		logStream (MESSAGE_ERROR) << "cannot find locked client with ID " << client_id << " to remove segment " << segnum << sendLog;
 	return -1;
 }
 
-int DataAbstractShared::lockSegment (int segnum)
+void DataAbstractShared::unmap ()
 {
-	struct sembuf so;
-	so.sem_num = segnum;
-	so.sem_op = -1;
-	so.sem_flg = SEM_UNDO;
-	if (semop (data->shared_sem, &so, 1))
-	{
-		logStream (MESSAGE_ERROR) << "cannot lock segment " << segnum << sendLog;
-		return -1;
-	}
-	return 0;
-}
-
-int DataAbstractShared::unlockSegment (int segnum)
-{
-	struct sembuf so;
-	so.sem_num = segnum;
-	so.sem_op = 1;
-	so.sem_flg = SEM_UNDO;
-	if (semop (data->shared_sem, &so, 1))
-	{
-		logStream (MESSAGE_ERROR) << "cannot unlock segment " << segnum << sendLog;
-		return -1;
-	}
-	return 0;
+	if (mapSize > 0 && data != NULL)
+		munmap (data, mapSize);
+	data = NULL;
+	mapSize = 0;
 }
 
 DataSharedRead::~DataSharedRead ()
 {
+	unmap ();
 }
 
-int DataSharedRead::attach (int _shm_id)
+int DataSharedRead::attach (const char *_shm_name)
 {
-	data = (struct SharedDataHeader *) shmat (_shm_id, NULL, 0);
-	if (data == (void *) -1)
+	int fd = shm_open (_shm_name, O_RDWR, 0);
+	if (fd < 0)
 	{
-		logStream (MESSAGE_ERROR) << "cannot attach to shared memory " << _shm_id << sendLog;
+		logStream (MESSAGE_ERROR) << "cannot open shared memory " << _shm_name << ": " << strerror (errno) << sendLog;
 		return -1;
 	}
-	shm_id = _shm_id;
+	struct stat st;
+	if (fstat (fd, &st))
+	{
+		logStream (MESSAGE_ERROR) << "cannot stat shared memory " << _shm_name << ": " << strerror (errno) << sendLog;
+		close (fd);
+		return -1;
+	}
+	void *m = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (m == MAP_FAILED)
+	{
+		logStream (MESSAGE_ERROR) << "cannot map shared memory " << _shm_name << ": " << strerror (errno) << sendLog;
+		return -1;
+	}
+	data = (struct SharedDataHeader *) m;
+	mapSize = st.st_size;
+	shm_name = std::string (_shm_name);
 	return 0;
 }
 
-
 int DataSharedRead::confirmClient (int segnum, int client_id)
 {
-	if (lockSegment (segnum))
-		return -1;
 	// confirm there is already allocated client
 	struct SharedDataSegment *sseg = getSegment (segnum);
 	for (int s = 0; s < MAX_SHARED_CLIENTS; s++)
 	{
 		if (sseg->client_ids[s] == client_id)
-		{
-			unlockSegment (segnum);
 			return 0;
-		}
 	}
-	unlockSegment (segnum);
 	logStream (MESSAGE_ERROR) << "cannot find empty client slot to lock segment " << segnum << sendLog;
 	return -1;
 }
 
+void DataSharedRead::markRead (int client_id, size_t bytes)
+{
+	consumed = bytes;
+	for (int s = 0; s < MAX_SHARED_CLIENTS; s++)
+	{
+		if (activeSegment->client_ids[s] == client_id)
+		{
+			activeSegment->client_read[s] = bytes;
+			break;
+		}
+	}
+}
+
 DataWrite::DataWrite (int _channum, size_t *chansizes):DataAbstractWrite ()
 {
 	channum = _channum;
@@ -138,52 +138,82 @@ size_t DataWrite::getDataSize ()
 	return ret;
 }
 
+void DataSharedWrite::removeStale ()
+{
+	// POSIX shared memory objects are files in /dev/shm
+	DIR *dir = opendir ("/dev/shm");
+	if (dir == NULL)
+		return;
+	struct dirent *de;
+	while ((de = readdir (dir)) != NULL)
+	{
+		int pid, n;
+		char c;
+		if (sscanf (de->d_name, "rts2-%d-%d%c", &pid, &n, &c) != 2 || pid <= 0)
+			continue;
+		if (kill (pid, 0) == 0 || errno != ESRCH)
+			continue;
+		std::string name = std::string ("/") + de->d_name;
+		if (shm_unlink (name.c_str ()) == 0)
+			logStream (MESSAGE_INFO) << "removed stale shared memory " << name << " of process " << pid << sendLog;
+	}
+	closedir (dir);
+}
+
 struct SharedDataHeader *DataSharedWrite::create (int numseg, size_t segsize)
 {
-	shm_id = shmget (IPC_PRIVATE, sizeof (struct SharedDataHeader) + numseg * (sizeof (struct SharedDataSegment) + segsize), 0666);
-	if (shm_id < 0)
+	static int shm_count = 0;
+	if (shm_count == 0)
+		removeStale ();
+	std::ostringstream _os;
+	_os << "/rts2-" << getpid () << "-" << shm_count++;
+	shm_name = _os.str ();
+
+	// remove stale object left by a process with the same PID
+	shm_unlink (shm_name.c_str ());
+	int fd = shm_open (shm_name.c_str (), O_RDWR | O_CREAT | O_EXCL, 0666);
+	if (fd < 0)
 	{
-		logStream (MESSAGE_ERROR) << "cannot create shared memory segment: " << strerror (errno) << sendLog;
+		logStream (MESSAGE_ERROR) << "cannot create shared memory " << shm_name << ": " << strerror (errno) << sendLog;
 		return NULL;
 	}
-	data = (struct SharedDataHeader *) shmat (shm_id, NULL, 0);
-	if (data == (void *) -1)
+	// permissions are subject to umask, make sure all readers can open the object
+	fchmod (fd, 0666);
+
+	size_t s = sizeof (struct SharedDataHeader) + numseg * (sizeof (struct SharedDataSegment) + segsize);
+	if (ftruncate (fd, s))
 	{
-		shm_id = -1;
-		logStream (MESSAGE_ERROR) << "cannot attach shared memory segment: " << strerror (errno) << sendLog;
+		logStream (MESSAGE_ERROR) << "cannot set size of shared memory " << shm_name << " to " << s << " bytes: " << strerror (errno) << sendLog;
+		close (fd);
+		shm_unlink (shm_name.c_str ());
 		return NULL;
 	}
-	struct shmid_ds ds;
-	if (shmctl (shm_id, IPC_STAT, &ds) < 0 || shmctl (shm_id, IPC_RMID, &ds) < 0)
+	void *m = mmap (NULL, s, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (m == MAP_FAILED)
 	{
-		shmdt (data);
-		shm_id = -1;
-		logStream (MESSAGE_ERROR) << "Cannot perform shmctl call: " << strerror (errno) << sendLog;
+		logStream (MESSAGE_ERROR) << "cannot map shared memory " << shm_name << ": " << strerror (errno) << sendLog;
+		shm_unlink (shm_name.c_str ());
 		return NULL;
 	}
+	data = (struct SharedDataHeader *) m;
+	mapSize = s;
+
 	// initalize shared data header
 	data->nseg = numseg;
-	// first set is for exclusive locks, second is to signal waiting locks
-	data->shared_sem = semget (IPC_PRIVATE, numseg, 0666);
-	if (data->shared_sem < 0)
-	{
-		logStream (MESSAGE_ERROR) << "cannot create shared semaphore " << strerror (errno) << sendLog;
-		shmdt ((void *) data);
-		return NULL;
-	}
+	data->nextseg = 0;
 
 	struct SharedDataSegment *seg = getSegment (0);
 	for (int i = 0; i < numseg; i++, seg++)
 	{
-		memset (seg->client_ids, 0, sizeof (int) * MAX_SHARED_CLIENTS);
+		for (int c = 0; c < MAX_SHARED_CLIENTS; c++)
+		{
+			seg->client_ids[c] = 0;
+			seg->client_read[c] = 0;
+		}
 		seg->size = segsize;
 		seg->bytesSoFar = 0;
 		seg->offset = sizeof (struct SharedDataHeader) + sizeof (struct SharedDataSegment) * numseg + i * segsize;
-
-		struct sembuf so;
-		so.sem_num = i;
-		so.sem_op = 1;
-		semop (data->shared_sem, &so, 1);
 	}
 
 	return data;
@@ -191,10 +221,10 @@ struct SharedDataHeader *DataSharedWrite::create (int numseg, size_t segsize)
 
 DataSharedWrite::~DataSharedWrite ()
 {
-	if (shm_id > 0)
+	if (mapSize > 0)
 	{
-		semctl (data->shared_sem, IPC_RMID, 0);
-		shmdt (data);
+		shm_unlink (shm_name.c_str ());
+		unmap ();
 	}
 }
 
@@ -206,28 +236,44 @@ size_t DataSharedWrite::getDataSize ()
 	return ret;
 }
 
-int DataSharedWrite::addClient (size_t segsize, int chan, int client)
+void DataSharedWrite::dataWritten (int chan, size_t size)
 {
-	for (int i = 0; i < data->nseg; i++)
+	// data must be visible before readers see the new size
+	__sync_synchronize ();
+	chan2seg[chan]->bytesSoFar += size;
+}
+
+int DataSharedWrite::addClients (size_t segsize, int chan, const std::vector <int> &clients)
+{
+	if (clients.size () > MAX_SHARED_CLIENTS)
 	{
-		lockSegment (i);
+		logStream (MESSAGE_ERROR) << "too many shared memory clients: " << clients.size () << ", maximum is " << MAX_SHARED_CLIENTS << sendLog;
+		return -1;
+	}
+	for (int j = 0; j < data->nseg; j++)
+	{
+		int i = (data->nextseg + j) % data->nseg;
 		struct SharedDataSegment *sseg = getSegment (i);
 		int s;
 		for (s = 0; s < MAX_SHARED_CLIENTS; s++)
 		{
-			if (sseg->client_ids[s] > 0)
+			if (sseg->client_ids[s] != 0)
 				break;
 		}
+		// readers only clear slots, so once all slots are empty, segment can be safely reused
 		if (s == MAX_SHARED_CLIENTS)
 		{
 			sseg->bytesSoFar = 0;
 			sseg->size = segsize;
-			sseg->client_ids[0] = client;
-			chan2seg[chan] = sseg; 
-			unlockSegment (i);
+			for (s = 0; s < (int) clients.size (); s++)
+				sseg->client_read[s] = 0;
+			__sync_synchronize ();
+			for (s = 0; s < (int) clients.size (); s++)
+				sseg->client_ids[s] = clients[s];
+			chan2seg[chan] = sseg;
+			data->nextseg = (i + 1) % data->nseg;
 			return i;
 		}
-		unlockSegment (i);
 	}
 	return -1;
 }
@@ -240,6 +286,41 @@ void DataSharedWrite::endChannels ()
 	}
 }
 
+int DataSharedWrite::getFreeSegments ()
+{
+	int ret = 0;
+	for (int i = 0; i < getSegmentNumber (); i++)
+	{
+		struct SharedDataSegment *sseg = getSegment (i);
+		int s;
+		for (s = 0; s < MAX_SHARED_CLIENTS; s++)
+		{
+			if (sseg->client_ids[s] != 0)
+				break;
+		}
+		if (s == MAX_SHARED_CLIENTS)
+			ret++;
+	}
+	return ret;
+}
+
+void DataSharedWrite::getClientLag (std::map <int, size_t> &lag, std::map <int, int> &held)
+{
+	for (int i = 0; i < getSegmentNumber (); i++)
+	{
+		struct SharedDataSegment *sseg = getSegment (i);
+		for (int s = 0; s < MAX_SHARED_CLIENTS; s++)
+		{
+			int c = sseg->client_ids[s];
+			if (c == 0)
+				continue;
+			size_t r = sseg->client_read[s];
+			lag[c] += sseg->bytesSoFar > r ? sseg->bytesSoFar - r : 0;
+			held[c]++;
+		}
+	}
+}
+
 DataChannels::~DataChannels ()
 {
 	for (DataChannels::iterator iter = begin (); iter != end (); iter++)
@@ -274,6 +355,7 @@ void DataChannels::initSharedFromConnection (Connection *conn, DataSharedRead *s
 			throw Error ("cannot parse channel segment or size");
 		push_back (new DataSharedRead (shm, seg));
 	}
+	shared = true;
 	if (!conn->paramEnd ())
 		throw Error ("too much parameters in PROTO_SHARED command");
 }
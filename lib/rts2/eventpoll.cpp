@@ -0,0 +1,285 @@
+/*
+ * epoll/timerfd based event engine.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "eventpoll.h"
+#include "nan.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+
+#ifdef RTS2_HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#endif
+
+using namespace rts2core;
+
+EventPoll::EventPoll ()
+{
+	epoll_fd = -1;
+	timer_fd = -1;
+	timer_armed = NAN;
+	current = NULL;
+}
+
+EventPoll::~EventPoll ()
+{
+	closeFds ();
+}
+
+bool EventPoll::available ()
+{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	return true;
+#else
+	return false;
+#endif
+}
+
+int EventPoll::init ()
+{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	epoll_fd = epoll_create (64);
+	if (epoll_fd < 0)
+		return -1;
+#ifdef RTS2_HAVE_SYS_TIMERFD_H
+	timer_fd = timerfd_create (CLOCK_REALTIME, TFD_NONBLOCK);
+	if (timer_fd >= 0)
+		ctl (EPOLL_CTL_ADD, timer_fd, READ);
+#endif
+	events_buf.resize (16);
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+void EventPoll::watch (int fd, uint32_t events, Connection *owner)
+{
+	if (fd < 0)
+		return;
+	std::map <int, PollEntry>::iterator iter = fds.find (fd);
+	bool force = current != NULL && current->force;
+	if (current != NULL && std::find (current->fds.begin (), current->fds.end (), fd) == current->fds.end ())
+		current->fds.push_back (fd);
+	if (iter != fds.end ())
+	{
+		if (iter->second.owner == owner && iter->second.events == events && !force)
+		{
+			if (current)
+				iter->second.round = current->round;
+			return;
+		}
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+		// descriptor was closed and reopened - epoll already removed it
+		if (ctl (EPOLL_CTL_MOD, fd, events) && errno == ENOENT)
+			ctl (EPOLL_CTL_ADD, fd, events);
+#endif
+	}
+	else
+	{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+		if (ctl (EPOLL_CTL_ADD, fd, events) && errno == EEXIST)
+			ctl (EPOLL_CTL_MOD, fd, events);
+#endif
+	}
+	PollEntry &pe = fds[fd];
+	pe.owner = owner;
+	pe.events = events;
+	pe.round = current ? current->round : 0;
+}
+
+void EventPoll::unwatch (int fd, Connection *owner)
+{
+	std::map <int, PollEntry>::iterator iter = fds.find (fd);
+	if (iter == fds.end ())
+		return;
+	if (owner != NULL && iter->second.owner != owner)
+		return;
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	// errors are expected - descriptor might be already closed
+	ctl (EPOLL_CTL_DEL, fd, 0);
+#endif
+	fds.erase (iter);
+}
+
+void EventPoll::beginOwner (Connection *owner, int state, int sock)
+{
+	std::map <Connection *, OwnerEntry>::iterator iter = owners.find (owner);
+	if (iter == owners.end ())
+	{
+		current = &(owners[owner]);
+		current->round = 1;
+		current->force = true;
+	}
+	else
+	{
+		current = &(iter->second);
+		current->round++;
+		current->force = current->state != state || current->sock != sock;
+	}
+	current->state = state;
+	current->sock = sock;
+}
+
+bool EventPoll::ownerChanged (Connection *owner, int state, int sock)
+{
+	std::map <Connection *, OwnerEntry>::iterator iter = owners.find (owner);
+	return iter == owners.end () || iter->second.state != state || iter->second.sock != sock;
+}
+
+void EventPoll::endOwner (Connection *owner)
+{
+	if (current == NULL)
+		return;
+	for (std::vector <int>::iterator iter = current->fds.begin (); iter != current->fds.end ();)
+	{
+		std::map <int, PollEntry>::iterator fi = fds.find (*iter);
+		if (fi == fds.end () || fi->second.owner != owner)
+		{
+			iter = current->fds.erase (iter);
+		}
+		else if (fi->second.round != current->round)
+		{
+			unwatch (*iter, owner);
+			iter = current->fds.erase (iter);
+		}
+		else
+		{
+			iter++;
+		}
+	}
+	current = NULL;
+}
+
+void EventPoll::removeOwner (Connection *owner)
+{
+	std::map <Connection *, OwnerEntry>::iterator iter = owners.find (owner);
+	if (iter == owners.end ())
+		return;
+	for (std::vector <int>::iterator fi = iter->second.fds.begin (); fi != iter->second.fds.end (); fi++)
+		unwatch (*fi, owner);
+	owners.erase (iter);
+}
+
+void EventPoll::setTimer (double at)
+{
+#ifdef RTS2_HAVE_SYS_TIMERFD_H
+	if (timer_fd < 0)
+		return;
+	if ((isnan (at) && isnan (timer_armed)) || at == timer_armed)
+		return;
+	struct itimerspec its;
+	its.it_interval.tv_sec = 0;
+	its.it_interval.tv_nsec = 0;
+	if (isnan (at))
+	{
+		its.it_value.tv_sec = 0;
+		its.it_value.tv_nsec = 0;
+	}
+	else
+	{
+		its.it_value.tv_sec = (time_t) floor (at);
+		its.it_value.tv_nsec = (long) ((at - floor (at)) * 1e9);
+		// zero value disarms the timer
+		if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+			its.it_value.tv_nsec = 1;
+	}
+	if (timerfd_settime (timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0)
+		timer_armed = at;
+#endif
+}
+
+int EventPoll::wait (long usec_timeout)
+{
+	ready.clear ();
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	if (epoll_fd < 0)
+		return -1;
+	if (events_buf.size () < fds.size () + 1)
+		events_buf.resize (fds.size () + 1);
+	int ms_timeout = usec_timeout <= 0 ? 0 : (usec_timeout + 999) / 1000;
+	int ret = epoll_wait (epoll_fd, &(events_buf[0]), events_buf.size (), ms_timeout);
+	if (ret < 0)
+		return errno == EINTR ? 0 : -1;
+	for (int i = 0; i < ret; i++)
+	{
+		int fd = events_buf[i].data.fd;
+		if (fd == timer_fd)
+		{
+			uint64_t expirations;
+			if (read (timer_fd, &expirations, sizeof (expirations)) < 0 && errno != EAGAIN)
+				return -1;
+			timer_armed = NAN;
+			continue;
+		}
+		ReadyEntry re;
+		re.fd = fd;
+		re.events = 0;
+		if (events_buf[i].events & (EPOLLIN | EPOLLPRI | EPOLLHUP | EPOLLERR))
+			re.events |= READ;
+		if (events_buf[i].events & (EPOLLOUT | EPOLLERR))
+			re.events |= WRITE;
+		ready.push_back (re);
+	}
+	return ready.size ();
+#else
+	return -1;
+#endif
+}
+
+Connection *EventPoll::getOwner (int fd)
+{
+	std::map <int, PollEntry>::iterator iter = fds.find (fd);
+	if (iter == fds.end ())
+		return NULL;
+	return iter->second.owner;
+}
+
+void EventPoll::closeFds ()
+{
+	if (timer_fd >= 0)
+		close (timer_fd);
+	if (epoll_fd >= 0)
+		close (epoll_fd);
+	timer_fd = -1;
+	epoll_fd = -1;
+	fds.clear ();
+	owners.clear ();
+	ready.clear ();
+	current = NULL;
+}
+
+int EventPoll::ctl (int op, int fd, uint32_t events)
+{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	struct epoll_event ev;
+	ev.events = 0;
+	if (events & READ)
+		ev.events |= EPOLLIN | EPOLLPRI;
+	if (events & WRITE)
+		ev.events |= EPOLLOUT;
+	ev.data.u64 = 0;
+	ev.data.fd = fd;
+	return epoll_ctl (epoll_fd, op, fd, &ev);
+#else
+	return -1;
+#endif
+}
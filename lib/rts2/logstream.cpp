@@ -56,12 +56,19 @@ void LogStream::logArrAsHex (const char *arr, int len)
 
 void LogStream::sendLog ()
 {
-	masterApp->sendMessage (messageType, ls.str ().c_str ());
+	// connections are not thread safe, messages from other threads are send by the main thread
+	if (masterApp->isMainThread ())
+		masterApp->sendMessage (messageType, ls.str ().c_str ());
+	else
+		masterApp->sendThreadMessage (messageType, ls.str ().c_str ());
 }
 
 void LogStream::sendLogNoEndl ()
 {
-	masterApp->sendMessageNoEndl (messageType, ls.str ().c_str ());
+	if (masterApp->isMainThread ())
+		masterApp->sendMessageNoEndl (messageType, ls.str ().c_str ());
+	else
+		masterApp->sendThreadMessage (messageType, ls.str ().c_str ());
 }
 
 LogStream & sendLog (LogStream & _ls)
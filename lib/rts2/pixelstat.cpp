@@ -0,0 +1,1310 @@
+/*
+ * Single pass pixel statistics (sum, min, max, variance, mode).
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "pixelstat.h"
+#include "imghdr.h"
+#include "nan.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PIXELSTAT_AVX2
+#define PIXELSTAT_SIMD
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELSTAT_SSE2
+#define PIXELSTAT_SIMD
+#endif
+
+// maximal number of vector iterations before 32 bit lane sums must be flushed to 64 bit sum
+#define LANE_FLUSH     16384
+
+// number of valid pixels averaged to get shift of the first update
+#define SHIFT_PIXELS   256
+
+using namespace rts2core;
+
+#ifdef PIXELSTAT_SIMD
+static inline uint64_t laneSumU32 (__m128i v)
+{
+	uint32_t s[4];
+	_mm_storeu_si128 ((__m128i *) s, v);
+	return (uint64_t) s[0] + s[1] + s[2] + s[3];
+}
+
+static inline int64_t laneSum64 (__m128i v)
+{
+	int64_t s[2];
+	_mm_storeu_si128 ((__m128i *) s, v);
+	return s[0] + s[1];
+}
+
+static inline double laneSumPd (__m128d v)
+{
+	double s[2];
+	_mm_storeu_pd (s, v);
+	return s[0] + s[1];
+}
+
+// add squares of signed 16 bit lanes to 64 bit lanes
+static inline __m128i addSquares16 (__m128i acc, __m128i v)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	// sum of two squares is at most 2^31, so it can be zero extended
+	__m128i q = _mm_madd_epi16 (v, v);
+	acc = _mm_add_epi64 (acc, _mm_unpacklo_epi32 (q, zero));
+	return _mm_add_epi64 (acc, _mm_unpackhi_epi32 (q, zero));
+}
+
+// SSE2 does not have 32 bit min/max
+static inline __m128i minEpi32 (__m128i a, __m128i b)
+{
+#ifdef PIXELSTAT_AVX2
+	return _mm_min_epi32 (a, b);
+#else
+	__m128i lt = _mm_cmplt_epi32 (a, b);
+	return _mm_or_si128 (_mm_and_si128 (lt, a), _mm_andnot_si128 (lt, b));
+#endif
+}
+
+static inline __m128i maxEpi32 (__m128i a, __m128i b)
+{
+#ifdef PIXELSTAT_AVX2
+	return _mm_max_epi32 (a, b);
+#else
+	__m128i gt = _mm_cmpgt_epi32 (a, b);
+	return _mm_or_si128 (_mm_and_si128 (gt, a), _mm_andnot_si128 (gt, b));
+#endif
+}
+#endif
+
+/**
+ * Sum of squared deviations from the mean, from exact sums of pixel values and their squares.
+ */
+static double exactM2 (long double sq, long double s, size_t n)
+{
+	long double q = sq - s * s / n;
+	return q > 0 ? q : 0;
+}
+
+PixelStatistics::PixelStatistics (bool _mode, bool _squares)
+{
+	if (_mode)
+	{
+		histogram = new uint32_t[PIXELSTAT_HISTOGRAM_SIZE];
+		memset (histogram, 0, PIXELSTAT_HISTOGRAM_SIZE * sizeof (uint32_t));
+	}
+	else
+	{
+		histogram = NULL;
+	}
+	squares = _squares;
+	histOffset = 0;
+	histUsed = false;
+	reset ();
+}
+
+PixelStatistics::~PixelStatistics ()
+{
+	delete[] histogram;
+}
+
+void PixelStatistics::reset ()
+{
+	resetSums ();
+	if (histUsed)
+		memset (histogram, 0, PIXELSTAT_HISTOGRAM_SIZE * sizeof (uint32_t));
+	histUsed = false;
+	modeCount = 0;
+	modeBin = 0;
+}
+
+void PixelStatistics::resetSums ()
+{
+	sum = 0;
+	min = INFINITY;
+	max = -INFINITY;
+	count = 0;
+	m2 = 0;
+}
+
+size_t PixelStatistics::update (int dataType, const char *data, size_t dataSize)
+{
+	switch (dataType)
+	{
+		case RTS2_DATA_BYTE:
+			return update ((const uint8_t *) data, dataSize);
+		case RTS2_DATA_SHORT:
+			return update ((const int16_t *) data, dataSize / 2);
+		case RTS2_DATA_LONG:
+			return update ((const int32_t *) data, dataSize / 4);
+		case RTS2_DATA_LONGLONG:
+			return update ((const int64_t *) data, dataSize / 8);
+		case RTS2_DATA_FLOAT:
+			return update ((const float *) data, dataSize / 4);
+		case RTS2_DATA_DOUBLE:
+			return update ((const double *) data, dataSize / 8);
+		case RTS2_DATA_SBYTE:
+			return update ((const int8_t *) data, dataSize);
+		case RTS2_DATA_USHORT:
+			return update ((const uint16_t *) data, dataSize / 2);
+		case RTS2_DATA_ULONG:
+			return update ((const uint32_t *) data, dataSize / 4);
+	}
+	return 0;
+}
+
+size_t PixelStatistics::update (const uint8_t *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const int8_t *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const uint16_t *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const int16_t *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const uint32_t *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const int32_t *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const int64_t *data, size_t n)
+{
+	// 64 bit sum can overflow
+	return squares ? updateScalarInt <int64_t, double, true> (data, n, 0) : updateScalarInt <int64_t, double, false> (data, n, 0);
+}
+
+size_t PixelStatistics::update (const float *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+size_t PixelStatistics::update (const double *data, size_t n)
+{
+	return squares ? kernel <true> (data, n) : kernel <false> (data, n);
+}
+
+double PixelStatistics::getAverage ()
+{
+	if (count == 0)
+		return NAN;
+	return sum / count;
+}
+
+double PixelStatistics::getMode ()
+{
+	if (modeCount == 0)
+		return NAN;
+	return modeBin + histOffset;
+}
+
+const char *PixelStatistics::getKernelName ()
+{
+#if defined(PIXELSTAT_AVX2)
+	return "AVX2";
+#elif defined(PIXELSTAT_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+void PixelStatistics::setHistogramOffset (long offset)
+{
+	if (histogram == NULL)
+		return;
+	if (offset != histOffset)
+	{
+		// data type changed without reset - start new histogram
+		if (histUsed)
+			memset (histogram, 0, PIXELSTAT_HISTOGRAM_SIZE * sizeof (uint32_t));
+		modeCount = 0;
+		modeBin = 0;
+		histOffset = offset;
+	}
+	histUsed = true;
+}
+
+void PixelStatistics::addMoments (size_t n, double s, double q)
+{
+	if (n == 0)
+		return;
+	if (q < 0)
+		q = 0;
+	if (count == 0)
+	{
+		m2 = q;
+		return;
+	}
+	double delta = s / n - sum / count;
+	m2 += q + delta * delta * ((double) count * n / (count + n));
+}
+
+template <typename t> double PixelStatistics::getShift (const t *data, size_t n)
+{
+	if (count > 0)
+		return sum / count;
+	double s = 0;
+	size_t c = 0;
+	for (size_t i = 0; i < n && c < SHIFT_PIXELS; i++)
+	{
+		double v = data[i];
+		// NaN does not pass any comparison
+		if (v == v)
+		{
+			s += v;
+			c++;
+		}
+	}
+	return c > 0 ? s / c : 0;
+}
+
+template <typename t, bool sq> size_t PixelStatistics::updateScalarFloat (const t *data, size_t n)
+{
+	double tSum = 0;
+	double tMin = min;
+	double tMax = max;
+	size_t nanCount = 0;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	double sD = 0;
+	double sQ = 0;
+	setHistogramOffset (0);
+	if (histogram)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			t tD = data[i];
+			// NaN does not pass any comparison
+			if (!(tD == tD))
+			{
+				nanCount++;
+				continue;
+			}
+			tSum += tD;
+			if (tD < tMin)
+				tMin = tD;
+			if (tD > tMax)
+				tMax = tD;
+			if (sq)
+			{
+				double d = tD - shift;
+				sD += d;
+				sQ += d * d;
+			}
+			if (tD > -0.5 && tD < PIXELSTAT_HISTOGRAM_SIZE - 0.5)
+				histAdd ((long) (tD + 0.5));
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			t tD = data[i];
+			if (!(tD == tD))
+			{
+				nanCount++;
+				continue;
+			}
+			tSum += tD;
+			if (tD < tMin)
+				tMin = tD;
+			if (tD > tMax)
+				tMax = tD;
+			if (sq)
+			{
+				double d = tD - shift;
+				sD += d;
+				sQ += d * d;
+			}
+		}
+	}
+	if (sq && n > nanCount)
+		addMoments (n - nanCount, tSum, sQ - sD * sD / (n - nanCount));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n - nanCount;
+	return n;
+}
+
+template <typename t, typename sum_t, bool sq> size_t PixelStatistics::updateScalarInt (const t *data, size_t n, long offset)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (offset);
+	t tMin = data[0];
+	t tMax = data[0];
+	sum_t tSum = 0;
+	double shift = sq ? getShift (data, n) : 0;
+	double sD = 0;
+	double sQ = 0;
+	// histogram is filled in the same loop, values outside of histogram are rejected by histAdd
+	if (histogram)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			t tD = data[i];
+			tSum += tD;
+			if (tD < tMin)
+				tMin = tD;
+			if (tD > tMax)
+				tMax = tD;
+			if (sq)
+			{
+				double d = tD - shift;
+				sD += d;
+				sQ += d * d;
+			}
+			histAdd ((long) tD - offset);
+		}
+	}
+	else
+	{
+		// conditional moves, so the loop can be vectorized
+		for (size_t i = 0; i < n; i++)
+		{
+			t tD = data[i];
+			tSum += tD;
+			tMin = tD < tMin ? tD : tMin;
+			tMax = tD > tMax ? tD : tMax;
+			if (sq)
+			{
+				double d = tD - shift;
+				sD += d;
+				sQ += d * d;
+			}
+		}
+	}
+	if (sq)
+		addMoments (n, tSum, sQ - sD * sD / n);
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const uint8_t *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (0);
+	size_t i = 0;
+	uint8_t tMin = 0xff;
+	uint8_t tMax = 0;
+	uint64_t tSum = 0;
+	uint64_t tSq = 0;
+#ifdef PIXELSTAT_SIMD
+	__m128i vMin = _mm_set1_epi8 ((char) 0xff);
+	__m128i vMax = _mm_setzero_si128 ();
+	__m128i vSum = _mm_setzero_si128 ();
+	__m128i vSq = _mm_setzero_si128 ();
+	const __m128i zero = _mm_setzero_si128 ();
+	int iter = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+		vMin = _mm_min_epu8 (vMin, v);
+		vMax = _mm_max_epu8 (vMax, v);
+		// two 64 bit sums of 8 bytes
+		vSum = _mm_add_epi64 (vSum, _mm_sad_epu8 (v, zero));
+		if (sq)
+		{
+			__m128i lo = _mm_unpacklo_epi8 (v, zero);
+			__m128i hi = _mm_unpackhi_epi8 (v, zero);
+			vSq = _mm_add_epi32 (vSq, _mm_add_epi32 (_mm_madd_epi16 (lo, lo), _mm_madd_epi16 (hi, hi)));
+			if (++iter == LANE_FLUSH)
+			{
+				tSq += laneSumU32 (vSq);
+				vSq = _mm_setzero_si128 ();
+				iter = 0;
+			}
+		}
+		if (histogram)
+			for (int j = 0; j < 16; j++)
+				histAdd (data[i + j]);
+	}
+	uint8_t lanes[16];
+	_mm_storeu_si128 ((__m128i *) lanes, vMin);
+	for (int j = 0; j < 16; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_si128 ((__m128i *) lanes, vMax);
+	for (int j = 0; j < 16; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	tSum = laneSum64 (vSum);
+	tSq += laneSumU32 (vSq);
+#endif
+	for (; i < n; i++)
+	{
+		uint8_t tD = data[i];
+		tSum += tD;
+		if (sq)
+			tSq += tD * tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		histAdd (tD);
+	}
+	if (sq)
+		addMoments (n, tSum, exactM2 (tSq, tSum, n));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const int8_t *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (-128);
+	size_t i = 0;
+	int8_t tMin = 127;
+	int8_t tMax = -128;
+	int64_t tSum = 0;
+	uint64_t tSq = 0;
+#ifdef PIXELSTAT_SIMD
+	// values offset by 128 are unsigned, so unsigned min/max and sum of absolute differences can be used
+	const __m128i sign = _mm_set1_epi8 ((char) 0x80);
+	__m128i vMin = _mm_set1_epi8 ((char) 0xff);
+	__m128i vMax = _mm_setzero_si128 ();
+	__m128i vSum = _mm_setzero_si128 ();
+	__m128i vSq = _mm_setzero_si128 ();
+	const __m128i zero = _mm_setzero_si128 ();
+	int iter = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+		__m128i u = _mm_xor_si128 (v, sign);
+		vMin = _mm_min_epu8 (vMin, u);
+		vMax = _mm_max_epu8 (vMax, u);
+		vSum = _mm_add_epi64 (vSum, _mm_sad_epu8 (u, zero));
+		if (sq)
+		{
+			// sign extension to 16 bits
+			__m128i lo = _mm_srai_epi16 (_mm_unpacklo_epi8 (v, v), 8);
+			__m128i hi = _mm_srai_epi16 (_mm_unpackhi_epi8 (v, v), 8);
+			vSq = _mm_add_epi32 (vSq, _mm_add_epi32 (_mm_madd_epi16 (lo, lo), _mm_madd_epi16 (hi, hi)));
+			if (++iter == LANE_FLUSH)
+			{
+				tSq += laneSumU32 (vSq);
+				vSq = _mm_setzero_si128 ();
+				iter = 0;
+			}
+		}
+		if (histogram)
+			for (int j = 0; j < 16; j++)
+				histAdd ((long) data[i + j] + 128);
+	}
+	uint8_t lanes[16];
+	_mm_storeu_si128 ((__m128i *) lanes, vMin);
+	for (int j = 0; j < 16; j++)
+		if (lanes[j] - 128 < tMin)
+			tMin = lanes[j] - 128;
+	_mm_storeu_si128 ((__m128i *) lanes, vMax);
+	for (int j = 0; j < 16; j++)
+		if (lanes[j] - 128 > tMax)
+			tMax = lanes[j] - 128;
+	tSum = laneSum64 (vSum) - 128 * (int64_t) i;
+	tSq += laneSumU32 (vSq);
+#endif
+	for (; i < n; i++)
+	{
+		int8_t tD = data[i];
+		tSum += tD;
+		if (sq)
+			tSq += tD * tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		histAdd ((long) tD + 128);
+	}
+	if (sq)
+		addMoments (n, tSum, exactM2 (tSq, tSum, n));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const uint16_t *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (0);
+	size_t i = 0;
+	uint16_t tMin = 0xffff;
+	uint16_t tMax = 0;
+	uint64_t tSum = 0;
+	uint64_t tSq = 0;
+#ifdef PIXELSTAT_SIMD
+	// squares of values with flipped sign bit (value - 32768) are summed, sum of squares of values is calculated from them
+	int64_t sqFlipped = 0;
+#endif
+#if defined(PIXELSTAT_AVX2)
+	const __m256i sign = _mm256_set1_epi16 ((short) 0x8000);
+	__m256i vMin = _mm256_set1_epi16 ((short) 0xffff);
+	__m256i vMax = _mm256_setzero_si256 ();
+	__m256i vSum = _mm256_setzero_si256 ();
+	__m256i vSq = _mm256_setzero_si256 ();
+	const __m256i zero = _mm256_setzero_si256 ();
+	int iter = 0;
+	for (; i + 16 <= n; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256 ((const __m256i *) (data + i));
+		vMin = _mm256_min_epu16 (vMin, v);
+		vMax = _mm256_max_epu16 (vMax, v);
+		vSum = _mm256_add_epi32 (vSum, _mm256_unpacklo_epi16 (v, zero));
+		vSum = _mm256_add_epi32 (vSum, _mm256_unpackhi_epi16 (v, zero));
+		if (sq)
+		{
+			__m256i vs = _mm256_xor_si256 (v, sign);
+			__m256i q = _mm256_madd_epi16 (vs, vs);
+			vSq = _mm256_add_epi64 (vSq, _mm256_unpacklo_epi32 (q, zero));
+			vSq = _mm256_add_epi64 (vSq, _mm256_unpackhi_epi32 (q, zero));
+		}
+		if (histogram)
+			for (int j = 0; j < 16; j++)
+				histAdd (data[i + j]);
+		if (++iter == LANE_FLUSH)
+		{
+			uint32_t s[8];
+			_mm256_storeu_si256 ((__m256i *) s, vSum);
+			for (int j = 0; j < 8; j++)
+				tSum += s[j];
+			vSum = _mm256_setzero_si256 ();
+			iter = 0;
+		}
+	}
+	uint16_t lanes[16];
+	_mm256_storeu_si256 ((__m256i *) lanes, vMin);
+	for (int j = 0; j < 16; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm256_storeu_si256 ((__m256i *) lanes, vMax);
+	for (int j = 0; j < 16; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	uint32_t s[8];
+	_mm256_storeu_si256 ((__m256i *) s, vSum);
+	for (int j = 0; j < 8; j++)
+		tSum += s[j];
+	int64_t q[4];
+	_mm256_storeu_si256 ((__m256i *) q, vSq);
+	sqFlipped = q[0] + q[1] + q[2] + q[3];
+#elif defined(PIXELSTAT_SSE2)
+	// SSE2 does not have unsigned 16 bit min/max, flip sign bit and use signed operations
+	const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+	__m128i vMin = _mm_set1_epi16 (0x7fff);
+	__m128i vMax = _mm_set1_epi16 ((short) 0x8000);
+	__m128i vSum = _mm_setzero_si128 ();
+	__m128i vSq = _mm_setzero_si128 ();
+	const __m128i zero = _mm_setzero_si128 ();
+	int iter = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+		__m128i vs = _mm_xor_si128 (v, sign);
+		vMin = _mm_min_epi16 (vMin, vs);
+		vMax = _mm_max_epi16 (vMax, vs);
+		vSum = _mm_add_epi32 (vSum, _mm_unpacklo_epi16 (v, zero));
+		vSum = _mm_add_epi32 (vSum, _mm_unpackhi_epi16 (v, zero));
+		if (sq)
+			vSq = addSquares16 (vSq, vs);
+		if (histogram)
+			for (int j = 0; j < 8; j++)
+				histAdd (data[i + j]);
+		if (++iter == LANE_FLUSH)
+		{
+			tSum += laneSumU32 (vSum);
+			vSum = _mm_setzero_si128 ();
+			iter = 0;
+		}
+	}
+	uint16_t lanes[8];
+	_mm_storeu_si128 ((__m128i *) lanes, _mm_xor_si128 (vMin, sign));
+	for (int j = 0; j < 8; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_si128 ((__m128i *) lanes, _mm_xor_si128 (vMax, sign));
+	for (int j = 0; j < 8; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	tSum += laneSumU32 (vSum);
+	sqFlipped = laneSum64 (vSq);
+#endif
+#ifdef PIXELSTAT_SIMD
+	// value = flipped + 32768, so value^2 = flipped^2 + 65536 * flipped + 2^30
+	if (sq)
+		tSq = sqFlipped + 65536 * ((int64_t) tSum - 32768 * (int64_t) i) + ((int64_t) i << 30);
+#endif
+	for (; i < n; i++)
+	{
+		uint16_t tD = data[i];
+		tSum += tD;
+		if (sq)
+			tSq += (uint32_t) tD * tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		histAdd (tD);
+	}
+	if (sq)
+		addMoments (n, tSum, exactM2 (tSq, tSum, n));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const int16_t *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (-32768);
+	size_t i = 0;
+	int16_t tMin = 32767;
+	int16_t tMax = -32768;
+	int64_t tSum = 0;
+	uint64_t tSq = 0;
+#ifdef PIXELSTAT_SIMD
+	__m128i vMin = _mm_set1_epi16 (0x7fff);
+	__m128i vMax = _mm_set1_epi16 ((short) 0x8000);
+	__m128i vSum = _mm_setzero_si128 ();
+	__m128i vSq = _mm_setzero_si128 ();
+	int iter = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+		vMin = _mm_min_epi16 (vMin, v);
+		vMax = _mm_max_epi16 (vMax, v);
+		// sign extension to 32 bits
+		__m128i vsign = _mm_srai_epi16 (v, 15);
+		vSum = _mm_add_epi32 (vSum, _mm_unpacklo_epi16 (v, vsign));
+		vSum = _mm_add_epi32 (vSum, _mm_unpackhi_epi16 (v, vsign));
+		if (sq)
+			vSq = addSquares16 (vSq, v);
+		if (histogram)
+			for (int j = 0; j < 8; j++)
+				histAdd ((long) data[i + j] + 32768);
+		if (++iter == LANE_FLUSH)
+		{
+			int32_t s[4];
+			_mm_storeu_si128 ((__m128i *) s, vSum);
+			tSum += (int64_t) s[0] + s[1] + s[2] + s[3];
+			vSum = _mm_setzero_si128 ();
+			iter = 0;
+		}
+	}
+	int16_t lanes[8];
+	_mm_storeu_si128 ((__m128i *) lanes, vMin);
+	for (int j = 0; j < 8; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_si128 ((__m128i *) lanes, vMax);
+	for (int j = 0; j < 8; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	int32_t s[4];
+	_mm_storeu_si128 ((__m128i *) s, vSum);
+	tSum += (int64_t) s[0] + s[1] + s[2] + s[3];
+	tSq = laneSum64 (vSq);
+#endif
+	for (; i < n; i++)
+	{
+		int16_t tD = data[i];
+		tSum += tD;
+		if (sq)
+			tSq += (int32_t) tD * tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		histAdd ((long) tD + 32768);
+	}
+	if (sq)
+		addMoments (n, tSum, exactM2 (tSq, tSum, n));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const uint32_t *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (0);
+	size_t i = 0;
+	uint32_t tMin = 0xffffffff;
+	uint32_t tMax = 0;
+	uint64_t tSum = 0;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	double sD = 0;
+	double sQ = 0;
+#ifdef PIXELSTAT_SIMD
+	// there are no unsigned 32 bit operations, flip sign bit (value - 2^31) and use signed operations
+	const __m128i sign = _mm_set1_epi32 (0x80000000);
+	if (sq)
+	{
+		// flipped values are converted to double, their sums are exact while below 2^53
+		__m128d vMin = _mm_set1_pd (INFINITY);
+		__m128d vMax = _mm_set1_pd (-INFINITY);
+		__m128d vShift = _mm_set1_pd (shift - 2147483648.0);
+		__m128d vS0 = _mm_setzero_pd ();
+		__m128d vS1 = _mm_setzero_pd ();
+		__m128d vQ0 = _mm_setzero_pd ();
+		__m128d vQ1 = _mm_setzero_pd ();
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i vs = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (data + i)), sign);
+			__m128d c0 = _mm_cvtepi32_pd (vs);
+			__m128d c1 = _mm_cvtepi32_pd (_mm_unpackhi_epi64 (vs, vs));
+			vMin = _mm_min_pd (vMin, _mm_min_pd (c0, c1));
+			vMax = _mm_max_pd (vMax, _mm_max_pd (c0, c1));
+			vS0 = _mm_add_pd (vS0, c0);
+			vS1 = _mm_add_pd (vS1, c1);
+			__m128d d0 = _mm_sub_pd (c0, vShift);
+			__m128d d1 = _mm_sub_pd (c1, vShift);
+			vQ0 = _mm_add_pd (vQ0, _mm_mul_pd (d0, d0));
+			vQ1 = _mm_add_pd (vQ1, _mm_mul_pd (d1, d1));
+			if (histogram)
+				for (int j = 0; j < 4; j++)
+					histAdd (data[i + j]);
+		}
+		double lanes[2];
+		_mm_storeu_pd (lanes, vMin);
+		for (int j = 0; j < 2; j++)
+			if (lanes[j] + 2147483648.0 < tMin)
+				tMin = lanes[j] + 2147483648.0;
+		_mm_storeu_pd (lanes, vMax);
+		for (int j = 0; j < 2; j++)
+			if (lanes[j] + 2147483648.0 > tMax)
+				tMax = lanes[j] + 2147483648.0;
+		tSum = (int64_t) laneSumPd (_mm_add_pd (vS0, vS1)) + ((int64_t) i << 31);
+		sD = tSum - shift * i;
+		sQ = laneSumPd (_mm_add_pd (vQ0, vQ1));
+	}
+	else
+	{
+		__m128i vMin = _mm_set1_epi32 (0x7fffffff);
+		__m128i vMax = _mm_set1_epi32 (0x80000000);
+		__m128i vSum = _mm_setzero_si128 ();
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i vs = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *) (data + i)), sign);
+			vMin = minEpi32 (vMin, vs);
+			vMax = maxEpi32 (vMax, vs);
+			// sign extension to 64 bits
+			__m128i vsign = _mm_srai_epi32 (vs, 31);
+			vSum = _mm_add_epi64 (vSum, _mm_unpacklo_epi32 (vs, vsign));
+			vSum = _mm_add_epi64 (vSum, _mm_unpackhi_epi32 (vs, vsign));
+			if (histogram)
+				for (int j = 0; j < 4; j++)
+					histAdd (data[i + j]);
+		}
+		uint32_t lanes[4];
+		_mm_storeu_si128 ((__m128i *) lanes, _mm_xor_si128 (vMin, sign));
+		for (int j = 0; j < 4; j++)
+			if (lanes[j] < tMin)
+				tMin = lanes[j];
+		_mm_storeu_si128 ((__m128i *) lanes, _mm_xor_si128 (vMax, sign));
+		for (int j = 0; j < 4; j++)
+			if (lanes[j] > tMax)
+				tMax = lanes[j];
+		tSum = laneSum64 (vSum) + ((int64_t) i << 31);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		uint32_t tD = data[i];
+		tSum += tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		if (sq)
+		{
+			double d = tD - shift;
+			sD += d;
+			sQ += d * d;
+		}
+		histAdd (tD);
+	}
+	if (sq)
+		addMoments (n, tSum, sQ - sD * sD / n);
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const int32_t *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	setHistogramOffset (0);
+	size_t i = 0;
+	int32_t tMin = 0x7fffffff;
+	int32_t tMax = -0x7fffffff - 1;
+	int64_t tSum = 0;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	double sD = 0;
+	double sQ = 0;
+#ifdef PIXELSTAT_SIMD
+	if (sq)
+	{
+		// values are converted to double, their sums are exact while below 2^53
+		__m128d vMin = _mm_set1_pd (INFINITY);
+		__m128d vMax = _mm_set1_pd (-INFINITY);
+		__m128d vShift = _mm_set1_pd (shift);
+		__m128d vS0 = _mm_setzero_pd ();
+		__m128d vS1 = _mm_setzero_pd ();
+		__m128d vQ0 = _mm_setzero_pd ();
+		__m128d vQ1 = _mm_setzero_pd ();
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+			__m128d c0 = _mm_cvtepi32_pd (v);
+			__m128d c1 = _mm_cvtepi32_pd (_mm_unpackhi_epi64 (v, v));
+			vMin = _mm_min_pd (vMin, _mm_min_pd (c0, c1));
+			vMax = _mm_max_pd (vMax, _mm_max_pd (c0, c1));
+			vS0 = _mm_add_pd (vS0, c0);
+			vS1 = _mm_add_pd (vS1, c1);
+			__m128d d0 = _mm_sub_pd (c0, vShift);
+			__m128d d1 = _mm_sub_pd (c1, vShift);
+			vQ0 = _mm_add_pd (vQ0, _mm_mul_pd (d0, d0));
+			vQ1 = _mm_add_pd (vQ1, _mm_mul_pd (d1, d1));
+			if (histogram)
+				for (int j = 0; j < 4; j++)
+					histAdd (data[i + j]);
+		}
+		double lanes[2];
+		_mm_storeu_pd (lanes, vMin);
+		for (int j = 0; j < 2; j++)
+			if (lanes[j] < tMin)
+				tMin = lanes[j];
+		_mm_storeu_pd (lanes, vMax);
+		for (int j = 0; j < 2; j++)
+			if (lanes[j] > tMax)
+				tMax = lanes[j];
+		tSum = laneSumPd (_mm_add_pd (vS0, vS1));
+		sD = tSum - shift * i;
+		sQ = laneSumPd (_mm_add_pd (vQ0, vQ1));
+	}
+	else
+	{
+		__m128i vMin = _mm_set1_epi32 (0x7fffffff);
+		__m128i vMax = _mm_set1_epi32 (0x80000000);
+		__m128i vSum = _mm_setzero_si128 ();
+		for (; i + 4 <= n; i += 4)
+		{
+			__m128i v = _mm_loadu_si128 ((const __m128i *) (data + i));
+			vMin = minEpi32 (vMin, v);
+			vMax = maxEpi32 (vMax, v);
+			// sign extension to 64 bits
+			__m128i vsign = _mm_srai_epi32 (v, 31);
+			vSum = _mm_add_epi64 (vSum, _mm_unpacklo_epi32 (v, vsign));
+			vSum = _mm_add_epi64 (vSum, _mm_unpackhi_epi32 (v, vsign));
+			if (histogram)
+				for (int j = 0; j < 4; j++)
+					histAdd (data[i + j]);
+		}
+		int32_t lanes[4];
+		_mm_storeu_si128 ((__m128i *) lanes, vMin);
+		for (int j = 0; j < 4; j++)
+			if (lanes[j] < tMin)
+				tMin = lanes[j];
+		_mm_storeu_si128 ((__m128i *) lanes, vMax);
+		for (int j = 0; j < 4; j++)
+			if (lanes[j] > tMax)
+				tMax = lanes[j];
+		tSum = laneSum64 (vSum);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		int32_t tD = data[i];
+		tSum += tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		if (sq)
+		{
+			double d = tD - shift;
+			sD += d;
+			sQ += d * d;
+		}
+		histAdd (tD);
+	}
+	if (sq)
+		addMoments (n, tSum, sQ - sD * sD / n);
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const float *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	// histogram is filled per pixel, the loop cannot be vectorized
+	if (histogram)
+		return updateScalarFloat <float, sq> (data, n);
+#ifdef PIXELSTAT_SIMD
+	// NaNs are rare, they are masked only if the data contain them
+	if (kernelNoNaN <sq> (data, n))
+		return n;
+#endif
+	setHistogramOffset (0);
+	size_t i = 0;
+	double tMin = min;
+	double tMax = max;
+	double tSum = 0;
+	size_t nanCount = 0;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	double sD = 0;
+	double sQ = 0;
+#ifdef PIXELSTAT_SIMD
+	__m128 vMin = _mm_set1_ps (INFINITY);
+	__m128 vMax = _mm_set1_ps (-INFINITY);
+	__m128d vSumL = _mm_setzero_pd ();
+	__m128d vSumH = _mm_setzero_pd ();
+	__m128d vShift = _mm_set1_pd (shift);
+	__m128d vDL = _mm_setzero_pd ();
+	__m128d vDH = _mm_setzero_pd ();
+	__m128d vQL = _mm_setzero_pd ();
+	__m128d vQH = _mm_setzero_pd ();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 v = _mm_loadu_ps (data + i);
+		// min/max returns second operand if any of operands is NaN - so NaN are ignored
+		vMin = _mm_min_ps (v, vMin);
+		vMax = _mm_max_ps (v, vMax);
+		// NaN lanes are zeroed before summing
+		__m128 vOrd = _mm_cmpord_ps (v, v);
+		__m128 vNum = _mm_and_ps (v, vOrd);
+		nanCount += 4 - __builtin_popcount (_mm_movemask_ps (vOrd));
+		__m128d vL = _mm_cvtps_pd (vNum);
+		__m128d vH = _mm_cvtps_pd (_mm_movehl_ps (vNum, vNum));
+		vSumL = _mm_add_pd (vSumL, vL);
+		vSumH = _mm_add_pd (vSumH, vH);
+		if (sq)
+		{
+			// deviations of NaN lanes are zeroed by ordered mask widened to 64 bits
+			__m128d dL = _mm_and_pd (_mm_sub_pd (vL, vShift), _mm_castps_pd (_mm_unpacklo_ps (vOrd, vOrd)));
+			__m128d dH = _mm_and_pd (_mm_sub_pd (vH, vShift), _mm_castps_pd (_mm_unpackhi_ps (vOrd, vOrd)));
+			vDL = _mm_add_pd (vDL, dL);
+			vDH = _mm_add_pd (vDH, dH);
+			vQL = _mm_add_pd (vQL, _mm_mul_pd (dL, dL));
+			vQH = _mm_add_pd (vQH, _mm_mul_pd (dH, dH));
+		}
+	}
+	float lanes[4];
+	_mm_storeu_ps (lanes, vMin);
+	for (int j = 0; j < 4; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_ps (lanes, vMax);
+	for (int j = 0; j < 4; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	tSum = laneSumPd (_mm_add_pd (vSumL, vSumH));
+	sD = laneSumPd (_mm_add_pd (vDL, vDH));
+	sQ = laneSumPd (_mm_add_pd (vQL, vQH));
+#endif
+	for (; i < n; i++)
+	{
+		float tD = data[i];
+		// NaN does not pass any comparison
+		if (!(tD == tD))
+		{
+			nanCount++;
+			continue;
+		}
+		tSum += tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		if (sq)
+		{
+			double d = tD - shift;
+			sD += d;
+			sQ += d * d;
+		}
+	}
+	if (sq && n > nanCount)
+		addMoments (n - nanCount, tSum, sQ - sD * sD / (n - nanCount));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n - nanCount;
+	return n;
+}
+
+template <bool sq> size_t PixelStatistics::kernel (const double *data, size_t n)
+{
+	if (n == 0)
+		return 0;
+	// histogram is filled per pixel, the loop cannot be vectorized
+	if (histogram)
+		return updateScalarFloat <double, sq> (data, n);
+#ifdef PIXELSTAT_SIMD
+	// NaNs are rare, they are masked only if the data contain them
+	if (kernelNoNaN <sq> (data, n))
+		return n;
+#endif
+	setHistogramOffset (0);
+	size_t i = 0;
+	double tMin = min;
+	double tMax = max;
+	double tSum = 0;
+	size_t nanCount = 0;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	double sD = 0;
+	double sQ = 0;
+#ifdef PIXELSTAT_SIMD
+	__m128d vMin = _mm_set1_pd (INFINITY);
+	__m128d vMax = _mm_set1_pd (-INFINITY);
+	__m128d vSum0 = _mm_setzero_pd ();
+	__m128d vSum1 = _mm_setzero_pd ();
+	__m128d vShift = _mm_set1_pd (shift);
+	__m128d vD0 = _mm_setzero_pd ();
+	__m128d vD1 = _mm_setzero_pd ();
+	__m128d vQ0 = _mm_setzero_pd ();
+	__m128d vQ1 = _mm_setzero_pd ();
+	// two vectors in each iteration, so additions are not limited by their latency
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128d v0 = _mm_loadu_pd (data + i);
+		__m128d v1 = _mm_loadu_pd (data + i + 2);
+		// min/max returns second operand if any of operands is NaN - so NaN are ignored
+		vMin = _mm_min_pd (v0, _mm_min_pd (v1, vMin));
+		vMax = _mm_max_pd (v0, _mm_max_pd (v1, vMax));
+		__m128d vOrd0 = _mm_cmpord_pd (v0, v0);
+		__m128d vOrd1 = _mm_cmpord_pd (v1, v1);
+		nanCount += 4 - __builtin_popcount (_mm_movemask_pd (vOrd0) | (_mm_movemask_pd (vOrd1) << 2));
+		vSum0 = _mm_add_pd (vSum0, _mm_and_pd (v0, vOrd0));
+		vSum1 = _mm_add_pd (vSum1, _mm_and_pd (v1, vOrd1));
+		if (sq)
+		{
+			__m128d d0 = _mm_and_pd (_mm_sub_pd (v0, vShift), vOrd0);
+			__m128d d1 = _mm_and_pd (_mm_sub_pd (v1, vShift), vOrd1);
+			vD0 = _mm_add_pd (vD0, d0);
+			vD1 = _mm_add_pd (vD1, d1);
+			vQ0 = _mm_add_pd (vQ0, _mm_mul_pd (d0, d0));
+			vQ1 = _mm_add_pd (vQ1, _mm_mul_pd (d1, d1));
+		}
+	}
+	double lanes[2];
+	_mm_storeu_pd (lanes, vMin);
+	for (int j = 0; j < 2; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_pd (lanes, vMax);
+	for (int j = 0; j < 2; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	tSum = laneSumPd (_mm_add_pd (vSum0, vSum1));
+	sD = laneSumPd (_mm_add_pd (vD0, vD1));
+	sQ = laneSumPd (_mm_add_pd (vQ0, vQ1));
+#endif
+	for (; i < n; i++)
+	{
+		double tD = data[i];
+		if (!(tD == tD))
+		{
+			nanCount++;
+			continue;
+		}
+		tSum += tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		if (sq)
+		{
+			double d = tD - shift;
+			sD += d;
+			sQ += d * d;
+		}
+	}
+	if (sq && n > nanCount)
+		addMoments (n - nanCount, tSum, sQ - sD * sD / (n - nanCount));
+	sum += tSum;
+	updateMinMax (tMin, tMax);
+	count += n - nanCount;
+	return n;
+}
+
+#ifdef PIXELSTAT_SIMD
+template <bool sq> bool PixelStatistics::kernelNoNaN (const float *data, size_t n)
+{
+	size_t i = 0;
+	double tMin = min;
+	double tMax = max;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	__m128 vMin = _mm_set1_ps (INFINITY);
+	__m128 vMax = _mm_set1_ps (-INFINITY);
+	__m128d vShift = _mm_set1_pd (shift);
+	__m128d vDL = _mm_setzero_pd ();
+	__m128d vDH = _mm_setzero_pd ();
+	__m128d vQL = _mm_setzero_pd ();
+	__m128d vQH = _mm_setzero_pd ();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 v = _mm_loadu_ps (data + i);
+		vMin = _mm_min_ps (v, vMin);
+		vMax = _mm_max_ps (v, vMax);
+		__m128d dL = _mm_cvtps_pd (v);
+		__m128d dH = _mm_cvtps_pd (_mm_movehl_ps (v, v));
+		if (sq)
+		{
+			dL = _mm_sub_pd (dL, vShift);
+			dH = _mm_sub_pd (dH, vShift);
+			vQL = _mm_add_pd (vQL, _mm_mul_pd (dL, dL));
+			vQH = _mm_add_pd (vQH, _mm_mul_pd (dH, dH));
+		}
+		vDL = _mm_add_pd (vDL, dL);
+		vDH = _mm_add_pd (vDH, dH);
+	}
+	float lanes[4];
+	_mm_storeu_ps (lanes, vMin);
+	for (int j = 0; j < 4; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_ps (lanes, vMax);
+	for (int j = 0; j < 4; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	double sD = laneSumPd (_mm_add_pd (vDL, vDH));
+	double sQ = laneSumPd (_mm_add_pd (vQL, vQH));
+	for (; i < n; i++)
+	{
+		float tD = data[i];
+		double d = tD - shift;
+		sD += d;
+		sQ += d * d;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+	}
+	if (!(sD == sD))
+		return false;
+	if (sq)
+		addMoments (n, shift * n + sD, sQ - sD * sD / n);
+	sum += shift * n + sD;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return true;
+}
+
+template <bool sq> bool PixelStatistics::kernelNoNaN (const double *data, size_t n)
+{
+	size_t i = 0;
+	double tMin = min;
+	double tMax = max;
+	// sums of deviations from shift and of their squares
+	double shift = sq ? getShift (data, n) : 0;
+	__m128d vMin = _mm_set1_pd (INFINITY);
+	__m128d vMax = _mm_set1_pd (-INFINITY);
+	__m128d vShift = _mm_set1_pd (shift);
+	__m128d vD0 = _mm_setzero_pd ();
+	__m128d vD1 = _mm_setzero_pd ();
+	__m128d vQ0 = _mm_setzero_pd ();
+	__m128d vQ1 = _mm_setzero_pd ();
+	// two vectors in each iteration, so additions are not limited by their latency
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128d d0 = _mm_loadu_pd (data + i);
+		__m128d d1 = _mm_loadu_pd (data + i + 2);
+		vMin = _mm_min_pd (d0, _mm_min_pd (d1, vMin));
+		vMax = _mm_max_pd (d0, _mm_max_pd (d1, vMax));
+		if (sq)
+		{
+			d0 = _mm_sub_pd (d0, vShift);
+			d1 = _mm_sub_pd (d1, vShift);
+			vQ0 = _mm_add_pd (vQ0, _mm_mul_pd (d0, d0));
+			vQ1 = _mm_add_pd (vQ1, _mm_mul_pd (d1, d1));
+		}
+		vD0 = _mm_add_pd (vD0, d0);
+		vD1 = _mm_add_pd (vD1, d1);
+	}
+	double lanes[2];
+	_mm_storeu_pd (lanes, vMin);
+	for (int j = 0; j < 2; j++)
+		if (lanes[j] < tMin)
+			tMin = lanes[j];
+	_mm_storeu_pd (lanes, vMax);
+	for (int j = 0; j < 2; j++)
+		if (lanes[j] > tMax)
+			tMax = lanes[j];
+	double sD = laneSumPd (_mm_add_pd (vD0, vD1));
+	double sQ = laneSumPd (_mm_add_pd (vQ0, vQ1));
+	for (; i < n; i++)
+	{
+		double tD = data[i];
+		double d = tD - shift;
+		sD += d;
+		sQ += d * d;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+	}
+	if (!(sD == sD))
+		return false;
+	if (sq)
+		addMoments (n, shift * n + sD, sQ - sD * sD / n);
+	sum += shift * n + sD;
+	updateMinMax (tMin, tMax);
+	count += n;
+	return true;
+}
+#endif
@@ -0,0 +1,159 @@
+/*
+ * HEALPix based spatial index.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "spatialindex.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <libnova/libnova.h>
+
+using namespace rts2core;
+
+static double separation (double ra1, double dec1, double ra2, double dec2)
+{
+	struct ln_equ_posn p1, p2;
+	p1.ra = ra1;
+	p1.dec = dec1;
+	p2.ra = ra2;
+	p2.dec = dec2;
+	return ln_get_angular_separation (&p1, &p2);
+}
+
+static void addRange (std::vector <pixrange_t> &ranges, int64_t from, int64_t to)
+{
+	if (!ranges.empty () && ranges.back ().second + 1 >= from)
+		ranges.back ().second = to;
+	else
+		ranges.push_back (pixrange_t (from, to));
+}
+
+// descend to children of pixel which might intersect with the cone
+static void queryPixel (int order, int64_t pix, int maxOrder, double ra, double dec, double radius, std::vector <pixrange_t> &ranges)
+{
+	double pra, pdec;
+	healpix_pix2ang_nest (order, pix, &pra, &pdec);
+	// slightly enlarge pixel radius to be on the safe side with rounding errors
+	double pixrad = healpix_max_pixrad (order) * 1.01 + 1e-9;
+	double dist = separation (ra, dec, pra, pdec);
+	if (dist > radius + pixrad)
+		return;
+
+	if (order == maxOrder || dist + pixrad <= radius)
+	{
+		int shift = 2 * (HEALPIX_TARGET_ORDER - order);
+		addRange (ranges, pix << shift, ((pix + 1) << shift) - 1);
+		return;
+	}
+
+	for (int i = 0; i < 4; i++)
+		queryPixel (order + 1, pix * 4 + i, maxOrder, ra, dec, radius, ranges);
+}
+
+void rts2core::healpixQueryDisc (double ra, double dec, double radius, std::vector <pixrange_t> &ranges)
+{
+	ranges.clear ();
+
+	// cone covering most of the sky - return everything
+	if (radius >= 90)
+	{
+		ranges.push_back (pixrange_t (0, healpix_npix (HEALPIX_TARGET_ORDER) - 1));
+		return;
+	}
+
+	// finest order with pixels comparable to cone size
+	int maxOrder = 0;
+	while (maxOrder < HEALPIX_TARGET_ORDER && healpix_max_pixrad (maxOrder + 1) > radius / 2.0)
+		maxOrder++;
+
+	for (int64_t face = 0; face < 12; face++)
+		queryPixel (0, face, maxOrder, ra, dec, radius, ranges);
+}
+
+void rts2core::healpixRangesSQL (std::ostream &_os, const char *column, std::vector <pixrange_t> &ranges)
+{
+	_os << "(";
+	for (std::vector <pixrange_t>::iterator iter = ranges.begin (); iter != ranges.end (); iter++)
+	{
+		if (iter != ranges.begin ())
+			_os << " OR ";
+		_os << column << " BETWEEN " << iter->first << " AND " << iter->second;
+	}
+	_os << ")";
+}
+
+SpatialIndex::SpatialIndex ()
+{
+	sorted = true;
+}
+
+void SpatialIndex::clear ()
+{
+	entries.clear ();
+	sorted = true;
+}
+
+void SpatialIndex::add (int id, double ra, double dec)
+{
+	if (isnan (ra) || isnan (dec))
+		return;
+	Entry e;
+	e.pix = healpix_ang2pix_nest (HEALPIX_TARGET_ORDER, ra, dec);
+	e.id = id;
+	e.ra = ra;
+	e.dec = dec;
+	entries.push_back (e);
+	sorted = false;
+}
+
+void SpatialIndex::build ()
+{
+	if (sorted)
+		return;
+	std::sort (entries.begin (), entries.end ());
+	sorted = true;
+}
+
+size_t SpatialIndex::cone (double ra, double dec, double radius, std::vector <int> &ids)
+{
+	build ();
+
+	std::vector <pixrange_t> ranges;
+	healpixQueryDisc (ra, dec, radius, ranges);
+
+	size_t examined = 0;
+
+	Entry key;
+	key.id = INT_MIN;
+	std::vector <Entry>::iterator iter = entries.begin ();
+
+	for (std::vector <pixrange_t>::iterator riter = ranges.begin (); riter != ranges.end (); riter++)
+	{
+		key.pix = riter->first;
+		// ranges are sorted, so search can continue from the last position
+		iter = std::lower_bound (iter, entries.end (), key);
+		for (; iter != entries.end () && iter->pix <= riter->second; iter++)
+		{
+			examined++;
+			if (separation (ra, dec, iter->ra, iter->dec) < radius)
+				ids.push_back (iter->id);
+		}
+	}
+	return examined;
+}
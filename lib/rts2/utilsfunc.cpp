@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 double random_num ()
@@ -406,6 +407,14 @@ double getNow ()
 	return infot.tv_sec + (double) infot.tv_usec / USEC_SEC;
 }
 
+double getCPUTime ()
+{
+	struct timespec ts;
+	if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts))
+		return NAN;
+	return ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
 const char * multiWCS (const char *name, char multi_wcs)
 {
 	static char ret[50];
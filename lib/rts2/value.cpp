@@ -25,6 +25,10 @@
 #include "block.h"
 #include "configuration.h"
 #include "value.h"
+#include "valuearray.h"
+#include "valueminmax.h"
+#include "valuerectangle.h"
+#include "valuestat.h"
 #include "timestamp.h"
 
 #include "radecparser.h"
@@ -962,3 +966,66 @@ Value *newValue (int rts2Type, std::string name, std::string desc)
 	logStream (MESSAGE_ERROR) << "unknow value name: " << name << " type: " << rts2Type << sendLog;
 	return NULL;
 }
+
+rts2core::Value *duplicateValue (rts2core::Value * old_value, bool withVal)
+{
+	rts2core::Value *dup_val = NULL;
+	switch (old_value->getValueExtType ())
+	{
+		case 0:
+			dup_val = newValue (old_value->getFlags (), old_value->getName (), old_value->getDescription ());
+			// do some extra settings
+			switch (old_value->getValueType ())
+			{
+				case RTS2_VALUE_SELECTION:
+					((rts2core::ValueSelection *) dup_val)->copySel ((rts2core::ValueSelection *) old_value);
+					break;
+			}
+			if (withVal)
+				((rts2core::ValueString *) dup_val)->setFromValue (old_value);
+			break;
+		case RTS2_VALUE_STAT:
+			dup_val = new rts2core::ValueDoubleStat (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits ());
+			break;
+		case RTS2_VALUE_MMAX:
+			dup_val = new rts2core::ValueDoubleMinMax (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits ());
+			((rts2core::ValueDoubleMinMax *) dup_val)->copyMinMax ((rts2core::ValueDoubleMinMax *) old_value);
+			break;
+		case RTS2_VALUE_RECTANGLE:
+			dup_val = new rts2core::ValueRectangle (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
+			break;
+		case RTS2_VALUE_ARRAY:
+			switch (old_value->getValueBaseType ())
+			{
+				case RTS2_VALUE_STRING:
+					dup_val = new rts2core::StringArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
+					break;
+				case RTS2_VALUE_DOUBLE:
+					dup_val = new rts2core::DoubleArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
+					break;
+				case RTS2_VALUE_TIME:
+					dup_val = new rts2core::TimeArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
+					break;
+				case RTS2_VALUE_INTEGER:
+					dup_val = new rts2core::IntegerArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
+					break;
+				case RTS2_VALUE_BOOL:
+					dup_val = new rts2core::BoolArray (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits (), old_value->getFlags ());
+					break;
+				default:
+					logStream (MESSAGE_ERROR) << "unknow array type: " << old_value->getValueBaseType () << sendLog;
+					break;
+			}
+			if (dup_val)
+				break;
+		case RTS2_VALUE_TIMESERIE:
+			dup_val = new rts2core::ValueDoubleTimeserie (old_value->getName (), old_value->getDescription (), old_value->getWriteToFits ());
+			break;
+		default:
+			logStream (MESSAGE_ERROR) << "unknow value type: " << old_value->getValueExtType () << sendLog;
+			return NULL;
+	}
+	if (withVal)
+		dup_val->setFromValue (old_value);
+	return dup_val;
+}
@@ -0,0 +1,143 @@
+/*
+ * Pool of worker threads for data parallel loops.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "workerpool.h"
+
+#include <unistd.h>
+
+using namespace rts2core;
+
+WorkerPool::WorkerPool (int threads)
+{
+	pthread_mutex_init (&mutex, NULL);
+	pthread_cond_init (&startCond, NULL);
+	pthread_cond_init (&doneCond, NULL);
+
+	job = NULL;
+	items = 0;
+	chunk = 1;
+	nextItem = 0;
+	generation = 0;
+	running = 0;
+	quit = false;
+
+	for (int i = 1; i < threads; i++)
+	{
+		pthread_t th;
+		if (pthread_create (&th, NULL, workerThread, this))
+			break;
+		workers.push_back (th);
+	}
+}
+
+WorkerPool::~WorkerPool ()
+{
+	pthread_mutex_lock (&mutex);
+	quit = true;
+	pthread_cond_broadcast (&startCond);
+	pthread_mutex_unlock (&mutex);
+
+	for (std::vector <pthread_t>::iterator iter = workers.begin (); iter != workers.end (); iter++)
+		pthread_join (*iter, NULL);
+
+	pthread_cond_destroy (&doneCond);
+	pthread_cond_destroy (&startCond);
+	pthread_mutex_destroy (&mutex);
+}
+
+void WorkerPool::run (WorkerJob *_job, size_t _items, size_t _chunk)
+{
+	if (_items == 0)
+		return;
+	if (_chunk == 0)
+		_chunk = 1;
+
+	// no need to wake up threads for a single chunk
+	if (workers.empty () || _items <= _chunk)
+	{
+		for (size_t i = 0; i < _items; i++)
+			_job->processItem (i);
+		return;
+	}
+
+	pthread_mutex_lock (&mutex);
+	job = _job;
+	items = _items;
+	chunk = _chunk;
+	nextItem = 0;
+	running = workers.size ();
+	generation++;
+	pthread_cond_broadcast (&startCond);
+	pthread_mutex_unlock (&mutex);
+
+	processItems ();
+
+	pthread_mutex_lock (&mutex);
+	while (running > 0)
+		pthread_cond_wait (&doneCond, &mutex);
+	job = NULL;
+	pthread_mutex_unlock (&mutex);
+}
+
+int WorkerPool::getOnlineCPUs ()
+{
+	long n = sysconf (_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
+
+void WorkerPool::processItems ()
+{
+	while (true)
+	{
+		size_t i = __sync_fetch_and_add (&nextItem, chunk);
+		if (i >= items)
+			return;
+		size_t e = i + chunk;
+		if (e > items)
+			e = items;
+		for (; i < e; i++)
+			job->processItem (i);
+	}
+}
+
+void *WorkerPool::workerThread (void *arg)
+{
+	WorkerPool *pool = (WorkerPool *) arg;
+	unsigned int seen = 0;
+
+	pthread_mutex_lock (&pool->mutex);
+	while (true)
+	{
+		while (!pool->quit && pool->generation == seen)
+			pthread_cond_wait (&pool->startCond, &pool->mutex);
+		if (pool->quit)
+			break;
+		seen = pool->generation;
+		pthread_mutex_unlock (&pool->mutex);
+
+		pool->processItems ();
+
+		pthread_mutex_lock (&pool->mutex);
+		pool->running--;
+		if (pool->running == 0)
+			pthread_cond_signal (&pool->doneCond);
+	}
+	pthread_mutex_unlock (&pool->mutex);
+	return NULL;
+}
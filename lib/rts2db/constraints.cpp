@@ -21,6 +21,8 @@
 #include "utilsfunc.h"
 #include "configuration.h"
 
+#include <pthread.h>
+
 #ifndef RTS2_HAVE_DECL_LN_GET_ALT_FROM_AIRMASS
 double ln_get_alt_from_airmass (double X, double airmass_scale)
 {
@@ -205,6 +207,55 @@ bool ConstraintInterval::isBetween (double val)
 	return false;
 }
 
+// maximal changes of constraint values in degrees per day, with margin for
+// parallax and motion of the Moon
+#define RATE_HOUR_ANGLE        360.9856
+#define RATE_ALTITUDE          380.0
+#define RATE_LUNAR_DISTANCE    25.0
+#define RATE_SOLAR_DISTANCE    1.5
+#define RATE_LUNAR_PHASE       20.0
+
+/**
+ * Returns time before which value, which changes at most by rate per day,
+ * cannot cross any of the interval boundaries. Returns nan if there is no
+ * boundary, 0 if rate is not known.
+ */
+template <typename iter_t> static double nextBoundary (iter_t begin, iter_t end, double val, double JD, double rate)
+{
+	if (isnan (rate))
+		return 0;
+	double d = INFINITY;
+	for (iter_t iter = begin; iter != end; iter++)
+	{
+		if (!isnan (iter->getLower ()) && fabs (val - iter->getLower ()) < d)
+			d = fabs (val - iter->getLower ());
+		if (!isnan (iter->getUpper ()) && fabs (val - iter->getUpper ()) < d)
+			d = fabs (val - iter->getUpper ());
+	}
+	if (isinf (d))
+		return NAN;
+	return JD + d / rate;
+}
+
+// values of targets which move on the sky do not have known rate
+static double targetRate (Target *tar, double rate)
+{
+	return tar->hasConstantPosition () ? rate : NAN;
+}
+
+bool ConstraintInterval::satisfyValue (double val, double JD, double rate, double *nextJD)
+{
+	if (isnan (val))
+	{
+		if (nextJD)
+			*nextJD = NAN;
+		return true;
+	}
+	if (nextJD)
+		*nextJD = nextBoundary (intervals.begin (), intervals.end (), val, JD, rate);
+	return isBetween (val);
+}
+
 // interval functions
 
 // reverse intervals. Intervals must be ordered
@@ -272,13 +323,16 @@ void Constraint::getSatisfiedIntervals (Target *tar, time_t from, time_t to, int
 {
 	double vf = NAN;
 
+	double from_JD = ln_get_julian_from_timet (&from);
 	double to_JD = ln_get_julian_from_timet (&to);
 
+	TargetEphemeris *eph = tar->getEphemeris (from_JD, to_JD);
+
 	double t;
-	for (t = ln_get_julian_from_timet (&from); t < to_JD;)
+	for (t = from_JD; t < to_JD;)
 	{
 		double nextJD;
-		if (satisfy (tar, t, &nextJD))
+		if (eph ? satisfyCached (tar, eph, t, &nextJD) : satisfy (tar, t, &nextJD))
 		{
 			if (isnan (vf))
 				vf = t;
@@ -292,15 +346,14 @@ void Constraint::getSatisfiedIntervals (Target *tar, time_t from, time_t to, int
 		}
 		if (isnan (nextJD))
 			t = to_JD;
-		else if (nextJD > 0)
-			t = nextJD;
 		else
-			t += step / 86400.0;
+			t = nextJD > t + step / 86400.0 ? nextJD : t + step / 86400.0;
 	}
 	if (!isnan (vf))
 	{
 		ln_get_timet_from_julian (vf, &from);
-		ln_get_timet_from_julian (t, &to);
+		// hint can point past the end of the interval
+		ln_get_timet_from_julian (t < to_JD ? t : to_JD, &to);
 		ret.push_back (std::pair <time_t, time_t> (from, to));
 	}
 }
@@ -394,7 +447,19 @@ void ConstraintTime::load (xmlNodePtr cons)
 bool ConstraintTime::satisfy (Target *target, double JD, double *nextJD)
 {
 	if (nextJD)
-		*nextJD = 0;
+	{
+		// satisfaction changes at the first boundary not before JD
+		*nextJD = NAN;
+		for (std::list <ConstraintDoubleInterval>::iterator iter = intervals.begin (); iter != intervals.end (); iter++)
+		{
+			double l = iter->getLower ();
+			double u = iter->getUpper ();
+			if (!isnan (l) && l >= JD && (isnan (*nextJD) || l < *nextJD))
+				*nextJD = l;
+			if (!isnan (u) && u >= JD && (isnan (*nextJD) || u < *nextJD))
+				*nextJD = u;
+		}
+	}
 	return isBetween (JD);
 }
 
@@ -416,16 +481,29 @@ void ConstraintTime::getSatisfiedIntervals (Target *tar, time_t from, time_t to,
 
 bool ConstraintAirmass::satisfy (Target *tar, double JD, double *nextJD)
 {
-	double am = tar->getAirmass (JD);
-	if (isnan (am))
+	return satisfyAirmass (tar, tar->getAirmass (JD), JD, nextJD);
+}
+
+bool ConstraintAirmass::satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD)
+{
+	return satisfyAirmass (tar, eph->getAirmass (JD), JD, nextJD);
+}
+
+bool ConstraintAirmass::satisfyAirmass (Target *tar, double airmass, double JD, double *nextJD)
+{
+	bool ret = satisfyValue (airmass, JD, NAN, nextJD);
+	// airmass does not change linearly, compare altitudes of boundaries
+	if (nextJD && *nextJD == 0 && tar->hasConstantPosition ())
 	{
-		if (nextJD)
-			*nextJD = NAN;
-		return true;
+		double alt = ln_get_alt_from_airmass (airmass, 750.0);
+		if (!isnan (alt))
+		{
+			std::vector <ConstraintDoubleInterval> ac;
+			getAltitudeIntervals (ac);
+			*nextJD = nextBoundary (ac.begin (), ac.end (), alt, JD, RATE_ALTITUDE);
+		}
 	}
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (am);
+	return ret;
 }
 
 void ConstraintAirmass::getAltitudeIntervals (std::vector <ConstraintDoubleInterval> &ac)
@@ -444,16 +522,12 @@ void ConstraintAirmass::getAltitudeIntervals (std::vector <ConstraintDoubleInter
 
 bool ConstraintZenithDistance::satisfy (Target *tar, double JD, double *nextJD)
 {
-	double zd = tar->getZenitDistance (JD);
-	if (isnan (zd))
-	{
-		if (nextJD)
-			*nextJD = NAN;
-		return true;
-	}
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween(zd);
+	return satisfyValue (tar->getZenitDistance (JD), JD, targetRate (tar, RATE_ALTITUDE), nextJD);
+}
+
+bool ConstraintZenithDistance::satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD)
+{
+	return satisfyValue (eph->getZenitDistance (JD), JD, targetRate (tar, RATE_ALTITUDE), nextJD);
 }
 
 void ConstraintZenithDistance::getAltitudeIntervals (std::vector <ConstraintDoubleInterval> &ac)
@@ -472,30 +546,35 @@ void ConstraintZenithDistance::getAltitudeIntervals (std::vector <ConstraintDoub
 
 bool ConstraintHA::satisfy (Target *tar, double JD, double *nextJD)
 {
-	double ha = tar->getHourAngle (JD);
-	if (isnan (ha))
+	return satisfyHA (tar, tar->getHourAngle (JD), JD, nextJD);
+}
+
+bool ConstraintHA::satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD)
+{
+	return satisfyHA (tar, eph->getHourAngle (JD), JD, nextJD);
+}
+
+bool ConstraintHA::satisfyHA (Target *tar, double ha, double JD, double *nextJD)
+{
+	bool ret = satisfyValue (ha, JD, targetRate (tar, RATE_HOUR_ANGLE), nextJD);
+	// hour angle wraps from 180 to -180
+	if (nextJD && *nextJD > 0)
 	{
-	 	if (nextJD)
-			*nextJD = NAN;
-		return true;
+		double wrap = JD + (180 - ha) / RATE_HOUR_ANGLE;
+		if (wrap < *nextJD)
+			*nextJD = wrap;
 	}
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (ha);
+	return ret;
 }
 
 bool ConstraintLunarDistance::satisfy (Target *tar, double JD, double *nextJD)
 {
-	double ld = tar->getLunarDistance (JD);
-	if (isnan (ld))
-	{
-		if (nextJD)
-			*nextJD = NAN;
-		return true;
-	}
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (ld);
+	return satisfyValue (tar->getLunarDistance (JD), JD, targetRate (tar, RATE_LUNAR_DISTANCE), nextJD);
+}
+
+bool ConstraintLunarDistance::satisfyCached (Target *tar, TargetEphemeris *eph, double JD, double *nextJD)
+{
+	return satisfyValue (eph->getLunarDistance (JD), JD, targetRate (tar, RATE_LUNAR_DISTANCE), nextJD);
 }
 
 void ConstraintLunarDistance::getSatisfiedIntervals (Target *tar, time_t from, time_t to, int step, interval_arr_t &ret)
@@ -517,30 +596,17 @@ bool ConstraintLunarAltitude::satisfy (Target *tar, double JD, double *nextJD)
 	struct ln_hrz_posn hrz_lun;
 	ln_get_lunar_equ_coords (JD, &eq_lun);
 	ln_get_hrz_from_equ (&eq_lun, rts2core::Configuration::instance ()->getObserver (), JD, &hrz_lun);
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (hrz_lun.alt);
+	return satisfyValue (hrz_lun.alt, JD, RATE_ALTITUDE, nextJD);
 }
 
 bool ConstraintLunarPhase::satisfy (Target *tar, double JD, double *nextJD)
 {
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (ln_get_lunar_phase (JD));
+	return satisfyValue (ln_get_lunar_phase (JD), JD, RATE_LUNAR_PHASE, nextJD);
 }
 
 bool ConstraintSolarDistance::satisfy (Target *tar, double JD, double *nextJD)
 {
-	double sd = tar->getSolarDistance (JD);
-	if (isnan (sd))
-	{
-		if (nextJD)
-		  	*nextJD = NAN;
-		return true;
-	}
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (sd);
+	return satisfyValue (tar->getSolarDistance (JD), JD, targetRate (tar, RATE_SOLAR_DISTANCE), nextJD);
 }
 
 bool ConstraintSunAltitude::satisfy (Target *tar, double JD, double *nextJD)
@@ -549,9 +615,7 @@ bool ConstraintSunAltitude::satisfy (Target *tar, double JD, double *nextJD)
 	struct ln_hrz_posn hrz_sun;
 	ln_get_solar_equ_coords (JD, &eq_sun);
 	ln_get_hrz_from_equ (&eq_sun, rts2core::Configuration::instance ()->getObserver (), JD, &hrz_sun);
-	if (nextJD)
-		*nextJD = 0;
-	return isBetween (hrz_sun.alt);
+	return satisfyValue (hrz_sun.alt, JD, RATE_ALTITUDE, nextJD);
 }
 
 void ConstraintMaxRepeat::load (xmlNodePtr cons)
@@ -691,21 +755,33 @@ size_t Constraints::getTimeConstraints (std::map <std::string, ConstraintPtr> &c
 	return i;
 }
 
-bool Constraints::satisfy (Target *tar, double JD)
+bool Constraints::satisfy (Target *tar, double JD, double *nextJD)
 {
+	TargetEphemeris *eph = tar->getLoadedEphemeris (JD);
+	if (nextJD)
+		*nextJD = NAN;
 	for (Constraints::iterator iter = begin (); iter != end (); iter++)
 	{
-		if (!(iter->second->satisfy (tar, JD, NULL)))
+		double next;
+		if (!(eph ? iter->second->satisfyCached (tar, eph, JD, nextJD ? &next : NULL) : iter->second->satisfy (tar, JD, nextJD ? &next : NULL)))
+		{
+			if (nextJD)
+				*nextJD = 0;
 			return false;
+		}
+		// the earliest change; 0 if time of some change is not known
+		if (nextJD && !isnan (next) && (isnan (*nextJD) || next < *nextJD))
+			*nextJD = next;
 	}
 	return true;
 }
 
 size_t Constraints::getViolated (Target *tar, double JD, ConstraintsList &violated)
 {
+	TargetEphemeris *eph = tar->getLoadedEphemeris (JD);
 	for (Constraints::iterator iter = begin (); iter != end (); iter++)
 	{
-		if (!(iter->second->satisfy (tar, JD, NULL)))
+		if (!(eph ? iter->second->satisfyCached (tar, eph, JD, NULL) : iter->second->satisfy (tar, JD, NULL)))
 			violated.push_back (iter->second);
 	}
 	return violated.size ();
@@ -713,9 +789,10 @@ size_t Constraints::getViolated (Target *tar, double JD, ConstraintsList &violat
 
 size_t Constraints::getSatisfied (Target *tar, double JD, ConstraintsList &satisfied)
 {
+	TargetEphemeris *eph = tar->getLoadedEphemeris (JD);
 	for (Constraints::iterator iter = begin (); iter != end (); iter++)
 	{
-		if (iter->second->satisfy (tar, JD, NULL))
+		if (eph ? iter->second->satisfyCached (tar, eph, JD, NULL) : iter->second->satisfy (tar, JD, NULL))
 			satisfied.push_back (iter->second);
 	}
 	return satisfied.size ();
@@ -745,9 +822,12 @@ double Constraints::getSatisfiedDuration (Target *tar, double from, double to, d
 	
 	double t;
 	double from_JD = ln_get_julian_from_timet (&fti);
-	for (t = from_JD; t < to_JD; t += step / 86400.0)
+	// build ephemeris for the whole interval; satisfy will then use it
+	tar->getEphemeris (from_JD, to_JD);
+	for (t = from_JD; t < to_JD;)
 	{
-		if (!satisfy (tar, t))
+		double nextJD;
+		if (!satisfy (tar, t, &nextJD))
 		{
 			if (t == from_JD)
 			{
@@ -757,6 +837,10 @@ double Constraints::getSatisfiedDuration (Target *tar, double from, double to, d
 		  	ln_get_timet_from_julian (t, &ret);
 			return ret;
 		}
+		// constraints cannot be violated before nextJD
+		if (isnan (nextJD))
+			break;
+		t = nextJD > t + step / 86400.0 ? nextJD : t + step / 86400.0;
 	}
 	return INFINITY;
 }
@@ -908,6 +992,9 @@ static Constraints *masterCons = NULL;
 static std::map <int, Constraints *> constraintsCache;
 static rts2core::ConnNotify *watchConn = NULL;
 
+// protects master constraints and cache, which can be accessed from worker threads
+static pthread_mutex_t constraintsMutex = PTHREAD_MUTEX_INITIALIZER;
+
 void ConstraintsList::printJSON (std::ostream &os)
 {
 	os << "[";
@@ -929,29 +1016,56 @@ MasterConstraints::~MasterConstraints ()
 
 Constraints & MasterConstraints::getConstraint ()
 {
-	if (masterCons)
-		return *masterCons;
-	masterCons = new Constraints ();
-	masterCons->load (rts2core::Configuration::instance ()->getMasterConstraintFile ());
+	pthread_mutex_lock (&constraintsMutex);
+	if (masterCons == NULL)
+	{
+		Constraints *cons = new Constraints ();
+		try
+		{
+			cons->load (rts2core::Configuration::instance ()->getMasterConstraintFile ());
+		}
+		catch (...)
+		{
+			delete cons;
+			pthread_mutex_unlock (&constraintsMutex);
+			throw;
+		}
+		masterCons = cons;
+	}
+	pthread_mutex_unlock (&constraintsMutex);
 	return *masterCons;
 }
 
 Constraints * MasterConstraints::getTargetConstraints (int tar_id)
 {
+	Constraints *ret = NULL;
+	pthread_mutex_lock (&constraintsMutex);
 	std::map <int, Constraints *>::iterator ci = constraintsCache.find (tar_id);
-	if (ci == constraintsCache.end ())
-	{
-		return NULL;
-	}
-	return ci->second;
+	if (ci != constraintsCache.end ())
+		ret = ci->second;
+	pthread_mutex_unlock (&constraintsMutex);
+	return ret;
 }
 
-void MasterConstraints::setTargetConstraints (int tar_id, Constraints * _constraints)
+Constraints * MasterConstraints::setTargetConstraints (int tar_id, Constraints * _constraints)
 {
-	Constraints *old = getTargetConstraints (tar_id);
-	if (old)
-		delete old;
+	pthread_mutex_lock (&constraintsMutex);
+	std::map <int, Constraints *>::iterator ci = constraintsCache.find (tar_id);
+	if (ci != constraintsCache.end () && ci->second != NULL)
+	{
+		// constraints were loaded by other thread, which might use them
+		if (_constraints != NULL)
+		{
+			delete _constraints;
+			_constraints = ci->second;
+			pthread_mutex_unlock (&constraintsMutex);
+			return _constraints;
+		}
+		delete ci->second;
+	}
 	constraintsCache[tar_id] = _constraints;
+	pthread_mutex_unlock (&constraintsMutex);
+	return _constraints;
 }
 
 void MasterConstraints::setNotifyConnection (rts2core::ConnNotify *_watchConn)
@@ -966,7 +1080,9 @@ rts2core::ConnNotify *MasterConstraints::getNotifyConnection ()
 
 void MasterConstraints::clearCache ()
 {
+	pthread_mutex_lock (&constraintsMutex);
 	for (std::map <int, Constraints *>::iterator ci = constraintsCache.begin (); ci != constraintsCache.end (); ci++)
 		delete ci->second;
 	constraintsCache.clear ();
+	pthread_mutex_unlock (&constraintsMutex);
 }
@@ -0,0 +1,203 @@
+/*
+ * Sampled target ephemeris for a night.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "rts2db/targetephemeris.h"
+#include "rts2db/target.h"
+
+#include <math.h>
+#include <pthread.h>
+
+using namespace rts2db;
+
+// lunar positions shared by ephemerides with the same sampling
+static double lunarFrom = NAN;
+static double lunarStep = NAN;
+static std::vector <struct ln_equ_posn> lunarPositions;
+static pthread_mutex_t lunarMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// copy n lunar positions, extending shared cache as needed
+static void getLunarPositions (double from, double step, size_t n, std::vector <struct ln_equ_posn> &positions)
+{
+	pthread_mutex_lock (&lunarMutex);
+	if (from != lunarFrom || step != lunarStep)
+	{
+		lunarFrom = from;
+		lunarStep = step;
+		lunarPositions.clear ();
+	}
+	while (lunarPositions.size () < n)
+	{
+		struct ln_equ_posn moon;
+		ln_get_lunar_equ_coords (from + lunarPositions.size () * step, &moon);
+		lunarPositions.push_back (moon);
+	}
+	positions.assign (lunarPositions.begin (), lunarPositions.begin () + n);
+	pthread_mutex_unlock (&lunarMutex);
+}
+
+// interpolate angle, taking care of wrap around period
+static double interpolateAngle (double a0, double a1, double frac, double period)
+{
+	double d = a1 - a0;
+	if (d > period / 2.0)
+		d -= period;
+	else if (d < -period / 2.0)
+		d += period;
+	return a0 + frac * d;
+}
+
+TargetEphemeris::TargetEphemeris (Target *_target, double _from, double _to, double _step)
+{
+	target = _target;
+	from = _from;
+	step = _step / 86400.0;
+
+	size_t n = (size_t) ceil ((_to - _from) / step) + 1;
+	to = from + (n - 1) * step;
+
+	alt.resize (n);
+	az.resize (n);
+	ha.resize (n);
+	lunarDistance.resize (n);
+
+	std::vector <struct ln_equ_posn> moon;
+	getLunarPositions (from, step, n, moon);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		double JD = from + i * step;
+		struct ln_hrz_posn hrz;
+		target->getAltAz (&hrz, JD);
+		alt[i] = hrz.alt;
+		az[i] = hrz.az;
+		ha[i] = target->getHourAngle (JD);
+		lunarDistance[i] = target->getDistance (&(moon[i]), JD);
+	}
+}
+
+void TargetEphemeris::getAltAz (struct ln_hrz_posn *hrz, double JD)
+{
+	size_t i;
+	double frac;
+	if (!getIndex (JD, i, frac))
+	{
+		target->getAltAz (hrz, JD);
+		return;
+	}
+	hrz->alt = alt[i] + frac * (alt[i + 1] - alt[i]);
+	hrz->az = ln_range_degrees (interpolateAngle (az[i], az[i + 1], frac, 360));
+}
+
+double TargetEphemeris::getAltitude (double JD)
+{
+	size_t i;
+	double frac;
+	if (!getIndex (JD, i, frac))
+	{
+		struct ln_hrz_posn hrz;
+		target->getAltAz (&hrz, JD);
+		return hrz.alt;
+	}
+	return alt[i] + frac * (alt[i + 1] - alt[i]);
+}
+
+double TargetEphemeris::getAirmass (double JD)
+{
+	return ln_get_airmass (getAltitude (JD), target->getAirmassScale ());
+}
+
+double TargetEphemeris::getZenitDistance (double JD)
+{
+	return 90.0 - getAltitude (JD);
+}
+
+double TargetEphemeris::getHourAngle (double JD)
+{
+	size_t i;
+	double frac;
+	if (!getIndex (JD, i, frac))
+		return target->getHourAngle (JD);
+	double ret = interpolateAngle (ha[i], ha[i + 1], frac, 360);
+	if (ret > 180)
+		ret -= 360;
+	else if (ret <= -180)
+		ret += 360;
+	return ret;
+}
+
+double TargetEphemeris::getLunarDistance (double JD)
+{
+	size_t i;
+	double frac;
+	if (!getIndex (JD, i, frac))
+		return target->getLunarDistance (JD);
+	return lunarDistance[i] + frac * (lunarDistance[i + 1] - lunarDistance[i]);
+}
+
+bool TargetEphemeris::isAboveHorizon (double JD)
+{
+	struct ln_hrz_posn hrz;
+	getAltAz (&hrz, JD);
+	return target->isAboveHorizon (&hrz);
+}
+
+void TargetEphemeris::getMinMaxAlt (double _start, double _end, double &_min, double &_max)
+{
+	size_t i, e;
+	double frac;
+	// Target::getMinMaxAlt does not calculate exact values for longer intervals
+	if ((_end - _start) >= 1.0 || !getIndex (_start, i, frac) || !getIndex (_end, e, frac))
+	{
+		target->getMinMaxAlt (_start, _end, _min, _max);
+		return;
+	}
+	_min = getAltitude (_start);
+	_max = _min;
+	double a = getAltitude (_end);
+	if (a < _min)
+		_min = a;
+	if (a > _max)
+		_max = a;
+	// samples inside interval
+	for (i++; i <= e; i++)
+	{
+		if (alt[i] < _min)
+			_min = alt[i];
+		if (alt[i] > _max)
+			_max = alt[i];
+	}
+}
+
+double TargetEphemeris::getNightStart (double JD, double lng)
+{
+	// JD starts at noon UT, local noon is shifted by longitude
+	return floor (JD + lng / 360.0) - lng / 360.0;
+}
+
+bool TargetEphemeris::getIndex (double JD, size_t &i, double &frac)
+{
+	if (!(JD >= from && JD <= to) || alt.size () < 2)
+		return false;
+	double p = (JD - from) / step;
+	i = (size_t) floor (p);
+	if (i >= alt.size () - 1)
+		i = alt.size () - 2;
+	frac = p - i;
+	return true;
+}
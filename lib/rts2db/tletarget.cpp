@@ -23,9 +23,6 @@
 #include "libnova_cpp.h"
 #include "rts2fits/image.h"
 
-#include "pluto/norad.h"
-#include "pluto/observe.h"
-
 using namespace rts2db;
 
 TLETarget::TLETarget (int in_tar_id, struct ln_lnlat_posn *in_obs, double in_altitude):Target (in_tar_id, in_obs, in_altitude)
@@ -43,65 +40,36 @@ void TLETarget::load ()
 		tle1 = tarInfo.substr (0, sub - 1);
 		tle2 = tarInfo.substr (sub + 1);
 
-		int ret = parse_elements (tle1.c_str (), tle2.c_str (), &tle);
+		int ret = propagator.load (tle1.c_str (), tle2.c_str ());
 		if (ret != 0)
 		{
 			throw rts2core::Error ("cannot parse TLE");
 		}
 
-		ephem = 1;
-		is_deep = select_ephemeris (&tle);
-
-		if (is_deep && (ephem == 1 || ephem == 2))
-			ephem += 2;    /* switch to an SDx */
-		if (!is_deep && (ephem == 3 || ephem == 4))
-			ephem -= 2;    /* switch to an SGx */
+		propagator.setObserver (ln_deg_to_rad (observer->lng), ln_deg_to_rad (observer->lat), obs_altitude);
 	}
 }
 
 void TLETarget::getPosition (struct ln_equ_posn *pos, double JD)
 {
-	double sat_params[N_SAT_PARAMS], observer_loc[3];
-	double t_since;
-	double sat_pos[3]; /* Satellite position vector */
 	double dist_to_satellite;
 
-	double r_s, r_c;
-
-	lat_alt_to_parallax (ln_deg_to_rad (observer->lat), obs_altitude * 1000, &r_s, &r_c);
+	if (!propagator.isLoaded ())
+		throw rts2core::Error ("TLE not loaded");
 
-	t_since = (JD - tle.epoch) * 1440.;
-	switch (ephem)
+	if (propagator.getPosition (JD, pos->ra, pos->dec, dist_to_satellite))
 	{
-		case 0:
-			SGP_init (sat_params, &tle);
-			SGP (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 1:
-			SGP4_init (sat_params, &tle);
-			SGP4 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 2:
-			SGP8_init (sat_params, &tle);
-			SGP8 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 3:
-			SDP4_init (sat_params, &tle);
-			SDP4 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 4:
-			SDP8_init (sat_params, &tle);
-			SDP8 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		default:
-			throw rts2core::Error ("invalid ephem");
+		pos->ra = pos->dec = NAN;
+		return;
 	}
 
-	get_satellite_ra_dec_delta (observer_loc, sat_pos, &(pos->ra), &(pos->dec), &dist_to_satellite);
+	pos->ra = ln_rad_to_deg (pos->ra);
+	pos->dec = ln_rad_to_deg (pos->dec);
 }
 
 int TLETarget::getRST (struct ln_rst_time *rst, double JD, double horizon)
 {
+	return propagator.getRST (JD, ln_deg_to_rad (horizon), rst->rise, rst->set, rst->transit);
 }
 
 void TLETarget::printExtra (Rts2InfoValStream & _os, double JD)
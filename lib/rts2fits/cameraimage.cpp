@@ -31,6 +31,12 @@ CameraImage::~CameraImage (void)
 		delete *iter;
 	}
 	deviceWaits.clear ();
+	for (std::list < std::pair < rts2core::Connection *, std::vector < rts2core::Value * > > >::iterator iter = pendingValues.begin (); iter != pendingValues.end (); iter++)
+	{
+		for (std::vector < rts2core::Value * >::iterator viter = iter->second.begin (); viter != iter->second.end (); viter++)
+			delete *viter;
+	}
+	pendingValues.clear ();
 	delete image;
 	image = NULL;
 }
@@ -68,9 +74,7 @@ bool CameraImage::waitingFor (rts2core::DevClient * devClient)
 		}
 	}
 	if (ret)
-	{
-		image->writeConn (devClient->getConnection (), INFO_CALLED);
-	}
+		writeConn (devClient->getConnection (), INFO_CALLED);
 	return ret;
 }
 
@@ -89,7 +93,7 @@ bool CameraImage::wasTriggered (rts2core::DevClient * devClient)
 	{
 		if (*iter == devClient)
 		{
-			image->writeConn (devClient->getConnection (), TRIGGERED);
+			writeConn (devClient->getConnection (), TRIGGERED);
 			triggerWaits.erase (iter);
 			return true;
 		}
@@ -97,6 +101,26 @@ bool CameraImage::wasTriggered (rts2core::DevClient * devClient)
 	return false;
 }
 
+void CameraImage::flushMetaData ()
+{
+	for (std::list < std::pair < rts2core::Connection *, std::vector < rts2core::Value * > > >::iterator iter = pendingValues.begin (); iter != pendingValues.end (); iter++)
+		image->writeConnValues (iter->first, iter->second);
+	pendingValues.clear ();
+}
+
+void CameraImage::writeConn (rts2core::Connection * conn, imageWriteWhich_t which)
+{
+	if (writing)
+	{
+		pendingValues.push_back (std::pair < rts2core::Connection *, std::vector < rts2core::Value * > > (conn, std::vector < rts2core::Value * > ()));
+		image->copyConnValues (conn, which, pendingValues.back ().second);
+	}
+	else
+	{
+		image->writeConn (conn, which);
+	}
+}
+
 bool CameraImage::canDelete ()
 {
 	if (isnan (exEnd) || !dataWriten)
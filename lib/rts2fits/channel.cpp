@@ -18,6 +18,8 @@
  */
 
 #include "rts2fits/channel.h"
+#include "rts2fits/imagescale.h"
+#include "pixelstat.h"
 #include "error.h"
 #include "imghdr.h"
 #include "nan.h"
@@ -26,6 +28,8 @@
 #include <string.h>
 #include <math.h>
 #include <iostream>
+#include <algorithm>
+#include <pthread.h>
 
 using namespace rts2image;
 
@@ -40,7 +44,11 @@ Channel::Channel (int16_t _dataType)
 	naxis = 0;
 	sizes = NULL;
 
+	loader = NULL;
+	hdu = -1;
+
 	pixelSum = average = stdev = NAN;
+	median = mad = clippedMean = NAN;
 }
 
 Channel::Channel (int ch, char *_data, int _naxis, long *_sizes, int16_t _dataType, bool dealloc)
@@ -57,7 +65,11 @@ Channel::Channel (int ch, char *_data, int _naxis, long *_sizes, int16_t _dataTy
 	sizes = new long [naxis];
 	memcpy (sizes, _sizes, naxis * sizeof (long));
 
+	loader = NULL;
+	hdu = -1;
+
 	pixelSum = average = stdev = NAN;
+	median = mad = clippedMean = NAN;
 }
 
 
@@ -76,89 +88,760 @@ Channel::Channel (int ch, char *_data, long dataSize, int _naxis, long *_sizes,
 	sizes = new long [naxis];
 	memcpy (sizes, _sizes, naxis * sizeof (long));
 
+	loader = NULL;
+	hdu = -1;
+
 	pixelSum = average = stdev = NAN;
+	median = mad = clippedMean = NAN;
+}
+
+Channel::Channel (int ch, int _naxis, long *_sizes, int16_t _dataType, ChannelLoader *_loader, int _hdu)
+{
+	channelnum = ch;
+
+	data = NULL;
+	allocated = false;
+
+	naxis = _naxis;
+
+	dataType = _dataType;
+
+	sizes = new long [naxis];
+	memcpy (sizes, _sizes, naxis * sizeof (long));
+
+	loader = _loader;
+	hdu = _hdu;
+
+	pixelSum = average = stdev = NAN;
+	median = mad = clippedMean = NAN;
 }
 
 Channel::~Channel ()
+{
+	releaseData ();
+	delete[] sizes;
+}
+
+const char *Channel::getData ()
+{
+	if (data == NULL && loader != NULL)
+		loader->loadChannelData (this);
+	return (char *) data;
+}
+
+void Channel::setData (char *_data, bool dealloc)
+{
+	releaseData ();
+	data = _data;
+	allocated = dealloc;
+}
+
+int Channel::getPixelByteSize ()
+{
+	if (dataType == RTS2_DATA_ULONG)
+		return 4;
+	return abs (dataType) / 8;
+}
+
+void Channel::releaseData ()
 {
 	if (allocated)
 		delete[] data;
-	delete[] sizes;
+	data = NULL;
+	allocated = false;
+}
+
+void Channel::setStatistics (long double _pixelSum, double _average, double _stdev, double _median, double _mad, double _clippedMean)
+{
+	pixelSum = _pixelSum;
+	average = _average;
+	stdev = _stdev;
+	median = _median;
+	mad = _mad;
+	clippedMean = _clippedMean;
+}
+
+// pixels of channel chunk processed by a single thread. Chunks do not depend
+// on number of threads, so results are the same for any number of threads
+#define STAT_CHUNK_PIXELS      (1 << 18)
+
+// histogram used for robust statistics of 8 and 16 bit data
+#define STAT_HISTOGRAM_SIZE    PIXELSTAT_HISTOGRAM_SIZE
+
+// histogram bins used to select median of data with more than 16 bits
+#define SELECT_BINS            65536
+// candidates of the selected value are copied once there is at most that many of them
+#define SELECT_BUFFER          65536
+// pixels sampled to guess range of the selected value
+#define SELECT_SAMPLE          8192
+
+#define STAT_CLIP_SIGMA        3.0
+#define STAT_CLIP_ITERATIONS   5
+
+// MAD to standard deviation of normal distribution
+#define MAD_TO_SIGMA           1.4826
+
+/**
+ * Number of pixels, their mean, sum of squared deviations from the mean,
+ * sum, minimum and maximum of pixel values.
+ */
+struct StatMoments
+{
+	size_t n;
+	double mean;
+	double m2;
+	long double sum;
+	double min;
+	double max;
+};
+
+static void clearMoments (StatMoments &m)
+{
+	m.n = 0;
+	m.mean = m.m2 = 0;
+	m.sum = 0;
+	m.min = INFINITY;
+	m.max = -INFINITY;
+}
+
+/**
+ * Merge moments of two parts (parallel variant of Welford's algorithm).
+ */
+static void mergeMoments (StatMoments &a, const StatMoments &b)
+{
+	if (b.n == 0)
+		return;
+	if (a.n == 0)
+	{
+		a = b;
+		return;
+	}
+	size_t n = a.n + b.n;
+	double delta = b.mean - a.mean;
+	a.mean += delta * b.n / n;
+	a.m2 += b.m2 + delta * delta * ((double) a.n * b.n / n);
+	a.sum += b.sum;
+	a.min = fmin (a.min, b.min);
+	a.max = fmax (a.max, b.max);
+	a.n = n;
 }
 
-template <typename pixel_type> void computeDataStatistics (pixel_type *data, long totalPixels, long double &pixelSum, double &average, double &stdev)
+/**
+ * Calculate moments of chunk of data in a single pass. Sum, sum of squared
+ * deviations from the mean, minimum and maximum are computed by
+ * PixelStatistics kernels, which also fill histogram if it is enabled.
+ */
+template <typename pixel_type> static void chunkStatistics (rts2core::PixelStatistics &ps, const pixel_type *data, size_t n, StatMoments &m)
 {
-	// calculate average of all channels..
-	pixel_type *pixel = data;
-	pixel_type *fullTop = pixel + totalPixels;
+	clearMoments (m);
+	ps.resetSums ();
+	ps.update (data, n);
 
-	pixelSum = 0;
+	m.n = ps.getCount ();
+	if (m.n == 0)
+		return;
+	m.sum = ps.getSum ();
+	m.mean = ps.getSum () / m.n;
+	m.m2 = ps.getM2 ();
+	m.min = ps.getMin ();
+	m.max = ps.getMax ();
+}
 
-	while (pixel < fullTop)
+/**
+ * Returns k-th (counted from 0) smallest histogram index.
+ */
+static double histogramKth (const std::vector <long> &histogram, size_t k)
+{
+	size_t cum = 0;
+	for (size_t i = 0; i < histogram.size (); i++)
 	{
-		pixelSum += *pixel;
-		pixel++;
+		cum += histogram[i];
+		if (cum > k)
+			return i;
 	}
-	if (totalPixels > 0)
+	return NAN;
+}
+
+/**
+ * Returns k-th (counted from 0) smallest absolute deviation of histogram indices from center.
+ */
+static double histogramDeviation (const std::vector <long> &histogram, double center, size_t k)
+{
+	long size = histogram.size ();
+	long lo = floor (center);
+	long hi = lo + 1;
+	size_t cum = 0;
+	while (lo >= 0 || hi < size)
 	{
-		average = pixelSum / totalPixels;
-		// calculate stdev
-		pixel = data;
-		stdev = 0;
-		while (pixel < fullTop)
+		double dlo = lo >= 0 ? center - lo : INFINITY;
+		double dhi = hi < size ? hi - center : INFINITY;
+		if (dlo <= dhi)
+		{
+			cum += histogram[lo];
+			lo--;
+			if (cum > k)
+				return dlo;
+		}
+		else
 		{
-			long double tmp_s = *pixel - average;
-			long double tmp_ss = tmp_s * tmp_s;
-			stdev += tmp_ss;
-			pixel++;
+			cum += histogram[hi];
+			hi++;
+			if (cum > k)
+				return dhi;
 		}
-		stdev = sqrt (stdev / totalPixels);
 	}
-	else
+	return NAN;
+}
+
+/**
+ * Offset of histogram index to pixel value, the same as PixelStatistics uses.
+ */
+static int histogramOffset (int16_t dataType)
+{
+	switch (dataType)
 	{
-		average = 0;
-		stdev = 0;
+		case RTS2_DATA_SBYTE:
+			return 128;
+		case RTS2_DATA_SHORT:
+			return 32768;
+		default:
+			return 0;
 	}
 }
 
-void Channel::computeStatistics (size_t _from, size_t _dataSize)
+static bool hasHistogram (int16_t dataType)
 {
-	if (_dataSize == 0)
-		_dataSize = getNPixels ();
 	switch (dataType)
 	{
 		case RTS2_DATA_BYTE:
-			computeDataStatistics ((unsigned char *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
 		case RTS2_DATA_SHORT:
-			computeDataStatistics ((int16_t *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
-		case RTS2_DATA_LONG:
-			computeDataStatistics ((int32_t *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
-		case RTS2_DATA_LONGLONG:
-			computeDataStatistics ((int64_t *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
-		case RTS2_DATA_FLOAT:
-			computeDataStatistics ((float *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
-		case RTS2_DATA_DOUBLE:
-			computeDataStatistics ((double *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
 		case RTS2_DATA_SBYTE:
-			computeDataStatistics ((signed char *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
-			break;
 		case RTS2_DATA_USHORT:
-			computeDataStatistics ((uint16_t *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Pixel value, used to select median.
+ */
+struct SelectValue
+{
+	double operator () (double v) const { return v; }
+};
+
+/**
+ * Absolute deviation of pixel value from center, used to select MAD.
+ */
+struct SelectDeviation
+{
+	double center;
+	SelectDeviation (double _center) { center = _center; }
+	double operator () (double v) const { return fabs (v - center); }
+};
+
+/**
+ * Copies transformed values within [lo, hi] to buf, which holds size + 1
+ * values. Returns number of values in the range, which were all copied if it
+ * is at most size. Counts values below the range and finds the smallest value
+ * above it. The loop is branch free, as pixels below and above the range are
+ * mixed randomly.
+ */
+template <typename pixel_type, typename transform> static size_t copyRange (const pixel_type *data, size_t n, double lo, double hi, transform f, double *buf, size_t size, size_t &below, double &above)
+{
+	size_t m = 0;
+	below = 0;
+	above = INFINITY;
+	for (size_t i = 0; i < n; i++)
+	{
+		double x = f (data[i]);
+		below += x < lo;
+		double y = x > hi ? x : INFINITY;
+		above = y < above ? y : above;
+		buf[m < size ? m : size] = x;
+		m += (x >= lo) & (x <= hi);
+	}
+	return m;
+}
+
+/**
+ * Returns k-th smallest of m values in buffer, and (k + 1)-th smallest in
+ * next. Above is the smallest value larger than all values in the buffer.
+ */
+static double bufferKth (std::vector <double> &buf, size_t m, size_t k, double above, double &next)
+{
+	std::vector <double>::iterator kth = buf.begin () + k;
+	std::nth_element (buf.begin (), kth, buf.begin () + m);
+	next = (k + 1 < m) ? *std::min_element (kth + 1, buf.begin () + m) : above;
+	return *kth;
+}
+
+/**
+ * Narrows [lo, hi] to range which likely contains k-th smallest of valid
+ * transformed values. The range is estimated from regularly spaced sample of
+ * pixels. Returns false if the range cannot be estimated.
+ */
+template <typename pixel_type, typename transform> static bool sampleRange (const pixel_type *data, size_t n, size_t valid, size_t k, transform f, double &lo, double &hi)
+{
+	std::vector <double> sample;
+	sample.reserve (SELECT_SAMPLE);
+	size_t step = n / SELECT_SAMPLE;
+	for (size_t i = 0; i < n && sample.size () < SELECT_SAMPLE; i += step)
+	{
+		double x = f (data[i]);
+		if (!isnan (x))
+			sample.push_back (x);
+	}
+	size_t s = sample.size ();
+	if (s < SELECT_SAMPLE / 2)
+		return false;
+	// rank of k-th value in the sample, with margin of four standard deviations of the estimate
+	size_t r = (double) k / valid * s;
+	size_t d = 2 * sqrt (s);
+	if (r > d)
+	{
+		std::nth_element (sample.begin (), sample.begin () + (r - d), sample.end ());
+		lo = sample[r - d];
+	}
+	if (r + d < s)
+	{
+		std::nth_element (sample.begin (), sample.begin () + (r + d), sample.end ());
+		hi = sample[r + d];
+	}
+	return true;
+}
+
+/**
+ * Returns k-th (counted from 0) smallest of valid transformed data values,
+ * which are all within [lo, hi], and (k + 1)-th smallest value in next. NaNs
+ * are ignored. Range guessed from a sample is tried first. If it does not
+ * contain the value or holds too many candidates, the range is narrowed by
+ * histogram passes over the data, until candidates fit to a small buffer, so
+ * memory needed does not depend on number of pixels.
+ */
+template <typename pixel_type, typename transform> static double selectKth (const pixel_type *data, size_t n, size_t valid, size_t k, double lo, double hi, transform f, double &next)
+{
+	std::vector <double> buf (SELECT_BUFFER + 1);
+	size_t below;
+	double above;
+	// number of values in [lo, hi]
+	size_t candidates = n;
+	next = lo;
+
+	double glo = lo;
+	double ghi = hi;
+	if (n > SELECT_BUFFER && sampleRange (data, n, valid, k, f, glo, ghi))
+	{
+		size_t m = copyRange (data, n, glo, ghi, f, &buf[0], SELECT_BUFFER, below, above);
+		if (k >= below && k - below < m)
+		{
+			if (m <= SELECT_BUFFER)
+				return bufferKth (buf, m, k - below, above, next);
+			lo = glo;
+			hi = ghi;
+			candidates = m;
+			next = lo;
+		}
+	}
+
+	// last bin collects values outside of the range
+	std::vector <size_t> hist;
+	std::vector <double> binMin;
+	std::vector <double> binMax;
+	// false if range cannot be narrowed by histogram
+	bool split = true;
+	while (lo < hi)
+	{
+		if (candidates <= SELECT_BUFFER || !split)
+		{
+			buf.resize (std::max (candidates, (size_t) SELECT_BUFFER) + 1);
+			size_t m = copyRange (data, n, lo, hi, f, &buf[0], buf.size () - 1, below, above);
+			if (k < below || k - below >= m || m >= buf.size ())
+				return NAN;
+			return bufferKth (buf, m, k - below, above, next);
+		}
+
+		// halves of range limits cannot overflow
+		double scale = (SELECT_BINS - 1) / (hi / 2 - lo / 2);
+		if (isinf (scale) || isnan (scale))
+		{
+			split = false;
+			continue;
+		}
+		hist.assign (SELECT_BINS + 1, 0);
+		binMin.assign (SELECT_BINS + 1, INFINITY);
+		binMax.assign (SELECT_BINS + 1, -INFINITY);
+		below = 0;
+		above = INFINITY;
+		for (size_t i = 0; i < n; i++)
+		{
+			double x = f (data[i]);
+			below += x < lo;
+			double y = x > hi ? x : INFINITY;
+			above = y < above ? y : above;
+			double t = (x / 2 - lo / 2) * scale;
+			t = t < SELECT_BINS - 1 ? t : SELECT_BINS - 1;
+			size_t b = ((x >= lo) & (x <= hi)) ? t : SELECT_BINS;
+			hist[b]++;
+			binMin[b] = x < binMin[b] ? x : binMin[b];
+			binMax[b] = x > binMax[b] ? x : binMax[b];
+		}
+
+		size_t cum = below;
+		size_t b;
+		for (b = 0; b < SELECT_BINS; b++)
+		{
+			if (cum + hist[b] > k)
+				break;
+			cum += hist[b];
+		}
+		if (b == SELECT_BINS)
+			return NAN;
+		// k-th value is the last in its bin, next value is the first of the following non-empty bin
+		if (cum + hist[b] == k + 1)
+		{
+			size_t c = b + 1;
+			while (c < SELECT_BINS && hist[c] == 0)
+				c++;
+			next = c < SELECT_BINS ? binMin[c] : above;
+			return binMax[b];
+		}
+		// bin covers the whole range, copy candidates
+		if (hist[b] == candidates)
+			split = false;
+		candidates = hist[b];
+		lo = binMin[b];
+		hi = binMax[b];
+		next = lo;
+	}
+	return lo;
+}
+
+/**
+ * Median of transformed values. Transformed values of all valid pixels are within [lo, hi].
+ */
+template <typename pixel_type, typename transform> static double selectMedian (const pixel_type *data, size_t n, size_t valid, double lo, double hi, transform f)
+{
+	double next;
+	double m = selectKth (data, n, valid, (valid - 1) / 2, lo, hi, f, next);
+	if (valid % 2 == 0)
+		m = (m + next) / 2.0;
+	return m;
+}
+
+/**
+ * Statistics of a single channel.
+ */
+struct StatChannel
+{
+	int16_t dataType;
+	const char *data;
+	size_t from;
+	size_t n;
+	bool robust;
+
+	StatMoments moments;
+	// filled for robust statistics of 8 and 16 bit data
+	std::vector <long> histogram;
+
+	double median;
+	double mad;
+	double clippedMean;
+};
+
+struct StatChunk
+{
+	size_t channel;
+	size_t start;
+	size_t end;
+	StatMoments moments;
+};
+
+struct StatJob
+{
+	std::vector <StatChannel> *channels;
+	std::vector <StatChunk> chunks;
+	// channels with robust statistics calculated from data
+	std::vector <size_t> robustChannels;
+	pthread_mutex_t mutex;
+};
+
+static void flushHistogram (StatJob *job, StatChannel *ch, rts2core::PixelStatistics *ps)
+{
+	if (ch == NULL || ch->histogram.empty ())
+		return;
+	const uint32_t *h = ps->getHistogram ();
+	if (h == NULL)
+		return;
+	pthread_mutex_lock (&(job->mutex));
+	for (size_t i = 0; i < ch->histogram.size (); i++)
+		ch->histogram[i] += h[i];
+	pthread_mutex_unlock (&(job->mutex));
+}
+
+static void chunksPart (void *a, size_t start, size_t end)
+{
+	StatJob *job = (StatJob *) a;
+	// kernels of the current channel; histogram is filled only for robust statistics of 8 and 16 bit data
+	rts2core::PixelStatistics *ps = NULL;
+	StatChannel *current = NULL;
+
+	for (size_t i = start; i < end; i++)
+	{
+		StatChunk &chunk = job->chunks[i];
+		StatChannel &ch = (*(job->channels))[chunk.channel];
+		if (current != &ch)
+		{
+			if (ps)
+				flushHistogram (job, current, ps);
+			delete ps;
+			ps = new rts2core::PixelStatistics (!ch.histogram.empty (), true);
+			current = &ch;
+		}
+		size_t off = ch.from + chunk.start;
+		size_t n = chunk.end - chunk.start;
+
+		switch (ch.dataType)
+		{
+			case RTS2_DATA_BYTE:
+				chunkStatistics (*ps, (const uint8_t *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_SHORT:
+				chunkStatistics (*ps, (const int16_t *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_LONG:
+				chunkStatistics (*ps, (const int32_t *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_LONGLONG:
+				chunkStatistics (*ps, (const int64_t *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_FLOAT:
+				chunkStatistics (*ps, (const float *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_DOUBLE:
+				chunkStatistics (*ps, (const double *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_SBYTE:
+				chunkStatistics (*ps, (const int8_t *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_USHORT:
+				chunkStatistics (*ps, (const uint16_t *) ch.data + off, n, chunk.moments);
+				break;
+			case RTS2_DATA_ULONG:
+				chunkStatistics (*ps, (const uint32_t *) ch.data + off, n, chunk.moments);
+				break;
+		}
+	}
+	if (ps)
+		flushHistogram (job, current, ps);
+	delete ps;
+}
+
+/**
+ * Median, MAD and sigma-clipped mean from histogram of 8 and 16 bit data.
+ */
+static void histogramRobust (StatChannel &ch)
+{
+	size_t n = ch.moments.n;
+	if (n == 0)
+		return;
+	const std::vector <long> &h = ch.histogram;
+	int offset = histogramOffset (ch.dataType);
+
+	double center = (histogramKth (h, (n - 1) / 2) + histogramKth (h, n / 2)) / 2.0;
+	ch.median = center - offset;
+	ch.mad = (histogramDeviation (h, center, (n - 1) / 2) + histogramDeviation (h, center, n / 2)) / 2.0;
+
+	double sigma = MAD_TO_SIGMA * ch.mad;
+	size_t last = 0;
+	ch.clippedMean = ch.median;
+	for (int it = 0; it < STAT_CLIP_ITERATIONS; it++)
+	{
+		long lo = ceil (center - STAT_CLIP_SIGMA * sigma);
+		long hi = floor (center + STAT_CLIP_SIGMA * sigma);
+		if (lo < 0)
+			lo = 0;
+		if (hi >= (long) h.size ())
+			hi = h.size () - 1;
+
+		size_t cnt = 0;
+		double s = 0, q = 0;
+		for (long i = lo; i <= hi; i++)
+		{
+			double d = i - center;
+			cnt += h[i];
+			s += h[i] * d;
+			q += h[i] * d * d;
+		}
+		if (cnt == 0 || cnt == last)
 			break;
-		case RTS2_DATA_ULONG:
-			computeDataStatistics ((uint32_t *) (getData ()) + _from, _dataSize, pixelSum, average, stdev);
+		last = cnt;
+		center += s / cnt;
+		sigma = sqrt (fmax (q / cnt - (s / cnt) * (s / cnt), 0));
+		ch.clippedMean = center - offset;
+	}
+}
+
+/**
+ * Median, MAD and sigma-clipped mean of data with more than 16 bits. NaNs
+ * are ignored. Data are not copied, median and MAD are selected by passes
+ * over the data, which copy only values close to the selected one.
+ */
+template <typename pixel_type> static void dataRobust (const pixel_type *data, StatChannel &ch)
+{
+	size_t valid = ch.moments.n;
+	if (valid == 0)
+		return;
+
+	ch.median = selectMedian (data, ch.n, valid, ch.moments.min, ch.moments.max, SelectValue ());
+	ch.mad = selectMedian (data, ch.n, valid, 0, fmax (ch.median - ch.moments.min, ch.moments.max - ch.median), SelectDeviation (ch.median));
+
+	double center = ch.median;
+	double sigma = MAD_TO_SIGMA * ch.mad;
+	size_t last = 0;
+	ch.clippedMean = ch.median;
+	for (int it = 0; it < STAT_CLIP_ITERATIONS; it++)
+	{
+		size_t cnt = 0;
+		double s = 0, q = 0;
+		for (size_t i = 0; i < ch.n; i++)
+		{
+			double d = data[i] - center;
+			if (!(fabs (d) <= STAT_CLIP_SIGMA * sigma))
+				continue;
+			cnt++;
+			s += d;
+			q += d * d;
+		}
+		if (cnt == 0 || cnt == last)
 			break;
-		default:
-			throw rts2core::Error ("unknow dataType");
+		last = cnt;
+		center += s / cnt;
+		sigma = sqrt (fmax (q / cnt - (s / cnt) * (s / cnt), 0));
+		ch.clippedMean = center;
 	}
 }
 
+static void robustPart (void *a, size_t start, size_t end)
+{
+	StatJob *job = (StatJob *) a;
+	for (size_t i = start; i < end; i++)
+	{
+		StatChannel &ch = (*(job->channels))[job->robustChannels[i]];
+		switch (ch.dataType)
+		{
+			case RTS2_DATA_LONG:
+				dataRobust ((const int32_t *) ch.data + ch.from, ch);
+				break;
+			case RTS2_DATA_LONGLONG:
+				dataRobust ((const int64_t *) ch.data + ch.from, ch);
+				break;
+			case RTS2_DATA_FLOAT:
+				dataRobust ((const float *) ch.data + ch.from, ch);
+				break;
+			case RTS2_DATA_DOUBLE:
+				dataRobust ((const double *) ch.data + ch.from, ch);
+				break;
+			case RTS2_DATA_ULONG:
+				dataRobust ((const uint32_t *) ch.data + ch.from, ch);
+				break;
+		}
+	}
+}
+
+/**
+ * Calculate statistics of channels. Channels are split to chunks, which
+ * are processed in parallel. Moments of chunks are merged in chunk order.
+ */
+static void channelsStatistics (Channel **chans, size_t nchan, size_t _from, size_t _dataSize, bool robust, std::vector <StatChannel> &stats)
+{
+	StatJob job;
+	job.channels = &stats;
+	stats.resize (nchan);
+
+	size_t totalPixels = 0;
+
+	for (size_t c = 0; c < nchan; c++)
+	{
+		StatChannel &ch = stats[c];
+		ch.dataType = chans[c]->getDataType ();
+		switch (ch.dataType)
+		{
+			case RTS2_DATA_BYTE:
+			case RTS2_DATA_SHORT:
+			case RTS2_DATA_LONG:
+			case RTS2_DATA_LONGLONG:
+			case RTS2_DATA_FLOAT:
+			case RTS2_DATA_DOUBLE:
+			case RTS2_DATA_SBYTE:
+			case RTS2_DATA_USHORT:
+			case RTS2_DATA_ULONG:
+				break;
+			default:
+				throw rts2core::Error ("unknow dataType");
+		}
+		// data of lazy channels must be loaded before threads are started
+		ch.data = chans[c]->getData ();
+		ch.from = _from;
+		ch.n = _dataSize == 0 ? chans[c]->getNPixels () : _dataSize;
+		ch.robust = robust;
+		ch.median = ch.mad = ch.clippedMean = NAN;
+		clearMoments (ch.moments);
+
+		if (robust)
+		{
+			if (hasHistogram (ch.dataType))
+				ch.histogram.assign (STAT_HISTOGRAM_SIZE, 0);
+			else
+				job.robustChannels.push_back (c);
+		}
+
+		for (size_t start = 0; start < ch.n; start += STAT_CHUNK_PIXELS)
+		{
+			StatChunk chunk;
+			chunk.channel = c;
+			chunk.start = start;
+			chunk.end = ch.n - start < STAT_CHUNK_PIXELS ? ch.n : start + STAT_CHUNK_PIXELS;
+			job.chunks.push_back (chunk);
+		}
+
+		totalPixels += ch.n;
+	}
+
+	pthread_mutex_init (&(job.mutex), NULL);
+	runParts (chunksPart, &job, job.chunks.size (), totalPixels);
+	pthread_mutex_destroy (&(job.mutex));
+
+	for (size_t i = 0; i < job.chunks.size (); i++)
+		mergeMoments (stats[job.chunks[i].channel].moments, job.chunks[i].moments);
+
+	if (robust)
+	{
+		for (size_t c = 0; c < nchan; c++)
+		{
+			if (!stats[c].histogram.empty ())
+				histogramRobust (stats[c]);
+		}
+		runParts (robustPart, &job, job.robustChannels.size (), totalPixels);
+	}
+}
+
+static double momentsStDev (const StatMoments &m)
+{
+	return m.n > 0 ? sqrt (m.m2 / m.n) : 0;
+}
+
+void Channel::computeStatistics (size_t _from, size_t _dataSize, bool robust)
+{
+	Channel *chan = this;
+	std::vector <StatChannel> stats;
+	channelsStatistics (&chan, 1, _from, _dataSize, robust, stats);
+
+	StatChannel &ch = stats[0];
+	setStatistics (ch.moments.sum, ch.moments.mean, momentsStDev (ch.moments), ch.median, ch.mad, ch.clippedMean);
+}
+
 Channels::Channels ()
 {
 }
@@ -168,3 +851,18 @@ Channels::~Channels ()
 	for (Channels::iterator iter = begin (); iter != end (); iter++)
 		delete (*iter);
 }
+
+void Channels::computeStatistics (size_t _from, size_t _dataSize, bool robust)
+{
+	if (empty ())
+		return;
+
+	std::vector <StatChannel> stats;
+	channelsStatistics (&(front ()), size (), _from, _dataSize, robust, stats);
+
+	for (size_t i = 0; i < size (); i++)
+	{
+		StatChannel &ch = stats[i];
+		(*this)[i]->setStatistics (ch.moments.sum, ch.moments.mean, momentsStDev (ch.moments), ch.median, ch.mad, ch.clippedMean);
+	}
+}
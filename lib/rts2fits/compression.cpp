@@ -0,0 +1,302 @@
+/*
+ * Tile compression of FITS images.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rts2fits/compression.h"
+#include "rts2fits/imagescale.h"
+#include "configuration.h"
+#include "app.h"
+#include "imghdr.h"
+
+// initial size and increment of memory FITS files
+#define MEMFILE_BLOCK    (2880 * 256)
+
+using namespace rts2image;
+
+int rts2image::compressionType (const char *name)
+{
+	if (name == NULL || name[0] == '\0' || !strcasecmp (name, "none"))
+		return 0;
+	if (!strcasecmp (name, "rice"))
+		return RICE_1;
+	if (!strcasecmp (name, "gzip"))
+		return GZIP_1;
+	if (!strcasecmp (name, "gzip2"))
+		return GZIP_2;
+	if (!strcasecmp (name, "hcompress"))
+		return HCOMPRESS_1;
+	if (!strcasecmp (name, "plio"))
+		return PLIO_1;
+	return -1;
+}
+
+int FitsCompression::load (const char *section)
+{
+	rts2core::Configuration *config = rts2core::Configuration::instance ();
+
+	std::string name;
+	config->getString (section, "compress", name, "none");
+	type = compressionType (name.c_str ());
+	tileWidth = config->getIntegerDefault (section, "compress_tile_width", 0);
+	tileHeight = config->getIntegerDefault (section, "compress_tile_height", 0);
+	config->getFloat (section, "compress_quantize", quantize, 0);
+
+	if (type < 0)
+	{
+		logStream (MESSAGE_ERROR) << "invalid compression " << name << " in section " << section << ", images will not be compressed" << sendLog;
+		type = 0;
+		return -1;
+	}
+	return 0;
+}
+
+int rts2image::fitsDataType (int dataType)
+{
+	switch (dataType)
+	{
+		case RTS2_DATA_BYTE:
+			return TBYTE;
+		case RTS2_DATA_SHORT:
+			return TSHORT;
+		case RTS2_DATA_LONG:
+			return TINT;
+		case RTS2_DATA_LONGLONG:
+			return TLONGLONG;
+		case RTS2_DATA_FLOAT:
+			return TFLOAT;
+		case RTS2_DATA_DOUBLE:
+			return TDOUBLE;
+		case RTS2_DATA_SBYTE:
+			return TSBYTE;
+		case RTS2_DATA_USHORT:
+			return TUSHORT;
+		case RTS2_DATA_ULONG:
+			return TUINT;
+	}
+	return -1;
+}
+
+CompressedChannel::CompressedChannel ()
+{
+	mem = NULL;
+	buf = NULL;
+	bufSize = 0;
+}
+
+CompressedChannel::~CompressedChannel ()
+{
+	if (mem)
+	{
+		int status = 0;
+		fits_close_file (mem, &status);
+	}
+	free (buf);
+}
+
+int CompressedChannel::compress (const FitsCompression &compression, int dataType, long sizes[2], void *data)
+{
+	int status = 0;
+	int fdt = fitsDataType (dataType);
+	if (fdt < 0)
+		return BAD_DATATYPE;
+
+	bufSize = MEMFILE_BLOCK;
+	buf = malloc (bufSize);
+	fits_create_memfile (&mem, &buf, &bufSize, MEMFILE_BLOCK, realloc, &status);
+	if (status)
+	{
+		mem = NULL;
+		return status;
+	}
+
+	// compressed image is always stored in extension
+	fits_create_img (mem, BYTE_IMG, 0, NULL, &status);
+
+	fits_set_compression_type (mem, compression.type, &status);
+	if (compression.tileWidth > 0 || compression.tileHeight > 0)
+	{
+		long tile[2];
+		tile[0] = compression.tileWidth > 0 ? compression.tileWidth : sizes[0];
+		tile[1] = compression.tileHeight > 0 ? compression.tileHeight : 1;
+		fits_set_tile_dim (mem, 2, tile, &status);
+	}
+	if (compression.quantize != 0)
+		fits_set_quantize_level (mem, compression.quantize, &status);
+
+	fits_create_img (mem, dataType == RTS2_DATA_SBYTE ? RTS2_DATA_BYTE : dataType, 2, sizes, &status);
+	fits_write_img (mem, fdt, 1, sizes[0] * sizes[1], data, &status);
+	return status;
+}
+
+int CompressedChannel::copyTo (fitsfile *ffile, int *status)
+{
+	if (mem == NULL)
+		return *status = BAD_FILEPTR;
+	fits_movabs_hdu (mem, 2, NULL, status);
+	fits_copy_hdu (mem, ffile, 0, status);
+	return *status;
+}
+
+struct CompressPart
+{
+	const FitsCompression *compression;
+	std::vector <ChannelData> *channels;
+	size_t start;
+	size_t end;
+};
+
+static void compressPart (CompressPart *part)
+{
+	for (size_t i = part->start; i < part->end; i++)
+	{
+		ChannelData &ch = (*(part->channels))[i];
+		ch.status = ch.compressed->compress (*(part->compression), ch.dataType, ch.sizes, ch.data);
+	}
+}
+
+static void *compressThread (void *arg)
+{
+	compressPart ((CompressPart *) arg);
+	return NULL;
+}
+
+void rts2image::compressChannels (const FitsCompression &compression, std::vector <ChannelData> &channels)
+{
+	size_t n = channels.size ();
+	size_t threads = getScalingThreads ();
+	if (threads > n)
+		threads = n;
+	// CFITSIO without thread support uses global buffers
+	if (threads < 1 || !fits_is_reentrant ())
+		threads = 1;
+
+	std::vector <CompressPart> parts (threads);
+	std::vector <pthread_t> tids (threads);
+	std::vector <bool> started (threads, false);
+
+	for (size_t i = 0; i < threads; i++)
+	{
+		parts[i].compression = &compression;
+		parts[i].channels = &channels;
+		parts[i].start = n * i / threads;
+		parts[i].end = n * (i + 1) / threads;
+	}
+
+	for (size_t i = 1; i < threads; i++)
+		started[i] = (pthread_create (&(tids[i]), NULL, compressThread, &(parts[i])) == 0);
+
+	compressPart (&(parts[0]));
+
+	for (size_t i = 1; i < threads; i++)
+	{
+		if (started[i])
+			pthread_join (tids[i], NULL);
+		else
+			compressPart (&(parts[i]));
+	}
+}
+
+int rts2image::convertCompression (const char *path, int compressType, char* &data, size_t &length)
+{
+	int status = 0;
+	fitsfile *in;
+	fitsfile *out;
+
+	fits_open_diskfile (&in, path, READONLY, &status);
+	if (status)
+		return status;
+
+	size_t size = MEMFILE_BLOCK;
+	void *buf = malloc (size);
+	fits_create_memfile (&out, &buf, &size, MEMFILE_BLOCK, realloc, &status);
+	if (status)
+	{
+		int s = 0;
+		fits_close_file (in, &s);
+		free (buf);
+		return status;
+	}
+
+	int hdunum = 0;
+	fits_get_num_hdus (in, &hdunum, &status);
+
+	for (int i = 1; i <= hdunum && status == 0; i++)
+	{
+		int hdutype;
+		fits_movabs_hdu (in, i, &hdutype, &status);
+		if (status)
+			break;
+
+		int naxis = 0;
+		if (hdutype == IMAGE_HDU)
+			fits_get_img_dim (in, &naxis, &status);
+
+		if (hdutype != IMAGE_HDU || naxis == 0)
+		{
+			fits_copy_hdu (in, out, 0, &status);
+		}
+		else if (fits_is_compressed_image (in, &status))
+		{
+			if (compressType == 0)
+				fits_img_decompress (in, out, &status);
+			else
+				fits_copy_hdu (in, out, 0, &status);
+		}
+		else if (compressType == 0)
+		{
+			fits_copy_hdu (in, out, 0, &status);
+		}
+		else
+		{
+			// primary header is kept in empty primary HDU, compressed data go to extension
+			if (i == 1)
+			{
+				int bitpix;
+				fits_get_img_type (in, &bitpix, &status);
+				fits_copy_header (in, out, &status);
+				fits_resize_img (out, bitpix, 0, NULL, &status);
+			}
+			fits_set_compression_type (out, compressType, &status);
+			fits_img_compress (in, out, &status);
+		}
+	}
+
+	// end of the last HDU is end of the file
+	LONGLONG headstart, datastart, dataend = 0;
+	fits_flush_file (out, &status);
+	fits_get_hduaddrll (out, &headstart, &datastart, &dataend, &status);
+
+	if (status == 0)
+	{
+		length = dataend;
+		data = new char[length];
+		memcpy (data, buf, length);
+	}
+
+	int s = 0;
+	fits_close_file (in, &s);
+	s = 0;
+	fits_close_file (out, &s);
+	free (buf);
+
+	return status;
+}
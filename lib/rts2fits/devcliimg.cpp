@@ -75,6 +75,27 @@ DevClientCameraImage::DevClientCameraImage (rts2core::Connection * in_connection
 
 	actualImage = NULL;
 
+#if defined(RTS2_HAVE_LIBJPEG) && RTS2_HAVE_LIBJPEG == 1
+	previewCache = NULL;
+	previewChannel = 0;
+	if (config->getBoolean (connection->getName (), "preview_pyramid", false))
+	{
+		std::string previewDir;
+		config->getString ("xmlrpcd", "preview_cache", previewDir, "");
+		if (previewDir.length () > 0)
+		{
+			previewCache = new PreviewCache (previewDir.c_str ());
+			previewChannel = config->getIntegerDefault (connection->getName (), "preview_channel", 0);
+		}
+		else
+		{
+			logStream (MESSAGE_WARNING) << "preview_pyramid is set for " << connection->getName () << ", but preview_cache is not specified in [xmlrpcd] section" << sendLog;
+		}
+	}
+#endif
+
+	compression.load (connection->getName ());
+
 	expNum = 0;
 
 	triggered = false;
@@ -82,8 +103,13 @@ DevClientCameraImage::DevClientCameraImage (rts2core::Connection * in_connection
 
 DevClientCameraImage::~DevClientCameraImage (void)
 {
+	waitWriteJobs ();
+	getMaster ()->deleteTimers (EVENT_IMAGE_WRITTEN, this);
 	delete fitsTemplate;
 	delete actualImage;
+#if defined(RTS2_HAVE_LIBJPEG) && RTS2_HAVE_LIBJPEG == 1
+	delete previewCache;
+#endif
 }
 
 Image * DevClientCameraImage::setImage (Image * old_img, Image * new_image)
@@ -148,6 +174,7 @@ void DevClientCameraImage::postEvent (rts2core::Event * event)
 			triggered = false;
 			break;
 		case EVENT_KILL_ALL:
+			waitWriteJobs ();
 			for (CameraImages::iterator iter = images.begin (); iter != images.end (); iter++)
 			{
 				delete iter->second;
@@ -161,6 +188,9 @@ void DevClientCameraImage::postEvent (rts2core::Event * event)
 			if (actualImage)
 				*((int *)event->getArg ()) += 1;
 			break;
+		case EVENT_IMAGE_WRITTEN:
+			checkWriteJobs ();
+			break;
 		case EVENT_METADATA_TIMEOUT:
 			if (checkImages.size ())
 			{
@@ -208,13 +238,16 @@ void DevClientCameraImage::fits2DataChannels (Image *img, rts2core::DataChannels
 	// add channels one by one
 	for (int i = 0; i < img->getChannelSize (); i++)
 	{
+		const void *chanData = img->getChannelData (i);
+		if (chanData == NULL)
+			continue;
 		struct imghdr imgh;
 		img->getImgHeader (&imgh, i);
 		long ts = img->getChannelNPixels (i) * img->getPixelByteSize ();
 		rts2core::DataRead *dr = new rts2core::DataRead (ts + sizeof (struct imghdr), img->getDataType ());
 		dr->setChunkSizeFromData ();
 		dr->addData ((char *) (&imgh), sizeof (struct imghdr));
-		dr->addData ((char *) img->getChannelData (i), ts);
+		dr->addData ((char *) chanData, ts);
 		data->push_back (dr);
 	}
 }
@@ -256,170 +289,253 @@ void DevClientCameraImage::fullDataReceived (int data_conn, rts2core::DataChanne
 
 		ci->writeMetaData ((struct imghdr *) ((*(data->begin ()))->getDataBuff ()));
 
-		// detector coordinates,..
-		rts2core::ValueRectangle *detsize = getRectangle ("DETSIZE");
-
-		rts2core::DoubleArray *chan1_offsets = getDoubleArray ("CHAN1_OFFSETS");
-		rts2core::DoubleArray *chan2_offsets = getDoubleArray ("CHAN2_OFFSETS");
+		// images from fits_data and images without data connection reuse their entry, so they are written immediately
+		ImageWriter *writer = ImageWriter::instance ();
+		if (data_conn > 0 && writer->isEnabled ())
+		{
+			if (writeJobs.empty ())
+				getMaster ()->addTimer (WRITER_CHECK_INTERVAL, new rts2core::Event (EVENT_IMAGE_WRITTEN, this));
+			// metadata received during write are queued, and written in checkWriteJobs
+			ci->setWriting (true);
+			writeJobs.push_back (writer->queue (ci, data));
+			return;
+		}
 
-		rts2core::DoubleArray *chan1_delta = getDoubleArray ("CHAN1_DELTA");
-		rts2core::DoubleArray *chan2_delta = getDoubleArray ("CHAN2_DELTA");
+		int nchan = data->size ();
+		std::vector <char *> buffs (nchan);
+		std::vector <char *> tops (nchan);
+		std::vector <int> hdus (nchan);
+		for (int i = 0; i < nchan; i++)
+		{
+			buffs[i] = (*data)[i]->getDataBuff ();
+			tops[i] = (*data)[i]->getDataTop ();
+		}
 
-		rts2core::DoubleArray *trim_x = getDoubleArray ("TRIM_X1");
-		rts2core::DoubleArray *trim_y = getDoubleArray ("TRIM_Y1");
-		rts2core::DoubleArray *trim_x2 = getDoubleArray ("TRIM_X2");
-		rts2core::DoubleArray *trim_y2 = getDoubleArray ("TRIM_Y2");
+		ci->image->writeChannels (nchan, &(buffs[0]), &(tops[0]), &(hdus[0]));
+		ci->dataWriten = true;
 
-		for (rts2core::DataChannels::iterator di = data->begin (); di != data->end (); di++)
+		for (int i = 0; i < nchan; i++)
 		{
-			ci->writeData ((*di)->getDataBuff (), (*di)->getDataTop (), data->size ());
-
-			struct imghdr *imgh = (struct imghdr *) ((*di)->getDataBuff ());
-
-			uint16_t chan = ntohs (imgh->channel) - 1;
-
-			int16_t x = ntohs (imgh->x);
-			int16_t y = ntohs (imgh->y);
-			int32_t w = ntohl (imgh->sizes[0]);
-			int32_t h = ntohl (imgh->sizes[1]);
-			int16_t bin1 = ntohs (imgh->binnings[0]);
-			int16_t bin2 = ntohs (imgh->binnings[1]);
-
-			// TV, TM - vector, matrixes
-			// for the momemt we assume detector == physical
-			double mods[NUM_WCS_VALUES] = {0, 0, 0, 0, 1, 1, 0};
-
-			if (chan1_offsets && chan < chan1_offsets->size ())
-				mods[2] += (*chan1_offsets)[chan];
-			if (chan2_offsets && chan < chan2_offsets->size ())
-				mods[3] += (*chan2_offsets)[chan];
-			if (chan1_delta && chan < chan1_delta->size ())
-				mods[4] *= (*chan1_delta)[chan];
-			if (chan2_delta && chan < chan2_delta->size ())
-				mods[5] *= (*chan2_delta)[chan];
-
-			// not sure about this, mayby should be commented out, same as following rows
-			// please change if you use channels features and will encounter problems
-			if (mods[4] > 0)
-				mods[2] *= -1;
-			if (mods[5] > 0)
-				mods[3] *= -1;
-
-			if (bin1 != 0)
-			{
-				mods[2] /= bin1;
-			}
+			ci->image->moveHDU (hdus[i]);
+			writeChannelHeaders (ci, (struct imghdr *) buffs[i]);
+		}
 
-			if (bin2 != 0)
-			{
-				mods[3] /= bin2;
-			}
+		imageWritten (iter);
+	}
+	else
+	{
+		logStream (MESSAGE_DEBUG) << "invalid data_conn: " << data_conn << sendLog;
+	}
+}
 
-			ci->image->writeWCS (mods);
+void DevClientCameraImage::writeChannelHeaders (CameraImage *ci, struct imghdr *imgh)
+{
+	// detector coordinates,..
+	rts2core::ValueRectangle *detsize = getRectangle ("DETSIZE");
 
-			if (detsize)
-			{
-				// write detector/channel orientation
-				ci->image->setValueRectange ("DETSIZE", detsize->getX ()->getValueDouble (), detsize->getWidth ()->getValueDouble (), detsize->getY ()->getValueDouble (), detsize->getHeight ()->getValueDouble (), "unbined detector size");
-				ci->image->setValueRectange ("DATASEC", 1, w, 1, h, "data binned section");
+	rts2core::DoubleArray *chan1_offsets = getDoubleArray ("CHAN1_OFFSETS");
+	rts2core::DoubleArray *chan2_offsets = getDoubleArray ("CHAN2_OFFSETS");
 
-				if (chan1_delta && chan < chan1_delta->size () && chan2_delta && chan < chan2_delta->size () && chan1_offsets && chan < chan1_offsets->size () && chan2_offsets && chan < chan2_offsets->size ())
-				{
-					double xx = (*chan1_offsets)[chan] + ((*chan1_delta)[chan] > 0 ? 1 : -1) * x;
-					double yy = (*chan2_offsets)[chan] + ((*chan2_delta)[chan] > 0 ? 1 : -1) * y;
-					ci->image->setValueRectange ("DETSEC",
-						xx,
-						xx + (*chan1_delta)[chan] * w * bin1,
-						yy,
-						yy + (*chan2_delta)[chan] * h * bin2,
-						"unbinned section of detector");
-					// write trim
-					if (trim_x || trim_y || trim_x2 || trim_y2)
-					{
-						double tx = NAN;
-						double ty = NAN;
-						double tx2 = NAN;
-						double ty2 = NAN;
-
-						if (trim_x && chan < trim_x->size ())
-							tx = (*trim_x)[chan] - x;
-					 	if (trim_y && chan < trim_y->size ())
-							ty = (*trim_y)[chan] - y;
-						if (trim_x2 && chan < trim_x2->size ())
-							tx2 = (*trim_x2)[chan] - x;
-						if (trim_y2 && chan < trim_y2->size ())
-							ty2 = (*trim_y2)[chan] - y;
-
-						if (tx <= 0)
-							tx = 1;
-						if (ty <= 0)
-							ty = 1;
-						if (tx2 <= 0)
-							tx2 = 1;
-						if (ty2 <= 0)
-							ty2 = 1;
-
-						// bin X and Y
-						tx /= bin1;
-						ty /= bin2;
-
-						tx2 /= bin1;
-						ty2 /= bin2;
-
-						if (tx2 > w)
-							tx2 = w;
-						if (ty2 > h)
-							ty2 = h;
-
-						if (tx > tx2)
-						{
-							tx = 1;
-							tx2 = 0;
-						}
-						if (ty > ty2)
-						{
-							ty = 1;
-							ty2 = 0;
-						}
-						ci->image->setValueRectange ("TRIMSEC", tx, tx2, ty, ty2, "TRIM binned section");
-					}
-				}
+	rts2core::DoubleArray *chan1_delta = getDoubleArray ("CHAN1_DELTA");
+	rts2core::DoubleArray *chan2_delta = getDoubleArray ("CHAN2_DELTA");
+
+	rts2core::DoubleArray *trim_x = getDoubleArray ("TRIM_X1");
+	rts2core::DoubleArray *trim_y = getDoubleArray ("TRIM_Y1");
+	rts2core::DoubleArray *trim_x2 = getDoubleArray ("TRIM_X2");
+	rts2core::DoubleArray *trim_y2 = getDoubleArray ("TRIM_Y2");
+
+	uint16_t chan = ntohs (imgh->channel) - 1;
+
+	int16_t x = ntohs (imgh->x);
+	int16_t y = ntohs (imgh->y);
+	int32_t w = ntohl (imgh->sizes[0]);
+	int32_t h = ntohl (imgh->sizes[1]);
+	int16_t bin1 = ntohs (imgh->binnings[0]);
+	int16_t bin2 = ntohs (imgh->binnings[1]);
+
+	// TV, TM - vector, matrixes
+	// for the momemt we assume detector == physical
+	double mods[NUM_WCS_VALUES] = {0, 0, 0, 0, 1, 1, 0};
 
-				std::ostringstream ccdsum;
-				ccdsum << bin1 << " " << bin2;
-				ci->image->setValue ("CCDSUM", ccdsum.str ().c_str (), "CCD binning");
+	if (chan1_offsets && chan < chan1_offsets->size ())
+		mods[2] += (*chan1_offsets)[chan];
+	if (chan2_offsets && chan < chan2_offsets->size ())
+		mods[3] += (*chan2_offsets)[chan];
+	if (chan1_delta && chan < chan1_delta->size ())
+		mods[4] *= (*chan1_delta)[chan];
+	if (chan2_delta && chan < chan2_delta->size ())
+		mods[5] *= (*chan2_delta)[chan];
 
-				ci->image->setValue ("LTV1", mods[2], "image beginning - detector X coordinate");
-				ci->image->setValue ("LTV2", mods[3], "image beginning - detector Y coordinate");
-				ci->image->setValue ("LTM1_1", mods[4], "delta along X axis");
-				ci->image->setValue ("LTM2_2", mods[5], "delta along Y axis");
+	// not sure about this, mayby should be commented out, same as following rows
+	// please change if you use channels features and will encounter problems
+	if (mods[4] > 0)
+		mods[2] *= -1;
+	if (mods[5] > 0)
+		mods[3] *= -1;
 
-				ci->image->setValue ("DTV1", 0, "detector transformation vector");
-				ci->image->setValue ("DTV2", 0, "detector transformation vector");
-				ci->image->setValue ("DTM1_1", 1, "detector transformation matrix");
-				ci->image->setValue ("DTM2_2", 1, "detector transformation matrix");
+	if (bin1 != 0)
+	{
+		mods[2] /= bin1;
+	}
+
+	if (bin2 != 0)
+	{
+		mods[3] /= bin2;
+	}
+
+	ci->image->writeWCS (mods);
+
+	if (detsize)
+	{
+		// write detector/channel orientation
+		ci->image->setValueRectange ("DETSIZE", detsize->getX ()->getValueDouble (), detsize->getWidth ()->getValueDouble (), detsize->getY ()->getValueDouble (), detsize->getHeight ()->getValueDouble (), "unbined detector size");
+		ci->image->setValueRectange ("DATASEC", 1, w, 1, h, "data binned section");
+
+		if (chan1_delta && chan < chan1_delta->size () && chan2_delta && chan < chan2_delta->size () && chan1_offsets && chan < chan1_offsets->size () && chan2_offsets && chan < chan2_offsets->size ())
+		{
+			double xx = (*chan1_offsets)[chan] + ((*chan1_delta)[chan] > 0 ? 1 : -1) * x;
+			double yy = (*chan2_offsets)[chan] + ((*chan2_delta)[chan] > 0 ? 1 : -1) * y;
+			ci->image->setValueRectange ("DETSEC",
+				xx,
+				xx + (*chan1_delta)[chan] * w * bin1,
+				yy,
+				yy + (*chan2_delta)[chan] * h * bin2,
+				"unbinned section of detector");
+			// write trim
+			if (trim_x || trim_y || trim_x2 || trim_y2)
+			{
+				double tx = NAN;
+				double ty = NAN;
+				double tx2 = NAN;
+				double ty2 = NAN;
+
+				if (trim_x && chan < trim_x->size ())
+					tx = (*trim_x)[chan] - x;
+			 	if (trim_y && chan < trim_y->size ())
+					ty = (*trim_y)[chan] - y;
+				if (trim_x2 && chan < trim_x2->size ())
+					tx2 = (*trim_x2)[chan] - x;
+				if (trim_y2 && chan < trim_y2->size ())
+					ty2 = (*trim_y2)[chan] - y;
+
+				if (tx <= 0)
+					tx = 1;
+				if (ty <= 0)
+					ty = 1;
+				if (tx2 <= 0)
+					tx2 = 1;
+				if (ty2 <= 0)
+					ty2 = 1;
+
+				// bin X and Y
+				tx /= bin1;
+				ty /= bin2;
+
+				tx2 /= bin1;
+				ty2 /= bin2;
+
+				if (tx2 > w)
+					tx2 = w;
+				if (ty2 > h)
+					ty2 = h;
+
+				if (tx > tx2)
+				{
+					tx = 1;
+					tx2 = 0;
+				}
+				if (ty > ty2)
+				{
+					ty = 1;
+					ty2 = 0;
+				}
+				ci->image->setValueRectange ("TRIMSEC", tx, tx2, ty, ty2, "TRIM binned section");
 			}
 		}
 
-		ci->image->moveHDU (1);
+		std::ostringstream ccdsum;
+		ccdsum << bin1 << " " << bin2;
+		ci->image->setValue ("CCDSUM", ccdsum.str ().c_str (), "CCD binning");
+
+		ci->image->setValue ("LTV1", mods[2], "image beginning - detector X coordinate");
+		ci->image->setValue ("LTV2", mods[3], "image beginning - detector Y coordinate");
+		ci->image->setValue ("LTM1_1", mods[4], "delta along X axis");
+		ci->image->setValue ("LTM2_2", mods[5], "delta along Y axis");
+
+		ci->image->setValue ("DTV1", 0, "detector transformation vector");
+		ci->image->setValue ("DTV2", 0, "detector transformation vector");
+		ci->image->setValue ("DTM1_1", 1, "detector transformation matrix");
+		ci->image->setValue ("DTM2_2", 1, "detector transformation matrix");
+	}
+}
+
+void DevClientCameraImage::imageWritten (CameraImages::iterator iter)
+{
+	CameraImage *ci = (*iter).second;
+
+	ci->image->moveHDU (1);
+
+	cameraImageReady (ci->image);
 
-		cameraImageReady (ci->image);
+	if (ci->canDelete ())
+	{
+		processCameraImage (iter);
+	}
+	else
+	{
+		logStream (MESSAGE_ERROR) << "getData, but not all metainfo - size of images:" << images.size () << sendLog;
+		getMaster ()->addTimer (180, new rts2core::Event (EVENT_METADATA_TIMEOUT, this));
+		checkImages.push_back (iter->second->image);
+	}
+}
 
-		if (ci->canDelete ())
+void DevClientCameraImage::checkWriteJobs ()
+{
+	ImageWriter *writer = ImageWriter::instance ();
+	// writer finishes images in order they were queued
+	while (!writeJobs.empty () && writer->isDone (writeJobs.front ()))
+	{
+		ImageWriteJob *job = writeJobs.front ();
+		writeJobs.pop_front ();
+
+		CameraImages::iterator iter;
+		for (iter = images.begin (); iter != images.end (); iter++)
 		{
-			processCameraImage (iter);
+			if (iter->second == job->ci)
+				break;
 		}
-		else
+
+		if (iter != images.end ())
 		{
-			logStream (MESSAGE_ERROR) << "getData, but not all metainfo - size of images:" << images.size () << sendLog;
-			getMaster ()->addTimer (180, new rts2core::Event (EVENT_METADATA_TIMEOUT, this));
-			checkImages.push_back (iter->second->image);
+			CameraImage *ci = job->ci;
+			ci->setWriting (false);
+			ci->dataWriten = true;
+			if (job->ret)
+				logStream (MESSAGE_ERROR) << "cannot write data of image " << ci->image->getAbsoluteFileName () << sendLog;
+			for (size_t i = 0; i < job->buffers.size (); i++)
+			{
+				ci->image->moveHDU (job->hdus[i]);
+				writeChannelHeaders (ci, (struct imghdr *) job->buffers[i]);
+			}
+			// metadata received during write go to the primary header
+			ci->image->moveHDU (1);
+			ci->flushMetaData ();
+			imageWritten (iter);
 		}
+		delete job;
 	}
-	else
+	if (!writeJobs.empty ())
+		getMaster ()->addTimer (WRITER_CHECK_INTERVAL, new rts2core::Event (EVENT_IMAGE_WRITTEN, this));
+}
+
+void DevClientCameraImage::waitWriteJobs ()
+{
+	for (std::list <ImageWriteJob *>::iterator iter = writeJobs.begin (); iter != writeJobs.end (); iter++)
 	{
-		logStream (MESSAGE_DEBUG) << "invalid data_conn: " << data_conn << sendLog;
+		ImageWriter::instance ()->wait (*iter);
+		delete *iter;
 	}
+	writeJobs.clear ();
 }
 
 void DevClientCameraImage::fitsData (const char *fn)
@@ -493,6 +609,11 @@ void DevClientCameraImage::processCameraImage (CameraImages::iterator cis)
 			// set filter..
 			// save us to the disk..
 			ci->image->saveImage ();
+#if defined(RTS2_HAVE_LIBJPEG) && RTS2_HAVE_LIBJPEG == 1
+			// generate pyramid in background, so browsing images does not need to read them again
+			if (previewCache)
+				previewCache->queuePyramid (ci->image->getAbsoluteFileName (), 0.005, previewChannel, PSEUDOCOLOUR_VARIANT_GREY);
+#endif
 		}
 		// do basic processing
 		imageProceRes res = processImage (ci->image);
@@ -546,6 +667,7 @@ void DevClientCameraImage::exposureStarted (bool expectImage)
 
 		if (image == NULL)
 			return;
+		image->setCompression (compression);
 		cameraMetadata (image);
 
 		const char *last_filename = image->getAbsoluteFileName ();
@@ -37,6 +37,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <libgen.h>
+#include <unistd.h>
 
 using namespace rts2image;
 
@@ -141,6 +142,9 @@ Image::Image (Image * in_image):FitsFile (in_image)
 	channels = in_image->channels;
 	dataType = in_image->dataType;
 	in_image->channels.clear ();
+	// data are now loaded from this image
+	for (Channels::iterator iter = channels.begin (); iter != channels.end (); iter++)
+		(*iter)->setLoader (this);
 	focPos = in_image->focPos;
 	signalNoise = in_image->signalNoise;
 	getFailed = in_image->getFailed;
@@ -909,6 +913,66 @@ void Image::writeWCS (double mods[NUM_WCS_VALUES])
 }
 
 int Image::writeData (char *in_data, char *fullTop, int nchan)
+{
+	return writeChannel (in_data, fullTop, nchan, NULL);
+}
+
+int Image::writeChannels (int nchan, char **data, char **tops, int *hdus)
+{
+	std::vector <CompressedChannel *> compressed (nchan, (CompressedChannel *) NULL);
+
+	// compress channels in parallel, compressed HDUs are then copied to the file
+	if (compression.isEnabled () && nchan > 1 && getFitsFile ())
+	{
+		std::vector <ChannelData> cd;
+		std::vector <int> chanIndex;
+		for (int i = 0; i < nchan; i++)
+		{
+			struct imghdr *im_h = (struct imghdr *) data[i];
+			if (ntohs (im_h->naxes) != 2)
+				continue;
+			ChannelData c;
+			c.compressed = new CompressedChannel ();
+			c.dataType = ntohs (im_h->data_type);
+			c.sizes[0] = ntohl (im_h->sizes[0]);
+			c.sizes[1] = ntohl (im_h->sizes[1]);
+			c.data = data[i] + sizeof (struct imghdr);
+			c.status = 0;
+			cd.push_back (c);
+			chanIndex.push_back (i);
+		}
+
+		compressChannels (compression, cd);
+
+		for (size_t i = 0; i < cd.size (); i++)
+		{
+			if (cd[i].status)
+			{
+				// will be compressed again by writeChannel, which reports the error
+				delete cd[i].compressed;
+				continue;
+			}
+			compressed[chanIndex[i]] = cd[i].compressed;
+		}
+	}
+
+	int ret = 0;
+	for (int i = 0; i < nchan; i++)
+	{
+		if (writeChannel (data[i], tops[i], nchan, compressed[i]))
+			ret = -1;
+		if (hdus)
+		{
+			hdus[i] = 1;
+			if (getFitsFile ())
+				fits_get_hdu_num (getFitsFile (), hdus + i);
+		}
+		delete compressed[i];
+	}
+	return ret;
+}
+
+int Image::writeChannel (char *in_data, char *fullTop, int nchan, CompressedChannel *compressed)
 {
 	struct imghdr *im_h = (struct imghdr *) in_data;
 	int ret;
@@ -955,7 +1019,29 @@ int Image::writeData (char *in_data, char *fullTop, int nchan)
 
 	// either put it as a new extension, or keep it in primary..
 
-	if (nchan == 1)
+	if (compression.isEnabled ())
+	{
+		// compressed images are always stored in extension
+		CompressedChannel local;
+		if (compressed == NULL)
+		{
+			fits_status = local.compress (compression, dataType, sizes, pixelData);
+			if (fits_status)
+			{
+				logStream (MESSAGE_ERROR) << "cannot compress image: " << getFitsErrors () << "dataType " << dataType << sendLog;
+				return -1;
+			}
+			compressed = &local;
+		}
+		compressed->copyTo (getFitsFile (), &fits_status);
+		if (fits_status)
+		{
+			logStream (MESSAGE_ERROR) << "cannot write compressed image: " << getFitsErrors () << sendLog;
+			return -1;
+		}
+		setValue ("INHERIT", true, "extension inherits primary header");
+	}
+	else if (nchan == 1)
 	{
 		if (dataType == RTS2_DATA_SBYTE)
 			fits_resize_img (getFitsFile (), RTS2_DATA_BYTE, 2, sizes, &fits_status);
@@ -987,38 +1073,41 @@ int Image::writeData (char *in_data, char *fullTop, int nchan)
 	ret = writeImgHeader (im_h, nchan);
 
 	long pixelSize = dataSize / getPixelByteSize ();
-	switch (dataType)
+	if (!compression.isEnabled ())
 	{
-		case RTS2_DATA_BYTE:
-			fits_write_img_byt (getFitsFile (), 0, 1, pixelSize, (unsigned char *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_SHORT:
-			fits_write_img_sht (getFitsFile (), 0, 1, pixelSize, (int16_t *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_LONG:
-			fits_write_img_int (getFitsFile (), 0, 1, pixelSize, (int *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_LONGLONG:
-			fits_write_img_lnglng (getFitsFile (), 0, 1, pixelSize, (LONGLONG *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_FLOAT:
-			fits_write_img_flt (getFitsFile (), 0, 1, pixelSize, (float *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_DOUBLE:
-			fits_write_img_dbl (getFitsFile (), 0, 1, pixelSize, (double *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_SBYTE:
-			fits_write_img_sbyt (getFitsFile (), 0, 1, pixelSize, (signed char *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_USHORT:
-			fits_write_img_usht (getFitsFile (), 0, 1, pixelSize, (short unsigned int *) pixelData, &fits_status);
-			break;
-		case RTS2_DATA_ULONG:
-			fits_write_img_uint (getFitsFile (), 0, 1, pixelSize, (unsigned int *) pixelData, &fits_status);
-			break;
-		default:
-			logStream (MESSAGE_ERROR) << "Unknow dataType " << dataType << sendLog;
-			return -1;
+		switch (dataType)
+		{
+			case RTS2_DATA_BYTE:
+				fits_write_img_byt (getFitsFile (), 0, 1, pixelSize, (unsigned char *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_SHORT:
+				fits_write_img_sht (getFitsFile (), 0, 1, pixelSize, (int16_t *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_LONG:
+				fits_write_img_int (getFitsFile (), 0, 1, pixelSize, (int *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_LONGLONG:
+				fits_write_img_lnglng (getFitsFile (), 0, 1, pixelSize, (LONGLONG *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_FLOAT:
+				fits_write_img_flt (getFitsFile (), 0, 1, pixelSize, (float *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_DOUBLE:
+				fits_write_img_dbl (getFitsFile (), 0, 1, pixelSize, (double *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_SBYTE:
+				fits_write_img_sbyt (getFitsFile (), 0, 1, pixelSize, (signed char *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_USHORT:
+				fits_write_img_usht (getFitsFile (), 0, 1, pixelSize, (short unsigned int *) pixelData, &fits_status);
+				break;
+			case RTS2_DATA_ULONG:
+				fits_write_img_uint (getFitsFile (), 0, 1, pixelSize, (unsigned int *) pixelData, &fits_status);
+				break;
+			default:
+				logStream (MESSAGE_ERROR) << "Unknow dataType " << dataType << sendLog;
+				return -1;
+		}
 	}
 	if (fits_status)
 	{
@@ -1027,10 +1116,17 @@ int Image::writeData (char *in_data, char *fullTop, int nchan)
 	}
 	if (writeRTS2Values)
 	{
-		ch->computeStatistics (0, pixelSize);
+		bool robust = rts2core::Configuration::instance ()->getRobustStatistics ();
+		ch->computeStatistics (0, pixelSize, robust);
 
 		setValue ("AVERAGE", ch->getAverage (), "average value of image");
 		setValue ("STDEV", ch->getStDev (), "standard deviation value of image");
+		if (robust)
+		{
+			setValue ("MEDIAN", ch->getMedian (), "median value of image");
+			setValue ("MAD", ch->getMAD (), "median absolute deviation of image");
+			setValue ("CLMEAN", ch->getClippedMean (), "3 sigma clipped mean of image");
+		}
 	}
 	return ret;
 }
@@ -1083,60 +1179,46 @@ void Image::getImgHeader (struct imghdr *im_h, int chan)
 
 void Image::getHistogram (long *histogram, long nbins)
 {
-	memset (histogram, 0, nbins * sizeof(int));
-	int bins;
+	memset (histogram, 0, nbins * sizeof (long));
 	if (channels.size () == 0)
 		loadChannels ();
 
-	switch (dataType)
+	for (size_t chan = 0; chan < channels.size (); chan++)
 	{
-		case RTS2_DATA_USHORT:
-			bins = 65536 / nbins;
-			for (Channels::iterator iter = channels.begin (); iter != channels.end (); iter++)
-			{
-				for (uint16_t *d = (uint16_t *)((*iter)->getData ()); d < ((uint16_t *)((*iter)->getData ())) + ((*iter)->getNPixels ()); d++)
-				{
-					histogram[*d / bins]++;
-				}
-			}
-			break;
-		case RTS2_DATA_FLOAT:
-			bins = 65536 / nbins;
-			for (Channels::iterator iter = channels.begin (); iter != channels.end (); iter++)
-			{
-				for (float *d = (float *)((*iter)->getData ()); d < ((float *)((*iter)->getData ())) + ((*iter)->getNPixels ()); d++)
-				{
-					histogram[((uint16_t)*d) / bins]++;
-				}
-			}
-			break;
-		default:
-			break;
+		const void *data = getChannelData (chan);
+		if (data == NULL)
+			continue;
+		switch (dataType)
+		{
+			case RTS2_DATA_USHORT:
+				histogramUShort ((const uint16_t *) data, channels[chan]->getNPixels (), histogram, nbins);
+				break;
+			case RTS2_DATA_FLOAT:
+				histogramFloat ((const float *) data, channels[chan]->getNPixels (), histogram, nbins);
+				break;
+			default:
+				break;
+		}
 	}
 }
 
 void Image::getChannelHistogram (int chan, long *histogram, long nbins)
 {
-	memset (histogram, 0, nbins * sizeof(int));
-	int bins;
+	memset (histogram, 0, nbins * sizeof (long));
 	if (channels.size () == 0)
 		loadChannels ();
 
+	const void *data = getChannelData (chan);
+	if (data == NULL)
+		return;
+
 	switch (dataType)
 	{
 		case RTS2_DATA_USHORT:
-			bins = 65536 / nbins;
-			for (uint16_t *d = (uint16_t *)(channels[chan]->getData ()); d < ((uint16_t *)(channels[chan]->getData ()) + channels[chan]->getNPixels ()); d++)
-			{
-				histogram[*d / bins]++;
-			}
+			histogramUShort ((const uint16_t *) data, channels[chan]->getNPixels (), histogram, nbins);
 			break;
 		case RTS2_DATA_FLOAT:
-			bins = 65536 / nbins;
-			for (float *d = (float *)(channels[chan]->getData ()); d < ((float *)(channels[chan]->getData ()) + channels[chan]->getNPixels ()); d++)
-			{
-				histogram[((uint16_t)*d) / bins]++;
-			}
+			histogramFloat ((const float *) data, channels[chan]->getNPixels (), histogram, nbins);
 			break;
 		default:
 			break;
@@ -1146,58 +1228,21 @@ void Image::getChannelHistogram (int chan, long *histogram, long nbins)
 
 template <typename bt, typename dt> void Image::getChannelGrayscaleByteBuffer (int chan, bt * &buf, bt black, dt low, dt high, long s, size_t offset, bool invert_y)
 {
+	const dt *data = (const dt *) getChannelData (chan);
+	if (data == NULL)
+		throw ErrorOpeningFitsFile (getFileName ());
+
 	if (buf == NULL)
 		buf = new bt[s];
-	
-	bt *k = buf;
-
-	if (invert_y)
-		k += (getChannelWidth (chan) + offset) * (getChannelHeight (chan) - 1);
-
-	const void *imageData = getChannelData (chan);
-
-	int chw = getChannelWidth (chan);
-	int j = chw;
 
-	for (int i = 0; (long) i < s; i++)
-	{
-		bt n;
-		dt pix = ((dt *)imageData)[i];
-		if (pix <= low)
-		{
-			n = black;
-		}
-		else if (pix >= high)
-		{
-			n = 0;
-		}
-		else
-		{
-			// linear scaling
-			n = black - black * ((double (pix - low)) / (high - low));
-		}
-		*k = n;
-		k++;
-		if (offset != 0 || invert_y)
-		{
-			j--;
-			if (j == 0)
-			{
-				if (invert_y)
-					k -= 2 * chw + offset;
-				else
-			  		k += offset;
-				j = chw;
-			}
-		}
-	}
+	scaleGrayscale (data, getChannelWidth (chan), getChannelHeight (chan), buf, black, low, high, offset, invert_y);
 }
 
 
 template <typename bt, typename dt> void Image::getChannelGrayscaleBuffer (int chan, bt * &buf, bt black, dt minval, dt mval, float quantiles, size_t offset, bool invert_y)
 {
-	long hist[65536];
-	getChannelHistogram (chan, hist, 65536);
+	std::vector <long> hist (65536);
+	getChannelHistogram (chan, &(hist[0]), 65536);
 
 	long psum = 0;
 	dt low = minval;
@@ -1284,147 +1329,24 @@ void Image::getChannelGrayscaleImage (int _dataType, int chan, unsigned char * &
 
 template <typename bt, typename dt> void Image::getChannelPseudocolourByteBuffer (int chan, bt * &buf, bt black, dt low, dt high, long s, size_t offset, bool invert_y, int colourVariant)
 {
-	if (buf == NULL)
-		buf = new bt[3 * s];
-	
-	double n;
-	bt nR, nG, nB;
-
-	bt *k = buf;
+	if (colourVariant < PSEUDOCOLOUR_VARIANT_GREY || colourVariant > PSEUDOCOLOUR_VARIANT_MALACHIT_INV)
+		logStream (MESSAGE_ERROR) << "Unknown colourVariant" << colourVariant << sendLog;
 
-	if (invert_y)
-		k += 3 * (getChannelWidth (chan) + offset) * (getChannelHeight (chan) - 1);
+	const dt *data = (const dt *) getChannelData (chan);
+	if (data == NULL)
+		throw ErrorOpeningFitsFile (getFileName ());
 
-	const void *imageData = getChannelData (chan);
-
-	int chw = getChannelWidth (chan);
-	int j = chw;
-
-	for (int i = 0; (long) i < s; i++)
-	{
-		dt pix = ((dt *)imageData)[i];
-
-		if ( pix < low )
-			pix = low;
-		if ( pix > high )
-			pix = high;
-
-		switch (colourVariant)
-		{
-			case PSEUDOCOLOUR_VARIANT_GREY:
-				n = 255.0 * double (pix - low) / double (high - low);
-				nR = n;
-				nG = nR;
-				nB = nR;
-				break;
-			case PSEUDOCOLOUR_VARIANT_GREY_INV:
-				n = 255.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = n;
-				nG = nR;
-				nB = nR;
-				break;
-			case PSEUDOCOLOUR_VARIANT_BLUE:
-				n = 511.0 * double (pix - low) / double (high - low);
-				nR = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nG = n / 2.0;
-				nB = (n < 256.0) ? n : 255;
-				break;
-			case PSEUDOCOLOUR_VARIANT_BLUE_INV:
-				n = 511.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nG = n / 2.0;
-				nB = (n < 256.0) ? n : 255;
-				break;
-			case PSEUDOCOLOUR_VARIANT_RED:
-				n = 511.0 * double (pix - low) / double (high - low);
-				nR = (n < 256.0) ? n : 255;
-				nG = n / 2.0;
-				nB = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_RED_INV:
-				n = 511.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = (n < 256.0) ? n : 255;
-				nG = n / 2.0;
-				nB = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_GREEN:
-				n = 511.0 * double (pix - low) / double (high - low);
-				nR = n / 2.0;
-				nG = (n < 256.0) ? n : 255;
-				nB = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_GREEN_INV:
-				n = 511.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = n / 2.0;
-				nG = (n < 256.0) ? n : 255;
-				nB = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_VIOLET:
-				n = 511.0 * double (pix - low) / double (high - low);
-				nR = n / 2.0;
-				nG = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nB = (n < 256.0) ? n : 255;
-				break;
-			case PSEUDOCOLOUR_VARIANT_VIOLET_INV:
-				n = 511.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = n / 2.0;
-				nG = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nB = (n < 256.0) ? n : 255;
-				break;
-			case PSEUDOCOLOUR_VARIANT_MAGENTA:
-				n = 511.0 * double (pix - low) / double (high - low);
-				nR = (n < 256.0) ? n : 255;
-				nG = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nB = n / 2.0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_MAGENTA_INV:
-				n = 511.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = (n < 256.0) ? n : 255;
-				nG = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nB = n / 2.0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_MALACHIT:
-				n = 511.0 * double (pix - low) / double (high - low);
-				nR = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nG = (n < 256.0) ? n : 255;
-				nB = n / 2.0;
-				break;
-			case PSEUDOCOLOUR_VARIANT_MALACHIT_INV:
-				n = 511.0 * ( 1.0 - double (pix - low) / double (high - low) );
-				nR = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
-				nG = (n < 256.0) ? n : 255;
-				nB = n / 2.0;
-				break;
-			default:
-				logStream (MESSAGE_ERROR) << "Unknown colourVariant" << colourVariant << sendLog;
-		}
+	if (buf == NULL)
+		buf = new bt[3 * s];
 
-		*k = nR;
-		k++;
-		*k = nG;
-		k++;
-		*k = nB;
-		k++;
-		if (offset != 0 || invert_y)
-		{
-			j--;
-			if (j == 0)
-			{
-				if (invert_y)
-					k -= 3 * (2 * chw + offset);
-				else
-			  		k += 3 * offset;
-				j = chw;
-			}
-		}
-	}
+	scalePseudocolour (data, getChannelWidth (chan), getChannelHeight (chan), buf, low, high, offset, invert_y, colourVariant);
 }
 
 
 template <typename bt, typename dt> void Image::getChannelPseudocolourBuffer (int chan, bt * &buf, bt black, dt minval, dt mval, float quantiles, size_t offset, bool invert_y, int colourVariant)
 {
-	long hist[65536];
-	getChannelHistogram (chan, hist, 65536);
+	std::vector <long> hist (65536);
+	getChannelHistogram (chan, &(hist[0]), 65536);
 
 	long psum = 0;
 	dt low = minval;
@@ -1646,6 +1568,13 @@ Magick::Image *Image::getMagickImage (const char *label, float quantiles, int ch
 		delete image;
 		throw ex;
 	}
+	catch (rts2core::Error &er)
+	{
+		// channel data cannot be read
+		delete[] buf;
+		delete image;
+		throw;
+	}
 }
 
 void Image::writeLabel (Magick::Image *mimage, int x, int y, unsigned int fs, const char *labelText)
@@ -1839,11 +1768,13 @@ void Image::setFilter (const char *in_filter)
 		setValue ("FILTER", filter, "camera filter as string");
 }
 
-void Image::computeStatistics (size_t _from, size_t _dataSize)
+void Image::computeStatistics (size_t _from, size_t _dataSize, bool robust)
 {
 	if (channels.size () == 0)
 		loadChannels ();
 
+	channels.computeStatistics (_from, _dataSize, robust);
+
 	long double pixelSum = 0;
 	long totalSize = 0;
 
@@ -1851,8 +1782,6 @@ void Image::computeStatistics (size_t _from, size_t _dataSize)
 
 	for (Channels::iterator iter = channels.begin (); iter != channels.end (); iter++)
 	{
-		(*iter)->computeStatistics (_from, _dataSize);
-
 		totalSize += (*iter)->getNPixels ();
 		pixelSum += (*iter)->getPixelSum ();
 		avg_stdev += (*iter)->getStDev ();
@@ -1867,8 +1796,6 @@ void Image::computeStatistics (size_t _from, size_t _dataSize)
 
 void Image::loadChannels ()
 {
-	// try to load data..
-	int anyNull = 0;
 	if (!getFitsFile ())
 		openFile (NULL, false, true);
 
@@ -1883,7 +1810,7 @@ void Image::loadChannels ()
 
 	int hdunum = 0;
 
-	// open all channels
+	// find all channels, their data are loaded on first access
 	while (fits_status == 0)
 	{
 	  	if (tothdu < 0)
@@ -1908,8 +1835,14 @@ void Image::loadChannels ()
 			continue;
 
 		// check that it has some axis..
+		// image parameters are read by CFITSIO calls, as keywords of tile compressed image describe binary table
 		int naxis = 0;
-		getValue ("NAXIS", naxis, true);
+		fits_get_img_dim (getFitsFile (), &naxis, &fits_status);
+		if (fits_status)
+		{
+			logStream (MESSAGE_ERROR) << "cannot retrieve image dimension: " << getFitsErrors () << sendLog;
+			return;
+		}
 		if (naxis == 0)
 			continue;
 
@@ -1931,57 +1864,24 @@ void Image::loadChannels ()
 			return;
 		}
 
-		// get its size..
-		long sizes[naxis];
-		getValues ("NAXIS", sizes, naxis, true);
-
-		long pixelSize = sizes[0];
-		for (int i = 1; i < naxis; i++)
-			pixelSize *= sizes[i];
-
-		char *imageData = new char[pixelSize * getPixelByteSize ()];
-		switch (dataType)
+		if (fitsDataType (dataType) < 0)
 		{
-			case RTS2_DATA_BYTE:
-				fits_read_img_byt (getFitsFile (), 0, 1, pixelSize, 0, (unsigned char *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_SHORT:
-				fits_read_img_sht (getFitsFile (), 0, 1, pixelSize, 0, (int16_t *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_LONG:
-				fits_read_img_int (getFitsFile (), 0, 1, pixelSize, 0, (int *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_LONGLONG:
-				fits_read_img_lnglng (getFitsFile (), 0, 1, pixelSize, 0, (LONGLONG *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_FLOAT:
-				fits_read_img_flt (getFitsFile (), 0, 1, pixelSize, 0, (float *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_DOUBLE:
-				fits_read_img_dbl (getFitsFile (), 0, 1, pixelSize, 0, (double *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_SBYTE:
-				fits_read_img_sbyt (getFitsFile (), 0, 1, pixelSize, 0, (signed char *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_USHORT:
-				fits_read_img_usht (getFitsFile (), 0, 1, pixelSize, 0,(short unsigned int *) imageData, &anyNull, &fits_status);
-				break;
-			case RTS2_DATA_ULONG:
-				fits_read_img_uint (getFitsFile (), 0, 1, pixelSize, 0, (unsigned int *) imageData, &anyNull, &fits_status);
-				break;
-			default:
-				logStream (MESSAGE_ERROR) << "Unknow dataType " << dataType << sendLog;
-				delete[] imageData;
-				dataType = 0;
-				throw ErrorOpeningFitsFile (getFileName ());
+			logStream (MESSAGE_ERROR) << "Unknow dataType " << dataType << sendLog;
+			dataType = 0;
+			throw ErrorOpeningFitsFile (getFileName ());
 		}
+
+		// get its size..
+		long sizes[naxis];
+		fits_get_img_size (getFitsFile (), naxis, sizes, &fits_status);
 		if (fits_status)
 		{
-			delete[] imageData;
-			dataType = 0;
-			throw ErrorOpeningFitsFile (getFileName ());
+			logStream (MESSAGE_ERROR) << "cannot retrieve image size: " << getFitsErrors () << sendLog;
+			return;
 		}
-		fitsStatusGetValue ("image loadChannels", true);
+
+		int hdu;
+		fits_get_hdu_num (getFitsFile (), &hdu);
 
 		int ch;
 		try
@@ -2012,12 +1912,119 @@ void Image::loadChannels ()
 				ch = hdunum;
 			}
 		}
-		channels.push_back (new Channel (ch, imageData, naxis, sizes, dataType, true));
+		channels.push_back (new Channel (ch, naxis, sizes, dataType, this, hdu));
 		hdunum++;
 	}
 	moveHDU (1);
 }
 
+void Image::loadChannelData (Channel *ch)
+{
+	if (!getFitsFile ())
+		openFile (NULL, false, true);
+
+	int oldhdu;
+	fits_get_hdu_num (getFitsFile (), &oldhdu);
+
+	moveHDU (ch->getHDU ());
+
+	long pixelSize = ch->getNPixels ();
+	for (int i = 2; i < ch->getNaxis (); i++)
+		pixelSize *= ch->getSize (i);
+
+	int anyNull = 0;
+	char *imageData = new char[pixelSize * ch->getPixelByteSize ()];
+
+	fits_status = 0;
+	fits_read_img (getFitsFile (), fitsDataType (ch->getDataType ()), 1, pixelSize, NULL, imageData, &anyNull, &fits_status);
+	if (fits_status)
+	{
+		delete[] imageData;
+		logStream (MESSAGE_ERROR) << "cannot read data of channel " << ch->getChannelNumber () << ": " << getFitsErrors () << sendLog;
+		moveHDU (oldhdu);
+		throw ErrorOpeningFitsFile (getFileName ());
+	}
+	fitsStatusGetValue ("image loadChannelData", true);
+
+	ch->setData (imageData, true);
+
+	moveHDU (oldhdu);
+}
+
+int Image::getChannelSubset (int chan, long x, long y, long w, long h, void *buf)
+{
+	if (channels.size () == 0)
+	{
+		try
+		{
+			loadChannels ();
+		}
+		catch (rts2core::Error &er)
+		{
+			logStream (MESSAGE_ERROR) << er << sendLog;
+			return -1;
+		}
+	}
+
+	if (chan < 0 || (size_t) chan >= channels.size ())
+		return -1;
+
+	Channel *ch = channels[chan];
+	if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > ch->getWidth () || y + h > ch->getHeight ())
+		return -1;
+
+	int pixelByteSize = ch->getPixelByteSize ();
+
+	// data in memory, copy them
+	if (ch->isLoaded () || ch->getHDU () < 0)
+	{
+		const char *data = (const char *) getChannelData (chan);
+		if (data == NULL)
+			return -1;
+		for (long r = 0; r < h; r++)
+			memcpy (((char *) buf) + r * w * pixelByteSize, data + ((y + r) * ch->getWidth () + x) * pixelByteSize, w * pixelByteSize);
+		return 0;
+	}
+
+	if (!getFitsFile ())
+		openFile (NULL, false, true);
+
+	int oldhdu;
+	fits_get_hdu_num (getFitsFile (), &oldhdu);
+
+	moveHDU (ch->getHDU ());
+
+	long naxis = ch->getNaxis ();
+	long fpixel[naxis];
+	long lpixel[naxis];
+	long inc[naxis];
+	for (int i = 0; i < naxis; i++)
+	{
+		fpixel[i] = 1;
+		lpixel[i] = 1;
+		inc[i] = 1;
+	}
+	fpixel[0] = x + 1;
+	fpixel[1] = y + 1;
+	lpixel[0] = x + w;
+	lpixel[1] = y + h;
+
+	int anyNull = 0;
+	fits_status = 0;
+	fits_read_subset (getFitsFile (), fitsDataType (ch->getDataType ()), fpixel, lpixel, inc, NULL, buf, &anyNull, &fits_status);
+
+	int ret = 0;
+	if (fits_status)
+	{
+		logStream (MESSAGE_ERROR) << "cannot read region of channel " << ch->getChannelNumber () << ": " << getFitsErrors () << sendLog;
+		fits_status = 0;
+		ret = -1;
+	}
+
+	moveHDU (oldhdu);
+	return ret;
+}
+
 const void* Image::getChannelData (int chan)
 {
 	if (channels.size () == 0)
@@ -2032,7 +2039,15 @@ const void* Image::getChannelData (int chan)
 			return NULL;
 		}
 	}
-	return channels[chan]->getData ();
+	try
+	{
+		return channels[chan]->getData ();
+	}
+	catch (rts2core::Error &er)
+	{
+		logStream (MESSAGE_ERROR) << er << sendLog;
+		return NULL;
+	}
 }
 
 template <typename bt, typename dt> const bt * scaleData (dt * data, size_t numpix, dt smin, dt smax, scaling_type scaling, bt white)
@@ -2106,7 +2121,10 @@ const void * rts2image::getScaledData (int dataType, const void *data, size_t nu
 
 const void * Image::getChannelDataScaled (int chan, long smin, long smax, scaling_type scaling, int newType)
 {
-	return getScaledData (dataType, getChannelData (chan), getChannelNPixels (chan), smin, smax, scaling, newType);
+	const void *data = getChannelData (chan);
+	if (data == NULL)
+		return NULL;
+	return getScaledData (dataType, data, getChannelNPixels (chan), smin, smax, scaling, newType);
 }
 
 int Image::setAstroResults (double in_ra, double in_dec, double in_ra_err, double in_dec_err)
@@ -2586,6 +2604,33 @@ void Image::setEnvironmentalValues ()
 	}
 }
 
+void Image::copyConnValues (rts2core::Connection * conn, imageWriteWhich_t which, std::vector <rts2core::Value *> &copies)
+{
+	if (!writeConnection)
+		return;
+	int32_t when = (which == INFO_CALLED) ? RTS2_VWHEN_BEFORE_END : RTS2_VWHEN_TRIGGERED;
+	for (rts2core::ValueVector::iterator iter = conn->valueBegin (); iter != conn->valueEnd (); iter++)
+	{
+		rts2core::Value *val = *iter;
+		if (val->getWriteToFits () && val->getValueWriteFlags () == when)
+		{
+			rts2core::Value *dup = duplicateValue (val, true);
+			if (dup)
+				copies.push_back (dup);
+		}
+	}
+}
+
+void Image::writeConnValues (rts2core::Connection * conn, std::vector <rts2core::Value *> &copies)
+{
+	for (std::vector <rts2core::Value *>::iterator iter = copies.begin (); iter != copies.end (); iter++)
+	{
+		writeConnValue (conn, *iter);
+		delete *iter;
+	}
+	copies.clear ();
+}
+
 void Image::writeConn (rts2core::Connection * conn, imageWriteWhich_t which)
 {
 	if (writeConnection)
@@ -0,0 +1,556 @@
+/*
+ * Scaling of image data for display.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "rts2fits/imagescale.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCALE_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCALE_SSE2
+#endif
+
+using namespace rts2image;
+
+const char *rts2image::getScalingKernelName ()
+{
+#if defined(SCALE_AVX2)
+	return "AVX2";
+#elif defined(SCALE_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+static int defaultScalingThreads ()
+{
+	long n = sysconf (_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		return 1;
+	return n > 8 ? 8 : n;
+}
+
+static int scalingThreads = defaultScalingThreads ();
+
+void rts2image::setScalingThreads (int threads)
+{
+	scalingThreads = threads < 1 ? 1 : threads;
+}
+
+int rts2image::getScalingThreads ()
+{
+	return scalingThreads;
+}
+
+struct PartArg
+{
+	partFunction fn;
+	void *arg;
+	size_t start;
+	size_t end;
+};
+
+static void *partThread (void *a)
+{
+	PartArg *p = (PartArg *) a;
+	p->fn (p->arg, p->start, p->end);
+	return NULL;
+}
+
+void rts2image::runParts (partFunction fn, void *arg, size_t n, size_t pixels)
+{
+	size_t threads = getScalingThreads ();
+	if (threads > n)
+		threads = n;
+	if (pixels < SCALE_THREAD_MIN_PIXELS || threads < 2)
+	{
+		fn (arg, 0, n);
+		return;
+	}
+
+	std::vector <PartArg> parts (threads);
+	std::vector <pthread_t> tids (threads);
+	std::vector <bool> started (threads, false);
+
+	for (size_t i = 0; i < threads; i++)
+	{
+		parts[i].fn = fn;
+		parts[i].arg = arg;
+		parts[i].start = n * i / threads;
+		parts[i].end = n * (i + 1) / threads;
+	}
+
+	for (size_t i = 1; i < threads; i++)
+		started[i] = (pthread_create (&(tids[i]), NULL, partThread, &(parts[i])) == 0);
+
+	fn (arg, parts[0].start, parts[0].end);
+
+	for (size_t i = 1; i < threads; i++)
+	{
+		if (started[i])
+			pthread_join (tids[i], NULL);
+		else
+			// thread cannot be started, process its part
+			fn (arg, parts[i].start, parts[i].end);
+	}
+}
+
+// histogram and lookup table loops are scalar: SSE2 has no gather or
+// scatter, AVX2 gathers are not faster than scalar loads from the small
+// tables, and histogram increments of equal values would collide in vector
+// lanes. The threads split rows instead.
+template <typename dt> struct HistogramArg
+{
+	const dt *data;
+	long *histogram;
+	long nbins;
+	pthread_mutex_t mutex;
+};
+
+template <typename dt> static void histogramPart (void *a, size_t start, size_t end)
+{
+	HistogramArg <dt> *arg = (HistogramArg <dt> *) a;
+	std::vector <long> local (arg->nbins, 0);
+	long bins = 65536 / arg->nbins;
+
+	for (const dt *d = arg->data + start; d < arg->data + end; d++)
+		local[((uint16_t) *d) / bins]++;
+
+	pthread_mutex_lock (&(arg->mutex));
+	for (long i = 0; i < arg->nbins; i++)
+		arg->histogram[i] += local[i];
+	pthread_mutex_unlock (&(arg->mutex));
+}
+
+template <typename dt> static void histogram (const dt *data, size_t n, long *histogram, long nbins)
+{
+	HistogramArg <dt> arg;
+	arg.data = data;
+	arg.histogram = histogram;
+	arg.nbins = nbins;
+	pthread_mutex_init (&(arg.mutex), NULL);
+
+	runParts (histogramPart <dt>, &arg, n, n);
+
+	pthread_mutex_destroy (&(arg.mutex));
+}
+
+void rts2image::histogramUShort (const uint16_t *data, size_t n, long *histogram, long nbins)
+{
+	::histogram (data, n, histogram, nbins);
+}
+
+void rts2image::histogramFloat (const float *data, size_t n, long *histogram, long nbins)
+{
+	::histogram (data, n, histogram, nbins);
+}
+
+/**
+ * Lookup tables are used for data types with at most 16 bits. Index is
+ * unsigned representation of the value.
+ */
+template <typename dt> struct ScaleLUT
+{
+	enum { size = 0 };
+	static size_t index (dt v) { return 0; }
+	static dt value (size_t i) { return 0; }
+};
+
+template <> struct ScaleLUT <signed char>
+{
+	enum { size = 256 };
+	static size_t index (signed char v) { return (uint8_t) v; }
+	static signed char value (size_t i) { return (signed char) (uint8_t) i; }
+};
+
+template <> struct ScaleLUT <short>
+{
+	enum { size = 65536 };
+	static size_t index (short v) { return (uint16_t) v; }
+	static short value (size_t i) { return (short) (uint16_t) i; }
+};
+
+template <> struct ScaleLUT <unsigned short>
+{
+	enum { size = 65536 };
+	static size_t index (unsigned short v) { return v; }
+	static unsigned short value (size_t i) { return i; }
+};
+
+template <typename bt, typename dt> struct ScaleArg
+{
+	const dt *data;
+	int width;
+	int height;
+	bt *buf;
+	// output row length, in bt values
+	size_t stride;
+	bool invert_y;
+
+	// lookup table, NULL if values are calculated
+	const bt *lut;
+
+	// pseudocolour palette
+	const bt *palette;
+
+	double black;
+	double low;
+	double scale;
+};
+
+template <typename bt, typename dt> static inline bt * outputRow (ScaleArg <bt, dt> *arg, size_t y)
+{
+	return arg->buf + (arg->invert_y ? (arg->height - 1 - y) : y) * arg->stride;
+}
+
+/**
+ * Vector kernel of grayscale scaling. Returns number of processed pixels,
+ * rest of the row is scaled by the scalar loop. Calculates in double
+ * precision with the same operations as the scalar loop, so the results
+ * are identical.
+ */
+template <typename bt, typename dt> static inline int grayscaleRowVector (const dt *row, int width, bt *out, double black, double low, double scale)
+{
+	return 0;
+}
+
+#if defined(SCALE_AVX2) || defined(SCALE_SSE2)
+static inline int grayscaleRowVector (const float *row, int width, unsigned char *out, double black, double low, double scale)
+{
+	int x = 0;
+#if defined(SCALE_AVX2)
+	const __m256d vLow = _mm256_set1_pd (low);
+	const __m256d vScale = _mm256_set1_pd (scale);
+	const __m256d vBlack = _mm256_set1_pd (black);
+	const __m256d zero = _mm256_setzero_pd ();
+	for (; x + 8 <= width; x += 8)
+	{
+		// max returns second operand for NaN, so NaNs are black
+		__m256d v0 = _mm256_mul_pd (_mm256_sub_pd (_mm256_cvtps_pd (_mm_loadu_ps (row + x)), vLow), vScale);
+		v0 = _mm256_min_pd (_mm256_max_pd (v0, zero), vBlack);
+		__m256d v1 = _mm256_mul_pd (_mm256_sub_pd (_mm256_cvtps_pd (_mm_loadu_ps (row + x + 4)), vLow), vScale);
+		v1 = _mm256_min_pd (_mm256_max_pd (v1, zero), vBlack);
+		__m128i w = _mm_packs_epi32 (_mm256_cvttpd_epi32 (_mm256_sub_pd (vBlack, v0)), _mm256_cvttpd_epi32 (_mm256_sub_pd (vBlack, v1)));
+		_mm_storel_epi64 ((__m128i *) (out + x), _mm_packus_epi16 (w, w));
+	}
+#else
+	const __m128d vLow = _mm_set1_pd (low);
+	const __m128d vScale = _mm_set1_pd (scale);
+	const __m128d vBlack = _mm_set1_pd (black);
+	const __m128d zero = _mm_setzero_pd ();
+	for (; x + 8 <= width; x += 8)
+	{
+		__m128i i[4];
+		for (int j = 0; j < 2; j++)
+		{
+			__m128 f = _mm_loadu_ps (row + x + 4 * j);
+			// max returns second operand for NaN, so NaNs are black
+			__m128d vl = _mm_mul_pd (_mm_sub_pd (_mm_cvtps_pd (f), vLow), vScale);
+			__m128d vh = _mm_mul_pd (_mm_sub_pd (_mm_cvtps_pd (_mm_movehl_ps (f, f)), vLow), vScale);
+			vl = _mm_min_pd (_mm_max_pd (vl, zero), vBlack);
+			vh = _mm_min_pd (_mm_max_pd (vh, zero), vBlack);
+			i[2 * j] = _mm_cvttpd_epi32 (_mm_sub_pd (vBlack, vl));
+			i[2 * j + 1] = _mm_cvttpd_epi32 (_mm_sub_pd (vBlack, vh));
+		}
+		// conversion fills two low lanes
+		__m128i w = _mm_packs_epi32 (_mm_unpacklo_epi64 (i[0], i[1]), _mm_unpacklo_epi64 (i[2], i[3]));
+		_mm_storel_epi64 ((__m128i *) (out + x), _mm_packus_epi16 (w, w));
+	}
+#endif
+	return x;
+}
+#endif
+
+template <typename bt, typename dt> static void grayscaleRows (void *a, size_t start, size_t end)
+{
+	ScaleArg <bt, dt> *arg = (ScaleArg <bt, dt> *) a;
+	const int width = arg->width;
+
+	for (size_t y = start; y < end; y++)
+	{
+		const dt *row = arg->data + y * width;
+		bt *out = outputRow (arg, y);
+		if (arg->lut)
+		{
+			const bt *lut = arg->lut;
+			for (int x = 0; x < width; x++)
+				out[x] = lut[ScaleLUT <dt>::index (row[x])];
+		}
+		else
+		{
+			const double black = arg->black;
+			const double low = arg->low;
+			const double scale = arg->scale;
+			// NaNs are black
+			for (int x = grayscaleRowVector (row, width, out, black, low, scale); x < width; x++)
+			{
+				double v = ((double) row[x] - low) * scale;
+				v = v > 0 ? v : 0;
+				v = v < black ? v : black;
+				out[x] = (bt) (black - v);
+			}
+		}
+	}
+}
+
+template <typename bt, typename dt> static inline bt grayscaleValue (dt pix, bt black, dt low, dt high)
+{
+	if (pix <= low)
+		return black;
+	if (pix >= high)
+		return 0;
+	return black - black * ((double (pix - low)) / (high - low));
+}
+
+template <typename bt, typename dt> void rts2image::scaleGrayscale (const dt *data, int width, int height, bt *buf, bt black, dt low, dt high, size_t offset, bool invert_y)
+{
+	ScaleArg <bt, dt> arg;
+	arg.data = data;
+	arg.width = width;
+	arg.height = height;
+	arg.buf = buf;
+	arg.stride = width + offset;
+	arg.invert_y = invert_y;
+	arg.lut = NULL;
+	arg.palette = NULL;
+	arg.black = black;
+	arg.low = low;
+	arg.scale = high > low ? arg.black / ((double) high - (double) low) : INFINITY;
+
+	size_t pixels = (size_t) width * height;
+
+	std::vector <bt> lut;
+	// lookup table is faster only if it is smaller than the image
+	if (ScaleLUT <dt>::size > 0 && pixels > (size_t) ScaleLUT <dt>::size)
+	{
+		lut.resize (ScaleLUT <dt>::size);
+		for (size_t i = 0; i < (size_t) ScaleLUT <dt>::size; i++)
+			lut[i] = grayscaleValue (ScaleLUT <dt>::value (i), black, low, high);
+		arg.lut = &(lut[0]);
+	}
+
+	runParts (grayscaleRows <bt, dt>, &arg, height, pixels);
+}
+
+template <typename bt, typename dt> static void pseudocolourRows (void *a, size_t start, size_t end)
+{
+	ScaleArg <bt, dt> *arg = (ScaleArg <bt, dt> *) a;
+	const int width = arg->width;
+
+	for (size_t y = start; y < end; y++)
+	{
+		const dt *row = arg->data + y * width;
+		bt *out = outputRow (arg, y);
+		if (arg->lut)
+		{
+			const bt *lut = arg->lut;
+			for (int x = 0; x < width; x++, out += 3)
+			{
+				const bt *c = lut + 3 * ScaleLUT <dt>::index (row[x]);
+				out[0] = c[0];
+				out[1] = c[1];
+				out[2] = c[2];
+			}
+		}
+		else
+		{
+			const double low = arg->low;
+			const double scale = arg->scale;
+			const double pmax = SCALE_PALETTE_SIZE - 1;
+			const bt *palette = arg->palette;
+			for (int x = 0; x < width; x++, out += 3)
+			{
+				double v = ((double) row[x] - low) * scale;
+				v = v > 0 ? v : 0;
+				v = v < pmax ? v : pmax;
+				const bt *c = palette + 3 * (int) (v + 0.5);
+				out[0] = c[0];
+				out[1] = c[1];
+				out[2] = c[2];
+			}
+		}
+	}
+}
+
+template <typename bt, typename dt> void rts2image::scalePseudocolour (const dt *data, int width, int height, bt *buf, dt low, dt high, size_t offset, bool invert_y, int colourVariant)
+{
+	ScaleArg <bt, dt> arg;
+	arg.data = data;
+	arg.width = width;
+	arg.height = height;
+	arg.buf = buf;
+	arg.stride = 3 * (width + offset);
+	arg.invert_y = invert_y;
+	arg.lut = NULL;
+	arg.palette = NULL;
+	arg.black = 0;
+	arg.low = low;
+	arg.scale = high > low ? (SCALE_PALETTE_SIZE - 1) / ((double) high - (double) low) : 0;
+
+	size_t pixels = (size_t) width * height;
+
+	std::vector <bt> colours;
+	unsigned char r = 0, g = 0, b = 0;
+	if (ScaleLUT <dt>::size > 0 && pixels > (size_t) ScaleLUT <dt>::size)
+	{
+		colours.resize (3 * ScaleLUT <dt>::size);
+		for (size_t i = 0; i < (size_t) ScaleLUT <dt>::size; i++)
+		{
+			dt pix = ScaleLUT <dt>::value (i);
+			if (pix < low)
+				pix = low;
+			if (pix > high)
+				pix = high;
+			pseudocolour (colourVariant, double (pix - low), double (high - low), r, g, b);
+			colours[3 * i] = r;
+			colours[3 * i + 1] = g;
+			colours[3 * i + 2] = b;
+		}
+		arg.lut = &(colours[0]);
+	}
+	else
+	{
+		colours.resize (3 * SCALE_PALETTE_SIZE);
+		for (size_t i = 0; i < SCALE_PALETTE_SIZE; i++)
+		{
+			pseudocolour (colourVariant, i, SCALE_PALETTE_SIZE - 1, r, g, b);
+			colours[3 * i] = r;
+			colours[3 * i + 1] = g;
+			colours[3 * i + 2] = b;
+		}
+		arg.palette = &(colours[0]);
+	}
+
+	runParts (pseudocolourRows <bt, dt>, &arg, height, pixels);
+}
+
+bool rts2image::pseudocolour (int colourVariant, double value, double range, unsigned char &r, unsigned char &g, unsigned char &b)
+{
+	double n;
+	switch (colourVariant)
+	{
+		case PSEUDOCOLOUR_VARIANT_GREY:
+			n = 255.0 * value / range;
+			r = g = b = n;
+			break;
+		case PSEUDOCOLOUR_VARIANT_GREY_INV:
+			n = 255.0 * (1.0 - value / range);
+			r = g = b = n;
+			break;
+		case PSEUDOCOLOUR_VARIANT_BLUE:
+			n = 511.0 * value / range;
+			r = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			g = n / 2.0;
+			b = (n < 256.0) ? n : 255;
+			break;
+		case PSEUDOCOLOUR_VARIANT_BLUE_INV:
+			n = 511.0 * (1.0 - value / range);
+			r = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			g = n / 2.0;
+			b = (n < 256.0) ? n : 255;
+			break;
+		case PSEUDOCOLOUR_VARIANT_RED:
+			n = 511.0 * value / range;
+			r = (n < 256.0) ? n : 255;
+			g = n / 2.0;
+			b = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_RED_INV:
+			n = 511.0 * (1.0 - value / range);
+			r = (n < 256.0) ? n : 255;
+			g = n / 2.0;
+			b = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_GREEN:
+			n = 511.0 * value / range;
+			r = n / 2.0;
+			g = (n < 256.0) ? n : 255;
+			b = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_GREEN_INV:
+			n = 511.0 * (1.0 - value / range);
+			r = n / 2.0;
+			g = (n < 256.0) ? n : 255;
+			b = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_VIOLET:
+			n = 511.0 * value / range;
+			r = n / 2.0;
+			g = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			b = (n < 256.0) ? n : 255;
+			break;
+		case PSEUDOCOLOUR_VARIANT_VIOLET_INV:
+			n = 511.0 * (1.0 - value / range);
+			r = n / 2.0;
+			g = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			b = (n < 256.0) ? n : 255;
+			break;
+		case PSEUDOCOLOUR_VARIANT_MAGENTA:
+			n = 511.0 * value / range;
+			r = (n < 256.0) ? n : 255;
+			g = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			b = n / 2.0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_MAGENTA_INV:
+			n = 511.0 * (1.0 - value / range);
+			r = (n < 256.0) ? n : 255;
+			g = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			b = n / 2.0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_MALACHIT:
+			n = 511.0 * value / range;
+			r = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			g = (n < 256.0) ? n : 255;
+			b = n / 2.0;
+			break;
+		case PSEUDOCOLOUR_VARIANT_MALACHIT_INV:
+			n = 511.0 * (1.0 - value / range);
+			r = ((n - 256.0) > 0.0) ? n - 256.0 : 0;
+			g = (n < 256.0) ? n : 255;
+			b = n / 2.0;
+			break;
+		default:
+			r = g = b = 0;
+			return false;
+	}
+	return true;
+}
+
+// instantiate scaling functions for all supported data types
+#define INSTANTIATE_SCALE(dt) \
+	template void rts2image::scaleGrayscale <unsigned char, dt> (const dt *data, int width, int height, unsigned char *buf, unsigned char black, dt low, dt high, size_t offset, bool invert_y); \
+	template void rts2image::scalePseudocolour <unsigned char, dt> (const dt *data, int width, int height, unsigned char *buf, dt low, dt high, size_t offset, bool invert_y, int colourVariant);
+
+INSTANTIATE_SCALE(signed char)
+INSTANTIATE_SCALE(short)
+INSTANTIATE_SCALE(int)
+INSTANTIATE_SCALE(long long)
+INSTANTIATE_SCALE(float)
+INSTANTIATE_SCALE(double)
+INSTANTIATE_SCALE(unsigned short)
+INSTANTIATE_SCALE(unsigned int)
@@ -0,0 +1,260 @@
+/*
+ * Background writer of FITS image data.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rts2fits/imagewriter.h"
+#include "rts2fits/cameraimage.h"
+#include "configuration.h"
+#include "utilsfunc.h"
+
+using namespace rts2image;
+
+ImageWriteJob::ImageWriteJob (CameraImage *_ci, rts2core::DataChannels *data)
+{
+	ci = _ci;
+	totalSize = 0;
+	for (rts2core::DataChannels::iterator di = data->begin (); di != data->end (); di++)
+	{
+		size_t s = (*di)->getDataTop () - (*di)->getDataBuff ();
+		char *buf = new char[s];
+		memcpy (buf, (*di)->getDataBuff (), s);
+		buffers.push_back (buf);
+		sizes.push_back (s);
+		hdus.push_back (1);
+		totalSize += s;
+	}
+	done = false;
+	ret = 0;
+}
+
+ImageWriteJob::~ImageWriteJob ()
+{
+	for (std::vector <char *>::iterator iter = buffers.begin (); iter != buffers.end (); iter++)
+		delete[] *iter;
+}
+
+ImageWriter *ImageWriter::pInstance = NULL;
+
+ImageWriter *ImageWriter::instance ()
+{
+	if (pInstance == NULL)
+		pInstance = new ImageWriter ();
+	return pInstance;
+}
+
+ImageWriter::ImageWriter ()
+{
+	pthread_mutex_init (&mutex, NULL);
+	pthread_cond_init (&cond, NULL);
+	threadRunning = false;
+
+	throughput = NAN;
+	bytesWritten = 0;
+
+	rts2core::Configuration *config = rts2core::Configuration::instance ();
+
+	maxQueue = config->getIntegerDefault ("observatory", "write_queue", 2);
+
+	std::string fs;
+	config->getString ("observatory", "write_fsync", fs, "none");
+	if (fs == "data")
+	{
+		fsyncPolicy = WRITER_FSYNC_DATA;
+	}
+	else if (fs == "full")
+	{
+		fsyncPolicy = WRITER_FSYNC_FULL;
+	}
+	else
+	{
+		if (fs != "none")
+			logStream (MESSAGE_WARNING) << "invalid write_fsync value " << fs << ", expected none, data or full" << sendLog;
+		fsyncPolicy = WRITER_FSYNC_NONE;
+	}
+
+	// CFITSIO must be compiled with --enable-reentrant, as the main thread writes metadata to other files
+	if (maxQueue > 0 && !fits_is_reentrant ())
+	{
+		logStream (MESSAGE_WARNING) << "CFITSIO library is not reentrant, images will be written in the main thread" << sendLog;
+		maxQueue = 0;
+	}
+}
+
+void ImageWriter::setMaxQueue (int _maxQueue)
+{
+	if (_maxQueue > 0 && !fits_is_reentrant ())
+		_maxQueue = 0;
+	pthread_mutex_lock (&mutex);
+	maxQueue = _maxQueue;
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+}
+
+ImageWriteJob *ImageWriter::queue (CameraImage *ci, rts2core::DataChannels *data)
+{
+	ImageWriteJob *job = new ImageWriteJob (ci, data);
+
+	pthread_mutex_lock (&mutex);
+	if (!threadRunning)
+	{
+		int ret = pthread_create (&thread, NULL, writerThread, (void *) this);
+		if (ret)
+		{
+			pthread_mutex_unlock (&mutex);
+			logStream (MESSAGE_ERROR) << "cannot start image writer thread: " << strerror (ret) << ", writing image in the main thread" << sendLog;
+			writeJob (job);
+			job->done = true;
+			return job;
+		}
+		threadRunning = true;
+	}
+	if (maxQueue > 0 && (int) jobs.size () >= maxQueue)
+	{
+		logStream (MESSAGE_WARNING) << "waiting for " << jobs.size () << " images to be written" << sendLog;
+		while (maxQueue > 0 && (int) jobs.size () >= maxQueue)
+			pthread_cond_wait (&cond, &mutex);
+	}
+	jobs.push_back (job);
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+	return job;
+}
+
+bool ImageWriter::isDone (ImageWriteJob *job)
+{
+	pthread_mutex_lock (&mutex);
+	bool ret = job->done;
+	pthread_mutex_unlock (&mutex);
+	return ret;
+}
+
+void ImageWriter::wait (ImageWriteJob *job)
+{
+	pthread_mutex_lock (&mutex);
+	while (!job->done)
+		pthread_cond_wait (&cond, &mutex);
+	pthread_mutex_unlock (&mutex);
+}
+
+int ImageWriter::getQueueDepth ()
+{
+	pthread_mutex_lock (&mutex);
+	int ret = jobs.size ();
+	pthread_mutex_unlock (&mutex);
+	return ret;
+}
+
+double ImageWriter::getThroughput ()
+{
+	pthread_mutex_lock (&mutex);
+	double ret = throughput;
+	pthread_mutex_unlock (&mutex);
+	return ret;
+}
+
+double ImageWriter::getBytesWritten ()
+{
+	pthread_mutex_lock (&mutex);
+	double ret = bytesWritten;
+	pthread_mutex_unlock (&mutex);
+	return ret;
+}
+
+void ImageWriter::writeJob (ImageWriteJob *job)
+{
+	// main thread does not touch the image while it is written, metadata are queued in CameraImage
+	Image *image = job->ci->image;
+
+	int nchan = job->buffers.size ();
+	std::vector <char *> tops (nchan);
+	for (int i = 0; i < nchan; i++)
+		tops[i] = job->buffers[i] + job->sizes[i];
+
+	job->ret = image->writeChannels (nchan, &(job->buffers[0]), &(tops[0]), &(job->hdus[0]));
+
+	if (image->getFitsFile () && fsyncPolicy != WRITER_FSYNC_NONE)
+	{
+		int status = 0;
+		fits_flush_file (image->getFitsFile (), &status);
+		if (status == 0)
+			syncFile (image->getAbsoluteFileName ());
+	}
+}
+
+void ImageWriter::syncFile (const char *fn)
+{
+	int fd = open (fn, O_RDONLY);
+	if (fd < 0)
+	{
+		logStream (MESSAGE_WARNING) << "cannot open " << fn << " for sync: " << strerror (errno) << sendLog;
+		return;
+	}
+	if ((fsyncPolicy == WRITER_FSYNC_DATA ? fdatasync (fd) : fsync (fd)) < 0)
+		logStream (MESSAGE_WARNING) << "cannot sync " << fn << ": " << strerror (errno) << sendLog;
+	close (fd);
+
+	if (fsyncPolicy != WRITER_FSYNC_FULL)
+		return;
+
+	char *dn = strdup (fn);
+	fd = open (dirname (dn), O_RDONLY);
+	if (fd >= 0)
+	{
+		fsync (fd);
+		close (fd);
+	}
+	free (dn);
+}
+
+void *ImageWriter::writerThread (void *arg)
+{
+	((ImageWriter *) arg)->writer ();
+	return NULL;
+}
+
+void ImageWriter::writer ()
+{
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		while (jobs.empty ())
+			pthread_cond_wait (&cond, &mutex);
+
+		// job stays in queue while it is written, so it is counted in queue depth
+		ImageWriteJob *job = jobs.front ();
+		pthread_mutex_unlock (&mutex);
+
+		double t = getNow ();
+		writeJob (job);
+		t = getNow () - t;
+
+		pthread_mutex_lock (&mutex);
+		if (t > 0)
+			throughput = job->totalSize / t / 1048576.0;
+		bytesWritten += job->totalSize;
+		jobs.pop_front ();
+		job->done = true;
+		pthread_cond_broadcast (&cond);
+	}
+}
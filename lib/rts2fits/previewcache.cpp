@@ -0,0 +1,797 @@
+/*
+ * Persistent cache of image previews and tile pyramids.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "rts2fits/previewcache.h"
+
+#if defined(RTS2_HAVE_LIBJPEG) && RTS2_HAVE_LIBJPEG == 1
+
+#include "rts2fits/image.h"
+#include "utilsfunc.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace rts2image;
+
+// index of the full resolution level
+static int pyramidMaxZoom (int width, int height)
+{
+	int size = width > height ? width : height;
+	int z = 0;
+	while ((PREVIEW_TILE_SIZE << z) < size)
+		z++;
+	return z;
+}
+
+static void blobToData (Magick::Blob &blob, char* &data, size_t &length)
+{
+	length = blob.length ();
+	data = new char[length];
+	memcpy (data, blob.data (), length);
+}
+
+// FNV-1a hash, as hex string
+static std::string hashKey (const std::string &key)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (std::string::const_iterator iter = key.begin (); iter != key.end (); iter++)
+	{
+		h ^= (unsigned char) *iter;
+		h *= 1099511628211ULL;
+	}
+
+	char hex[17];
+	snprintf (hex, sizeof (hex), "%016llx", (unsigned long long) h);
+	return std::string (hex);
+}
+
+// update access time of the file, so prune works even on filesystems mounted with noatime
+static void touchAccess (int f, struct stat &st)
+{
+	if (st.st_atime >= time (NULL) - PREVIEW_ATIME_RESOLUTION)
+		return;
+	struct timespec ts[2];
+	ts[0].tv_sec = 0;
+	ts[0].tv_nsec = UTIME_NOW;
+	ts[1].tv_sec = 0;
+	ts[1].tv_nsec = UTIME_OMIT;
+	futimens (f, ts);
+}
+
+// remove entry file or pyramid directory
+static int removeEntry (const std::string &path)
+{
+	struct stat st;
+	if (lstat (path.c_str (), &st))
+		return -1;
+	if (S_ISDIR (st.st_mode))
+		return rmdir_r (path.c_str ());
+	return unlink (path.c_str ());
+}
+
+struct CacheEntry
+{
+	std::string path;
+	time_t atime;
+	long long size;
+};
+
+static bool olderAccess (const CacheEntry &a, const CacheEntry &b)
+{
+	return a.atime < b.atime;
+}
+
+// disk space used by the entry
+static long long entrySize (const std::string &path, struct stat &st)
+{
+	if (!S_ISDIR (st.st_mode))
+		return (long long) st.st_blocks * 512;
+
+	long long ret = (long long) st.st_blocks * 512;
+	DIR *d = opendir (path.c_str ());
+	if (d == NULL)
+		return ret;
+	struct dirent *de;
+	while ((de = readdir (d)) != NULL)
+	{
+		if (!strcmp (de->d_name, ".") || !strcmp (de->d_name, ".."))
+			continue;
+		std::string sub = path + '/' + de->d_name;
+		struct stat sst;
+		if (lstat (sub.c_str (), &sst) == 0)
+			ret += entrySize (sub, sst);
+	}
+	closedir (d);
+	return ret;
+}
+
+// last access of the entry; pyramid info is read on every pyramid access
+static time_t entryAccess (const std::string &path, struct stat &st)
+{
+	if (!S_ISDIR (st.st_mode))
+		return st.st_atime > st.st_mtime ? st.st_atime : st.st_mtime;
+
+	time_t ret = st.st_mtime;
+	struct stat ist;
+	if (stat ((path + "/info").c_str (), &ist) == 0 && ist.st_atime > ret)
+		ret = ist.st_atime;
+	return ret;
+}
+
+/**
+ * Collect cache entries. Level 0 directories are named by the first two
+ * characters of the key hash, level 1 directories hold versions of the entry.
+ * Files and pyramids on level 1 are entries of the old cache layout.
+ */
+static void collectEntries (const std::string &dir, int level, std::vector <CacheEntry> &entries, time_t now)
+{
+	DIR *d = opendir (dir.c_str ());
+	if (d == NULL)
+		return;
+	struct dirent *de;
+	while ((de = readdir (d)) != NULL)
+	{
+		if (!strcmp (de->d_name, ".") || !strcmp (de->d_name, ".."))
+			continue;
+		std::string path = dir + '/' + de->d_name;
+		struct stat st;
+		if (lstat (path.c_str (), &st))
+			continue;
+		if (S_ISDIR (st.st_mode) && level < 2 && strchr (de->d_name, '.') == NULL)
+		{
+			collectEntries (path, level + 1, entries, now);
+			continue;
+		}
+		CacheEntry e;
+		e.path = path;
+		e.size = entrySize (path, st);
+		if (strstr (de->d_name, ".tmp.") != NULL)
+		{
+			// entry being written, or left by crashed writer
+			if (st.st_mtime > now - 86400)
+				continue;
+			e.atime = 0;
+		}
+		else
+		{
+			e.atime = entryAccess (path, st);
+		}
+		entries.push_back (e);
+	}
+	closedir (d);
+}
+
+PreviewCache::PreviewCache (const char *_cacheDir)
+{
+	setCacheDir (_cacheDir);
+
+	maxSize = 0;
+	maxAge = 0;
+
+	pthread_mutex_init (&mutex, NULL);
+	pthread_cond_init (&cond, NULL);
+
+	threadRunning = false;
+	stopThread = false;
+	pruneRequested = false;
+}
+
+PreviewCache::~PreviewCache ()
+{
+	pthread_mutex_lock (&mutex);
+	stopThread = true;
+	jobs.clear ();
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+
+	if (threadRunning)
+		pthread_join (thread, NULL);
+
+	pthread_mutex_destroy (&mutex);
+	pthread_cond_destroy (&cond);
+}
+
+void PreviewCache::setCacheDir (const char *_cacheDir)
+{
+	if (_cacheDir == NULL)
+		cacheDir = "";
+	else
+		cacheDir = _cacheDir;
+	// remove trailing slashes
+	while (cacheDir.length () > 1 && cacheDir[cacheDir.length () - 1] == '/')
+		cacheDir.erase (cacheDir.length () - 1);
+}
+
+void PreviewCache::setLimits (long long _maxSize, double _maxAge)
+{
+	maxSize = _maxSize;
+	maxAge = _maxAge;
+}
+
+std::string PreviewCache::entryName (const char *path, const std::string &params)
+{
+	struct stat st;
+	char *rp = realpath (path, NULL);
+	if (rp == NULL || stat (rp, &st))
+	{
+		free (rp);
+		throw rts2core::Error (std::string ("cannot access ") + path + ": " + strerror (errno));
+	}
+
+	std::ostringstream os;
+	os << rp << '\n' << params;
+	free (rp);
+
+	std::ostringstream vs;
+	vs << st.st_ino << ' ' << st.st_size << ' ' << st.st_mtime;
+#ifdef __linux__
+	vs << '.' << st.st_mtim.tv_nsec;
+#endif
+
+	std::string key = hashKey (os.str ());
+
+	// distribute entries to subdirectories, versions of the entry share directory
+	return cacheDir + '/' + key.substr (0, 2) + '/' + key.substr (2) + '/' + hashKey (vs.str ());
+}
+
+bool PreviewCache::get (const std::string &entry, char* &data, size_t &length)
+{
+	if (!isEnabled ())
+		return false;
+
+	int f = open (entry.c_str (), O_RDONLY);
+	if (f == -1)
+		return false;
+
+	struct stat st;
+	if (fstat (f, &st))
+	{
+		close (f);
+		return false;
+	}
+	touchAccess (f, st);
+
+	length = st.st_size;
+	data = new char[length];
+
+	size_t rl = 0;
+	while (rl < length)
+	{
+		ssize_t ret = read (f, data + rl, length - rl);
+		if (ret <= 0)
+		{
+			if (ret < 0 && errno == EINTR)
+				continue;
+			close (f);
+			delete[] data;
+			data = NULL;
+			return false;
+		}
+		rl += ret;
+	}
+	close (f);
+	return true;
+}
+
+void PreviewCache::put (const std::string &entry, const void *data, size_t length)
+{
+	if (!isEnabled ())
+		return;
+
+	if (writeFile (entry, data, length))
+		removeStale (entry);
+}
+
+Magick::Image *PreviewCache::getLevelImage (const char *path, float quantiles, int chan, int colourVariant, int minSize)
+{
+	if (!isEnabled ())
+		return NULL;
+
+	std::string pyramid = pyramidName (path, quantiles, chan, colourVariant);
+	int width, height, levels;
+	if (!readInfo (pyramid, width, height, levels))
+		return NULL;
+
+	int size = width > height ? width : height;
+	for (int z = 0; z < levels; z++)
+	{
+		int ls = (size + (1 << (levels - 1 - z)) - 1) >> (levels - 1 - z);
+		if (ls < minSize)
+			continue;
+		if (ls > PREVIEW_LEVEL_MAX)
+			return NULL;
+		std::ostringstream os;
+		os << pyramid << "/level" << z << ".jpg";
+		char *data;
+		size_t length;
+		if (!get (os.str (), data, length))
+			return NULL;
+		Magick::Image *ret = NULL;
+		try
+		{
+			Magick::Blob blob (data, length);
+			ret = new Magick::Image (blob);
+		}
+		catch (Magick::Exception &ex)
+		{
+			logStream (MESSAGE_WARNING) << "cannot read pyramid level " << os.str () << ": " << ex.what () << sendLog;
+			delete ret;
+			ret = NULL;
+		}
+		delete[] data;
+		return ret;
+	}
+	return NULL;
+}
+
+void PreviewCache::getPyramidInfo (const char *path, float quantiles, int chan, int colourVariant, int &width, int &height, int &levels)
+{
+	if (isEnabled ())
+	{
+		generatePyramid (path, quantiles, chan, colourVariant);
+		if (readInfo (pyramidName (path, quantiles, chan, colourVariant), width, height, levels))
+			return;
+	}
+
+	Image image;
+	image.openFile (path, true, false);
+	Magick::Image *mimage = image.getMagickImage (NULL, quantiles, chan, colourVariant);
+	width = mimage->columns ();
+	height = mimage->rows ();
+	levels = pyramidMaxZoom (width, height) + 1;
+	delete mimage;
+}
+
+void PreviewCache::getTile (const char *path, float quantiles, int chan, int colourVariant, int z, int x, int y, char* &data, size_t &length)
+{
+	if (isEnabled ())
+	{
+		generatePyramid (path, quantiles, chan, colourVariant);
+		std::ostringstream os;
+		os << pyramidName (path, quantiles, chan, colourVariant) << '/' << z << '/' << x << '_' << y << ".jpg";
+		if (get (os.str (), data, length))
+			return;
+		int width, height, levels;
+		if (readInfo (pyramidName (path, quantiles, chan, colourVariant), width, height, levels))
+			throw rts2core::Error ("invalid tile coordinates");
+	}
+
+	// cache is not available, render requested tile
+	Image image;
+	image.openFile (path, true, false);
+	Magick::Image *mimage = image.getMagickImage (NULL, quantiles, chan, colourVariant);
+	try
+	{
+		int maxZoom = pyramidMaxZoom (mimage->columns (), mimage->rows ());
+		if (z < 0 || z > maxZoom)
+			throw rts2core::Error ("invalid tile zoom level");
+		int lw = (mimage->columns () + (1 << (maxZoom - z)) - 1) >> (maxZoom - z);
+		int lh = (mimage->rows () + (1 << (maxZoom - z)) - 1) >> (maxZoom - z);
+		if (x < 0 || y < 0 || x * PREVIEW_TILE_SIZE >= lw || y * PREVIEW_TILE_SIZE >= lh)
+			throw rts2core::Error ("invalid tile coordinates");
+		if (z < maxZoom)
+		{
+			Magick::Geometry g (lw, lh);
+			g.aspect (true);
+			mimage->zoom (g);
+		}
+		int tw = lw - x * PREVIEW_TILE_SIZE;
+		int th = lh - y * PREVIEW_TILE_SIZE;
+		mimage->crop (Magick::Geometry (tw < PREVIEW_TILE_SIZE ? tw : PREVIEW_TILE_SIZE, th < PREVIEW_TILE_SIZE ? th : PREVIEW_TILE_SIZE, x * PREVIEW_TILE_SIZE, y * PREVIEW_TILE_SIZE));
+		Magick::Blob blob;
+		mimage->write (&blob, "jpeg");
+		blobToData (blob, data, length);
+	}
+	catch (rts2core::Error &er)
+	{
+		delete mimage;
+		throw er;
+	}
+	delete mimage;
+}
+
+void PreviewCache::generatePyramid (const char *path, float quantiles, int chan, int colourVariant)
+{
+	if (!isEnabled ())
+		return;
+
+	std::string pyramid = pyramidName (path, quantiles, chan, colourVariant);
+	int width, height, levels;
+
+	pthread_mutex_lock (&mutex);
+	// wait for other thread generating the same pyramid
+	while (generating.find (pyramid) != generating.end ())
+		pthread_cond_wait (&cond, &mutex);
+	if (readInfo (pyramid, width, height, levels))
+	{
+		pthread_mutex_unlock (&mutex);
+		return;
+	}
+	generating.insert (pyramid);
+	pthread_mutex_unlock (&mutex);
+
+	char *tmpdir = NULL;
+	try
+	{
+		std::string tmpl = pyramid + ".tmp.XXXXXX";
+		if (mkpath (tmpl.c_str (), 0777))
+			throw rts2core::Error (std::string ("cannot create directory for ") + tmpl + ": " + strerror (errno));
+		tmpdir = strdup (tmpl.c_str ());
+		if (mkdtemp (tmpdir) == NULL)
+		{
+			free (tmpdir);
+			tmpdir = NULL;
+			throw rts2core::Error (std::string ("cannot create directory ") + tmpl + ": " + strerror (errno));
+		}
+		chmod (tmpdir, 0755);
+
+		double t = getNow ();
+
+		writePyramid (path, quantiles, chan, colourVariant, tmpdir);
+
+		// other process might generate the pyramid in the meantime
+		if (rename (tmpdir, pyramid.c_str ()))
+		{
+			rmdir_r (tmpdir);
+		}
+		else
+		{
+			logStream (MESSAGE_DEBUG) << "generated preview pyramid of " << path << " in " << (getNow () - t) << " s" << sendLog;
+			removeStale (pyramid);
+		}
+		free (tmpdir);
+	}
+	catch (...)
+	{
+		if (tmpdir)
+		{
+			rmdir_r (tmpdir);
+			free (tmpdir);
+		}
+		pthread_mutex_lock (&mutex);
+		generating.erase (pyramid);
+		pthread_cond_broadcast (&cond);
+		pthread_mutex_unlock (&mutex);
+		throw;
+	}
+
+	pthread_mutex_lock (&mutex);
+	generating.erase (pyramid);
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+}
+
+void PreviewCache::queuePyramid (const char *path, float quantiles, int chan, int colourVariant)
+{
+	if (!isEnabled ())
+		return;
+
+	PyramidJob job;
+	job.path = path;
+	job.quantiles = quantiles;
+	job.chan = chan;
+	job.colourVariant = colourVariant;
+
+	pthread_mutex_lock (&mutex);
+	if (!startThread ())
+	{
+		pthread_mutex_unlock (&mutex);
+		return;
+	}
+	jobs.push_back (job);
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+}
+
+void PreviewCache::prune ()
+{
+	if (!isEnabled () || (maxSize <= 0 && maxAge <= 0))
+		return;
+
+	double t = getNow ();
+	time_t now = time (NULL);
+
+	std::vector <CacheEntry> entries;
+	collectEntries (cacheDir, 0, entries, now);
+
+	std::sort (entries.begin (), entries.end (), olderAccess);
+
+	long long total = 0;
+	std::vector <CacheEntry>::iterator iter;
+	for (iter = entries.begin (); iter != entries.end (); iter++)
+		total += iter->size;
+
+	int removed = 0;
+	long long freed = 0;
+
+	for (iter = entries.begin (); iter != entries.end (); iter++)
+	{
+		if (!((maxAge > 0 && iter->atime < now - maxAge) || (maxSize > 0 && total > maxSize)))
+			break;
+		if (removeEntry (iter->path))
+		{
+			logStream (MESSAGE_WARNING) << "cannot remove preview cache entry " << iter->path << ": " << strerror (errno) << sendLog;
+			continue;
+		}
+		total -= iter->size;
+		freed += iter->size;
+		removed++;
+
+		// remove directories left empty; fails if they hold other entries
+		std::string dir = iter->path.substr (0, iter->path.rfind ('/'));
+		while (dir.length () > cacheDir.length () && rmdir (dir.c_str ()) == 0)
+			dir = dir.substr (0, dir.rfind ('/'));
+	}
+
+	logStream (MESSAGE_DEBUG) << "pruned preview cache, removed " << removed << " entries of " << freed << " bytes, " << (entries.size () - removed) << " entries of " << total << " bytes left, in " << (getNow () - t) << " s" << sendLog;
+}
+
+void PreviewCache::queuePrune ()
+{
+	if (!isEnabled ())
+		return;
+
+	pthread_mutex_lock (&mutex);
+	if (startThread ())
+	{
+		pruneRequested = true;
+		pthread_cond_broadcast (&cond);
+	}
+	pthread_mutex_unlock (&mutex);
+}
+
+bool PreviewCache::startThread ()
+{
+	if (threadRunning)
+		return true;
+	int ret = pthread_create (&thread, NULL, generatorThread, (void *) this);
+	if (ret)
+	{
+		logStream (MESSAGE_ERROR) << "cannot start preview cache thread: " << strerror (ret) << sendLog;
+		return false;
+	}
+	threadRunning = true;
+	return true;
+}
+
+std::string PreviewCache::pyramidName (const char *path, float quantiles, int chan, int colourVariant)
+{
+	std::ostringstream os;
+	os << "pyramid " << PREVIEW_TILE_SIZE << " q=" << quantiles << " chan=" << chan << " cv=" << colourVariant;
+	return entryName (path, os.str ()) + ".tiles";
+}
+
+bool PreviewCache::readInfo (const std::string &pyramid, int &width, int &height, int &levels)
+{
+	FILE *f = fopen ((pyramid + "/info").c_str (), "r");
+	if (f == NULL)
+		return false;
+	struct stat st;
+	if (fstat (fileno (f), &st) == 0)
+		touchAccess (fileno (f), st);
+	int ret = fscanf (f, "%d %d %d", &width, &height, &levels);
+	fclose (f);
+	return ret == 3;
+}
+
+void PreviewCache::writePyramid (const char *path, float quantiles, int chan, int colourVariant, const std::string &dir)
+{
+	Image image;
+	image.openFile (path, true, false);
+
+	Magick::Image *full = image.getMagickImage (NULL, quantiles, chan, colourVariant);
+	Magick::Image level (*full);
+	delete full;
+
+	int width = level.columns ();
+	int height = level.rows ();
+	int maxZoom = pyramidMaxZoom (width, height);
+
+	Magick::Blob blob;
+
+	for (int z = maxZoom; z >= 0; z--)
+	{
+		if (z < maxZoom)
+		{
+			Magick::Geometry g ((level.columns () + 1) / 2, (level.rows () + 1) / 2);
+			g.aspect (true);
+			level.zoom (g);
+		}
+
+		int lw = level.columns ();
+		int lh = level.rows ();
+
+		std::ostringstream zdir;
+		zdir << dir << '/' << z;
+		if (mkdir (zdir.str ().c_str (), 0755))
+			throw rts2core::Error (std::string ("cannot create directory ") + zdir.str () + ": " + strerror (errno));
+
+		for (int y = 0; y * PREVIEW_TILE_SIZE < lh; y++)
+		{
+			for (int x = 0; x * PREVIEW_TILE_SIZE < lw; x++)
+			{
+				int tw = lw - x * PREVIEW_TILE_SIZE;
+				int th = lh - y * PREVIEW_TILE_SIZE;
+				Magick::Image tile (level);
+				tile.crop (Magick::Geometry (tw < PREVIEW_TILE_SIZE ? tw : PREVIEW_TILE_SIZE, th < PREVIEW_TILE_SIZE ? th : PREVIEW_TILE_SIZE, x * PREVIEW_TILE_SIZE, y * PREVIEW_TILE_SIZE));
+				tile.write (&blob, "jpeg");
+
+				std::ostringstream tn;
+				tn << zdir.str () << '/' << x << '_' << y << ".jpg";
+				if (!writeFile (tn.str (), blob.data (), blob.length ()))
+					throw rts2core::Error (std::string ("cannot write pyramid tile ") + tn.str ());
+			}
+		}
+
+		if (lw <= PREVIEW_LEVEL_MAX && lh <= PREVIEW_LEVEL_MAX)
+		{
+			level.write (&blob, "jpeg");
+			std::ostringstream ln;
+			ln << dir << "/level" << z << ".jpg";
+			if (!writeFile (ln.str (), blob.data (), blob.length ()))
+				throw rts2core::Error (std::string ("cannot write pyramid level ") + ln.str ());
+		}
+	}
+
+	// info is written last, its presence marks complete pyramid
+	std::ostringstream info;
+	info << width << " " << height << " " << (maxZoom + 1) << std::endl;
+	if (!writeFile (dir + "/info", info.str ().c_str (), info.str ().length ()))
+		throw rts2core::Error (std::string ("cannot write pyramid info to ") + dir);
+}
+
+bool PreviewCache::writeFile (const std::string &file, const void *data, size_t length)
+{
+	if (mkpath (file.c_str (), 0777))
+	{
+		logStream (MESSAGE_ERROR) << "cannot create directory for preview cache entry " << file << ": " << strerror (errno) << sendLog;
+		return false;
+	}
+
+	// write to temporary file, rename it when complete
+	std::string tmpl = file + ".tmp.XXXXXX";
+	char *tmpname = strdup (tmpl.c_str ());
+	int f = mkstemp (tmpname);
+	if (f == -1)
+	{
+		logStream (MESSAGE_ERROR) << "cannot create preview cache entry " << file << ": " << strerror (errno) << sendLog;
+		free (tmpname);
+		return false;
+	}
+	fchmod (f, 0644);
+
+	size_t wl = 0;
+	while (wl < length)
+	{
+		ssize_t ret = write (f, ((const char *) data) + wl, length - wl);
+		if (ret <= 0)
+		{
+			if (ret < 0 && errno == EINTR)
+				continue;
+			logStream (MESSAGE_ERROR) << "cannot write preview cache entry " << file << ": " << strerror (errno) << sendLog;
+			close (f);
+			unlink (tmpname);
+			free (tmpname);
+			return false;
+		}
+		wl += ret;
+	}
+	close (f);
+
+	if (rename (tmpname, file.c_str ()))
+	{
+		logStream (MESSAGE_ERROR) << "cannot rename preview cache entry " << tmpname << " to " << file << ": " << strerror (errno) << sendLog;
+		unlink (tmpname);
+		free (tmpname);
+		return false;
+	}
+	free (tmpname);
+	return true;
+}
+
+void PreviewCache::removeStale (const std::string &entry)
+{
+	size_t sl = entry.rfind ('/');
+	std::string dir = entry.substr (0, sl);
+	// version hash, without .tiles extension
+	std::string version = entry.substr (sl + 1);
+	size_t dot = version.find ('.');
+	if (dot != std::string::npos)
+		version.erase (dot);
+
+	DIR *d = opendir (dir.c_str ());
+	if (d == NULL)
+		return;
+	struct dirent *de;
+	while ((de = readdir (d)) != NULL)
+	{
+		// skip current version and entries being written
+		if (!strcmp (de->d_name, ".") || !strcmp (de->d_name, "..") || !strncmp (de->d_name, version.c_str (), version.length ()) || strstr (de->d_name, ".tmp.") != NULL)
+			continue;
+		std::string path = dir + '/' + de->d_name;
+		if (removeEntry (path))
+			logStream (MESSAGE_WARNING) << "cannot remove stale preview cache entry " << path << ": " << strerror (errno) << sendLog;
+		else
+			logStream (MESSAGE_DEBUG) << "removed stale preview cache entry " << path << sendLog;
+	}
+	closedir (d);
+}
+
+void *PreviewCache::generatorThread (void *arg)
+{
+	((PreviewCache *) arg)->generator ();
+	return NULL;
+}
+
+void PreviewCache::generator ()
+{
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		while (!stopThread && jobs.empty () && !pruneRequested)
+			pthread_cond_wait (&cond, &mutex);
+		if (stopThread)
+			break;
+
+		if (pruneRequested)
+		{
+			pruneRequested = false;
+			pthread_mutex_unlock (&mutex);
+			prune ();
+			pthread_mutex_lock (&mutex);
+			continue;
+		}
+
+		PyramidJob job = jobs.front ();
+		jobs.pop_front ();
+		pthread_mutex_unlock (&mutex);
+
+		try
+		{
+			generatePyramid (job.path.c_str (), job.quantiles, job.chan, job.colourVariant);
+		}
+		catch (rts2core::Error &er)
+		{
+			logStream (MESSAGE_WARNING) << "cannot generate preview pyramid of " << job.path << ": " << er << sendLog;
+		}
+		catch (Magick::Exception &ex)
+		{
+			logStream (MESSAGE_WARNING) << "cannot generate preview pyramid of " << job.path << ": " << ex.what () << sendLog;
+		}
+
+		pthread_mutex_lock (&mutex);
+	}
+	pthread_mutex_unlock (&mutex);
+}
+
+#endif // RTS2_HAVE_LIBJPEG
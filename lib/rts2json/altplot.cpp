@@ -128,6 +128,15 @@ void AltPlot::preparePlot (double _from, double _to, Magick::Image* _image, Plot
 	plotXDate ();
 }
 
+// use ephemeris tables if they are available
+static void getTargetAltAz (rts2db::Target *tar, rts2db::TargetEphemeris *eph, struct ln_hrz_posn *hrz, double JD)
+{
+	if (eph)
+		eph->getAltAz (hrz, JD);
+	else
+		tar->getAltAz (hrz, JD);
+}
+
 void AltPlot::plotTargetHorizon (rts2db::Target *tar, Magick::Color col, PlotType _plotType, int linewidth)
 {
 	// reset stroke pattern
@@ -146,7 +155,9 @@ void AltPlot::plotTargetHorizon (rts2db::Target *tar, Magick::Color col, PlotTyp
 
 	double JD = ln_get_julian_from_timet (&t_from);
 
-	tar->getAltAz (&hrz, JD);
+	rts2db::TargetEphemeris *eph = tar->getEphemeris (JD, JD + (to - from) / 86400.0);
+
+	getTargetAltAz (tar, eph, &hrz, JD);
 
 	double stepX = (to - from) / (size.width () - y_axis_width) / 86400.0;
 
@@ -157,7 +168,7 @@ void AltPlot::plotTargetHorizon (rts2db::Target *tar, Magick::Color col, PlotTyp
 	while (x < (size.width ()))
 	{
 		JD += stepX;
-		tar->getAltAz (&hrz, JD);
+		getTargetAltAz (tar, eph, &hrz, JD);
 		double y_end = size.height () - x_axis_height - scaleY * rts2core::Configuration::instance ()->getObjectChecker ()->getHorizonHeight (&hrz, 0);
 		plotRange (x, y, x_end, y_end);
 		x = x_end;
@@ -182,7 +193,9 @@ void AltPlot::plotTarget (rts2db::Target *tar, Magick::Color col, int linewidth,
 
 	double JD = ln_get_julian_from_timet (&t_from);
 
-	tar->getAltAz (&hrz, JD);
+	rts2db::TargetEphemeris *eph = tar->getEphemeris (JD, JD + (to - from) / 86400.0);
+
+	getTargetAltAz (tar, eph, &hrz, JD);
 
 	double stepX = (to - from) / (size.width () - y_axis_width) / 86400.0;
 
@@ -193,7 +206,7 @@ void AltPlot::plotTarget (rts2db::Target *tar, Magick::Color col, int linewidth,
 	while (x < (size.width ()))
 	{
 		JD += stepX;
-		tar->getAltAz (&hrz, JD);
+		getTargetAltAz (tar, eph, &hrz, JD);
 		double y_end = size.height () - x_axis_height - scaleY * (hrz.alt - min) + shadow;
 		plotRange (x, y, x_end, y_end);
 		x = x_end;
@@ -22,6 +22,19 @@
 #include "rts2json/jsonvalue.h"
 #include "rts2json/httpreq.h"
 
+#include <algorithm>
+
+// ping WebSocket client if nothing was received for given time
+#define WS_PING_INTERVAL     30
+// close WebSocket if client does not reply to ping
+#define WS_TIMEOUT           90
+
+// do not flush updates if more then this number of bytes is waiting to be send to slow client
+#define WS_MAX_BACKLOG       262144
+
+// maximal number of messages kept for slow WebSocket client, older messages are dropped
+#define WS_MAX_MESSAGES      1000
+
 using namespace rts2json;
 
 AsyncAPI::AsyncAPI (JSONRequest *_req, rts2core::Connection *_conn, XmlRpc::XmlRpcServerConnection *_source, bool _ext):Object ()
@@ -31,6 +44,10 @@ AsyncAPI::AsyncAPI (JSONRequest *_req, rts2core::Connection *_conn, XmlRpc::XmlR
 	conn = _conn;
 	source = _source;
 	ext = _ext;
+	lastPing = 0;
+
+	if (source && source->isWebSocketRequest ())
+		source->acceptWebSocket (this);
 }
 
 AsyncAPI::~AsyncAPI ()
@@ -50,14 +67,14 @@ void AsyncAPI::postEvent (rts2core::Event *event)
 				os << "{";
 				rts2json::sendConnectionValues (os, conn, NULL, -1, ext);
 				os << ",\"ret\":0}";
-				req->sendAsyncJSON (os, source);
+				sendJSON (os);
 				asyncFinished ();
 				break;
 			case EVENT_COMMAND_FAILED:
 				os << "{";
 				rts2json::sendConnectionValues (os, conn, NULL, -1, ext);
 				os << ",\"ret\":-1}";
-				req->sendAsyncJSON (os, source);
+				sendJSON (os);
 				asyncFinished ();
 				break;
 		}
@@ -65,28 +82,44 @@ void AsyncAPI::postEvent (rts2core::Event *event)
 	Object::postEvent (event);
 }
 
-AsyncValueAPI::AsyncValueAPI (JSONRequest *_req, XmlRpc::XmlRpcServerConnection *_source, XmlRpc::HttpParams *params): AsyncAPI (_req, NULL, _source, false) 
+int AsyncAPI::idle ()
 {
-	// chunked response
-	req->sendAsyncDataHeader (0, _source, "application/json");
-
-	for (XmlRpc::HttpParams::iterator iter = params->begin (); iter != params->end (); iter++)
+	if (isWebSocket ())
 	{
-	  	// handle special values - states,..
-		if (strcmp (iter->getValue (), "__S__") == 0)
-		{
-			states.push_back (AsyncState (iter->getName ()));
-		}
-		else if (strcmp (iter->getValue (), "*") == 0)
+		time_t now = time (NULL);
+		time_t last = source->getWebSocketLastReceived ();
+		if (now - last > WS_TIMEOUT)
 		{
-			states.push_back (AsyncState (iter->getName ()));
-			devices.push_back (iter->getName ());
+			logStream (MESSAGE_DEBUG) << "closing WebSocket, client does not respond" << sendLog;
+			asyncFinished ();
 		}
-		else
+		else if (now - last > WS_PING_INTERVAL && now - lastPing > WS_PING_INTERVAL)
 		{
-			values.push_back (std::pair <std::string, std::string> (iter->getName (), iter->getValue ()));
+			source->pingWebSocket ();
+			lastPing = now;
 		}
 	}
+	return source == NULL;
+}
+
+void AsyncAPI::sendJSON (std::ostringstream &_os)
+{
+	if (isWebSocket ())
+		source->sendWebSocket (_os.str ());
+	else
+		req->sendAsyncJSON (_os, source);
+}
+
+AsyncValueAPI::AsyncValueAPI (JSONRequest *_req, XmlRpc::XmlRpcServerConnection *_source, XmlRpc::HttpParams *params): AsyncAPI (_req, NULL, _source, false) 
+{
+	master = NULL;
+	droppedMessages = 0;
+
+	// chunked response
+	if (!isWebSocket ())
+		req->sendAsyncDataHeader (0, _source, "application/json");
+
+	addSubscriptions (params);
 }
 
 void AsyncValueAPI::stateChanged (rts2core::Connection *_conn)
@@ -126,8 +159,129 @@ void AsyncValueAPI::valueChanged (rts2core::Connection *_conn, rts2core::Value *
 	}
 }
 
+void AsyncValueAPI::message (rts2core::Message &msg)
+{
+	if (source == NULL)
+		return;
+
+	for (std::vector <std::string>::iterator iter = messages.begin (); iter != messages.end (); iter++)
+	{
+		if (*iter == "*" || *iter == msg.getMessageOName ())
+		{
+			std::ostringstream os;
+			os << std::fixed << "{\"m\":[" << msg.getMessageTime () << "," << JsonString (msg.getMessageOName ()) << "," << msg.getType () << "," << JsonString (msg.getMessageString ()) << "]}";
+			if (isWebSocket ())
+			{
+				pendingMessages.push_back (os.str ());
+				if (pendingMessages.size () > WS_MAX_MESSAGES)
+				{
+					pendingMessages.pop_front ();
+					droppedMessages++;
+				}
+			}
+			else if (source->sendChunked (os.str ()) == false)
+			{
+				asyncFinished ();
+			}
+			return;
+		}
+	}
+}
+
+void AsyncValueAPI::webSocketMessage (XmlRpc::XmlRpcServerConnection *_source, int opcode, const std::string &message)
+{
+	if (opcode != WS_TEXT)
+		return;
+
+	std::string cmd = message;
+	XmlRpc::HttpParams params;
+	std::string::size_type pi = message.find ('?');
+	if (pi != std::string::npos)
+	{
+		cmd = message.substr (0, pi);
+		params.parse (message.substr (pi + 1));
+	}
+
+	std::ostringstream os;
+	if (cmd == "subscribe")
+	{
+		std::list <AsyncState>::size_type os_states = states.size ();
+		std::vector <std::string>::size_type os_devices = devices.size ();
+		std::vector <std::pair <std::string, std::string> >::size_type os_values = values.size ();
+		std::vector <std::string>::size_type os_messages = messages.size ();
+
+		addSubscriptions (&params);
+		try
+		{
+			// new values will be send with the next flush
+			if (master)
+				sendAll (master);
+			return;
+		}
+		catch (XmlRpc::JSONException &ex)
+		{
+			states.resize (os_states, AsyncState (""));
+			devices.resize (os_devices);
+			values.resize (os_values);
+			messages.resize (os_messages);
+			os << "{\"error\":" << JsonString (ex.getMessage ()) << ",\"ret\":-2}";
+		}
+	}
+	else if (cmd == "unsubscribe")
+	{
+		removeSubscriptions (&params);
+		return;
+	}
+	else
+	{
+		os << "{\"error\":" << JsonString ("unknown command " + cmd) << ",\"ret\":-2}";
+	}
+	source->sendWebSocket (os.str ());
+}
+
+void AsyncValueAPI::flush ()
+{
+	if (source == NULL || !isWebSocket () || !hasPending ())
+		return;
+
+	// client is too slow, wait until it reads data and send only the latest updates
+	if (source->getWebSocketPending () > WS_MAX_BACKLOG)
+		return;
+
+	std::ostringstream os;
+	os << "[";
+	for (std::map <std::string, std::string>::iterator iter = pending.begin (); iter != pending.end (); iter++)
+	{
+		if (iter != pending.begin ())
+			os << ",";
+		os << iter->second;
+	}
+	for (std::list <std::string>::iterator iter = pendingMessages.begin (); iter != pendingMessages.end (); iter++)
+	{
+		if (iter != pendingMessages.begin () || !pending.empty ())
+			os << ",";
+		os << *iter;
+	}
+	if (droppedMessages > 0)
+	{
+		if (!(pending.empty () && pendingMessages.empty ()))
+			os << ",";
+		os << "{\"m_dropped\":" << droppedMessages << "}";
+	}
+	os << "]";
+
+	pending.clear ();
+	pendingMessages.clear ();
+	droppedMessages = 0;
+
+	if (source->sendWebSocket (os.str ()) == false)
+		asyncFinished ();
+}
+
 void AsyncValueAPI::sendAll (rts2core::Device *device)
 {
+	master = device;
+
 	rts2core::Value *val;
 	rts2core::Connection *_conn;
 	for (std::list <AsyncState>::iterator iter = states.begin (); iter != states.end (); iter++)
@@ -198,7 +352,8 @@ void AsyncValueAPI::sendState (std::list <AsyncState>::iterator astate, rts2core
 	if (!isnan (_conn->getProgressEnd ()))
 		os << ",\"st\":" << _conn->getProgressEnd ();
 	os << "}";
-	source->sendChunked (os.str ());
+	// state of device is send before its values
+	sendUpdate (astate->name, os.str ());
 }
 
 void AsyncValueAPI::sendValue (const std::string &device, rts2core::Value *_value)
@@ -207,10 +362,81 @@ void AsyncValueAPI::sendValue (const std::string &device, rts2core::Value *_valu
 	os << std::fixed << "{\"d\":\"" << device << "\",\"t\":" << getNow () << ",\"v\":{";
 	rts2json::jsonValue (_value, true, os);
 	os << "}}";
-	if (source == NULL || source->sendChunked (os.str ()) == false)
+	sendUpdate (device + "." + _value->getName (), os.str ());
+}
+
+void AsyncValueAPI::sendUpdate (const std::string &key, const std::string &update)
+{
+	if (source == NULL)
+	{
+		asyncFinished ();
+		return;
+	}
+	if (isWebSocket ())
+	{
+		// replace older update of the same value
+		pending[key] = update;
+		return;
+	}
+	if (source->sendChunked (update) == false)
 		asyncFinished ();
 }
 
+void AsyncValueAPI::addSubscriptions (XmlRpc::HttpParams *params)
+{
+	for (XmlRpc::HttpParams::iterator iter = params->begin (); iter != params->end (); iter++)
+	{
+	  	// handle special values - states,..
+		if (strcmp (iter->getValue (), "__S__") == 0)
+		{
+			states.push_back (AsyncState (iter->getName ()));
+		}
+		else if (strcmp (iter->getValue (), "__M__") == 0)
+		{
+			messages.push_back (iter->getName ());
+		}
+		else if (strcmp (iter->getValue (), "*") == 0)
+		{
+			states.push_back (AsyncState (iter->getName ()));
+			devices.push_back (iter->getName ());
+		}
+		else
+		{
+			values.push_back (std::pair <std::string, std::string> (iter->getName (), iter->getValue ()));
+		}
+	}
+}
+
+void AsyncValueAPI::removeSubscriptions (XmlRpc::HttpParams *params)
+{
+	for (XmlRpc::HttpParams::iterator iter = params->begin (); iter != params->end (); iter++)
+	{
+		std::string name = iter->getName ();
+		if (strcmp (iter->getValue (), "__S__") == 0 || strcmp (iter->getValue (), "*") == 0)
+		{
+			for (std::list <AsyncState>::iterator siter = states.begin (); siter != states.end ();)
+			{
+				if (siter->name == name)
+					siter = states.erase (siter);
+				else
+					siter++;
+			}
+		}
+		if (strcmp (iter->getValue (), "__M__") == 0)
+		{
+			messages.erase (std::remove (messages.begin (), messages.end (), name), messages.end ());
+		}
+		else if (strcmp (iter->getValue (), "*") == 0)
+		{
+			devices.erase (std::remove (devices.begin (), devices.end (), name), devices.end ());
+		}
+		else
+		{
+			values.erase (std::remove (values.begin (), values.end (), std::pair <std::string, std::string> (name, iter->getValue ())), values.end ());
+		}
+	}
+}
+
 AsyncSimulateAPI::AsyncSimulateAPI (JSONRequest *_req, XmlRpc::XmlRpcServerConnection *_source, XmlRpc::HttpParams *params): AsyncValueAPI (_req, _source, params)
 {
 }
@@ -274,7 +500,7 @@ void AsyncDataAPI::fullDataReceived (rts2core::Connection *_conn, rts2core::Data
 							ds = sizeof (struct imghdr) + (newType / 8) * ds;
 							if (bytesSoFar == 0 && headerSend == false)
 							{
-								req->sendAsyncDataHeader (ds, source);
+								sendDataHeader (ds);
 								headerSend = true;
 							}
 						}
@@ -285,14 +511,13 @@ void AsyncDataAPI::fullDataReceived (rts2core::Connection *_conn, rts2core::Data
 							getScaledData (oldType, newData, ds, smin, smax, scaling, newType);
 							ds *= (newType / 8);
 						}
-						source->setResponse (newData, ds);
+						sendRest (newData, ds);
 						delete[] newData;
 					}
 					else
 					{
-						source->setResponse (data->getDataBuff () + bytesSoFar, data->getDataTop () - data->getDataBuff () - bytesSoFar);
+						sendRest (data->getDataBuff () + bytesSoFar, data->getDataTop () - data->getDataBuff () - bytesSoFar);
 					}
-					nullSource ();
 				}
 				else
 				{
@@ -326,11 +551,11 @@ void AsyncDataAPI::sendData ()
 				if (oldType == 0)
 					oldType = ntohs (((struct imghdr *) data->getDataBuff ())->data_type);
 
-				req->sendAsyncDataHeader (sizeof (struct imghdr) + (newType / 8) * (ds - sizeof (struct imghdr)) / (oldType / 8), source);
+				sendDataHeader (sizeof (struct imghdr) + (newType / 8) * (ds - sizeof (struct imghdr)) / (oldType / 8));
 			}
 			else
 			{
-				req->sendAsyncDataHeader (ds, source);
+				sendDataHeader (ds);
 			}
 			headerSend = true;
 		}
@@ -367,6 +592,33 @@ void AsyncDataAPI::sendData ()
 	doSendData (data->getDataBuff () + bytesSoFar, data->getDataTop () - data->getDataBuff () - bytesSoFar);
 }
 
+void AsyncDataAPI::sendRest (char *buf, size_t bufs)
+{
+	if (isWebSocket ())
+	{
+		// close frame is send after data
+		if (bufs > 0)
+			source->sendWebSocket (buf, bufs, WS_BINARY);
+		asyncFinished ();
+		return;
+	}
+	source->setResponse (buf, bufs);
+	nullSource ();
+}
+
+void AsyncDataAPI::sendDataHeader (size_t ds)
+{
+	// WebSocket client receives data size in text frame, followed by binary frames with data
+	if (isWebSocket ())
+	{
+		std::ostringstream os;
+		os << "{\"length\":" << ds << "}";
+		source->sendWebSocket (os.str ());
+		return;
+	}
+	req->sendAsyncDataHeader (ds, source);
+}
+
 AsyncCurrentAPI::AsyncCurrentAPI (JSONRequest *_req, rts2core::Connection *_conn, XmlRpc::XmlRpcServerConnection *_source, rts2core::DataAbstractRead *_data, int _chan, long _smin, long _smax, rts2image::scaling_type _scaling, int _newType):AsyncDataAPI (_req, _conn, _source, _data, _chan, _smin, _smax, _scaling, _newType)
 {
 	// try to send data
@@ -419,7 +671,7 @@ void AsyncExposeAPI::postEvent (rts2core::Event *event)
 				{
 					std::ostringstream os;
 					os << "{\"failed\"}";
-					req->sendAsyncJSON (os, source);
+					sendJSON (os);
 					asyncFinished ();
 				}
 				break;
@@ -470,7 +722,7 @@ void AsyncExposeAPI::exposureFailed (rts2core::Connection *_conn, int status)
 					{
 						std::ostringstream os;
 						os << "{\"failed\"}";
-						req->sendAsyncJSON (os, source);
+						sendJSON (os);
 					}
 					break;
 				case receivingImage:
@@ -514,7 +766,7 @@ void AsyncAPIMSet::postEvent (rts2core::Event *event)
 		if (pendingCalls == 0 && (succ != 0 || failed != 0))
 		{
 			os << "{\"succ\":" << succ << ",\"failed\":" << failed << ",\"ret\":0}";
-			req->sendAsyncJSON (os, source);
+			sendJSON (os);
 			asyncFinished ();
 		}
 	}
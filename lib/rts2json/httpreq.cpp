@@ -30,6 +30,8 @@ void GetRequestAuthorized::execute (XmlRpc::XmlRpcSource *source, struct sockadd
 	if (getServer ()->isPublic (saddr, getPrefix () + path))
 	{
 		http_code = HTTP_OK;
+		if (isOffloadable (path, params) && getServer ()->offloadRequest (this, connection, path, params))
+			throw XmlRpc::XmlRpcAsynchronous ();
 		authorizedExecute (source, path, params, response_type, response, response_length);
 		return;
 	}
@@ -50,6 +52,12 @@ void GetRequestAuthorized::execute (XmlRpc::XmlRpcSource *source, struct sockadd
 	}
 	http_code = HTTP_OK;
 
+	if (isOffloadable (path, params) && getServer ()->offloadRequest (this, connection, path, params))
+	{
+		getServer ()->addExecutedPage ();
+		throw XmlRpc::XmlRpcAsynchronous ();
+	}
+
 	authorizedExecute (source, path, params, response_type, response, response_length);
 
 	getServer ()->addExecutedPage ();
@@ -56,3 +56,19 @@ void HTTPServer::asyncIdle ()
 		}
 	}
 }
+
+bool HTTPServer::asyncPending ()
+{
+	for (std::list <rts2json::AsyncAPI *>::iterator iter = asyncAPIs.begin (); iter != asyncAPIs.end (); iter++)
+	{
+		if ((*iter)->hasPending ())
+			return true;
+	}
+	return false;
+}
+
+void HTTPServer::asyncFlush ()
+{
+	for (std::list <rts2json::AsyncAPI *>::iterator iter = asyncAPIs.begin (); iter != asyncAPIs.end (); iter++)
+		(*iter)->flush ();
+}
@@ -64,6 +64,35 @@
  *
  * <b>image/jpeg</b> sized to have bigger axis equal to <b>ps</b> parameter.
  *
+ * <hr/>
+ *
+ * @section XMLRPCD_filedownload_tiles tiles
+ *
+ * Returns tiles of multi-resolution pyramid generated from the image. Tiles
+ * are 256x256 pixels JPEG images. Level 0 fits into a single tile, each
+ * following level doubles image size, the last level has full image
+ * resolution. If preview_cache is set in [xmlrpcd] section of the
+ * configuration file, pyramid is generated on first request and served from
+ * the cache afterwards.
+ *
+ * @subsection Example
+ *
+ * http://localhost:8889/tiles/images/2011.1210/0001.fits
+ * http://localhost:8889/tiles/images/2011.1210/0001.fits?z=2&x=1&y=3
+ *
+ * @subsection Parameters
+ *  - <i><b>z</b> zoom level. If not specified, JSON with pyramid size is returned.</i>
+ *  - <i><b>x</b> tile column, counted from 0.</i>
+ *  - <i><b>y</b> tile row, counted from 0.</i>
+ *  - <i><b>q</b> quantiles for image display. Default to 0.005.</i>
+ *  - <i><b>chan</b> channel of multiple extenstion image, -1 for all channels.</i>
+ *  - <i><b>cv</b> colour variant.</i>
+ *
+ * @subsection Return
+ *
+ * <b>image/jpeg</b> tile, or JSON object with <b>w</b> and <b>h</b> full
+ * image size, number of <b>levels</b> and <b>tile</b> size.
+ *
  * @section XMLRPCD_filedownload_fits fits
  *
  * Allow access to FITS images.
@@ -71,10 +100,11 @@
  * @subsection Example
  *
  * http://localhost:8889/fits/images/2011.1210/0001.fits
+ * http://localhost:8889/fits/images/2011.1210/0001.fits?compress=rice
+ * http://localhost:8889/fits/images/2011.1210/0001.fits?compress=none
  *
  * @subsection Parameters
- *
- * None.
+ *  - <i><b>compress</b> if specified, image data are converted before they are send. <b>none</b> decompresses tile compressed images, <b>rice</b>, <b>gzip</b>, <b>gzip2</b>, <b>hcompress</b> or <b>plio</b> compress uncompressed images. Already compressed images are send as they are stored. If not specified, file is send as it is stored on the disk.</i>
  *
  * @subsection Return
  *
@@ -82,6 +112,20 @@
  *
  * <hr/>
  *
+ * @section XMLRPCD_filedownload_download download
+ *
+ * Returns bzip2 compressed tar archive of files.
+ *
+ * @subsection Parameters
+ *  - <i><b>files</b> file to include in the archive. Can be repeated.</i>
+ *  - <i><b>compress</b> converts FITS files, the same as for the fits request.</i>
+ *
+ * @subsection Return
+ *
+ * <b>application/x-gtar</b> archive with the files.
+ *
+ * <hr/>
+ *
  * @section XMLRPCD_filedownload_data data
  *
  * Return raw data. Properly service sockets, so it will send new data only if
@@ -96,7 +140,9 @@
 #define	_FILE_OFFSET_BITS 64
 #endif
 
+#include "rts2fits/compression.h"
 #include "rts2fits/image.h"
+#include "rts2fits/previewcache.h"
 #include "rts2json/bsc.h"
 #include "rts2json/imgpreview.h"
 #include "dirsupport.h"
@@ -222,9 +268,6 @@ using namespace Magick;
 void JpegImageRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length)
 {
 	response_type = "image/jpeg";
-	rts2image::Image image;
-	image.openFile (path.c_str (), true, false);
-	Blob blob;
 
 	const char * label = params->getString ("lb", getServer ()->getDefaultImageLabel ());
 
@@ -232,16 +275,34 @@ void JpegImageRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::str
 	int chan = params->getInteger ("chan", getServer ()->getDefaultChannel ());
 	int colourVariant = params->getInteger ("cv", DEFAULT_COLOURVARIANT);
 
-	Magick::Image *mimage = image.getMagickImage (label, quantiles, chan, colourVariant);
-
 	cacheMaxAge (CACHE_MAX_STATIC);
 
+	rts2image::PreviewCache *cache = getServer ()->getPreviewCache ();
+	std::string entry;
+	if (cache)
+	{
+		std::ostringstream os;
+		os << "jpeg lb=" << label << " q=" << quantiles << " chan=" << chan << " cv=" << colourVariant;
+		entry = cache->entryName (path.c_str (), os.str ());
+		if (cache->get (entry, response, response_length))
+			return;
+	}
+
+	rts2image::Image image;
+	image.openFile (path.c_str (), true, false);
+	Blob blob;
+
+	Magick::Image *mimage = image.getMagickImage (label, quantiles, chan, colourVariant);
+
 	mimage->write (&blob, "jpeg");
 	response_length = blob.length();
 	response = new char[response_length];
 	memcpy (response, blob.data(), response_length);
 
 	delete mimage;
+
+	if (cache)
+		cache->put (entry, response, response_length);
 }
 
 void JpegPreview::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length)
@@ -269,11 +330,29 @@ void JpegPreview::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string p
 	{
 		response_type = "image/jpeg";
 
+		cacheMaxAge (CACHE_MAX_STATIC);
+
+		rts2image::PreviewCache *cache = getServer ()->getPreviewCache ();
+		std::string entry;
+		if (cache)
+		{
+			std::ostringstream os;
+			os << "preview ps=" << prevsize << " lb=" << label << " q=" << quantiles << " chan=" << chan << " cv=" << colourVariant;
+			entry = cache->entryName (absPath, os.str ());
+			if (cache->get (entry, response, response_length))
+				return;
+		}
+
 		rts2image::Image image;
 		image.openFile (absPath, true, false);
 		Blob blob;
 
-		Magick::Image *mimage = image.getMagickImage (NULL, quantiles, chan, colourVariant);
+		Magick::Image *mimage = NULL;
+		// scale pyramid level, if available, instead of full image
+		if (cache && prevsize > 0)
+			mimage = cache->getLevelImage (absPath, quantiles, chan, colourVariant, prevsize);
+		if (mimage == NULL)
+			mimage = image.getMagickImage (NULL, quantiles, chan, colourVariant);
 		if (prevsize > 0)
 		{
 			mimage->zoom (Magick::Geometry (prevsize, prevsize));
@@ -284,14 +363,15 @@ void JpegPreview::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string p
 			image.writeLabel (mimage, 1, mimage->rows () - 2, 10, label);
 		}
 
-		cacheMaxAge (CACHE_MAX_STATIC);
-
 		mimage->write (&blob, "jpeg");
 		response_length = blob.length();
 		response = new char[response_length];
 		memcpy (response, blob.data(), response_length);
 
 		delete mimage;
+
+		if (cache)
+			cache->put (entry, response, response_length);
 		return;
 	}
 
@@ -403,11 +483,52 @@ void JpegPreview::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string p
 	memcpy (response, _os.str ().c_str (), response_length);
 }
 
+void TileRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length)
+{
+	float quantiles = params->getDouble ("q", DEFAULT_QUANTILES);
+	int chan = params->getInteger ("chan", getServer ()->getDefaultChannel ());
+	int colourVariant = params->getInteger ("cv", DEFAULT_COLOURVARIANT);
+
+	int z = params->getInteger ("z", -1);
+
+	rts2image::PreviewCache noCache;
+	rts2image::PreviewCache *cache = getServer ()->getPreviewCache ();
+	if (cache == NULL)
+		cache = &noCache;
+
+	cacheMaxAge (CACHE_MAX_STATIC);
+
+	if (z < 0)
+	{
+		int width, height, levels;
+		cache->getPyramidInfo (path.c_str (), quantiles, chan, colourVariant, width, height, levels);
+		std::ostringstream _os;
+		_os << "{\"w\":" << width << ",\"h\":" << height << ",\"levels\":" << levels << ",\"tile\":" << PREVIEW_TILE_SIZE << "}";
+		returnJSON (_os, response_type, response, response_length);
+		return;
+	}
+
+	response_type = "image/jpeg";
+	cache->getTile (path.c_str (), quantiles, chan, colourVariant, z, params->getInteger ("x", 0), params->getInteger ("y", 0), response, response_length);
+}
+
 #endif /* RTS2_HAVE_LIBJPEG */
 
 void FitsImageRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length)
 {
 	response_type = "image/fits";
+
+	const char *compress = params->getString ("compress", NULL);
+	if (compress != NULL)
+	{
+		int ct = rts2image::compressionType (compress);
+		if (ct < 0)
+			throw XmlRpc::XmlRpcException ("Invalid compression");
+		if (rts2image::convertCompression (path.c_str (), ct, response, response_length))
+			throw XmlRpc::XmlRpcException ("Cannot convert FITS file");
+		return;
+	}
+
 	int f = open (path.c_str (), O_RDONLY);
 	if (f == -1)
 	{
@@ -441,6 +562,16 @@ void DownloadRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::stri
 
 	addExtraHeader ("Content-disposition","attachment; filename=images.tar.bz2");
 
+	// validate parameters before archive is created, so it is not leaked
+	int ct = -1;
+	const char *compress = params->getString ("compress", NULL);
+	if (compress != NULL)
+	{
+		ct = rts2image::compressionType (compress);
+		if (ct < 0)
+			throw XmlRpc::XmlRpcException ("Invalid compression");
+	}
+
 	struct ::archive *a;
 	struct ::archive_entry *entry;
 
@@ -455,7 +586,6 @@ void DownloadRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::stri
 	{
 		if (!strcmp (iter->getName (), "files"))
 		{
-			entry = archive_entry_new ();
 			struct stat st;
 
 			char fn[strlen (iter->getValue ()) + 1];
@@ -463,17 +593,35 @@ void DownloadRequest::authorizedExecute (XmlRpc::XmlRpcSource *source, std::stri
 
 			int fd = open (fn, O_RDONLY);
 			if (fd < 0)
+			{
+				archive_write_finish (a);
 				throw XmlRpc::XmlRpcException ("Cannot open file for packing");
+			}
+			entry = archive_entry_new ();
 			fstat (fd, &st);
 			archive_entry_copy_stat (entry, &st);
 			archive_entry_set_pathname (entry, basename (fn));
-			archive_write_header (a, entry);
-
-			int len;
-			char buff[8196];
 
-			while ((len = read (fd, buff, sizeof (buff))) > 0)
-				archive_write_data (a, buff, len);
+			char *conv = NULL;
+			size_t conv_length = 0;
+			// files which are not FITS are packed as they are
+			if (ct >= 0 && rts2image::convertCompression (fn, ct, conv, conv_length) == 0)
+			{
+				archive_entry_set_size (entry, conv_length);
+				archive_write_header (a, entry);
+				archive_write_data (a, conv, conv_length);
+				delete[] conv;
+			}
+			else
+			{
+				archive_write_header (a, entry);
+
+				int len;
+				char buff[8196];
+
+				while ((len = read (fd, buff, sizeof (buff))) > 0)
+					archive_write_data (a, buff, len);
+			}
 
 			close (fd);
 			archive_entry_free (entry);
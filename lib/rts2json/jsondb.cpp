@@ -50,6 +50,28 @@ rts2db::Target * rts2json::getTarget (XmlRpc::HttpParams *params, const char *pa
 	return target;
 }
 
+// calls which only read from database
+static const char *readOnlyCalls[] = {
+	"tbyname", "tbyid", "tbylabel", "tbydistance", "tbystring", "ibyoid", "labels", "consts", "violated", "satisfied",
+	"cnst_alt", "cnst_alt_v", "cnst_time", "cnst_time_v", "resolve", "tlabs_list", "obytid", "lastobs", "obyid",
+	"stat_obylid", "plan", "labellist", "messages", "auger", NULL
+};
+
+bool JSONDBRequest::isOffloadableDB (const std::vector <std::string> &vals, XmlRpc::HttpParams *params)
+{
+	if (vals.size () == 0)
+		return false;
+	// chunked response is send from the main thread
+	if (vals[0] == "tbyname" && params->getInteger ("ch", 0))
+		return false;
+	for (const char **c = readOnlyCalls; *c; c++)
+	{
+		if (vals[0] == *c)
+			return true;
+	}
+	return false;
+}
+
 void JSONDBRequest::dbJSON (const std::vector <std::string> vals, XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, std::ostringstream &os)
 {
 	// returns target information specified by target name
@@ -24,8 +24,19 @@
 #include "valuerectangle.h"
 #include "valueminmax.h"
 
+#include "utilsfunc.h"
+
+#include <algorithm>
+
 using namespace rts2json;
 
+static unsigned long changeSequence = 0;
+
+unsigned long rts2json::getChangeSequence ()
+{
+	return changeSequence;
+}
+
 double DevInterface::getValueChangedTime (rts2core::Value *value)
 {
 	std::map <rts2core::Value *, double>::iterator iter = changedTimes.find (value);
@@ -34,6 +45,93 @@ double DevInterface::getValueChangedTime (rts2core::Value *value)
 	return iter->second;
 }
 
+unsigned long DevInterface::getValueChangedSequence (rts2core::Value *value)
+{
+	std::map <rts2core::Value *, unsigned long>::iterator iter = changedSequences.find (value);
+	if (iter == changedSequences.end ())
+		return 0;
+	return iter->second;
+}
+
+void DevInterface::markValueChanged (rts2core::Value *value)
+{
+	changeSequence++;
+	changedTimes[value] = getNow ();
+	changedSequences[value] = changeSequence;
+	lastSequence = changeSequence;
+}
+
+bool DevInterface::isCacheable (rts2core::Value *value)
+{
+	// values which are changed localy, without valueChanged call, cannot be cached
+	return getValueChangedSequence (value) > 0;
+}
+
+void DevInterface::jsonCachedValue (rts2core::Value *value, bool extended, std::ostringstream &os)
+{
+	unsigned long seq = getValueChangedSequence (value);
+	if (seq == 0)
+	{
+		jsonValue (value, extended, os);
+		return;
+	}
+
+	int e = extended ? 1 : 0;
+
+	std::map <rts2core::Value *, CachedValue>::iterator iter = cachedValues.find (value);
+	// value can be deleted and new value allocated at the same address, or flags changed with metainfo
+	if (iter == cachedValues.end () || iter->second.sequence != seq || iter->second.flags != value->getFlags () || iter->second.name != value->getName ())
+	{
+		CachedValue cv;
+		cv.name = value->getName ();
+		cv.flags = value->getFlags ();
+		cv.sequence = seq;
+		cv.valid[0] = cv.valid[1] = false;
+		iter = cachedValues.insert (std::pair <rts2core::Value *, CachedValue> (value, cv)).first;
+		iter->second = cv;
+	}
+
+	if (!iter->second.valid[e])
+	{
+		std::ostringstream vos;
+		vos << std::fixed;
+		jsonValue (value, extended, vos);
+		iter->second.json[e] = vos.str ();
+		iter->second.valid[e] = true;
+	}
+	os << iter->second.json[e];
+}
+
+void DevInterface::jsonSnapshot (rts2core::Connection *conn, bool extended, std::ostringstream &os)
+{
+	int e = extended ? 1 : 0;
+	if (snapshotValid[e] && snapshotSequence[e] == lastSequence && snapshotValues[e].size () == (size_t) conn->valueSize () && std::equal (snapshotValues[e].begin (), snapshotValues[e].end (), conn->valueBegin ()))
+	{
+		os << snapshot[e];
+		return;
+	}
+
+	std::ostringstream sos;
+	sos << std::fixed;
+	bool cacheable = true;
+	snapshotValues[e].clear ();
+	for (rts2core::ValueVector::iterator iter = conn->valueBegin (); iter != conn->valueEnd (); iter++)
+	{
+		if (iter != conn->valueBegin ())
+			sos << ",";
+		if (!isCacheable (*iter))
+			cacheable = false;
+		jsonCachedValue (*iter, extended, sos);
+		snapshotValues[e].push_back (*iter);
+	}
+
+	snapshot[e] = sos.str ();
+	snapshotSequence[e] = lastSequence;
+	snapshotValid[e] = cacheable;
+
+	os << snapshot[e];
+}
+
 void rts2json::sendArrayValue (rts2core::Value *value, std::ostringstream &os)
 {
 	os << "[";
@@ -164,30 +262,53 @@ void rts2json::jsonValue (rts2core::Value *value, bool extended, std::ostringstr
 		os << "," << value->isError () << "," << value->isWarning () << ",\"" << value->getDescription () << "\"]";
 }
 
-void rts2json::sendConnectionValues (std::ostringstream & os, rts2core::Connection * conn, XmlRpc::HttpParams *params, double from, bool extended)
+void rts2json::sendConnectionValues (std::ostringstream & os, rts2core::Connection * conn, XmlRpc::HttpParams *params, double from, bool extended, unsigned long since)
 {
 	os << "\"d\":{" << std::fixed;
 	double mfrom = NAN;
 	bool first = true;
 	rts2core::ValueVector::iterator iter;
 
-	for (iter = conn->valueBegin (); iter != conn->valueEnd (); iter++)
+	DevInterface *di = conn->getOtherDevClient () ? dynamic_cast <DevInterface *> (conn->getOtherDevClient ()) : NULL;
+
+	if (di && !(isnan (from) || from > 0) && since == 0)
 	{
-		if ((isnan (from) || from > 0) && conn->getOtherDevClient ())
+		// all values are requested
+		di->jsonSnapshot (conn, extended, os);
+	}
+	else
+	{
+		for (iter = conn->valueBegin (); iter != conn->valueEnd (); iter++)
 		{
-			double ch = ((DevInterface *) (conn->getOtherDevClient ()))->getValueChangedTime (*iter);
-			if (isnan (mfrom) || ch > mfrom)
-				mfrom = ch;
-			if (!isnan (from) && !isnan (ch) && ch < from)
-				continue;
-		}
+			if (di)
+			{
+				if (isnan (from) || from > 0)
+				{
+					double ch = di->getValueChangedTime (*iter);
+					if (isnan (mfrom) || ch > mfrom)
+						mfrom = ch;
+					if (!isnan (from) && !isnan (ch) && ch < from)
+						continue;
+				}
+				// values without reported change are always send, as their changes are not tracked
+				if (since > 0)
+				{
+					unsigned long seq = di->getValueChangedSequence (*iter);
+					if (seq > 0 && seq <= since)
+						continue;
+				}
+			}
 
-		if (first)
-			first = false;
-		else
-			os << ",";
+			if (first)
+				first = false;
+			else
+				os << ",";
 
-		jsonValue (*iter, extended, os);
+			if (di)
+				di->jsonCachedValue (*iter, extended, os);
+			else
+				jsonValue (*iter, extended, os);
+		}
 	}
 	os << "},\"minmax\":{";
 
@@ -206,5 +327,5 @@ void rts2json::sendConnectionValues (std::ostringstream & os, rts2core::Connecti
 		}
 	}
 
-	os << "},\"idle\":" << conn->isIdle () << ",\"state\":" << conn->getState () << ",\"sstart\":" << rts2json::JsonDouble (conn->getProgressStart ()) << ",\"send\":" << rts2json::JsonDouble (conn->getProgressEnd ()) << ",\"f\":" << rts2json::JsonDouble (mfrom);
+	os << "},\"idle\":" << conn->isIdle () << ",\"state\":" << conn->getState () << ",\"sstart\":" << rts2json::JsonDouble (conn->getProgressStart ()) << ",\"send\":" << rts2json::JsonDouble (conn->getProgressEnd ()) << ",\"f\":" << rts2json::JsonDouble (mfrom) << ",\"seq\":" << getChangeSequence ();
 }
@@ -223,6 +223,9 @@ Rts2SchedBag::Rts2SchedBag (double _JDstart, double _JDend)
 
 	eliteSize = 0;
 
+	pool = NULL;
+	NSGAvaluesSize = 0;
+
 	// fill in parameters for NSGA
 	objectives.push_back (ALTITUDE);
 	objectives.push_back (ACCOUNT);
@@ -246,6 +249,22 @@ Rts2SchedBag::~Rts2SchedBag (void)
 
 	delete ticketSet;
 	delete tarSet;
+
+	delete pool;
+}
+
+void Rts2SchedBag::setThreads (int threads)
+{
+	delete pool;
+	pool = NULL;
+	if (threads > 1)
+		pool = new rts2core::WorkerPool (threads);
+}
+
+void Rts2SchedBag::prepareEphemerides ()
+{
+	for (rts2sched::TicketSet::iterator iter = ticketSet->begin (); iter != ticketSet->end (); iter++)
+		iter->second->getTarget ()->getEphemeris (JDstart, JDend);
 }
 
 int Rts2SchedBag::constructSchedules (int num)
@@ -259,6 +278,8 @@ int Rts2SchedBag::constructSchedules (int num)
 		return -1;
 	}
 
+	prepareEphemerides ();
+
 	for (int i = 0; i < num; i++)
 	{
 		Rts2Schedule *sched = new Rts2Schedule (JDstart, JDend, minObsDuration, observer);
@@ -307,6 +328,8 @@ int Rts2SchedBag::constructSchedulesFromObsSet (int num, struct ln_date *obsNigh
 		return -1;
 	}
 
+	prepareEphemerides ();
+
 	for (int i = 0; i < num; i++)
 	{
 		Rts2Schedule *sched = new Rts2Schedule (JDstart, JDend, minObsDuration, observer);
@@ -397,6 +420,9 @@ void Rts2SchedBag::doGAStep ()
 {
 	Rts2SchedBag::iterator iter;
 
+	// fill merit caches, so elite selection does not evaluate merits
+	evaluatePopulation ();
+
 	// only the best..
 	pickElite (popSize / 2);
 
@@ -492,66 +518,205 @@ int Rts2SchedBag::dominatesNSGA (Rts2Schedule *sched1, Rts2Schedule *sched2)
 	return 0;
 }
 
-void Rts2SchedBag::calculateNSGARanks ()
+/**
+ * Evaluates constraints and objectives of schedules. Each schedule is
+ * evaluated by single thread, which also fills schedule merit caches.
+ */
+class NSGAEvaluationJob:public rts2core::WorkerJob
 {
-	// temporary structure which holds informations about ranks.
-	// Indexed by population (=schedule) number
-	struct {std::list <int> dominates; int dominated;} domStruct[size()];
-	// list of schedules in fronts
-	std::list <int> fronts[size ()];
+	public:
+		NSGAEvaluationJob (Rts2SchedBag *_bag, std::list <constraintFunc> &_constraints, std::list <objFunc> &_objectives, double *_values, size_t _valuesSize):rts2core::WorkerJob (), constraints (_constraints), objectives (_objectives)
+		{
+			bag = _bag;
+			values = _values;
+			valuesSize = _valuesSize;
+		}
 
-	NSGAfronts.clear ();
-	NSGAfrontsSize.clear ();
+		virtual void processItem (size_t i)
+		{
+			Rts2Schedule *sched = (*bag)[i];
+			double *v = values + i * valuesSize;
+			for (std::list <constraintFunc>::iterator iter = constraints.begin (); iter != constraints.end (); iter++, v++)
+				*v = sched->getConstraintFunction (*iter);
+			for (std::list <objFunc>::iterator iter = objectives.begin (); iter != objectives.end (); iter++, v++)
+				*v = sched->getObjectiveFunction (*iter);
+		}
 
-	NSGAfronts.push_back (std::vector <Rts2Schedule *> ());
-	NSGAfrontsSize.push_back (0);
+	private:
+		Rts2SchedBag *bag;
+		std::list <constraintFunc> &constraints;
+		std::list <objFunc> &objectives;
+		double *values;
+		size_t valuesSize;
+};
 
-	for (unsigned int p = 0; p < size (); p++)
-	{
-		domStruct[p].dominated = 0;
-		Rts2Schedule *sched_p = (*this)[p];
-		for (unsigned int q = 0; q < size (); q++)
+/**
+ * Presort for efficient non-dominated sort. Orders schedules so that
+ * schedule dominating other schedule is always in front of it. Schedules
+ * satisfying constraints are ordered first (constraints are compared in
+ * order of their importance), then schedules with less constraint
+ * violations, and then schedules with higher objectives.
+ */
+class NSGAPresort
+{
+	private:
+		const double *values;
+		size_t valuesSize;
+		size_t constraintsSize;
+	public:
+		NSGAPresort (const double *_values, size_t _valuesSize, size_t _constraintsSize)
 		{
-		  	// do not calculate for ourselfs..
-			if (p == q)
-				continue;
-			Rts2Schedule *sched_q = (*this)[q];
-			int dom = dominatesNSGA (sched_p, sched_q);
-			if (dom == -1)
-				domStruct[p].dominates.push_back (q);
-			else if (dom == 1)
-			  	domStruct[p].dominated++;
+			values = _values;
+			valuesSize = _valuesSize;
+			constraintsSize = _constraintsSize;
 		}
-		if (domStruct[p].dominated == 0)
+
+		bool operator () (size_t p, size_t q)
+		{
+			const double *v1 = values + p * valuesSize;
+			const double *v2 = values + q * valuesSize;
+			size_t i;
+			for (i = 0; i < constraintsSize; i++)
+			{
+				if ((v1[i] == 0) != (v2[i] == 0))
+					return v1[i] == 0;
+			}
+			for (i = 0; i < constraintsSize; i++)
+			{
+				if (v1[i] != v2[i])
+					return v1[i] < v2[i];
+			}
+			for (; i < valuesSize; i++)
+			{
+				if (v1[i] != v2[i])
+					return v1[i] > v2[i];
+			}
+			return p < q;
+		}
+};
+
+void Rts2SchedBag::evaluatePopulation ()
+{
+	NSGAvaluesSize = constraints.size () + objectives.size ();
+	NSGAvalues.resize (size () * NSGAvaluesSize);
+	if (size () == 0)
+		return;
+
+	// account set is loaded from the database on first access, make sure that happens before threads are started
+	rts2db::AccountSet::instance ();
+
+	NSGAEvaluationJob job (this, constraints, objectives, &(NSGAvalues[0]), NSGAvaluesSize);
+	if (pool)
+	{
+		pool->run (&job, size ());
+	}
+	else
+	{
+		for (size_t i = 0; i < size (); i++)
+			job.processItem (i);
+	}
+}
+
+int Rts2SchedBag::dominatesNSGAValues (size_t p, size_t q)
+{
+	const double *v1 = &(NSGAvalues[p * NSGAvaluesSize]);
+	const double *v2 = &(NSGAvalues[q * NSGAvaluesSize]);
+	size_t nc = constraints.size ();
+	size_t i;
+	// if some schedule violate, prefer the one which does not violate..
+	for (i = 0; i < nc; i++)
+	{
+		if (v1[i] == 0 && v2[i] > 0)
+			return -1;
+		if (v1[i] > 0 && v2[i] == 0)
+			return 1;
+	}
+	bool dom1 = false;
+	bool dom2 = false;
+	// if both are infeasible, prefer one which is closer to be feasible; feasible constraints are both 0
+	for (i = 0; i < nc; i++)
+	{
+		if (v1[i] < v2[i])
+			dom1 = true;
+		else if (v1[i] > v2[i])
+			dom2 = true;
+	}
+	for (; i < NSGAvaluesSize; i++)
+	{
+		if (v1[i] > v2[i])
+			dom1 = true;
+		else if (v2[i] > v1[i])
+			dom2 = true;
+	}
+	if (dom1 && !dom2)
+		return -1;
+	else if (!dom1 && dom2)
+		return 1;
+	return 0;
+}
+
+bool Rts2SchedBag::dominatedByFront (std::vector <size_t> &front, size_t q)
+{
+	// schedules added last are the most similar to q
+	for (std::vector <size_t>::reverse_iterator iter = front.rbegin (); iter != front.rend (); iter++)
+	{
+		if (dominatesNSGAValues (*iter, q) == -1)
+			return true;
+	}
+	return false;
+}
+
+void Rts2SchedBag::calculateNSGARanks ()
+{
+	evaluatePopulation ();
+
+	std::vector <size_t> order (size ());
+	size_t p;
+	for (p = 0; p < size (); p++)
+		order[p] = p;
+
+	if (size () > 0)
+		std::sort (order.begin (), order.end (), NSGAPresort (&(NSGAvalues[0]), NSGAvaluesSize, constraints.size ()));
+
+	// fronts holding schedule indices
+	std::vector <std::vector <size_t> > fronts;
+
+	for (std::vector <size_t>::iterator iter = order.begin (); iter != order.end (); iter++)
+	{
+		// schedule dominated by a member of front f is dominated by a member of every front before f
+		size_t lo = 0;
+		size_t hi = fronts.size ();
+		while (lo < hi)
 		{
-			sched_p->setNSGARank (0);
-			fronts[0].push_back (p);
-			NSGAfronts[0].push_back (sched_p);
-			NSGAfrontsSize[0]++;
+			size_t mid = (lo + hi) / 2;
+			if (dominatedByFront (fronts[mid], *iter))
+				lo = mid + 1;
+			else
+				hi = mid;
 		}
+		if (lo == fronts.size ())
+			fronts.push_back (std::vector <size_t> ());
+		fronts[lo].push_back (*iter);
 	}
-	int i = 0;
-	while (fronts[i].size () > 0)
+
+	NSGAfronts.clear ();
+	NSGAfrontsSize.clear ();
+
+	for (size_t f = 0; f < fronts.size (); f++)
 	{
 		NSGAfronts.push_back (std::vector <Rts2Schedule *> ());
-		NSGAfrontsSize.push_back (0);
-		for (std::list <int>::iterator p = fronts[i].begin (); p != fronts[i].end (); p++)
+		NSGAfrontsSize.push_back (fronts[f].size ());
+		for (std::vector <size_t>::iterator iter = fronts[f].begin (); iter != fronts[f].end (); iter++)
 		{
-			for (std::list <int>::iterator q = domStruct[*p].dominates.begin (); q != domStruct[*p].dominates.end (); q++)
-			{
-				domStruct[*q].dominated--;
-				if (domStruct[*q].dominated == 0)
-				{
-				 	Rts2Schedule *sched_q = (*this)[*q];
-					sched_q->setNSGARank (i + 1);
-					fronts[i + 1].push_back (*q);
-					NSGAfronts[i + 1].push_back (sched_q);
-					NSGAfrontsSize[i + 1]++;
-				}
-			}
+			Rts2Schedule *sched = (*this)[*iter];
+			sched->setNSGARank (f);
+			NSGAfronts[f].push_back (sched);
 		}
-		i++;
 	}
+
+	// the last front is always empty
+	NSGAfronts.push_back (std::vector <Rts2Schedule *> ());
+	NSGAfrontsSize.push_back (0);
 }
 
 // temporary operator for sorting based on crowding distance
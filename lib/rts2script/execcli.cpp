@@ -397,6 +397,8 @@ void DevClientCameraExec::exposureStarted (bool expectImage)
 			nextCommand ();
 	}
 
+	getMaster ()->postEvent (new rts2core::Event (EVENT_EXPOSURE_STARTED, (void *) this));
+
 	DevClientCameraImage::exposureStarted (expectImage);
 }
 
@@ -628,6 +630,13 @@ void DevClientTelescopeExec::checkInterChange ()
 		getMaster ()->postEvent (new rts2core::Event (EVENT_ENTER_WAIT));
 }
 
+void DevClientTelescopeExec::moveStart (bool correcting)
+{
+	DevClientTelescopeImage::moveStart (correcting);
+	if (!correcting)
+		getMaster ()->postEvent (new rts2core::Event (EVENT_TEL_MOVE_STARTED, (void *) this));
+}
+
 void DevClientTelescopeExec::moveEnd ()
 {
 	if (moveWasCorrecting)
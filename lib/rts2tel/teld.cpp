@@ -57,6 +57,13 @@ Telescope::Telescope (int in_argc, char **in_argv, bool diffTrack, bool hasTrack
 
 	raGuide = decGuide = NULL;
 	parkPos = NULL;
+
+	trajectoryGenerator = NULL;
+	trajectory = NULL;
+	trajectoryAhead = NULL;
+	trajectoryStep = NULL;
+	trajectoryPoints = NULL;
+	trajectoryMargin = NULL;
 	parkFlip = NULL;
 
 	useParkFlipping = false;
@@ -292,6 +299,7 @@ Telescope::Telescope (int in_argc, char **in_argv, bool diffTrack, bool hasTrack
 
 Telescope::~Telescope (void)
 {
+	delete trajectoryGenerator;
 	delete model;
 }
 
@@ -389,6 +397,23 @@ void Telescope::createDecGuide ()
 	decGuide->addSelVal ("PLUS");
 }
 
+void Telescope::createTrajectory ()
+{
+	createValue (trajectory, "trajectory", "stream precalculated trajectory to the mount", false, RTS2_VALUE_WRITABLE);
+	trajectory->setValueBool (true);
+
+	createValue (trajectoryAhead, "trajectory_ahead", "[s] how far ahead trajectory is calculated", false, RTS2_VALUE_WRITABLE | RTS2_DT_TIMEINTERVAL);
+	trajectoryAhead->setValueFloat (5);
+
+	createValue (trajectoryStep, "trajectory_step", "[s] time between trajectory points", false, RTS2_VALUE_WRITABLE | RTS2_DT_TIMEINTERVAL);
+	trajectoryStep->setValueFloat (0.5);
+
+	createValue (trajectoryPoints, "trajectory_points", "number of trajectory points send to the mount", false);
+	createValue (trajectoryMargin, "trajectory_margin", "[s] time covered by trajectory points send to the mount", false, RTS2_DT_TIMEINTERVAL);
+
+	trajectoryGenerator = new TrajectoryGenerator (this);
+}
+
 int Telescope::processOption (int in_opt)
 {
 	switch (in_opt)
@@ -586,8 +611,15 @@ int Telescope::setValue (rts2core::Value * old_value, rts2core::Value * new_valu
 		if (LibnovaEllFromMPC (&mpec_orbit, desc, new_value->getValue ()))
 			return -2;
 	}
+	else if (old_value == trajectory || old_value == trajectoryAhead || old_value == trajectoryStep)
+	{
+		// streaming is restarted with new parameters from tracking timer
+		stopTrajectoryStream ();
+	}
 	else if (old_value == diffTrackRaDec)
 	{
+		// trajectory send to the mount was calculated with old rates
+		stopTrajectoryStream ();
 	  	setDiffTrack (((rts2core::ValueRaDec *)new_value)->getRa (), ((rts2core::ValueRaDec *)new_value)->getDec ());
 		return 0;
 	}
@@ -1042,7 +1074,8 @@ void Telescope::postEvent (rts2core::Event * event)
 			// if tracking is still relevant, reschedule
 			if (tracking->getValueInteger ())
 			{
-				runTracking ();
+				if (runTrajectory () == false)
+					runTracking ();
 				addTimer (trackingInterval->getValueFloat (), event);
 				return;
 			}
@@ -1152,6 +1185,8 @@ int Telescope::setTracking (int track, bool addTrackingTimer, bool send)
 		tracking->setValueInteger (track);
 		// make sure we will not run two timers
 		deleteTimers (EVENT_TRACKING_TIMER);
+		// streaming is started again from tracking timer
+		stopTrajectoryStream ();
 		if (track > 0)
 		{
 			maskState (TEL_MASK_TRACK, TEL_TRACKING, "tracking started");
@@ -1173,41 +1208,69 @@ void Telescope::runTracking ()
 
 }
 
-void Telescope::calculateTLE (double JD, double &ra, double &dec, double &dist_to_satellite)
+void Telescope::loopSleep ()
 {
-	double sat_params[N_SAT_PARAMS], observer_loc[3];
-	double t_since;
-	double sat_pos[3]; /* Satellite position vector */
+	if (trajectoryGenerator)
+		trajectoryGenerator->unlock ();
+}
 
-	observer_cartesian_coords (JD, ln_deg_to_rad (getLongitude ()), tle_rho_cos_phi->getValueDouble (), tle_rho_sin_phi->getValueDouble (), observer_loc);
+void Telescope::loopWake ()
+{
+	if (trajectoryGenerator)
+		trajectoryGenerator->lock ();
+}
+
+bool Telescope::runTrajectory ()
+{
+	if (trajectoryGenerator == NULL || trajectory->getValueBool () == false)
+		return false;
 
-	t_since = (JD - tle.epoch) * 1440.;
-	switch (tle_ephem->getValueInteger ())
+	if (trajectoryGenerator->isActive ())
 	{
-		case 0:
-			SGP_init (sat_params, &tle);
-			SGP (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 1:
-			SGP4_init (sat_params, &tle);
-			SGP4 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 2:
-			SGP8_init (sat_params, &tle);
-			SGP8 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 3:
-			SDP4_init (sat_params, &tle);
-			SDP4 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		case 4:
-			SDP8_init (sat_params, &tle);
-			SDP8 (t_since, &tle, sat_params, sat_pos, NULL);
-			break;
-		default:
-			logStream (MESSAGE_ERROR) << "invalid tle_ephem " << tle_ephem->getValueInteger () << sendLog;
+		if ((getState () & TEL_MASK_MOVING) == TEL_OBSERVING)
+			return true;
+		stopTrajectoryStream ();
+		return false;
+	}
+
+	if (trajectoryGenerator->isFailed ())
+	{
+		logStream (MESSAGE_WARNING) << "trajectory streaming failed, switching to tracking with " << trackingInterval->getValueFloat () << " seconds interval" << sendLog;
+		stopTrajectory ();
+		trajectory->setValueBool (false);
+		sendValueAll (trajectory);
+		return false;
+	}
+
+	if ((getState () & TEL_MASK_MOVING) != TEL_OBSERVING)
+		return false;
+
+	int32_t ac, dc;
+	if (startTrajectory (ac, dc))
+		return false;
+
+	trajectoryGenerator->setTiming (trajectoryAhead->getValueFloat (), trajectoryStep->getValueFloat ());
+	trajectoryGenerator->start (ac, dc);
+	return trajectoryGenerator->isActive ();
+}
+
+void Telescope::stopTrajectoryStream ()
+{
+	if (trajectoryGenerator && trajectoryGenerator->isActive ())
+	{
+		trajectoryGenerator->stop ();
+		stopTrajectory ();
+	}
+}
+
+void Telescope::calculateTLE (double JD, double &ra, double &dec, double &dist_to_satellite)
+{
+	tlePropagator.setObserver (ln_deg_to_rad (getLongitude ()), ln_deg_to_rad (getLatitude ()), tle_rho_cos_phi->getValueDouble (), tle_rho_sin_phi->getValueDouble ());
+	if (tlePropagator.getPosition (JD, ra, dec, dist_to_satellite))
+	{
+		logStream (MESSAGE_ERROR) << "cannot calculate satellite position for tle_ephem " << tle_ephem->getValueInteger () << sendLog;
+		ra = dec = dist_to_satellite = NAN;
 	}
-	get_satellite_ra_dec_delta (observer_loc, sat_pos, &ra, &dec, &dist_to_satellite);
 }
 
 void Telescope::setDiffTrack (double dra, double ddec)
@@ -1250,6 +1313,15 @@ int Telescope::info ()
 	hourAngle->setValueDouble (ln_range_degrees (lst->getValueDouble () - telRaDec->getRa ()));
 	targetDistance->setValueDouble (getTargetDistance ());
 
+	if (trajectoryGenerator)
+	{
+		trajectoryPoints->setValueLong (trajectoryGenerator->getPointsSent ());
+		if (trajectoryGenerator->isActive ())
+			trajectoryMargin->setValueDouble (trajectoryGenerator->getLastTime () - getNow ());
+		else
+			trajectoryMargin->setValueDouble (NAN);
+	}
+
 	// check if we aren't bellow hard horizon - if yes, stop worm..
 	if (hardHorizon)
 	{
@@ -1519,6 +1591,9 @@ int Telescope::startResyncMove (rts2core::Connection * conn, int correction)
 		flip_move_start = telFlip->getValueInteger ();
 	}
 
+	// mount shall not follow trajectory of the previous target
+	stopTrajectoryStream ();
+
 	// everything is OK and prepared, let's move!
 	ret = startResync ();
 	if (ret)
@@ -1860,7 +1935,7 @@ int Telescope::commandAuthorized (rts2core::Connection * conn)
 		tle_l1->setValueString (l1);
 		tle_l2->setValueString (l2);
 
-		ret = parse_elements (tle_l1->getValueString ().c_str (), tle_l2->getValueString ().c_str (), &tle);
+		ret = tlePropagator.load (tle_l1->getValueString ().c_str (), tle_l2->getValueString ().c_str ());
 		if (ret != 0)
 		{
 			logStream (MESSAGE_ERROR) << "cannot target on TLEs" << sendLog;
@@ -1869,14 +1944,7 @@ int Telescope::commandAuthorized (rts2core::Connection * conn)
 			return DEVDEM_E_PARAMSVAL;
 		}
 
-		int ephem = 1;
-
-		int is_deep = select_ephemeris (&tle);
-		if (is_deep && (ephem == 1 || ephem == 2))
-			ephem += 2;    /* switch to an SDx */
-		if (!is_deep && (ephem == 3 || ephem == 4))
-			ephem -= 2;    /* switch to an SGx */
-		tle_ephem->setValueInteger (ephem);
+		tle_ephem->setValueInteger (tlePropagator.getEphem ());
 
 		return startResyncMove (conn, 0);
 	}
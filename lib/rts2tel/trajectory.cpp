@@ -0,0 +1,197 @@
+/*
+ * Generator of telescope tracking trajectory.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "trajectory.h"
+#include "teld.h"
+#include "utilsfunc.h"
+
+using namespace rts2teld;
+
+TrajectoryGenerator::TrajectoryGenerator (Telescope *_telescope)
+{
+	telescope = _telescope;
+
+	pthread_mutex_init (&mutex, NULL);
+	pthread_cond_init (&cond, NULL);
+	// main loop owns the lock, unless it waits for events
+	pthread_mutex_lock (&mutex);
+
+	threadRunning = false;
+	active = false;
+	failed = false;
+	quit = false;
+
+	ahead = 5;
+	step = 0.5;
+
+	lastPoint.t = NAN;
+	lastPoint.ac = 0;
+	lastPoint.dc = 0;
+	pointsSent = 0;
+}
+
+TrajectoryGenerator::~TrajectoryGenerator ()
+{
+	quit = true;
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+
+	if (threadRunning)
+		pthread_join (thread, NULL);
+
+	pthread_cond_destroy (&cond);
+	pthread_mutex_destroy (&mutex);
+}
+
+void TrajectoryGenerator::start (int32_t ac, int32_t dc)
+{
+	if (!threadRunning)
+	{
+		int ret = pthread_create (&thread, NULL, generatorThread, (void *) this);
+		if (ret)
+		{
+			logStream (MESSAGE_ERROR) << "cannot start trajectory thread: " << strerror (ret) << sendLog;
+			failed = true;
+			return;
+		}
+		threadRunning = true;
+	}
+
+	// first point is calculated for now
+	lastPoint.t = getNow () - step;
+	lastPoint.ac = ac;
+	lastPoint.dc = dc;
+	pointsSent = 0;
+
+	active = true;
+	failed = false;
+	pthread_cond_broadcast (&cond);
+}
+
+void TrajectoryGenerator::stop ()
+{
+	active = false;
+	pthread_cond_broadcast (&cond);
+}
+
+void TrajectoryGenerator::setTiming (double _ahead, double _step)
+{
+	ahead = _ahead;
+	if (_step > 0)
+		step = _step;
+	pthread_cond_broadcast (&cond);
+}
+
+int TrajectoryGenerator::calculatePoint (double t, TrajectoryPoint &point)
+{
+	time_t tt = (time_t) t;
+	double JD = ln_get_julian_from_timet (&tt) + (t - tt) / 86400.0;
+	double tar_distance;
+
+	point.t = t;
+	point.ac = lastPoint.ac;
+	point.dc = lastPoint.dc;
+
+	int ret = telescope->calculateTarget (JD, t - lastPoint.t, &(point.pos), tar_distance, point.ac, point.dc);
+	if (ret)
+		return ret;
+
+	// speed is difference to position one second later
+	struct ln_equ_posn pos;
+	int32_t ac = point.ac;
+	int32_t dc = point.dc;
+
+	ret = telescope->calculateTarget (JD + 1 / 86400.0, 1, &pos, tar_distance, ac, dc);
+	if (ret)
+		return ret;
+
+	point.ac_speed = ac - point.ac;
+	point.dc_speed = dc - point.dc;
+	return 0;
+}
+
+void *TrajectoryGenerator::generatorThread (void *arg)
+{
+	((TrajectoryGenerator *) arg)->generator ();
+	return NULL;
+}
+
+void TrajectoryGenerator::generator ()
+{
+	pthread_mutex_lock (&mutex);
+	while (!quit)
+	{
+		if (!active)
+		{
+			pthread_cond_wait (&cond, &mutex);
+			continue;
+		}
+
+		double now = getNow ();
+		double next = lastPoint.t + step;
+
+		// wait until next point is needed
+		if (next > now + ahead)
+		{
+			struct timespec ts;
+			double w = next - ahead;
+			ts.tv_sec = w;
+			ts.tv_nsec = (w - ts.tv_sec) * 1000000000;
+			pthread_cond_timedwait (&cond, &mutex, &ts);
+			continue;
+		}
+
+		// points in past are useless for the mount
+		if (next < now)
+			next = now;
+
+		std::vector <TrajectoryPoint> points;
+		while (next <= now + ahead)
+		{
+			TrajectoryPoint point;
+			int ret = calculatePoint (next, point);
+			if (ret)
+			{
+				if (ret < 0)
+					logStream (MESSAGE_WARNING) << "cannot calculate trajectory point, stopping trajectory" << sendLog;
+				failed = true;
+				break;
+			}
+			points.push_back (point);
+			lastPoint = point;
+			next += step;
+		}
+
+		if (!failed && telescope->sendTrajectory (points))
+		{
+			logStream (MESSAGE_WARNING) << "cannot send trajectory to the mount" << sendLog;
+			failed = true;
+		}
+
+		if (failed)
+			active = false;
+		else
+			pointsSent += points.size ();
+	}
+	pthread_mutex_unlock (&mutex);
+}
@@ -4,9 +4,19 @@
 #include "XmlRpcSource.h"
 #include "XmlRpcUtil.h"
 
+#include <errno.h>
 #include <math.h>
+#include <unistd.h>
 #include <sys/timeb.h>
 
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+#define EPOLL_CTL_ADD   1
+#define EPOLL_CTL_DEL   2
+#define EPOLL_CTL_MOD   3
+#endif
+
 #if defined(_WINDOWS)
 # include <winsock2.h>
 
@@ -26,10 +36,13 @@ XmlRpcDispatch::XmlRpcDispatch()
 	_endTime = -1.0;
 	_doClear = false;
 	_inWork = false;
+	_pollFd = -1;
 }
 
 XmlRpcDispatch::~XmlRpcDispatch()
 {
+	if (_pollFd >= 0)
+		::close(_pollFd);
 }
 
 // Monitor this source for the specified events and call its event handler
@@ -37,6 +50,11 @@ XmlRpcDispatch::~XmlRpcDispatch()
 void XmlRpcDispatch::addSource(XmlRpcSource* source, unsigned mask)
 {
 	_sources.push_back(MonitoredSource(source, mask));
+	if (_pollFd >= 0)
+	{
+		_pollSources[source] = --_sources.end();
+		pollCtl(EPOLL_CTL_ADD, source, mask);
+	}
 }
 
 
@@ -46,6 +64,11 @@ void XmlRpcDispatch::removeSource(XmlRpcSource* source)
 	for (SourceList::iterator it=_sources.begin(); it!=_sources.end(); ++it)
 		if (it->getSource() == source)
 		{
+			if (_pollFd >= 0)
+			{
+				pollCtl(EPOLL_CTL_DEL, source, 0);
+				_pollSources.erase(source);
+			}
 			_sources.erase(it);
 			break;
 		}
@@ -59,6 +82,7 @@ void XmlRpcDispatch::setSourceEvents(XmlRpcSource* source, unsigned eventMask)
 		if (it->getSource() == source)
 		{
 			it->getMask() = eventMask;
+			pollCtl(EPOLL_CTL_MOD, source, eventMask);
 			return;
 		}
 	// if not found, add it
@@ -116,6 +140,7 @@ void XmlRpcDispatch::work(double timeout, XmlRpcClient *chunkWait)
 		{
 			SourceList closeList = _sources;
 			_sources.clear();
+			_pollSources.clear();
 			for (SourceList::iterator it=closeList.begin(); it!=closeList.end(); ++it)
 			{
 				XmlRpcSource *src = it->getSource();
@@ -156,40 +181,108 @@ void XmlRpcDispatch::checkFd (fd_set *inFd, fd_set *outFd, fd_set *excFd, XmlRpc
 	for (it=_sources.begin(); it != _sources.end(); )
 	{
 		SourceList::iterator thisIt = it++;
-		XmlRpcSource* src = thisIt->getSource();
-		int fd = src->getfd();
-		unsigned newMask = (unsigned) -1;
-		// If you select on multiple event types this could be ambiguous
-		try
-		{
-			if (FD_ISSET(fd, inFd))
-				newMask &= (src == chunkWait) ? src->handleChunkEvent(ReadableEvent) : src->handleEvent(ReadableEvent);
-		}
-		catch (const XmlRpcAsynchronous &async)
-		{
-			XmlRpcUtil::log(3, "Asynchronous event while handling response.");
-			// stop monitoring the source..
-			thisIt->getMask() = 0;
-			src->goAsync ();
-		}
+		int fd = thisIt->getSource()->getfd();
+		handleSource(thisIt, FD_ISSET(fd, inFd), FD_ISSET(fd, outFd), FD_ISSET(fd, excFd), chunkWait);
+	}
+}
 
-		if (FD_ISSET(fd, outFd))
-			newMask &= (src == chunkWait) ? src->handleChunkEvent(WritableEvent) : src->handleEvent(WritableEvent);
-		if (FD_ISSET(fd, excFd))
-			newMask &= (src == chunkWait) ? src->handleChunkEvent(Exception) : src->handleEvent(Exception);
+int XmlRpcDispatch::enablePoll()
+{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	if (_pollFd >= 0)
+		return 0;
+	_pollFd = epoll_create(64);
+	if (_pollFd < 0)
+	{
+		XmlRpcUtil::error("Error in XmlRpcDispatch::enablePoll: cannot create epoll descriptor (%d).", errno);
+		return -1;
+	}
+	for (SourceList::iterator it=_sources.begin(); it!=_sources.end(); ++it)
+	{
+		_pollSources[it->getSource()] = it;
+		pollCtl(EPOLL_CTL_ADD, it->getSource(), it->getMask());
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
 
-		if ( ! newMask)
-		{
-			// Stop monitoring this one
-			_sources.erase(thisIt);
-			if ( ! src->getKeepOpen())
-				src->close();
-		}
-		else if (newMask != (unsigned) -1)
+void XmlRpcDispatch::checkPoll(XmlRpcSource *chunkWait)
+{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	if (_pollFd < 0)
+		return;
+	struct epoll_event events[64];
+	int nEvents = epoll_wait(_pollFd, events, 64, 0);
+	for (int i = 0; i < nEvents; i++)
+	{
+		// source might be removed while processing previous event
+		std::map< XmlRpcSource*, SourceList::iterator >::iterator pi = _pollSources.find((XmlRpcSource *) events[i].data.ptr);
+		if (pi == _pollSources.end())
+			continue;
+		handleSource(pi->second, events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR), events[i].events & EPOLLOUT, events[i].events & EPOLLPRI, chunkWait);
+	}
+#endif
+}
+
+void XmlRpcDispatch::handleSource(SourceList::iterator thisIt, bool readable, bool writable, bool exc, XmlRpcSource *chunkWait)
+{
+	XmlRpcSource* src = thisIt->getSource();
+	unsigned newMask = (unsigned) -1;
+	// If you select on multiple event types this could be ambiguous
+	try
+	{
+		if (readable)
+			newMask &= (src == chunkWait) ? src->handleChunkEvent(ReadableEvent) : src->handleEvent(ReadableEvent);
+	}
+	catch (const XmlRpcAsynchronous &async)
+	{
+		XmlRpcUtil::log(3, "Asynchronous event while handling response.");
+		// stop monitoring the source..
+		thisIt->getMask() = 0;
+		pollCtl(EPOLL_CTL_MOD, src, 0);
+		src->goAsync ();
+	}
+
+	if (writable)
+		newMask &= (src == chunkWait) ? src->handleChunkEvent(WritableEvent) : src->handleEvent(WritableEvent);
+	if (exc)
+		newMask &= (src == chunkWait) ? src->handleChunkEvent(Exception) : src->handleEvent(Exception);
+
+	if ( ! newMask)
+	{
+		// Stop monitoring this one
+		if (_pollFd >= 0)
 		{
-			thisIt->getMask() = newMask;
+			pollCtl(EPOLL_CTL_DEL, src, 0);
+			_pollSources.erase(src);
 		}
+		_sources.erase(thisIt);
+		if ( ! src->getKeepOpen())
+			src->close();
 	}
+	else if (newMask != (unsigned) -1)
+	{
+		thisIt->getMask() = newMask;
+		pollCtl(EPOLL_CTL_MOD, src, newMask);
+	}
+}
+
+void XmlRpcDispatch::pollCtl(int op, XmlRpcSource *source, unsigned mask)
+{
+#ifdef RTS2_HAVE_SYS_EPOLL_H
+	if (_pollFd < 0 || source->getfd() < 0)
+		return;
+	struct epoll_event ev;
+	ev.events = 0;
+	if (mask & ReadableEvent) ev.events |= EPOLLIN;
+	if (mask & WritableEvent) ev.events |= EPOLLOUT;
+	if (mask & Exception)     ev.events |= EPOLLPRI;
+	ev.data.ptr = source;
+	if (epoll_ctl(_pollFd, op, source->getfd(), &ev) && op == EPOLL_CTL_MOD && errno == ENOENT)
+		epoll_ctl(_pollFd, EPOLL_CTL_ADD, source->getfd(), &ev);
+#endif
 }
 
 // Exit from work routine. Presumably this will be called from
@@ -208,6 +301,7 @@ void XmlRpcDispatch::clear()
 	{
 		SourceList closeList = _sources;
 		_sources.clear();
+		_pollSources.clear();
 		for (SourceList::iterator it=closeList.begin(); it!=closeList.end(); ++it)
 			it->getSource()->close();
 	}
@@ -25,6 +25,10 @@ XmlRpcServer::XmlRpcServer()
 	_listMethods = NULL;
 	_methodHelp = NULL;
 	_defaultGetRequest = NULL;
+	_compressMinLength = 0;
+	_compressedResponses = 0;
+	_compressedOriginal = 0;
+	_compressedLength = 0;
 }
 
 
@@ -177,6 +181,18 @@ void XmlRpcServer::checkFd (fd_set *inFd, fd_set *outFd, fd_set *excFd)
 	_disp.checkFd(inFd, outFd, excFd);
 }
 
+int XmlRpcServer::enablePoll ()
+{
+	if (_disp.enablePoll())
+		return -1;
+	return _disp.getPollFd();
+}
+
+void XmlRpcServer::checkPoll ()
+{
+	_disp.checkPoll();
+}
+
 // Handle input on the server socket by accepting the connection
 // and reading the rpc request.
 unsigned XmlRpcServer::handleEvent(unsigned mask)
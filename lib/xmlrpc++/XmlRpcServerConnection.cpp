@@ -8,6 +8,13 @@
 #include <sstream>
 #include <iomanip>
 
+#ifdef RTS2_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define ACCEPT_GZIP      0x01
+#define ACCEPT_DEFLATE   0x02
+
 #ifndef MAKEDEPEND
 # include <stdio.h>
 # include <stdlib.h>
@@ -61,6 +68,7 @@ XmlRpcServerConnection::XmlRpcServerConnection(int fd, XmlRpcServer* server, boo
 	_server = server;
 	_connectionState = READ_HEADER;
 	_keepAlive = true;
+	_acceptEncoding = 0;
 
 	_get_response_header = std::string ("");
 	_extra_headers.clear ();
@@ -68,6 +76,11 @@ XmlRpcServerConnection::XmlRpcServerConnection(int fd, XmlRpcServer* server, boo
 	_get_response_length = 0;
 	_get_response = NULL;
 
+	_webSocketHandler = NULL;
+	_wsMessageOpcode = 0;
+	_wsWritten = 0;
+	_wsLastReceived = 0;
+
 	memcpy (&_saddr, saddr, addrlen);
 	_addrlen = addrlen;
 }
@@ -83,8 +96,11 @@ XmlRpcServerConnection::~XmlRpcServerConnection()
 // Handle input on the server socket by accepting the connection
 // and reading the rpc request. Return true to continue to monitor
 // the socket for events, false to remove it from the dispatcher.
-unsigned XmlRpcServerConnection::handleEvent(unsigned /*eventType*/)
+unsigned XmlRpcServerConnection::handleEvent(unsigned eventType)
 {
+	if (isWebSocket ())
+		return handleWebSocket (eventType);
+
 	if (_connectionState == READ_HEADER)
 		if ( ! readHeader()) return 0;
 
@@ -94,6 +110,10 @@ unsigned XmlRpcServerConnection::handleEvent(unsigned /*eventType*/)
 	if (_connectionState == GET_REQUEST)
 		if ( ! handleGet()) return 0;
 
+	// request was upgraded to WebSocket, but failed before going async
+	if (isWebSocket ())
+		return handleWebSocket (XmlRpcDispatch::WritableEvent);
+
 	if (_connectionState == POST_REQUEST)
 	  	if ( ! handlePost()) return 0;
 
@@ -134,6 +154,9 @@ bool XmlRpcServerConnection::readHeader()
 	char *lp = 0;				 // Start of content-length value
 	char *kp = 0;				 // Start of connection value
 	char *ap = 0;				 // Start of authorization header
+	char *ae = 0;				 // Start of accept-encoding header
+	char *up = 0;				 // Start of upgrade header
+	char *wk = 0;				 // Start of WebSocket key
 
 	for (char *cp = hp; (bp == 0) && (cp < ep); ++cp)
 	{
@@ -147,6 +170,12 @@ bool XmlRpcServerConnection::readHeader()
 			kp = cp + 12;
 		else if ((ep - cp > 12) && (strncasecmp (cp, "Authorization: ", 15) == 0))
 			ap = cp + 15;
+		else if ((ep - cp > 17) && (strncasecmp (cp, "Accept-Encoding: ", 17) == 0))
+			ae = cp + 17;
+		else if ((ep - cp > 9) && (strncasecmp (cp, "Upgrade: ", 9) == 0))
+			up = cp + 9;
+		else if ((ep - cp > 19) && (strncasecmp (cp, "Sec-WebSocket-Key: ", 19) == 0))
+			wk = cp + 19;
 		else if ((ep - cp >= 4) && (strncmp(cp, "\r\n\r\n", 4) == 0))
 			bp = cp + 4;
 		else if ((ep - cp >= 2) && (strncmp(cp, "\n\n", 2) == 0))
@@ -192,6 +221,32 @@ bool XmlRpcServerConnection::readHeader()
 		}
 	}
 
+	// compression accepted by client
+	_acceptEncoding = 0;
+	if (ae != 0)
+	{
+		char *aee = ae;
+		while (aee < ep && *aee != '\r' && *aee != '\n')
+			aee++;
+		std::string encodings = _header.substr (ae - hp, aee - ae);
+		if (encodings.find ("gzip") != std::string::npos)
+			_acceptEncoding |= ACCEPT_GZIP;
+		if (encodings.find ("deflate") != std::string::npos)
+			_acceptEncoding |= ACCEPT_DEFLATE;
+	}
+
+	// upgrade to WebSocket
+	_webSocketKey = "";
+	if (gp != 0 && up != 0 && wk != 0 && ep - up > 9 && strncasecmp (up, "websocket", 9) == 0)
+	{
+		while (wk < ep && isspace (*wk))
+			wk++;
+		char *wke = wk;
+		while (wke < ep && !isspace (*wke))
+			wke++;
+		_webSocketKey = _header.substr (wk - hp, wke - wk);
+	}
+
 	// Parse out any interesting bits from the header (HTTP version, connection)
 	_keepAlive = true;
 	if (_header.find("HTTP/1.0") != std::string::npos)
@@ -317,6 +372,8 @@ bool XmlRpcServerConnection::handleGet()
 	if (_get_response_header.length () == 0 || _get_response_length == 0)
 	{
 		executeGet();
+		if (isWebSocket ())
+			return true;
 		_getHeaderWritten = 0;
 		_getWritten = 0;
 		_bytesWritten = 0;
@@ -442,7 +499,6 @@ void XmlRpcServerConnection::executeGet()
 	const char* response_type = "text/plain";
 
 	int http_code = HTTP_BAD_REQUEST;
-	const char *http_code_string = "Failed";
 
 	XmlRpcServerGetRequest* request = _server->findGetRequest(_get);
 	if (request == NULL)
@@ -519,23 +575,38 @@ void XmlRpcServerConnection::executeGet()
 		catch (const JSONException& fault)
 		{
 			XmlRpcUtil::log(2, "XmlRpcServerConnection::executeRequest: JSON fault %s.", fault.getMessage().c_str());
+			if (isWebSocket ())
+			{
+				std::ostringstream os;
+				os << "{\"error\":" << XmlRpcUtil::jsonEncode (fault.getMessage ()) << ",\"ret\":-2}";
+				sendWebSocket (os.str ());
+				closeWebSocket ();
+				return;
+			}
 			if (isChunked ())
 			{
 				std::ostringstream os;
-				os << "{\"error\":\"" << fault.getMessage () << "\",\"ret\":-2}";
+				os << "{\"error\":" << XmlRpcUtil::jsonEncode (fault.getMessage ()) << ",\"ret\":-2}";
 				sendChunked (os.str ());
 				sendChunked (std::string (""));
 			}
 			else
 			{
-				_get_response = new char[200];
-				_get_response_length = snprintf (_get_response, 200, "{\"error\":\"%s\",\"ret\":-2}", fault.getMessage().c_str());
+				std::string r = std::string ("{\"error\":") + XmlRpcUtil::jsonEncode (fault.getMessage ()) + ",\"ret\":-2}";
+				_get_response_length = r.length ();
+				_get_response = new char[_get_response_length];
+				memcpy (_get_response, r.c_str (), _get_response_length);
 				response_type = "application/json";
 				http_code = fault.getCode ();
 			}
 		}
 		catch (const std::exception& ex)
 		{
+			if (isWebSocket ())
+			{
+				closeWebSocket (WS_CLOSE_PROTOCOL);
+				return;
+			}
 			_get_response = new char[501];
 			response_type = "text/html";
 			_get_response_length = snprintf (_get_response, 500, "<html><head><title>Error</title></head><body><p>Bad request %s</p></body></html>", ex.what());
@@ -544,6 +615,13 @@ void XmlRpcServerConnection::executeGet()
 		}
 	}
 
+	finishGet (http_code, response_type);
+}
+
+void XmlRpcServerConnection::finishGet (int http_code, const char *response_type)
+{
+	const char *http_code_string;
+
 	switch (http_code)
 	{
 		case HTTP_OK:
@@ -559,6 +637,9 @@ void XmlRpcServerConnection::executeGet()
 			break;
 	}
 
+	if (http_code == HTTP_OK)
+		compressResponse (response_type);
+
 	_get_response_header = printHeaders (http_code, http_code_string, response_type, _get_response_length, _extra_headers);
 	printf ("%s", _get_response_header.c_str ());
 }
@@ -741,8 +822,69 @@ bool XmlRpcServerConnection::sendChunked (const std::string &data)
 	return true;
 }
 
+void XmlRpcServerConnection::goAsync ()
+{
+	// WebSocket connections must be monitored for client frames
+	if (isWebSocket ())
+		setSourceEvents (XmlRpcDispatch::ReadableEvent | (getWebSocketPending () > 0 ? XmlRpcDispatch::WritableEvent : 0));
+	else
+		_connectionState = WAIT_ASYNC;
+}
+
+void XmlRpcServerConnection::offloadFinished (int http_code, const char *response_type, char *response, size_t response_length)
+{
+	_get_response = response;
+	_get_response_length = response_length;
+	// empty response would be executed again by handleGet
+	if (_get_response_length == 0)
+	{
+		XmlRpcUtil::error("XmlRpcServerConnection::offloadFinished: empty response.");
+		offloadFailed (false, HTTP_BAD_REQUEST, "empty response");
+		return;
+	}
+	finishGet (http_code, response_type);
+	_getHeaderWritten = 0;
+	_getWritten = 0;
+	_bytesWritten = 0;
+	_connectionState = GET_REQUEST;
+	setSourceEvents (XmlRpcDispatch::WritableEvent);
+}
+
+void XmlRpcServerConnection::offloadFailed (bool json, int code, const std::string &message)
+{
+	delete[] _get_response;
+	const char *response_type;
+	std::string r;
+	if (json)
+	{
+		r = std::string ("{\"error\":") + XmlRpcUtil::jsonEncode (message) + ",\"ret\":-2}";
+		response_type = "application/json";
+	}
+	else
+	{
+		r = std::string ("<html><head><title>Error</title></head><body><p>Bad request ") + XmlRpcUtil::xmlEncode (message) + "</p></body></html>";
+		response_type = "text/html";
+	}
+	_get_response_length = r.length ();
+	_get_response = new char[_get_response_length];
+	memcpy (_get_response, r.c_str (), _get_response_length);
+	finishGet (code, response_type);
+	_getHeaderWritten = 0;
+	_getWritten = 0;
+	_bytesWritten = 0;
+	_connectionState = GET_REQUEST;
+	setSourceEvents (XmlRpcDispatch::WritableEvent);
+}
+
 void XmlRpcServerConnection::asyncFinished ()
 {
+	if (isWebSocket ())
+	{
+		_webSocketHandler = NULL;
+		_server->asyncFinished (this);
+		closeWebSocket ();
+		return;
+	}
 	prepareForNext ();
 	setSourceEvents (XmlRpcDispatch::ReadableEvent);
 	_server->asyncFinished (this);
@@ -750,6 +892,206 @@ void XmlRpcServerConnection::asyncFinished ()
 		close ();
 }
 
+bool XmlRpcServerConnection::acceptWebSocket (XmlRpcWebSocketHandler *handler)
+{
+	if (!isWebSocketRequest ())
+		return false;
+
+	std::ostringstream os;
+	os << "HTTP/1.1 101 Switching Protocols\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Accept: " << webSocketAccept (_webSocketKey) << "\r\n"
+		"Server: " << XMLRPC_VERSION << "\r\n\r\n";
+
+	_webSocketHandler = handler;
+	_wsIn = "";
+	_wsMessage = "";
+	_wsOut = os.str ();
+	_wsWritten = 0;
+	_wsLastReceived = time (NULL);
+	_keepAlive = true;
+	_connectionState = WEBSOCKET;
+
+	XmlRpcUtil::log(3, "XmlRpcServerConnection::acceptWebSocket: switching socket %d to WebSocket", getfd ());
+
+	return writeWebSocket ();
+}
+
+bool XmlRpcServerConnection::sendWebSocket (const char *data, size_t len, int opcode)
+{
+	if (_connectionState != WEBSOCKET)
+		return false;
+
+	size_t pending = getWebSocketPending ();
+	webSocketFrame (_wsOut, opcode, data, len);
+
+	// try to write immediately, rest will be written when socket is ready
+	if (pending == 0)
+	{
+		if (!writeWebSocket ())
+		{
+			_connectionState = WEBSOCKET_CLOSING;
+			_wsOut = "";
+			_wsWritten = 0;
+			setSourceEvents (XmlRpcDispatch::ReadableEvent | XmlRpcDispatch::WritableEvent);
+			return false;
+		}
+		if (getWebSocketPending () > 0)
+			setSourceEvents (XmlRpcDispatch::ReadableEvent | XmlRpcDispatch::WritableEvent);
+	}
+	return true;
+}
+
+void XmlRpcServerConnection::closeWebSocket (int code)
+{
+	if (_connectionState != WEBSOCKET)
+		return;
+
+	char payload[2];
+	payload[0] = (code >> 8) & 0xff;
+	payload[1] = code & 0xff;
+	webSocketFrame (_wsOut, WS_CLOSE, payload, 2);
+
+	_connectionState = WEBSOCKET_CLOSING;
+	setSourceEvents (XmlRpcDispatch::ReadableEvent | XmlRpcDispatch::WritableEvent);
+}
+
+unsigned XmlRpcServerConnection::handleWebSocket (unsigned eventType)
+{
+	if ((eventType & XmlRpcDispatch::ReadableEvent) && !readWebSocket ())
+		return 0;
+
+	if (!writeWebSocket ())
+		return 0;
+
+	// close frame was send, close connection
+	if (_connectionState == WEBSOCKET_CLOSING && getWebSocketPending () == 0)
+		return 0;
+
+	return XmlRpcDispatch::ReadableEvent | (getWebSocketPending () > 0 ? XmlRpcDispatch::WritableEvent : 0);
+}
+
+bool XmlRpcServerConnection::readWebSocket ()
+{
+	char buf[4096];
+	ssize_t n = recv (getfd (), buf, sizeof (buf), 0);
+	if (n == 0)
+		return false;
+	if (n < 0)
+		return errno == EAGAIN || errno == EINTR;
+
+	_wsIn.append (buf, n);
+	_wsLastReceived = time (NULL);
+
+	while (_wsIn.length () >= 2)
+	{
+		const unsigned char *p = (const unsigned char *) _wsIn.data ();
+		bool fin = p[0] & 0x80;
+		int opcode = p[0] & 0x0f;
+		uint64_t len = p[1] & 0x7f;
+		size_t hl = 2;
+
+		// frames send by client must be masked
+		if (!(p[1] & 0x80))
+		{
+			XmlRpcUtil::error ("XmlRpcServerConnection::readWebSocket: unmasked frame");
+			closeWebSocket (WS_CLOSE_PROTOCOL);
+			return true;
+		}
+
+		if (len == 126)
+		{
+			if (_wsIn.length () < 4)
+				break;
+			len = (p[2] << 8) | p[3];
+			hl = 4;
+		}
+		else if (len == 127)
+		{
+			if (_wsIn.length () < 10)
+				break;
+			len = 0;
+			for (int i = 2; i < 10; i++)
+				len = (len << 8) | p[i];
+			hl = 10;
+		}
+
+		if (len + _wsMessage.length () > WS_MAX_MESSAGE)
+		{
+			XmlRpcUtil::error ("XmlRpcServerConnection::readWebSocket: message too big");
+			closeWebSocket (WS_CLOSE_TOO_BIG);
+			return true;
+		}
+
+		if (_wsIn.length () < hl + 4 + len)
+			break;
+
+		const unsigned char *mask = p + hl;
+		std::string payload = _wsIn.substr (hl + 4, len);
+		for (size_t i = 0; i < payload.length (); i++)
+			payload[i] ^= mask[i % 4];
+		_wsIn.erase (0, hl + 4 + len);
+
+		switch (opcode)
+		{
+			case WS_PING:
+				sendWebSocket (payload, WS_PONG);
+				break;
+			case WS_PONG:
+				break;
+			case WS_CLOSE:
+				if (_connectionState == WEBSOCKET)
+				{
+					_webSocketHandler = NULL;
+					_server->asyncFinished (this);
+					closeWebSocket (payload.length () >= 2 ? (((unsigned char) payload[0]) << 8) | ((unsigned char) payload[1]) : WS_CLOSE_NORMAL);
+				}
+				_wsIn = "";
+				return true;
+			case WS_TEXT:
+			case WS_BINARY:
+				_wsMessageOpcode = opcode;
+				_wsMessage = payload;
+				break;
+			case WS_CONTINUATION:
+				_wsMessage += payload;
+				break;
+			default:
+				XmlRpcUtil::error ("XmlRpcServerConnection::readWebSocket: unknown opcode %d", opcode);
+				closeWebSocket (WS_CLOSE_PROTOCOL);
+				return true;
+		}
+
+		if (fin && (opcode == WS_TEXT || opcode == WS_BINARY || opcode == WS_CONTINUATION))
+		{
+			if (_webSocketHandler && _connectionState == WEBSOCKET)
+				_webSocketHandler->webSocketMessage (this, _wsMessageOpcode, _wsMessage);
+			_wsMessage = "";
+		}
+	}
+	return true;
+}
+
+bool XmlRpcServerConnection::writeWebSocket ()
+{
+	while (_wsWritten < _wsOut.length ())
+	{
+		ssize_t n = send (getfd (), _wsOut.data () + _wsWritten, _wsOut.length () - _wsWritten, 0);
+		if (n < 0)
+		{
+			if (errno == EAGAIN || errno == EINTR)
+				return true;
+			XmlRpcUtil::error ("XmlRpcServerConnection::writeWebSocket: write error (%s).", XmlRpcSocket::getErrorMsg().c_str());
+			return false;
+		}
+		_wsWritten += n;
+	}
+	_wsOut = "";
+	_wsWritten = 0;
+	return true;
+}
+
 std::string XmlRpcServerConnection::getHttpDate ()
 {
 	std::ostringstream ret;
@@ -767,9 +1109,61 @@ std::string XmlRpcServerConnection::getHttpDate ()
 	return ret.str ();
 }
 
+void XmlRpcServerConnection::compressResponse (const char *response_type)
+{
+#ifdef RTS2_HAVE_ZLIB
+	size_t minLength = _server->getCompressMinLength ();
+	if (minLength == 0 || _get_response_length < minLength || _get_response == NULL || isChunked ())
+		return;
+	if (!(_acceptEncoding & (ACCEPT_GZIP | ACCEPT_DEFLATE)))
+		return;
+	// images and archives are already compressed
+	if (!(strncmp (response_type, "text/", 5) == 0 || strncmp (response_type, "application/json", 16) == 0 || strncmp (response_type, "application/javascript", 22) == 0))
+		return;
+
+	bool gzip = _acceptEncoding & ACCEPT_GZIP;
+
+	z_stream zs;
+	memset (&zs, 0, sizeof (zs));
+	// 16 added to window bits produces gzip header
+	if (deflateInit2 (&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return;
+
+	size_t bound = deflateBound (&zs, _get_response_length);
+	char *compressed = new char[bound];
+
+	zs.next_in = (Bytef *) _get_response;
+	zs.avail_in = _get_response_length;
+	zs.next_out = (Bytef *) compressed;
+	zs.avail_out = bound;
+
+	int ret = deflate (&zs, Z_FINISH);
+	size_t compressedLength = zs.total_out;
+	deflateEnd (&zs);
+
+	// do not send compressed data if it does not save anything
+	if (ret != Z_STREAM_END || compressedLength >= _get_response_length)
+	{
+		delete[] compressed;
+		return;
+	}
+
+	_server->responseCompressed (_get_response_length, compressedLength);
+
+	delete[] _get_response;
+	_get_response = compressed;
+	_get_response_length = compressedLength;
+
+	addExtraHeader ("Content-Encoding", gzip ? "gzip" : "deflate");
+	addExtraHeader ("Vary", "Accept-Encoding");
+#endif
+}
+
 void XmlRpcServerConnection::prepareForNext ()
 {
 	_authorization = "";
+	_acceptEncoding = 0;
+	_webSocketKey = "";
 	_get = "";
 	_post = "";
 	_header = "";
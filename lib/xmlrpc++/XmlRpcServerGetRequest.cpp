@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <iostream>
+#include <pthread.h>
 
 using namespace XmlRpc;
 
@@ -140,6 +141,31 @@ XmlRpcServerGetRequest::~XmlRpcServerGetRequest()
 	if (_server) _server->removeGetRequest(this);
 }
 
+// headers collected by threads executing requests outside of the main thread
+static pthread_key_t threadHeadersKey;
+static pthread_once_t threadHeadersOnce = PTHREAD_ONCE_INIT;
+
+static void createThreadHeadersKey ()
+{
+	pthread_key_create (&threadHeadersKey, NULL);
+}
+
+void XmlRpcServerGetRequest::setThreadHeaders (std::list <std::pair <const char *, std::string> > *headers)
+{
+	pthread_once (&threadHeadersOnce, createThreadHeadersKey);
+	pthread_setspecific (threadHeadersKey, headers);
+}
+
+void XmlRpcServerGetRequest::addExtraHeader (const char *name, std::string value)
+{
+	pthread_once (&threadHeadersOnce, createThreadHeadersKey);
+	std::list <std::pair <const char *, std::string> > *headers = (std::list <std::pair <const char *, std::string> > *) pthread_getspecific (threadHeadersKey);
+	if (headers)
+		headers->push_back (std::pair <const char *, std::string> (name, value));
+	else
+		connection->addExtraHeader (name, value);
+}
+
 void XmlRpcServerGetRequest::setAuthorization(std::string authorization)
 {
  	if (authorization.length () == 0)
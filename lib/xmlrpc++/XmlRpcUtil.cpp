@@ -224,6 +224,48 @@ XmlRpcUtil::xmlDecode(const std::string& encoded)
 }
 
 
+// Replace raw text with quoted JSON string.
+
+std::string
+XmlRpcUtil::jsonEncode(const std::string& raw)
+{
+	std::string encoded("\"");
+	for (std::string::const_iterator iter = raw.begin(); iter != raw.end(); ++iter)
+	{
+		switch (*iter)
+		{
+			case '"':
+				encoded += "\\\"";
+				break;
+			case '\\':
+				encoded += "\\\\";
+				break;
+			case '\n':
+				encoded += "\\n";
+				break;
+			case '\r':
+				encoded += "\\r";
+				break;
+			case '\t':
+				encoded += "\\t";
+				break;
+			default:
+				if ((unsigned char) *iter < 0x20)
+				{
+					char buf[7];
+					snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char) *iter);
+					encoded += buf;
+				}
+				else
+				{
+					encoded += *iter;
+				}
+		}
+	}
+	encoded += '"';
+	return encoded;
+}
+
 // Replace raw text with xml-encoded entities.
 
 std::string
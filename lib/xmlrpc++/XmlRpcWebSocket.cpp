@@ -0,0 +1,141 @@
+/*
+ * WebSocket (RFC 6455) support for XML-RPC/HTTP server.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "XmlRpcWebSocket.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// GUID appended to client key, defined by RFC 6455
+#define WS_GUID    "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+static inline uint32_t rol (uint32_t v, int bits)
+{
+	return (v << bits) | (v >> (32 - bits));
+}
+
+// SHA-1 digest, needed only for handshake
+static void sha1 (const std::string &data, unsigned char digest[20])
+{
+	uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+	std::string msg = data;
+	uint64_t bits = (uint64_t) data.length () * 8;
+	msg += (char) 0x80;
+	while (msg.length () % 64 != 56)
+		msg += (char) 0x00;
+	for (int i = 7; i >= 0; i--)
+		msg += (char) ((bits >> (i * 8)) & 0xff);
+
+	for (size_t block = 0; block < msg.length (); block += 64)
+	{
+		uint32_t w[80];
+		const unsigned char *p = (const unsigned char *) msg.data () + block;
+		for (int i = 0; i < 16; i++)
+			w[i] = (p[i * 4] << 24) | (p[i * 4 + 1] << 16) | (p[i * 4 + 2] << 8) | p[i * 4 + 3];
+		for (int i = 16; i < 80; i++)
+			w[i] = rol (w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; i++)
+		{
+			uint32_t f, k;
+			if (i < 20)
+			{
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (i < 40)
+			{
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (i < 60)
+			{
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else
+			{
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+			uint32_t t = rol (a, 5) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = rol (b, 30);
+			b = a;
+			a = t;
+		}
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+
+	for (int i = 0; i < 20; i++)
+		digest[i] = (h[i / 4] >> (24 - (i % 4) * 8)) & 0xff;
+}
+
+std::string XmlRpc::webSocketAccept (const std::string &key)
+{
+	static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	unsigned char digest[20];
+	sha1 (key + WS_GUID, digest);
+
+	std::string ret;
+	for (int i = 0; i < 20; i += 3)
+	{
+		uint32_t v = digest[i] << 16;
+		if (i + 1 < 20)
+			v |= digest[i + 1] << 8;
+		if (i + 2 < 20)
+			v |= digest[i + 2];
+		ret += b64[(v >> 18) & 0x3f];
+		ret += b64[(v >> 12) & 0x3f];
+		ret += (i + 1 < 20) ? b64[(v >> 6) & 0x3f] : '=';
+		ret += (i + 2 < 20) ? b64[v & 0x3f] : '=';
+	}
+	return ret;
+}
+
+void XmlRpc::webSocketFrame (std::string &buf, int opcode, const char *data, size_t len)
+{
+	// final fragment
+	buf += (char) (0x80 | (opcode & 0x0f));
+	if (len < 126)
+	{
+		buf += (char) len;
+	}
+	else if (len < 65536)
+	{
+		buf += (char) 126;
+		buf += (char) ((len >> 8) & 0xff);
+		buf += (char) (len & 0xff);
+	}
+	else
+	{
+		buf += (char) 127;
+		for (int i = 7; i >= 0; i--)
+			buf += (char) (((uint64_t) len >> (i * 8)) & 0xff);
+	}
+	buf.append (data, len);
+}
@@ -66,6 +66,19 @@ void BB::postEvent (rts2core::Event *event)
 		case EVENT_SCHEDULING_DONE:
 			processSchedule ((ObservatorySchedule *) event->getArg ());
 			break;
+		case EVENT_START_SCHEDULE:
+			try
+			{
+				startSchedule ((ConnBBQueue *) event->getArg ());
+			}
+			catch (XmlRpc::JSONException &er)
+			{
+				logStream (MESSAGE_ERROR) << "cannot start schedule: " << er.getMessage () << sendLog;
+			}
+			break;
+		case EVENT_TASK_RETRY:
+			addTimer (((BBTask *) event->getArg ())->getRetry (), new rts2core::Event (EVENT_TASK_SCHEDULE, event->getArg ()));
+			break;
 	}
 	rts2db::DeviceDb::postEvent (event);
 }
@@ -102,6 +115,10 @@ int BB::init ()
 	if (printDebug ())
 		XmlRpc::setVerbosity (5);
 
+	rts2core::Configuration *config = rts2core::Configuration::instance ();
+	task_queue.setMaxThreads (config->getIntegerDefault ("bb", "task_threads", 4));
+	getSessions ()->setTimeouts (config->getIntegerDefault ("bb", "request_timeout", 30), config->getDoubleDefault ("bb", "observatory_cache", 600));
+
 	XmlRpcServer::bindAndListen (rpcPort);
 	XmlRpcServer::enableIntrospection (true);
 
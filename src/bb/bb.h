@@ -40,6 +40,10 @@
 
 #define EVENT_TASK_SCHEDULE       1500
 #define EVENT_SCHEDULING_DONE     1501
+// task thread prepared schedule script, main thread shall start it
+#define EVENT_START_SCHEDULE      1502
+// task shall be rescheduled, argument is BBTask with retry delay
+#define EVENT_TASK_RETRY          1503
 
 using namespace XmlRpc;
 
@@ -80,6 +84,8 @@ class BB:public rts2db::DeviceDb, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 
 		bool getDebugConn () { return debugConn->getValueBool (); }
 
+		ObservatorySessions *getSessions () { return task_queue.getSessions (); }
+
 	protected:
 		virtual int processOption (int opt);
 
@@ -91,6 +97,9 @@ class BB:public rts2db::DeviceDb, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 		virtual void addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 		virtual void selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 
+		// sockets added in addSelectSocks are not registered with epoll
+		virtual bool canEventPoll () { return false; }
+
 	private:
 		int rpcPort;
 		BBAPI bbApi;
@@ -127,6 +127,12 @@ void BBAPI::executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc:
 			}
 			os << "\"target_id\":" << tar_id << ",\"schedule_id\":" << schedule_id;
 		}
+		// statistics of requests to observatories
+		else if (vals[0] == "sessions")
+		{
+			os << "\"sessions\":";
+			queue->getSessions ()->toJSON (os);
+		}
 		// schedule status
 		else if (vals[0] == "schedule_status")
 		{
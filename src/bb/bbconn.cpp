@@ -105,7 +105,7 @@ void ConnBBQueue::processCommand (char *cmd)
 	}
 }
 
-ConnBBQueue *rts2bb::scheduleTarget (int tar_id, int observatory_id, ObservatorySchedule *obs_sched)
+ConnBBQueue *rts2bb::prepareSchedule (int tar_id, int observatory_id, ObservatorySchedule *obs_sched)
 {
 	std::ostringstream p_os;
 	p_os << rts2core::Configuration::instance ()->getStringDefault ("bb", "script_dir", RTS2_SHARE_PREFIX "/rts2/bb") << "/schedule_target.py";
@@ -126,13 +126,27 @@ ConnBBQueue *rts2bb::scheduleTarget (int tar_id, int observatory_id, Observatory
 
 	bbqueue->addArg (observatory_id);
 
+	return bbqueue;
+}
+
+void rts2bb::startSchedule (ConnBBQueue *bbqueue)
+{
 	int ret = bbqueue->init ();
 	if (ret)
+	{
+		delete bbqueue;
 		throw JSONException ("cannot execute schedule script");
+	}
 
 	if (((BB *) getMasterApp ())->getDebugConn ())
 		bbqueue->setConnectionDebug (true);
 
 	((BB *) getMasterApp ())->addConnection (bbqueue);
+}
+
+ConnBBQueue *rts2bb::scheduleTarget (int tar_id, int observatory_id, ObservatorySchedule *obs_sched)
+{
+	ConnBBQueue *bbqueue = prepareSchedule (tar_id, observatory_id, obs_sched);
+	startSchedule (bbqueue);
 	return bbqueue;
 }
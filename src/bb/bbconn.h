@@ -36,6 +36,20 @@ class ConnBBQueue:public rts2script::ConnExe
 		ObservatorySchedule *obs_sched;
 };
 
+/**
+ * Prepare schedule script for target on observatory. Looks up target
+ * mapping in the database, does not touch master connections, so it can be
+ * called from task threads.
+ */
+ConnBBQueue *prepareSchedule (int tar_id, int observatory_id, ObservatorySchedule *obs_sched = NULL);
+
+/**
+ * Start prepared schedule script and add it to master connections. Must be
+ * called from the main thread. Deletes bbqueue and throws JSONException if
+ * the script cannot be started.
+ */
+void startSchedule (ConnBBQueue *bbqueue);
+
 ConnBBQueue *scheduleTarget (int tar_id, int observatory_id, ObservatorySchedule *obs_sched = NULL);
 
 }
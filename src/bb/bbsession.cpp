@@ -0,0 +1,236 @@
+/*
+ * Persistent HTTP sessions to BB observatories.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "bbsession.h"
+#include "app.h"
+#include "rts2json/jsonvalue.h"
+
+#include "rts2db/sqlerror.h"
+
+using namespace rts2bb;
+
+static void auth (SoupSession *session, SoupMessage *msg, SoupAuth *_auth, gboolean retrying, gpointer data)
+{
+	if (retrying)
+		return;
+	((Observatory *) data)->auth (_auth);
+}
+
+ObservatorySession::ObservatorySession (int _observatory_id, int _timeout, double _cache_time):obs (_observatory_id)
+{
+	observatory_id = _observatory_id;
+	loaded = NAN;
+	cache_time = _cache_time;
+
+	timeout = _timeout;
+
+	requests = 0;
+	failed = 0;
+	transport_errors = 0;
+	timeouts = 0;
+	last_request = NAN;
+	last_latency = NAN;
+	sum_latency = 0;
+	max_latency = NAN;
+
+	pthread_mutex_init (&mutex, NULL);
+
+	g_type_init ();
+
+	session = soup_session_sync_new_with_options (
+		SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_CONTENT_DECODER,
+		SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_COOKIE_JAR,
+		SOUP_SESSION_USER_AGENT, "rts2 bb",
+		SOUP_SESSION_TIMEOUT, _timeout,
+		NULL);
+
+	g_signal_connect (session, "authenticate", G_CALLBACK (auth), &obs);
+}
+
+ObservatorySession::~ObservatorySession ()
+{
+	g_object_unref (session);
+	pthread_mutex_destroy (&mutex);
+}
+
+JsonParser *ObservatorySession::jsonRequest (const std::string &path)
+{
+	pthread_mutex_lock (&mutex);
+
+	try
+	{
+		loadObservatory ();
+	}
+	catch (rts2db::SqlError &er)
+	{
+		pthread_mutex_unlock (&mutex);
+		throw er;
+	}
+
+	std::ostringstream request;
+	request << obs.getURL () << path;
+
+	SoupMessage *msg = soup_message_new (SOUP_METHOD_GET, request.str ().c_str ());
+	if (msg == NULL)
+	{
+		logStream (MESSAGE_ERROR) << "invalid URL of observatory " << observatory_id << ": " << request.str () << sendLog;
+		failed++;
+		pthread_mutex_unlock (&mutex);
+		return NULL;
+	}
+
+	last_request = getNow ();
+
+	soup_session_send_message (session, msg);
+
+	last_latency = getNow () - last_request;
+	requests++;
+	sum_latency += last_latency;
+	if (isnan (max_latency) || last_latency > max_latency)
+		max_latency = last_latency;
+
+	if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
+	{
+		if (SOUP_STATUS_IS_TRANSPORT_ERROR (msg->status_code))
+		{
+			// session reports timeout as IO error, raised once timeout elapsed
+			if (msg->status_code == SOUP_STATUS_IO_ERROR && timeout > 0 && last_latency >= timeout)
+				timeouts++;
+			else
+				transport_errors++;
+			// observatory might have changed its URL
+			loaded = NAN;
+		}
+		else
+		{
+			failed++;
+		}
+		logStream (MESSAGE_ERROR) << "error calling " << path << " on observatory " << observatory_id << ": " << msg->status_code << " : " << msg->reason_phrase << sendLog;
+		g_object_unref (msg);
+		pthread_mutex_unlock (&mutex);
+		return NULL;
+	}
+
+	JsonParser *result = json_parser_new ();
+
+	GError *error = NULL;
+
+	json_parser_load_from_data (result, msg->response_body->data, msg->response_body->length, &error);
+	g_object_unref (msg);
+
+	if (error)
+	{
+		logStream (MESSAGE_ERROR) << "unable to parse " << path << " from observatory " << observatory_id << ": " << error->message << sendLog;
+		failed++;
+		g_error_free (error);
+		g_object_unref (result);
+		pthread_mutex_unlock (&mutex);
+		return NULL;
+	}
+
+	pthread_mutex_unlock (&mutex);
+	return result;
+}
+
+void ObservatorySession::invalidate ()
+{
+	pthread_mutex_lock (&mutex);
+	loaded = NAN;
+	pthread_mutex_unlock (&mutex);
+}
+
+void ObservatorySession::toJSON (std::ostream &os)
+{
+	pthread_mutex_lock (&mutex);
+	os << "{\"observatory_id\":" << observatory_id
+		<< ",\"requests\":" << requests
+		<< ",\"failed\":" << failed
+		<< ",\"transport_errors\":" << transport_errors
+		<< ",\"timeouts\":" << timeouts
+		<< ",\"last_request\":" << rts2json::JsonDouble (last_request)
+		<< ",\"last_latency\":" << rts2json::JsonDouble (last_latency)
+		<< ",\"avg_latency\":" << rts2json::JsonDouble (requests > 0 ? sum_latency / requests : NAN)
+		<< ",\"max_latency\":" << rts2json::JsonDouble (max_latency)
+		<< "}";
+	pthread_mutex_unlock (&mutex);
+}
+
+void ObservatorySession::loadObservatory ()
+{
+	double now = getNow ();
+	if (!isnan (loaded) && now - loaded < cache_time)
+		return;
+	obs.load ();
+	loaded = now;
+}
+
+ObservatorySessions::ObservatorySessions ()
+{
+	pthread_mutex_init (&mutex, NULL);
+	timeout = 30;
+	cache_time = 600;
+}
+
+ObservatorySessions::~ObservatorySessions ()
+{
+	for (std::map <int, ObservatorySession *>::iterator iter = sessions.begin (); iter != sessions.end (); iter++)
+		delete iter->second;
+	sessions.clear ();
+	pthread_mutex_destroy (&mutex);
+}
+
+void ObservatorySessions::setTimeouts (int _timeout, double _cache_time)
+{
+	pthread_mutex_lock (&mutex);
+	timeout = _timeout;
+	cache_time = _cache_time;
+	pthread_mutex_unlock (&mutex);
+}
+
+ObservatorySession *ObservatorySessions::get (int observatory_id)
+{
+	pthread_mutex_lock (&mutex);
+	std::map <int, ObservatorySession *>::iterator iter = sessions.find (observatory_id);
+	ObservatorySession *ret;
+	if (iter == sessions.end ())
+	{
+		ret = new ObservatorySession (observatory_id, timeout, cache_time);
+		sessions[observatory_id] = ret;
+	}
+	else
+	{
+		ret = iter->second;
+	}
+	pthread_mutex_unlock (&mutex);
+	return ret;
+}
+
+void ObservatorySessions::toJSON (std::ostream &os)
+{
+	pthread_mutex_lock (&mutex);
+	os << "[";
+	for (std::map <int, ObservatorySession *>::iterator iter = sessions.begin (); iter != sessions.end (); iter++)
+	{
+		if (iter != sessions.begin ())
+			os << ",";
+		iter->second->toJSON (os);
+	}
+	os << "]";
+	pthread_mutex_unlock (&mutex);
+}
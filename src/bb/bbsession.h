@@ -0,0 +1,135 @@
+/*
+ * Persistent HTTP sessions to BB observatories.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_BB_SESSION__
+#define __RTS2_BB_SESSION__
+
+#include "bbdb.h"
+
+#include <map>
+#include <ostream>
+#include <pthread.h>
+#include <glib-object.h>
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+
+namespace rts2bb
+{
+
+/**
+ * HTTP session to a single observatory. Session is kept open between
+ * requests, so HTTP keep-alive connections to the observatory are reused.
+ * Observatory record is cached and reloaded from the database only when it
+ * becomes older than cache timeout. Only a single request to the
+ * observatory runs at a time. Used by tasks which call observatory API
+ * (BBConfirmTask), so confirmations to different observatories can run in
+ * parallel from BBTasks threads.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class ObservatorySession
+{
+	public:
+		/**
+		 * @param _observatory_id  observatory ID
+		 * @param _timeout         request timeout in seconds
+		 * @param _cache_time      time in seconds for which observatory record is cached
+		 */
+		ObservatorySession (int _observatory_id, int _timeout, double _cache_time);
+		~ObservatorySession ();
+
+		/**
+		 * Request JSON from the observatory API.
+		 *
+		 * @param path  path (with parameters) appended to observatory API URL
+		 *
+		 * @return parsed JSON, NULL on error; caller shall unref it
+		 */
+		JsonParser *jsonRequest (const std::string &path);
+
+		/**
+		 * Force reload of the observatory record before the next request.
+		 */
+		void invalidate ();
+
+		/**
+		 * Write request statistics as JSON object.
+		 */
+		void toJSON (std::ostream &os);
+
+	private:
+		int observatory_id;
+		Observatory obs;
+		double loaded;
+		double cache_time;
+
+		SoupSession *session;
+		pthread_mutex_t mutex;
+		int timeout;
+
+		// statistics
+		long requests;
+		// HTTP and JSON parsing errors
+		long failed;
+		// connection errors other than timeouts
+		long transport_errors;
+		long timeouts;
+		double last_request;
+		double last_latency;
+		double sum_latency;
+		double max_latency;
+
+		void loadObservatory ();
+};
+
+/**
+ * Sessions to all observatories.
+ */
+class ObservatorySessions
+{
+	public:
+		ObservatorySessions ();
+		~ObservatorySessions ();
+
+		/**
+		 * Set timeout of new sessions, and cache time of observatory records.
+		 */
+		void setTimeouts (int _timeout, double _cache_time);
+
+		/**
+		 * Return session for given observatory, create it if it does not exists.
+		 */
+		ObservatorySession *get (int observatory_id);
+
+		/**
+		 * Write statistics of all sessions.
+		 */
+		void toJSON (std::ostream &os);
+
+	private:
+		std::map <int, ObservatorySession *> sessions;
+		pthread_mutex_t mutex;
+
+		int timeout;
+		double cache_time;
+};
+
+}
+
+#endif // !__RTS2_BB_SESSION__
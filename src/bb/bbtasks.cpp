@@ -26,59 +26,9 @@
 
 using namespace rts2bb;
 
-static void auth (SoupSession *session, SoupMessage *msg, SoupAuth *_auth, gboolean retrying, gpointer data)
-{
-	if (retrying)
-		return;
-	((Observatory *) data)->auth (_auth);
-}
-
 JsonParser *BBTask::jsonRequest (int observatory_id, std::string path)
 {
-	Observatory obs (observatory_id);
-	obs.load ();
-
-	std::ostringstream request;
-	request << obs.getURL () << path;
-
-	g_type_init ();
-
-	SoupMessage *msg = soup_message_new (SOUP_METHOD_GET, request.str ().c_str ());
-
-	SoupSession *session = soup_session_sync_new_with_options (
-		SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_CONTENT_DECODER,
-		SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_COOKIE_JAR,
-		SOUP_SESSION_USER_AGENT, "rts2 bb",
-		NULL);
-
-	g_signal_connect (session, "authenticate", G_CALLBACK (auth), &obs);
-
-	soup_session_send_message (session, msg);
-
-	if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code))
-	{
-		logStream (MESSAGE_ERROR) << "error calling " << path << ": " << msg->status_code << " : " << msg->reason_phrase << sendLog;
-		return NULL;
-	}
-
-	JsonParser *result = json_parser_new ();
-
-	GError *error = NULL;
-
-	json_parser_load_from_data (result, msg->response_body->data, strlen (msg->response_body->data), &error);
-	if (error)
-	{
-		logStream (MESSAGE_ERROR) << "unable to parse " << path << sendLog;
-		g_error_free (error);
-		g_object_unref (msg);
-		g_object_unref (session);
-		return NULL;
-	}
-
-	g_object_unref (msg);
-	g_object_unref (session);
-
-	return result;
+	return ((BB *) getMasterApp ())->getSessions ()->get (observatory_id)->jsonRequest (path);
 }
 
 int BBTaskSchedule::run ()
@@ -86,7 +36,8 @@ int BBTaskSchedule::run ()
 	switch (obs_sched->getState ())
 	{
 		case BB_SCHEDULE_CREATED:
-			sched_process = scheduleTarget (tar_id, obs_sched->getObservatoryId (), obs_sched);
+			// database lookups run in the task thread, script is forked and added to connections by the main thread
+			((BB *) getMasterApp ())->postThreadEvent (new rts2core::Event (EVENT_START_SCHEDULE, (void *) prepareSchedule (tar_id, obs_sched->getObservatoryId (), obs_sched)));
 			return 0;
 		default:
 			logStream (MESSAGE_WARNING) << "unknow BBTaskSchedule state: " << obs_sched->getState () << sendLog;
@@ -136,7 +87,7 @@ void BBConfirmTask::confirmTarget (BBSchedules &bbsch, ObservatorySchedule &sche
 
 BBTasks::BBTasks (BB *_server):TSQueue <BBTask *> ()
 {
-	send_thread = 0;
+	maxThreads = 4;
 	server = _server;
 }
 
@@ -155,7 +106,9 @@ void BBTasks::run ()
 	int ret = t->run ();
 	if (ret)
 	{
-		server->addTimer (ret, new rts2core::Event (EVENT_TASK_SCHEDULE, (void *) t));
+		// timers belong to the main loop
+		t->setRetry (ret);
+		server->postThreadEvent (new rts2core::Event (EVENT_TASK_RETRY, (void *) t));
 	}
 	else
 	{
@@ -179,8 +132,16 @@ void *processTasks (void *arg)
 
 void BBTasks::queueTask (BBTask *t)
 {
-	if (send_thread == 0)
-		pthread_create (&send_thread, NULL, processTasks, (void *) this);
+	// start new thread for every queued task, until maximal number of threads is reached
+	if (threads.size () < maxThreads)
+	{
+		pthread_t thread;
+		int ret = pthread_create (&thread, NULL, processTasks, (void *) this);
+		if (ret)
+			logStream (MESSAGE_ERROR) << "cannot create task thread: " << strerror (ret) << sendLog;
+		else
+			threads.push_back (thread);
+	}
 
 	push (t);
 }
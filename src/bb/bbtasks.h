@@ -24,8 +24,10 @@
 
 #include "bbdb.h"
 #include "bbconn.h"
+#include "bbsession.h"
 
 #include <pthread.h>
+#include <vector>
 #include <glib-object.h>
 #include <json-glib/json-glib.h>
 #include <libsoup/soup.h>
@@ -41,7 +43,7 @@ class BB;
 class BBTask
 {
 	public:
-		BBTask () {};
+		BBTask () { retry = 0; };
 
 		virtual ~BBTask () {}
 
@@ -51,9 +53,18 @@ class BBTask
 		 * @return 0 if task should not be re-run. > 0 specifies seconds after which task should be rescheduled.
 		 */
 		virtual int run () = 0;
+
+		void setRetry (int _retry) { retry = _retry; }
+		int getRetry () { return retry; }
 	
 	protected:
+		/**
+		 * Request JSON from observatory, using observatory persistent session.
+		 */
 		JsonParser *jsonRequest (int observatory_id, std::string url);
+
+	private:
+		int retry;
 };
 
 /**
@@ -66,7 +77,6 @@ class BBTaskSchedule:public BBTask
 		{
 			obs_sched = _schedule;
 			tar_id = _tar_id;
-			sched_process = NULL;
 		}
 
 		virtual ~BBTaskSchedule ()
@@ -78,7 +88,6 @@ class BBTaskSchedule:public BBTask
 	private:
 		ObservatorySchedule *obs_sched;
 		int tar_id;
-		ConnBBQueue *sched_process;
 };
 
 /**
@@ -108,7 +117,11 @@ class BBConfirmTask:public BBTask
 
 
 /**
- * Queue holding all tasks.
+ * Queue holding all tasks. Tasks are executed by pool of threads, so
+ * confirmation requests to different observatories and database work of
+ * scheduling tasks run in parallel. Schedule scripts are forked and
+ * connections added by the main thread, tasks hand them over with
+ * Block::postThreadEvent.
  */
 class BBTasks:public TSQueue <BBTask *>
 {
@@ -119,10 +132,20 @@ class BBTasks:public TSQueue <BBTask *>
 		void run ();
 
 		void queueTask (BBTask *t);
+
+		/**
+		 * Set maximal number of threads executing tasks.
+		 */
+		void setMaxThreads (int _maxThreads) { maxThreads = _maxThreads > 0 ? _maxThreads : 1; }
+
+		ObservatorySessions *getSessions () { return &sessions; }
 	
 	private:
-		pthread_t send_thread;
+		std::vector <pthread_t> threads;
+		size_t maxThreads;
 		BB *server;
+
+		ObservatorySessions sessions;
 };
 
 }
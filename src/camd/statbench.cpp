@@ -0,0 +1,268 @@
+/*
+ * Benchmark of readout and image channel statistics computation.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * Compares PixelStatistics kernels with the per-pixel loop previously used
+ * in Camera::sendReadoutData (sum, min, max, full histogram and histogram
+ * scan for mode).
+ *
+ * Then compares statistics of multi-channel image calculated by two pass
+ * loop, as it was done before chunked statistics were introduced, with
+ * Channels::computeStatistics running in a single thread and in the given
+ * number of threads. Prints times, maximal difference of averages and
+ * standard deviations, and time needed to calculate robust statistics.
+ * Run as
+ *
+ * rts2-statbench [width] [height] [repeats] [channels] [threads]
+ */
+
+#include "pixelstat.h"
+#include "rts2fits/channel.h"
+#include "rts2fits/imagescale.h"
+#include "imghdr.h"
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+double now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// reference implementation
+template <typename t> double referenceStat (t *data, size_t n, uint32_t *modeCount, size_t modeCountSize, double &tMin, double &tMax, double &mode)
+{
+	long double tSum = 0;
+	tMin = data[0];
+	tMax = data[0];
+	memset (modeCount, 0, modeCountSize * sizeof (uint32_t));
+	for (size_t i = 0; i < n; i++)
+	{
+		t tD = data[i];
+		tSum += tD;
+		if (tD < tMin)
+			tMin = tD;
+		if (tD > tMax)
+			tMax = tD;
+		modeCount[(long) tD]++;
+	}
+	uint32_t modeNum = 0;
+	for (size_t i = 0; i < modeCountSize; i++)
+	{
+		if (modeCount[i] > modeNum)
+		{
+			mode = i;
+			modeNum = modeCount[i];
+		}
+	}
+	return tSum;
+}
+
+template <typename t> void runBench (const char *name, t *data, size_t n, int repeats)
+{
+	uint32_t *modeCount = new uint32_t[65536];
+	double rSum = 0, rMin = 0, rMax = 0, rMode = 0;
+
+	double t1 = now ();
+	for (int i = 0; i < repeats; i++)
+		rSum = referenceStat (data, n, modeCount, 65536, rMin, rMax, rMode);
+	double refTime = (now () - t1) / repeats;
+
+	rts2core::PixelStatistics ps;
+	t1 = now ();
+	for (int i = 0; i < repeats; i++)
+	{
+		ps.reset ();
+		ps.update (data, n);
+	}
+	double kerTime = (now () - t1) / repeats;
+
+	std::cout << name << " reference " << refTime * 1000.0 << " ms (" << n / refTime / 1e6 << " Mpix/s) "
+		<< ps.getKernelName () << " " << kerTime * 1000.0 << " ms (" << n / kerTime / 1e6 << " Mpix/s) speedup "
+		<< refTime / kerTime << std::endl;
+
+	if (rSum != ps.getSum () || rMin != ps.getMin () || rMax != ps.getMax () || rMode != ps.getMode ())
+	{
+		std::cerr << name << " results differ: sum " << rSum << " " << ps.getSum ()
+			<< " min " << rMin << " " << ps.getMin ()
+			<< " max " << rMax << " " << ps.getMax ()
+			<< " mode " << rMode << " " << ps.getMode () << std::endl;
+	}
+
+	delete[] modeCount;
+}
+
+// two pass channel statistics, as it was done before
+template <typename dt> void referenceChannelStatistics (const dt *data, long n, double &average, double &stdev)
+{
+	long double sum = 0;
+	for (long i = 0; i < n; i++)
+		sum += data[i];
+	average = sum / n;
+	long double ss = 0;
+	for (long i = 0; i < n; i++)
+	{
+		long double d = data[i] - average;
+		ss += d * d;
+	}
+	stdev = sqrt (ss / n);
+}
+
+// normaly distributed sky background with few bright pixels
+template <typename dt> void fillSky (dt *data, size_t n, double mean, double sigma, double maxval)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		double u1 = (random () + 1.0) / ((double) RAND_MAX + 2.0);
+		double u2 = (random () + 1.0) / ((double) RAND_MAX + 2.0);
+		double v = mean + sigma * sqrt (-2 * log (u1)) * cos (2 * M_PI * u2);
+		if (random () % 1000 == 0)
+			v = maxval;
+		data[i] = (dt) v;
+	}
+}
+
+template <typename dt> int channelBench (const char *name, int16_t dataType, int width, int height, int nchan, int threads, double mean, double sigma, double maxval)
+{
+	long sizes[2] = {width, height};
+	long n = (long) width * height;
+
+	rts2image::Channels channels;
+	for (int c = 0; c < nchan; c++)
+	{
+		dt *data = new dt[n];
+		// amplifiers have slightly different bias
+		fillSky (data, n, mean + c, sigma, maxval);
+		channels.push_back (new rts2image::Channel (c, (char *) data, 2, sizes, dataType, true));
+	}
+
+	std::vector <double> avg (nchan), stdev (nchan);
+
+	double t = now ();
+	for (int c = 0; c < nchan; c++)
+		referenceChannelStatistics ((const dt *) channels[c]->getData (), n, avg[c], stdev[c]);
+	double tRef = now () - t;
+
+	rts2image::setScalingThreads (1);
+	t = now ();
+	channels.computeStatistics ();
+	double tSingle = now () - t;
+
+	std::vector <double> singleAvg (nchan), singleStdev (nchan);
+	for (int c = 0; c < nchan; c++)
+	{
+		singleAvg[c] = channels[c]->getAverage ();
+		singleStdev[c] = channels[c]->getStDev ();
+	}
+
+	rts2image::setScalingThreads (threads);
+	t = now ();
+	channels.computeStatistics ();
+	double tThreads = now () - t;
+
+	t = now ();
+	channels.computeStatistics (0, 0, true);
+	double tRobust = now () - t;
+
+	double maxDiff = 0;
+	bool threadsDiffer = false;
+	for (int c = 0; c < nchan; c++)
+	{
+		maxDiff = fmax (maxDiff, fabs (avg[c] - channels[c]->getAverage ()) / sigma);
+		maxDiff = fmax (maxDiff, fabs (stdev[c] - channels[c]->getStDev ()) / sigma);
+		if (singleAvg[c] != channels[c]->getAverage () || singleStdev[c] != channels[c]->getStDev ())
+			threadsDiffer = true;
+	}
+
+	std::cout << name << "\t" << tRef * 1000.0 << " / " << tSingle * 1000.0 << " / " << tThreads * 1000.0 << " ms, robust " << tRobust * 1000.0 << " ms, max diff " << maxDiff << " sigma"
+		<< "\tchannel 0 median " << channels[0]->getMedian () << " MAD " << channels[0]->getMAD () << " clipped mean " << channels[0]->getClippedMean () << std::endl;
+
+	if (threadsDiffer)
+		std::cerr << name << " results differ with number of threads" << std::endl;
+
+	return (maxDiff > 1e-9 || threadsDiffer) ? 1 : 0;
+}
+
+int main (int argc, char **argv)
+{
+	size_t w = 4096;
+	size_t h = 4096;
+	int repeats = 10;
+	int nchan = 16;
+	int threads = rts2image::getScalingThreads ();
+	if (argc > 1)
+		w = atoi (argv[1]);
+	if (argc > 2)
+		h = atoi (argv[2]);
+	if (argc > 3)
+		repeats = atoi (argv[3]);
+	if (argc > 4)
+		nchan = atoi (argv[4]);
+	if (argc > 5)
+		threads = atoi (argv[5]);
+
+	size_t n = w * h;
+	srandom (1);
+
+	uint16_t *d16 = new uint16_t[n];
+	for (size_t i = 0; i < n; i++)
+		d16[i] = 1000 + random () % 2000;
+	runBench ("uint16", d16, n, repeats);
+	delete[] d16;
+
+	uint8_t *d8 = new uint8_t[n];
+	for (size_t i = 0; i < n; i++)
+		d8[i] = random () % 256;
+	runBench ("uint8", d8, n, repeats);
+	delete[] d8;
+
+	float *df = new float[n];
+	for (size_t i = 0; i < n; i++)
+		df[i] = 1000 + random () % 2000;
+	runBench ("float", df, n, repeats);
+	delete[] df;
+
+	// channels of the same total size as the readout
+	int cw = w;
+	int ch = h / nchan > 0 ? h / nchan : 1;
+
+	std::cout << nchan << " channels of " << cw << "x" << ch << " pixels, times for two pass loop / chunked / chunked with " << threads << " threads" << std::endl;
+
+	int errors = 0;
+	errors += channelBench <signed char> ("SBYTE", RTS2_DATA_SBYTE, cw, ch, nchan, threads, 0, 20, 127);
+	errors += channelBench <short> ("SHORT", RTS2_DATA_SHORT, cw, ch, nchan, threads, 1000, 100, 32767);
+	errors += channelBench <unsigned short> ("USHORT", RTS2_DATA_USHORT, cw, ch, nchan, threads, 1000, 100, 65535);
+	errors += channelBench <int> ("LONG", RTS2_DATA_LONG, cw, ch, nchan, threads, 1000, 100, 1000000);
+	errors += channelBench <unsigned int> ("ULONG", RTS2_DATA_ULONG, cw, ch, nchan, threads, 1000, 100, 1000000);
+	errors += channelBench <float> ("FLOAT", RTS2_DATA_FLOAT, cw, ch, nchan, threads, 1000, 100, 1000000);
+	errors += channelBench <double> ("DOUBLE", RTS2_DATA_DOUBLE, cw, ch, nchan, threads, 1000, 100, 1000000);
+
+	if (errors)
+	{
+		std::cerr << errors << " data types differ from two pass statistics" << std::endl;
+		return 1;
+	}
+	return 0;
+}
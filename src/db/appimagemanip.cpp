@@ -72,6 +72,7 @@
 #define OPT_RTS2OPERA_WCS       OPT_LOCAL + 18
 #define OPT_ADD_TEMPLATE        OPT_LOCAL + 19
 #define OPT_APPEND_EXTENSIONS   OPT_LOCAL + 20
+#define OPT_WINDOW              OPT_LOCAL + 21
 
 namespace rts2image
 {
@@ -117,6 +118,9 @@ class AppImage:public rts2image::AppImageCore
 		void printModel (rts2image::Image * image);
 		void printStat (rts2image::Image * image);
 
+		// statistics window, win_w == 0 for full channel
+		long win_x, win_y, win_w, win_h;
+
 		double d_x1, d_y1, d_x2, d_y2;
 
 		const char* print_expr;
@@ -260,6 +264,37 @@ void AppImage::printModel (Image *image)
 
 void AppImage::printStat (Image *image)
 {
+	if (win_w > 0)
+	{
+		// read only window from the file, channel by channel
+		try
+		{
+			image->loadChannels ();
+		}
+		catch (rts2core::Error &er)
+		{
+			logStream (MESSAGE_ERROR) << er << sendLog;
+			return;
+		}
+		long sizes[2] = {win_w, win_h};
+		for (int ch = 0; ch < image->getChannelSize (); ch++)
+		{
+			char *buf = new char[win_w * win_h * image->getPixelByteSize ()];
+			if (image->getChannelSubset (ch, win_x, win_y, win_w, win_h, buf))
+			{
+				delete[] buf;
+				logStream (MESSAGE_ERROR) << "cannot read window " << win_x << ":" << win_y << ":" << win_w << ":" << win_h << " of channel " << ch << " from " << image->getFileName () << sendLog;
+				continue;
+			}
+			Channel wc (ch, buf, 2, sizes, image->getDataType (), true);
+			wc.computeStatistics ();
+			std::cout << image->getFileName ()
+				<< " " << ch
+				<< " " << wc.getAverage ()
+				<< " " << wc.getStDev () << std::endl;
+		}
+		return;
+	}
 	image->computeStatistics ();
 	std::cout << image->getFileName ()
 		<< " " << image->getAverage ()
@@ -393,6 +428,13 @@ int AppImage::processOption (int in_opt)
 			operation |= IMAGEOP_APPEND_EXT;
 			appendOutput = new FitsFile (optarg, true);
 			break;
+		case OPT_WINDOW:
+			if (sscanf (optarg, "%ld:%ld:%ld:%ld", &win_x, &win_y, &win_w, &win_h) != 4 || win_w <= 0 || win_h <= 0)
+			{
+				std::cerr << "invalid window " << optarg << ", expected x:y:w:h" << std::endl;
+				return -1;
+			}
+			break;
 		default:
 
 		#ifdef RTS2_HAVE_PGSQL
@@ -520,6 +562,8 @@ rts2image::AppImageCore (in_argc, in_argv, in_readOnly)
 
 	rts2opera_ext = '-';
 
+	win_x = win_y = win_w = win_h = 0;
+
 	err_ra = err_dec = err = NAN;
 
 	addOption (OPT_APPEND_EXTENSIONS, "append-extensions", 1, "append images specified as arguments to the given (new) image specified as option");
@@ -527,6 +571,7 @@ rts2image::AppImageCore (in_argc, in_argv, in_readOnly)
 	addOption ('P', NULL, 1, "print filename followed by expression");
 	addOption ('r', NULL, 0, "print referencig status - usefull for modelling checks");
 	addOption ('s', NULL, 0, "print image statistics - average, median, min & max values,...");
+	addOption (OPT_WINDOW, "window", 1, "compute statistics (-s) on x:y:w:h window of every channel, read only the window from the file");
 	addOption ('n', NULL, 0, "print numbers only - do not pretty print degrees,..");
 	addOption ('c', NULL, 1, "copy image(s) to path expression given as argument");
 	addOption (OPT_ADDDATE, "add-date", 0, "add DATE-OBS to image header");
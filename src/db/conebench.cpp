@@ -0,0 +1,155 @@
+/*
+ * Benchmark of cone search.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * Compares cone search over HEALPix index with the full scan, which
+ * evaluates angular separation for every target (as the query without
+ * tar_hpix condition does). Checks that both return the same targets, and
+ * prints SQL condition used for the last cone, so the database query can be
+ * compared with EXPLAIN ANALYZE. Run as
+ *
+ * rts2-conebench [targets] [radius] [queries]
+ */
+
+#include "spatialindex.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <libnova/libnova.h>
+
+double now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+double randomUniform ()
+{
+	return random () / ((double) RAND_MAX + 1);
+}
+
+// uniformly distributed position on sphere
+void randomPosition (double &ra, double &dec)
+{
+	ra = randomUniform () * 360.0;
+	dec = asin (randomUniform () * 2.0 - 1.0) * 180.0 / M_PI;
+}
+
+int main (int argc, char **argv)
+{
+	int n = 500000;
+	double radius = 0.5;
+	int queries = 100;
+	if (argc > 1)
+		n = atoi (argv[1]);
+	if (argc > 2)
+		radius = atof (argv[2]);
+	if (argc > 3)
+		queries = atoi (argv[3]);
+
+	srandom (1);
+
+	std::vector <double> ras (n);
+	std::vector <double> decs (n);
+
+	rts2core::SpatialIndex index;
+
+	int errors = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		randomPosition (ras[i], decs[i]);
+		index.add (i, ras[i], decs[i]);
+
+		// check pixel center is close to position
+		int64_t pix = healpix_ang2pix_nest (HEALPIX_TARGET_ORDER, ras[i], decs[i]);
+		struct ln_equ_posn p1, p2;
+		p1.ra = ras[i];
+		p1.dec = decs[i];
+		healpix_pix2ang_nest (HEALPIX_TARGET_ORDER, pix, &p2.ra, &p2.dec);
+		if (ln_get_angular_separation (&p1, &p2) > healpix_max_pixrad (HEALPIX_TARGET_ORDER))
+		{
+			if (errors < 10)
+				std::cerr << "position " << ras[i] << " " << decs[i] << " is too far from center of its pixel " << pix << std::endl;
+			errors++;
+		}
+	}
+
+	double t1 = now ();
+	index.build ();
+	double buildTime = now () - t1;
+
+	double scanTime = 0;
+	double indexTime = 0;
+	size_t found = 0;
+	size_t examined = 0;
+	std::vector <rts2core::pixrange_t> ranges;
+
+	for (int q = 0; q < queries; q++)
+	{
+		struct ln_equ_posn c, p;
+		randomPosition (c.ra, c.dec);
+
+		std::vector <int> scanIds;
+		t1 = now ();
+		for (int i = 0; i < n; i++)
+		{
+			p.ra = ras[i];
+			p.dec = decs[i];
+			if (ln_get_angular_separation (&c, &p) < radius)
+				scanIds.push_back (i);
+		}
+		scanTime += now () - t1;
+
+		std::vector <int> indexIds;
+		t1 = now ();
+		examined += index.cone (c.ra, c.dec, radius, indexIds);
+		indexTime += now () - t1;
+
+		std::sort (indexIds.begin (), indexIds.end ());
+		if (scanIds != indexIds)
+		{
+			std::cerr << "cone " << c.ra << " " << c.dec << " differs: full scan found " << scanIds.size () << ", index " << indexIds.size () << std::endl;
+			errors++;
+		}
+		found += scanIds.size ();
+
+		rts2core::healpixQueryDisc (c.ra, c.dec, radius, ranges);
+	}
+
+	std::cout << n << " targets, radius " << radius << " deg, " << queries << " queries, " << (double) found / queries << " targets per cone" << std::endl
+		<< "index build " << buildTime * 1000.0 << " ms" << std::endl
+		<< "full scan " << scanTime * 1000.0 / queries << " ms per query" << std::endl
+		<< "index " << indexTime * 1000.0 / queries << " ms per query, " << (double) examined / queries << " candidates, speedup " << scanTime / indexTime << std::endl;
+
+	std::ostringstream os;
+	rts2core::healpixRangesSQL (os, "tar_hpix", ranges);
+	std::cout << "last cone condition (" << ranges.size () << " ranges): " << os.str () << std::endl;
+
+	if (errors)
+	{
+		std::cerr << errors << " errors" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Benchmark of image scaling for display.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * Compares grayscale and pseudocolour scaling kernels with per-pixel
+ * scaling, for all RTS2_DATA_ types. Prints time needed to scale the image
+ * by per-pixel loop, by the kernel running in a single thread and by the
+ * kernel running in the given number of threads, and maximal difference
+ * between per-pixel and kernel results. Run as
+ *
+ * rts2-scalebench [width] [height] [threads]
+ */
+
+#include "rts2fits/imagescale.h"
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+
+double now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// per-pixel scaling, as it was done before kernels were introduced
+template <typename dt> void referenceGrayscale (const dt *data, int width, int height, unsigned char *buf, unsigned char black, dt low, dt high)
+{
+	unsigned char *k = buf + width * (height - 1);
+	int j = width;
+	for (long i = 0; i < (long) width * height; i++)
+	{
+		dt pix = data[i];
+		if (pix <= low)
+			*k = black;
+		else if (pix >= high)
+			*k = 0;
+		else
+			*k = black - black * ((double (pix - low)) / (high - low));
+		k++;
+		j--;
+		if (j == 0)
+		{
+			k -= 2 * width;
+			j = width;
+		}
+	}
+}
+
+template <typename dt> void referencePseudocolour (const dt *data, int width, int height, unsigned char *buf, dt low, dt high, int colourVariant)
+{
+	unsigned char *k = buf + 3 * width * (height - 1);
+	int j = width;
+	for (long i = 0; i < (long) width * height; i++)
+	{
+		dt pix = data[i];
+		if (pix < low)
+			pix = low;
+		if (pix > high)
+			pix = high;
+		rts2image::pseudocolour (colourVariant, double (pix - low), double (high - low), k[0], k[1], k[2]);
+		k += 3;
+		j--;
+		if (j == 0)
+		{
+			k -= 6 * width;
+			j = width;
+		}
+	}
+}
+
+int maxDifference (const std::vector <unsigned char> &a, const std::vector <unsigned char> &b)
+{
+	int ret = 0;
+	for (size_t i = 0; i < a.size (); i++)
+	{
+		int d = abs ((int) a[i] - (int) b[i]);
+		if (d > ret)
+			ret = d;
+	}
+	return ret;
+}
+
+// normaly distributed sky background with few bright pixels
+template <typename dt> void fillData (std::vector <dt> &data, double mean, double sigma, double maxval)
+{
+	for (size_t i = 0; i < data.size (); i++)
+	{
+		double u1 = (random () + 1.0) / ((double) RAND_MAX + 2.0);
+		double u2 = (random () + 1.0) / ((double) RAND_MAX + 2.0);
+		double v = mean + sigma * sqrt (-2 * log (u1)) * cos (2 * M_PI * u2);
+		if (random () % 1000 == 0)
+			v = maxval;
+		data[i] = (dt) v;
+	}
+}
+
+template <typename dt> int benchType (const char *name, int width, int height, int threads, double mean, double sigma, double maxval)
+{
+	size_t pixels = (size_t) width * height;
+	std::vector <dt> data (pixels);
+	fillData (data, mean, sigma, maxval);
+
+	dt low = (dt) (mean - 3 * sigma);
+	dt high = (dt) (mean + 5 * sigma);
+
+	std::vector <unsigned char> ref (pixels);
+	std::vector <unsigned char> out (pixels);
+	std::vector <unsigned char> ref3 (3 * pixels);
+	std::vector <unsigned char> out3 (3 * pixels);
+
+	double t = now ();
+	referenceGrayscale (&(data[0]), width, height, &(ref[0]), (unsigned char) 255, low, high);
+	double tRef = now () - t;
+
+	rts2image::setScalingThreads (1);
+	t = now ();
+	rts2image::scaleGrayscale (&(data[0]), width, height, &(out[0]), (unsigned char) 255, low, high, 0, true);
+	double tSingle = now () - t;
+
+	rts2image::setScalingThreads (threads);
+	t = now ();
+	rts2image::scaleGrayscale (&(data[0]), width, height, &(out[0]), (unsigned char) 255, low, high, 0, true);
+	double tThreads = now () - t;
+
+	int grayDiff = maxDifference (ref, out);
+
+	t = now ();
+	referencePseudocolour (&(data[0]), width, height, &(ref3[0]), low, high, PSEUDOCOLOUR_VARIANT_BLUE);
+	double tRef3 = now () - t;
+
+	rts2image::setScalingThreads (1);
+	t = now ();
+	rts2image::scalePseudocolour (&(data[0]), width, height, &(out3[0]), low, high, 0, true, PSEUDOCOLOUR_VARIANT_BLUE);
+	double tSingle3 = now () - t;
+
+	rts2image::setScalingThreads (threads);
+	t = now ();
+	rts2image::scalePseudocolour (&(data[0]), width, height, &(out3[0]), low, high, 0, true, PSEUDOCOLOUR_VARIANT_BLUE);
+	double tThreads3 = now () - t;
+
+	int colourDiff = maxDifference (ref3, out3);
+
+	std::cout << name << "\tgrayscale " << tRef * 1000.0 << " / " << tSingle * 1000.0 << " / " << tThreads * 1000.0 << " ms, max diff " << grayDiff
+		<< "\tpseudocolour " << tRef3 * 1000.0 << " / " << tSingle3 * 1000.0 << " / " << tThreads3 * 1000.0 << " ms, max diff " << colourDiff << std::endl;
+
+	// results of lookup tables must be exact, calculated values can differ by rounding
+	return (grayDiff > 1 || colourDiff > 2) ? 1 : 0;
+}
+
+int main (int argc, char **argv)
+{
+	int width = 4096;
+	int height = 4096;
+	int threads = rts2image::getScalingThreads ();
+	if (argc > 1)
+		width = atoi (argv[1]);
+	if (argc > 2)
+		height = atoi (argv[2]);
+	if (argc > 3)
+		threads = atoi (argv[3]);
+
+	srandom (1);
+
+	std::cout << width << "x" << height << " pixels, " << rts2image::getScalingKernelName () << " float kernel, times for per-pixel scaling / kernel / kernel with " << threads << " threads" << std::endl;
+
+	int errors = 0;
+	errors += benchType <signed char> ("SBYTE", width, height, threads, 0, 20, 127);
+	errors += benchType <short> ("SHORT", width, height, threads, 1000, 100, 32767);
+	errors += benchType <unsigned short> ("USHORT", width, height, threads, 1000, 100, 65535);
+	errors += benchType <int> ("LONG", width, height, threads, 1000, 100, 1000000);
+	errors += benchType <unsigned int> ("ULONG", width, height, threads, 1000, 100, 1000000);
+	errors += benchType <long long> ("LONGLONG", width, height, threads, 1000, 100, 1000000);
+	errors += benchType <float> ("FLOAT", width, height, threads, 1000, 100, 1000000);
+	errors += benchType <double> ("DOUBLE", width, height, threads, 1000, 100, 1000000);
+
+	if (errors)
+	{
+		std::cerr << errors << " data types differ from per-pixel scaling" << std::endl;
+		return 1;
+	}
+	return 0;
+}
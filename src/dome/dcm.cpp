@@ -41,6 +41,7 @@ class Rts2ConnDcm:public Rts2ConnFramWeather
 		Rts2ConnDcm (int in_weather_port, Rts2DevDomeDcm * in_master);
 		virtual ~ Rts2ConnDcm (void);
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 };
 
 class Rts2DevDomeDcm:public Rts2DevDome
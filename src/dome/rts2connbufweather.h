@@ -48,5 +48,6 @@ class Rts2ConnBufWeather:public Rts2ConnFramWeather
 			int in_bad_windspeed_timeout,
 			Rts2DevDome * in_master);
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 };
 #endif							 /* !__RTS2_CONNBUFWEATHER__ */
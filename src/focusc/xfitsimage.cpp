@@ -263,6 +263,10 @@ void XFitsImage::drawImage (rts2image::Image * image, int chan, Display * _displ
 
 	int i, j;
 
+	const char *chanData = (const char *) image->getChannelData (chan);
+	if (chanData == NULL)
+		return;
+
 	if (window == 0L)
 		buildWindow ();
 
@@ -321,9 +325,9 @@ void XFitsImage::drawImage (rts2image::Image * image, int chan, Display * _displ
 	char *iP = (char *) malloc (iW * iH * iPixelByteSize);
 	char *iTop = iP;
 	// pointer to top line of square image subset
-	const char *iNineTop = (const char *) image->getChannelData (chan);
+	const char *iNineTop = chanData;
 	// prepare the image data to be processed
-	const char *im_ptr = (const char *) image->getChannelData (chan) + iPixelByteSize * (vorigin + horigin * image->getChannelWidth (chan));
+	const char *im_ptr = chanData + iPixelByteSize * (vorigin + horigin * image->getChannelWidth (chan));
 
 	// fill IP
 	// copy image center..
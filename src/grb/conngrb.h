@@ -44,9 +44,11 @@ class ConnGrb:public rts2core::ConnNoSend
 		virtual int init ();
 
 		virtual int add (fd_set * readset, fd_set * writeset, fd_set * expset);
+		virtual void addPoll (rts2core::EventPoll *poll);
 
 		virtual void connectionError (int last_data_size);
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		double lastPacket ();
 		double delta ();
@@ -52,6 +52,7 @@ class ConnShooter:public rts2core::ConnNoSend
 
 		virtual void connectionError (int last_data_size);
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		int lastPacket ();
 		double lastTargetTime ();
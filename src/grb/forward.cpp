@@ -44,9 +44,11 @@ class Rts2ConnFwGrb:public rts2core::ConnNoSend
 		virtual int init ();
 
 		virtual int add (fd_set * readset, fd_set * writeset, fd_set * expset);
+		virtual void addPoll (rts2core::EventPoll *poll);
 
 		virtual void connectionError (int last_data_size);
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		int lastPacket ();
 		double delta ();
@@ -288,6 +290,16 @@ int Rts2ConnFwGrb::add (fd_set * readset, fd_set * writeset, fd_set * expset)
 	return rts2core::Connection::add (readset, writeset, expset);
 }
 
+void Rts2ConnFwGrb::addPoll (rts2core::EventPoll *poll)
+{
+	if (gcn_listen_sock >= 0)
+	{
+		poll->watch (gcn_listen_sock, rts2core::EventPoll::READ, this);
+		return;
+	}
+	rts2core::Connection::addPoll (poll);
+}
+
 void Rts2ConnFwGrb::connectionError (int last_data_size)
 {
 	logStream (MESSAGE_DEBUG) << "Rts2ConnFwGrb::connectionError" << sendLog;
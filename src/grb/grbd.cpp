@@ -20,6 +20,8 @@
 #include "command.h"
 #include "grbd.h"
 
+#include <iomanip>
+
 using namespace rts2grbd;
 
 #define OPT_GRB_DISABLE         OPT_LOCAL + 49
@@ -68,6 +70,12 @@ Grbd::Grbd (int in_argc, char **in_argv):DeviceDb (in_argc, in_argv, DEVICE_TYPE
 	createValue (lastIntegral, "last_integral", "time of last INTEGRAL position", false);
 	createValue (lastIntegralRaDec, "last_integral_position", "INTEGRAL current position", false);
 
+	createValue (alertReceived, "alert_received", "time when GCN packet of the last GRB passed to executor was received", false);
+	createValue (alertParsed, "alert_parsed", "time when GCN packet of the last GRB passed to executor was parsed", false);
+	createValue (alertCommitted, "alert_committed", "time when the last GRB passed to executor was committed to the database", false);
+	createValue (alertAccepted, "alert_accepted", "time when executor accepted the last GRB", false);
+	createValue (alertLatency, "alert_latency", "[s] time from GCN packet reception to executor acceptance", false);
+
 	createValue (recordNotVisible, "not_visible", "record GRBs not visible from the current location", false, RTS2_VALUE_WRITABLE);
 	recordNotVisible->setValueBool (true);
 
@@ -271,6 +279,20 @@ void Grbd::postEvent (rts2core::Event * event)
 				addTimer (60, new rts2core::Event (EVENT_TIMER_GCNCNN_INIT, this));
 			}
 			break;
+		case EVENT_COMMAND_OK:
+			if (event->getArg () == execC)
+			{
+				double received = alertReceived->getValueDouble ();
+				alertAccepted->setValueDouble (getNow ());
+				alertLatency->setValueDouble (alertAccepted->getValueDouble () - received);
+				sendValueAll (alertAccepted);
+				sendValueAll (alertLatency);
+				logStream (MESSAGE_INFO) << "GRB with ID " << execC->getGrbID () << " accepted by executor" << std::fixed << std::setprecision (3)
+					<< ", parsed +" << (alertParsed->getValueDouble () - received)
+					<< " s, committed +" << (alertCommitted->getValueDouble () - received)
+					<< " s, accepted +" << alertLatency->getValueDouble () << " s after GCN packet was received" << sendLog;
+			}
+			break;
 		case EVENT_COMMAND_FAILED:
 			if (event->getArg () == execC)
 			{
@@ -293,18 +315,35 @@ void Grbd::postEvent (rts2core::Event * event)
 }
 
 // that method is called when somebody want to immediatelly observe GRB
-int Grbd::newGcnGrb (int tar_id)
+int Grbd::newGcnGrb (int tar_id, double received, double parsed, double committed)
 {
 	if (grb_enabled->getValueBool () != true)
 	{
 		logStream (MESSAGE_WARNING) << "GRB was not passed to executor, as this feature is disabled" << sendLog;
 		return -1;
 	}
+
+	// GRBs entered by test command are measured from now
+	if (isnan (received))
+		received = getNow ();
+
+	alertReceived->setValueDouble (received);
+	alertParsed->setValueDouble (parsed);
+	alertCommitted->setValueDouble (committed);
+	alertAccepted->setValueDouble (NAN);
+	alertLatency->setValueDouble (NAN);
+
+	sendValueAll (alertReceived);
+	sendValueAll (alertParsed);
+	sendValueAll (alertCommitted);
+	sendValueAll (alertAccepted);
+	sendValueAll (alertLatency);
+
 	rts2core::Connection *exec;
 	exec = getOpenConnection ("EXEC");
 	if (exec)
 	{
-		execC = new rts2core::CommandExecGrb (this, tar_id);
+		execC = new rts2core::CommandExecGrb (this, tar_id, received);
 		exec->queCommand (execC, 0, this);
 	}
 	else if (!queueName)
@@ -58,7 +58,15 @@ class Grbd:public rts2db::DeviceDb
 		virtual int info ();
 		virtual void postEvent (rts2core::Event * event);
 
-		int newGcnGrb (int tar_id);
+		/**
+		 * Pass GRB target to executor and selector queue.
+		 *
+		 * @param tar_id     GRB target ID
+		 * @param received   ctime when GCN packet was received
+		 * @param parsed     ctime when GCN packet was parsed
+		 * @param committed  ctime when target was committed to the database
+		 */
+		int newGcnGrb (int tar_id, double received = NAN, double parsed = NAN, double committed = NAN);
 
 		virtual int commandAuthorized (rts2core::Connection * conn);
 
@@ -111,6 +119,13 @@ class Grbd:public rts2db::DeviceDb
 		rts2core::ValueTime *lastIntegral;
 		rts2core::ValueRaDec *lastIntegralRaDec;
 
+		// stages of the last GRB passed to executor
+		rts2core::ValueTime *alertReceived;
+		rts2core::ValueTime *alertParsed;
+		rts2core::ValueTime *alertCommitted;
+		rts2core::ValueTime *alertAccepted;
+		rts2core::ValueDouble *alertLatency;
+
 		rts2core::ValueBool *recordNotVisible;
 		rts2core::ValueBool *recordOnlyVisibleTonight;
 		rts2core::ValueDouble *minGrbAltitude;
@@ -39,6 +39,7 @@ class Rts2GrbForwardConnection:public rts2core::ConnNoSend
 		virtual int init ();
 		// span new GRBFw connection
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 };
 
 class Rts2GrbForwardClientConn:public rts2core::ConnNoSend
@@ -50,5 +51,6 @@ class Rts2GrbForwardClientConn:public rts2core::ConnNoSend
 		virtual void postEvent (rts2core::Event * event);
 
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 };
 #endif							 /* !__RTS2_GRBFW__ */
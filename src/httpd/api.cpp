@@ -124,6 +124,20 @@ void sendSelection (std::ostringstream &os, rts2core::ValueSelection *value)
 
 }
 
+bool API::isOffloadable (const std::string &path, XmlRpc::HttpParams *params)
+{
+#ifdef RTS2_HAVE_PGSQL
+	std::vector <std::string> vals = SplitStr (path, std::string ("/"));
+	if (vals.size () != 1)
+		return false;
+	if (vals[0] == "taltitudes")
+		return true;
+	return isOffloadableDB (vals, params);
+#else
+	return false;
+#endif // RTS2_HAVE_PGSQL
+}
+
 void API::executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length)
 {
 	std::vector <std::string> vals = SplitStr (path, std::string ("/"));
@@ -191,17 +205,15 @@ void API::executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::H
 
 			response_length += sizeof (imghdr);
 
+			const void *data = newType != 0 ? image->getChannelDataScaled (chan, smin, smax, scaling, newType) : image->getChannelData (chan);
+			if (data == NULL)
+				throw JSONException ("cannot read image data");
+
 			response = new char[response_length];
 
+			memcpy (response + sizeof (imghdr), data, response_length - sizeof (imghdr));
 			if (newType != 0)
-			{
-				memcpy (response + sizeof (imghdr), image->getChannelDataScaled (chan, smin, smax, scaling, newType), response_length - sizeof (imghdr));
 				im_h.data_type = htons (newType);
-			}
-			else
-			{
-				memcpy (response + sizeof (imghdr), image->getChannelData (chan), response_length - sizeof (imghdr));
-			}
 			memcpy (response, &im_h, sizeof (imghdr));
 			return;
 		}
@@ -516,14 +528,17 @@ void API::executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::H
 				os << "\"from\":" << *(n.getFrom ()) << ",\"to\":" << *(n.getTo ());
 			}
 			// get variables from all connected devices
+			// seq parameter - return only values changed after given change sequence (returned as seq)
 			else if (vals[0] == "getall")
 			{
+				double cpuStart = getCPUTime ();
 				bool ext = params->getInteger ("e", 0);
 				double from = params->getDouble ("from", 0);
+				unsigned long since = params->getDouble ("seq", 0);
 
 				// send centrald values
 				os << "\"centrald\":{";
-				rts2json::sendConnectionValues (os, master->getSingleCentralConn (), params, from, ext);
+				rts2json::sendConnectionValues (os, master->getSingleCentralConn (), params, from, ext, since);
 
 				// send own values first
 				os << "},\"" << ((HttpD *) getMasterApp ())->getDeviceName () << "\":{";
@@ -535,16 +550,19 @@ void API::executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::H
 					if ((*iter)->getName ()[0] == '\0')
 						continue;
 					os << ",\"" << (*iter)->getName () << "\":{";
-					rts2json::sendConnectionValues (os, *iter, params, from, ext);
+					rts2json::sendConnectionValues (os, *iter, params, from, ext, since);
 					os << '}';
 				}
+				master->valuesRequest (os.tellp (), getCPUTime () - cpuStart);
 			}
 			// get variables
 			else if (vals[0] == "get" || vals[0] == "status")
 			{
+				double cpuStart = getCPUTime ();
 				const char *device = params->getString ("d","");
 				bool ext = params->getInteger ("e", 0);
 				double from = params->getDouble ("from", 0);
+				unsigned long since = params->getDouble ("seq", 0);
 				if (strcmp (device, ((HttpD *) getMasterApp ())->getDeviceName ()))
 				{
 					if (isCentraldName (device))
@@ -553,12 +571,13 @@ void API::executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::H
 						conn = master->getOpenConnection (device);
 					if (conn == NULL)
 						throw JSONException ("cannot find device");
-					rts2json::sendConnectionValues (os, conn, params, from, ext);
+					rts2json::sendConnectionValues (os, conn, params, from, ext, since);
 				}
 				else
 				{
 					sendOwnValues (os, params, from, ext);
 				}
+				master->valuesRequest (os.tellp (), getCPUTime () - cpuStart);
 			}
 			else if (vals[0] == "push")
 			{
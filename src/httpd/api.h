@@ -50,6 +50,8 @@ class API:public rts2json::JSONRequest
 
 		void sendOwnValues (std::ostringstream & os, XmlRpc::HttpParams *params, double from, bool extended);
 
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params);
+
 	protected:
 		virtual void executeJSON (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length);
 	
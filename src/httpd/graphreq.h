@@ -69,6 +69,8 @@ class Graph: public rts2json::GetRequestAuthorized
 	public:
 		Graph (const char *prefix, rts2json::HTTPServer *_http_server, XmlRpc::XmlRpcServer *s):rts2json::GetRequestAuthorized (prefix, _http_server, "plot graphs of recorded system values", s) {};
 
+		virtual bool isOffloadable (const std::string &path, XmlRpc::HttpParams *params) { return true; }
+
 		virtual void authorizedExecute (XmlRpc::XmlRpcSource *source, std::string path, XmlRpc::HttpParams *params, const char* &response_type, char* &response, size_t &response_length);
 
 	private:
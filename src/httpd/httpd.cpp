@@ -36,6 +36,7 @@ using namespace Magick;
 #include "r2x.h"
 
 #include <arpa/inet.h>
+#include <ctype.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -87,7 +88,7 @@ void XmlDevInterface::stateChanged (rts2core::ServerState * state)
 
 void XmlDevInterface::valueChanged (rts2core::Value * value)
 {
-	changedTimes[value] = getNow ();
+	markValueChanged (value);
 	(getMaster ())->valueChangedEvent (getConnection (), value);
 }
 
@@ -244,7 +245,122 @@ void HttpD::bbSend (double t)
 	sendValueAll (bbLastSuccess);
 }
 
+void HttpD::valuesRequest (size_t bytes, double cpu)
+{
+	valuesRequests->inc ();
+	valuesBytes->addValue (bytes, 100);
+	valuesBytes->calculate ();
+	valuesCPU->addValue (cpu * 1000.0, 100);
+	valuesCPU->calculate ();
+}
+
+bool HttpD::offloadRequest (rts2json::GetRequestAuthorized *request, XmlRpc::XmlRpcServerConnection *connection, const std::string &path, XmlRpc::HttpParams *params)
+{
+	if (requestPool.getWorkers () <= 0)
+		return false;
+	OffloadedRequest *req = new OffloadedRequest (request, connection, path, params);
+	offloaded.push_back (req);
+	requestPool.push (req);
+	offloadedRequests->inc ();
+	return true;
+}
+
+void HttpD::offloadedFinished ()
+{
+	std::list <OffloadedRequest *> finished;
+	requestPool.getFinished (finished);
+
+	for (std::list <OffloadedRequest *>::iterator iter = finished.begin (); iter != finished.end (); iter++)
+	{
+		OffloadedRequest *req = *iter;
+		offloaded.remove (req);
+		addLatency (req);
+
+		if (req->connection)
+		{
+			if (req->failed)
+			{
+				req->connection->offloadFailed (req->jsonError, req->errorCode, req->errorMessage);
+			}
+			else
+			{
+				for (std::list <std::pair <const char *, std::string> >::iterator hi = req->headers.begin (); hi != req->headers.end (); hi++)
+					req->connection->addExtraHeader (hi->first, hi->second);
+				// connection takes ownership of the response
+				req->connection->offloadFinished (HTTP_OK, req->responseType, req->response, req->responseLength);
+				req->response = NULL;
+			}
+		}
+
+		delete req;
+	}
+
+#ifdef RTS2_HAVE_PGSQL
+	if (constraintsModified && offloaded.empty ())
+	{
+		rts2db::MasterConstraints::clearCache ();
+		constraintsModified = false;
+	}
+#endif
+}
+
+// histogram bins upper limits, in milliseconds
+static const double latencyBins[] = {10, 30, 100, 300, 1000, 3000};
+#define LATENCY_BINS    (sizeof (latencyBins) / sizeof (latencyBins[0]) + 1)
+
+void HttpD::addLatency (OffloadedRequest *req)
+{
+	std::map <std::string, LatencyStat>::iterator iter = latencies.find (req->request->getPrefix ());
+	if (iter == latencies.end ())
+	{
+		std::string suffix = req->request->getPrefix ();
+		for (std::string::iterator si = suffix.begin (); si != suffix.end (); si++)
+		{
+			if (!isalnum (*si))
+				*si = '_';
+		}
+
+		LatencyStat ls;
+		createValue (ls.latency, (std::string ("latency") + suffix).c_str (), "[ms] time from request arrival to its completion by worker thread, last 100 requests", false);
+		updateMetaInformations (ls.latency);
+		createValue (ls.histogram, (std::string ("latency") + suffix + "_hist").c_str (), "histogram of request latencies, number of requests completed in <10, <30, <100, <300, <1000, <3000 and >=3000 ms", false);
+		for (size_t i = 0; i < LATENCY_BINS; i++)
+			ls.histogram->addValue (0);
+		updateMetaInformations (ls.histogram);
+
+		iter = latencies.insert (std::pair <std::string, LatencyStat> (req->request->getPrefix (), ls)).first;
+	}
+
+	double l = (req->finished - req->queued) * 1000.0;
+
+	iter->second.latency->addValue (l, 100);
+	iter->second.latency->calculate ();
+
+	size_t bin = 0;
+	while (bin < LATENCY_BINS - 1 && l >= latencyBins[bin])
+		bin++;
+	std::vector <int> hist (iter->second.histogram->valueBegin (), iter->second.histogram->valueEnd ());
+	hist[bin]++;
+	iter->second.histogram->setValueArray (hist);
+}
+
 #ifdef RTS2_HAVE_PGSQL
+void HttpD::updateRecorderStatistics ()
+{
+	int queued;
+	long written, dropped, batches, errors;
+	double lastWrite;
+
+	valueRecorder.getStatistics (queued, written, dropped, batches, errors, lastWrite);
+
+	recordQueue->setValueInteger (queued);
+	recordWritten->setValueLong (written);
+	recordDropped->setValueLong (dropped);
+	recordBatches->setValueLong (batches);
+	recordErrors->setValueLong (errors);
+	recordLastWrite->setValueDouble (lastWrite);
+}
+
 void HttpD::confirmSchedule (rts2db::Plan &_plan)
 {
 	rts2core::Connection *selConn = getOpenConnection (DEVICE_TYPE_SELECTOR);
@@ -453,7 +569,16 @@ rts2image::imageProceRes XmlDevCameraClient::processImage (rts2image::Image * im
 int HttpD::info ()
 {
 	bbQueueSize->setValueInteger (events.bbServers.queueSize ());
+
+	long responses;
+	long long original, compressed;
+	XmlRpcServer::getCompressStatistics (responses, original, compressed);
+	compressedResponses->setValueLong (responses);
+	compressRatio->setValueDouble (original > 0 ? (double) compressed / original : NAN);
+
+	workersQueue->setValueInteger (offloaded.size ());
 #ifdef RTS2_HAVE_PGSQL
+	updateRecorderStatistics ();
 	return DeviceDb::info ();
 #else
 	return rts2core::Device::info ();
@@ -463,6 +588,20 @@ int HttpD::info ()
 int HttpD::idle ()
 {
 	rts2json::HTTPServer::asyncIdle ();
+	// updates to WebSocket clients are collected and send together
+	if (pushFlushScheduled == false && rts2json::HTTPServer::asyncPending ())
+	{
+		addTimer (pushInterval->getValueDouble (), new Event (EVENT_XMLRPC_PUSH_FLUSH));
+		pushFlushScheduled = true;
+	}
+#ifdef RTS2_HAVE_LIBJPEG
+	// cache directory is walked in the cache thread
+	if (previewCache.isEnabled () && getNow () > nextPreviewPrune)
+	{
+		previewCache.queuePrune ();
+		nextPreviewPrune = getNow () + PREVIEW_PRUNE_INTERVAL;
+	}
+#endif
 #ifdef RTS2_HAVE_PGSQL
 	return DeviceDb::idle ();
 #else
@@ -557,6 +696,17 @@ int HttpD::init ()
 	XmlRpcServer::bindAndListen (rpcPort);
 	XmlRpcServer::enableIntrospection (true);
 
+	if (getEventPoll ())
+	{
+		int pollFd = XmlRpcServer::enablePoll ();
+		if (pollFd < 0)
+		{
+			logStream (MESSAGE_ERROR) << "cannot switch XML-RPC server to epoll" << sendLog;
+			return -1;
+		}
+		addPollSocket (pollFd);
+	}
+
 	// try states..
 	if (stateChangeFile != NULL)
 	{
@@ -607,8 +757,33 @@ int HttpD::init ()
 	// auth_localhost
 	auth_localhost = Configuration::instance ()->getBoolean ("xmlrpcd", "auth_localhost", auth_localhost);
 
+	compressMin->setValueInteger (Configuration::instance ()->getIntegerDefault ("xmlrpcd", "compress_min", compressMin->getValueInteger ()));
+	if (compressMin->getValueInteger () < 0)
+		compressMin->setValueInteger (0);
+	XmlRpcServer::setCompressMinLength (compressMin->getValueInteger ());
+
+	pushInterval->setValueDouble (Configuration::instance ()->getDoubleDefault ("xmlrpcd", "push_interval", pushInterval->getValueDouble ()));
+
+	workers->setValueInteger (Configuration::instance ()->getIntegerDefault ("xmlrpcd", "workers", workers->getValueInteger ()));
+	if (workers->getValueInteger () < 0)
+		workers->setValueInteger (0);
+	if (requestPool.setWorkers (workers->getValueInteger ()))
+		workers->setValueInteger (requestPool.getWorkers ());
+	if (requestPool.getNotifyFd () >= 0)
+		addPollSocket (requestPool.getNotifyFd ());
+
 #ifdef RTS2_HAVE_LIBJPEG
 	Magick::InitializeMagick (".");
+
+	std::string previewDir;
+	Configuration::instance ()->getString ("xmlrpcd", "preview_cache", previewDir, "");
+	previewCache.setCacheDir (previewDir.c_str ());
+
+	int previewSize;
+	double previewAge;
+	Configuration::instance ()->getInteger ("xmlrpcd", "preview_cache_size", previewSize, 1024);
+	Configuration::instance ()->getDouble ("xmlrpcd", "preview_cache_age", previewAge, 30);
+	previewCache.setLimits ((long long) previewSize * 1024 * 1024, previewAge * 86400);
 #endif /* RTS2_HAVE_LIBJPEG */
 	return ret;
 }
@@ -621,6 +796,8 @@ void HttpD::addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set
 	rts2core::Device::addSelectSocks (read_set, write_set, exp_set);
 #endif
 	XmlRpcServer::addToFd (&read_set, &write_set, &exp_set);
+	if (requestPool.getNotifyFd () >= 0)
+		FD_SET (requestPool.getNotifyFd (), &read_set);
 }
 
 void HttpD::selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set)
@@ -631,6 +808,27 @@ void HttpD::selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set)
 	rts2core::Device::selectSuccess (read_set, write_set, exp_set);
 #endif
 	XmlRpcServer::checkFd (&read_set, &write_set, &exp_set);
+	if (requestPool.getNotifyFd () >= 0 && FD_ISSET (requestPool.getNotifyFd (), &read_set))
+		offloadedFinished ();
+}
+
+void HttpD::pollSuccess (int fd, uint32_t events)
+{
+	if (fd == XmlRpcServer::getPollFd ())
+	{
+		XmlRpcServer::checkPoll ();
+		return;
+	}
+	if (fd == requestPool.getNotifyFd ())
+	{
+		offloadedFinished ();
+		return;
+	}
+#ifdef RTS2_HAVE_PGSQL
+	DeviceDb::pollSuccess (fd, events);
+#else
+	rts2core::Device::pollSuccess (fd, events);
+#endif
 }
 
 void HttpD::signaledHUP ()
@@ -656,6 +854,9 @@ void HttpD::connectionRemoved (rts2core::Connection *conn)
 	{
 		if ((*iter)->isForConnection (conn))
 		{
+			// WebSocket connection would otherwise keep pointer to the removed API
+			if ((*iter)->isWebSocket ())
+				(*iter)->asyncFinished ();
 			iter = asyncAPIs.erase (iter);
 			numberAsyncAPIs->setValueInteger (asyncAPIs.size ());
 			sendValueAll (numberAsyncAPIs);
@@ -689,6 +890,12 @@ void HttpD::removeConnection (XmlRpcServerConnection *source)
 		if ((*iter)->isForSource (source))
 			(*iter)->nullSource ();
 	}
+	// response of offloaded request will be dropped
+	for (std::list <OffloadedRequest *>::iterator iter = offloaded.begin (); iter != offloaded.end (); iter++)
+	{
+		if ((*iter)->connection == source)
+			(*iter)->connection = NULL;
+	}
 	XmlRpcServer::removeConnection (source);
 }
 
@@ -699,6 +906,10 @@ HttpD::HttpD (int argc, char **argv): rts2core::Device (argc, argv, DEVICE_TYPE_
 #endif
 ,XmlRpcServer (),
   events(this),
+  requestPool (this),
+#ifdef RTS2_HAVE_PGSQL
+  valueRecorder (this),
+#endif
 // construct all handling events..
   login (this),
   deviceCount (this),
@@ -736,6 +947,7 @@ HttpD::HttpD (int argc, char **argv): rts2core::Device (argc, argv, DEVICE_TYPE_
 #ifdef RTS2_HAVE_LIBJPEG
   jpegRequest ("/jpeg", this, this),
   jpegPreview ("/preview", this, "/", this),
+  tileRequest ("/tiles", this, this),
   downloadRequest ("/download", this, this),
   current ("/current", this, this),
 #ifdef RTS2_HAVE_PGSQL
@@ -789,6 +1001,51 @@ HttpD::HttpD (int argc, char **argv): rts2core::Device (argc, argv, DEVICE_TYPE_
 	createValue (messageBufferSize, "message_buffer_size", "number of last messages to kept in memory", false, RTS2_VALUE_WRITABLE);
 	messageBufferSize->setValueInteger (100);
 
+	createValue (valuesRequests, "values_requests", "number of get and getall API requests", false);
+	valuesRequests->setValueLong (0);
+	createValue (valuesBytes, "values_bytes", "[bytes] size of get and getall responses (before compression), last 100 requests", false);
+	createValue (valuesCPU, "values_cpu", "[ms] CPU time spend on get and getall responses, last 100 requests", false);
+
+	createValue (compressMin, "compress_min", "[bytes] minimal size of compressed response, 0 to disable compression", false, RTS2_VALUE_WRITABLE);
+	compressMin->setValueInteger (1024);
+	createValue (compressedResponses, "compressed_responses", "number of compressed responses", false);
+	compressedResponses->setValueLong (0);
+	createValue (compressRatio, "compress_ratio", "ratio of compressed and original size of compressed responses", false);
+
+	createValue (pushInterval, "push_interval", "[s] interval between updates send to WebSocket clients", false, RTS2_VALUE_WRITABLE);
+	pushInterval->setValueDouble (0.1);
+	pushFlushScheduled = false;
+
+#ifdef RTS2_HAVE_LIBJPEG
+	nextPreviewPrune = 0;
+#endif
+
+	createValue (workers, "workers", "number of threads executing database queries and image conversions, 0 to execute them in the main thread", false, RTS2_VALUE_WRITABLE);
+	workers->setValueInteger (2);
+	createValue (workersQueue, "workers_queue", "number of requests waiting for or executed by worker threads", false);
+	createValue (offloadedRequests, "offloaded_requests", "number of requests executed by worker threads", false);
+	offloadedRequests->setValueLong (0);
+	constraintsModified = false;
+
+#ifdef RTS2_HAVE_PGSQL
+	createValue (recordQueue, "record_queue", "number of value records waiting to be written to the database", false);
+	createValue (recordWritten, "record_written", "number of value records written to the database", false);
+	recordWritten->setValueLong (0);
+	createValue (recordDropped, "record_dropped", "number of value records dropped, as queue was full or database write failed", false);
+	recordDropped->setValueLong (0);
+	createValue (recordBatches, "record_batches", "number of batches of value records written", false);
+	recordBatches->setValueLong (0);
+	createValue (recordErrors, "record_errors", "number of failed writes of value records batches", false);
+	recordErrors->setValueLong (0);
+	createValue (recordLastWrite, "record_last_write", "time of the last successful write of value records", false);
+	createValue (recordBatchSize, "record_batch_size", "number of value records written in one batch", false, RTS2_VALUE_WRITABLE);
+	recordBatchSize->setValueInteger (100);
+	createValue (recordBatchInterval, "record_batch_interval", "[s] maximal time value record waits before it is written", false, RTS2_VALUE_WRITABLE | RTS2_DT_TIMEINTERVAL);
+	recordBatchInterval->setValueDouble (5);
+	createValue (recordQueueLimit, "record_queue_limit", "maximal number of value records waiting to be written", false, RTS2_VALUE_WRITABLE);
+	recordQueueLimit->setValueInteger (100000);
+#endif
+
 	debugTestscript = false;
 
 	bbQueueName = NULL;
@@ -814,6 +1071,11 @@ HttpD::HttpD (int argc, char **argv): rts2core::Device (argc, argv, DEVICE_TYPE_
 
 HttpD::~HttpD ()
 {
+	requestPool.stop ();
+	for (std::list <OffloadedRequest *>::iterator iter = offloaded.begin (); iter != offloaded.end (); iter++)
+		delete *iter;
+	offloaded.clear ();
+
 	for (std::vector <rts2json::Directory *>::iterator id = directories.begin (); id != directories.end (); id++)
 		delete *id;
 
@@ -871,6 +1133,22 @@ void HttpD::deviceReady (rts2core::Connection * conn)
 	}
 }
 
+void HttpD::postEvent (rts2core::Event *event)
+{
+	switch (event->getType ())
+	{
+		case EVENT_XMLRPC_PUSH_FLUSH:
+			pushFlushScheduled = false;
+			rts2json::HTTPServer::asyncFlush ();
+			break;
+	}
+#ifdef RTS2_HAVE_PGSQL
+	DeviceDb::postEvent (event);
+#else
+	rts2core::Device::postEvent (event);
+#endif
+}
+
 int HttpD::setValue (rts2core::Value *old_value, rts2core::Value *new_value)
 {
 	if (old_value == bbCadency)
@@ -878,6 +1156,44 @@ int HttpD::setValue (rts2core::Value *old_value, rts2core::Value *new_value)
 		for (BBServers::iterator iter = events.bbServers.begin (); iter != events.bbServers.end (); iter++)
 			iter->setCadency (new_value->getValueInteger ());
 	}
+	if (old_value == compressMin)
+	{
+		if (new_value->getValueInteger () < 0)
+			return -2;
+		XmlRpcServer::setCompressMinLength (new_value->getValueInteger ());
+		return 0;
+	}
+	if (old_value == pushInterval)
+		return new_value->getValueDouble () < 0 ? -2 : 0;
+	if (old_value == workers)
+	{
+		if (new_value->getValueInteger () < 0)
+			return -2;
+		return requestPool.setWorkers (new_value->getValueInteger ()) ? -2 : 0;
+	}
+#ifdef RTS2_HAVE_PGSQL
+	if (old_value == recordBatchSize)
+	{
+		if (new_value->getValueInteger () <= 0)
+			return -2;
+		valueRecorder.setBatch (new_value->getValueInteger (), recordBatchInterval->getValueDouble ());
+		return 0;
+	}
+	if (old_value == recordBatchInterval)
+	{
+		if (!(new_value->getValueDouble () >= 0))
+			return -2;
+		valueRecorder.setBatch (recordBatchSize->getValueInteger (), new_value->getValueDouble ());
+		return 0;
+	}
+	if (old_value == recordQueueLimit)
+	{
+		if (new_value->getValueInteger () <= 0)
+			return -2;
+		valueRecorder.setQueueLimit (new_value->getValueInteger ());
+		return 0;
+	}
+#endif
 	// if it is a template file, load it immediately
 	for (std::list <XmlDevCameraClient *>::iterator iter = camClis.begin (); iter != camClis.end (); iter++)
 	{
@@ -980,6 +1296,9 @@ void HttpD::message (Message & msg)
 		}
 	}
 	
+	for (std::list <rts2json::AsyncAPI *>::iterator iter = asyncAPIs.begin (); iter != asyncAPIs.end (); iter++)
+		(*iter)->message (msg);
+
 	while (messages.size () > (size_t) (messageBufferSize->getValueInteger ()))
 	{
 		messages.pop_front ();
@@ -1006,7 +1325,11 @@ int HttpD::commandAuthorized (rts2core::Connection *conn)
 void HttpD::fileModified (struct inotify_event *event)
 {
 #ifdef RTS2_HAVE_PGSQL
-	rts2db::MasterConstraints::clearCache ();
+	// worker threads might use cached constraints
+	if (offloaded.empty ())
+		rts2db::MasterConstraints::clearCache ();
+	else
+		constraintsModified = true;
 #endif
 }
 
@@ -30,6 +30,7 @@
 #include "rts2db/plan.h"
 #include "rts2json/addtargetreq.h"
 #include "bbapi.h"
+#include "valuerecorder.h"
 #else
 #include "configuration.h"
 #include "device.h"
@@ -47,6 +48,7 @@
 #include "rts2json/targetreq.h"
 #include "rts2json/obsreq.h"
 #include "rts2json/imgpreview.h"
+#include "rts2fits/previewcache.h"
 #include "rts2json/nightreq.h"
 #include "session.h"
 #include "xmlrpc++/XmlRpc.h"
@@ -58,6 +60,7 @@
 #include "planreq.h"
 #include "switchstatereq.h"
 #include "api.h"
+#include "requestpool.h"
 
 #include "connnotify.h"
 #include "rts2script/execcli.h"
@@ -69,6 +72,7 @@
 #define EVENT_XMLRPC_VALUE_TIMER    RTS2_LOCAL_EVENT + 850
 #define EVENT_XMLRPC_BB             RTS2_LOCAL_EVENT + 851
 #define EVENT_TERMINATE_TEST        RTS2_LOCAL_EVENT + 852
+#define EVENT_XMLRPC_PUSH_FLUSH     RTS2_LOCAL_EVENT + 853
 
 using namespace XmlRpc;
 
@@ -89,7 +93,7 @@ namespace rts2xmlrpc
 class XmlDevInterface:public rts2json::DevInterface
 {
 	public:
-		XmlDevInterface ():changedTimes () {}
+		XmlDevInterface ():rts2json::DevInterface () {}
 		void stateChanged (rts2core::ServerState * state);
 
 		void valueChanged (rts2core::Value * value);
@@ -97,10 +101,6 @@ class XmlDevInterface:public rts2json::DevInterface
 	protected:
 		virtual HttpD *getMaster () = 0;
 		virtual rts2core::Connection *getConnection () = 0;
-
-	private:
-		// value change times
-		std::map <rts2core::Value *, double> changedTimes;
 };
 
 /**
@@ -111,7 +111,7 @@ class XmlDevInterface:public rts2json::DevInterface
  *
  * @addgroup XMLRPC
  */
-class XmlDevClient:public rts2image::DevClientWriteImage, XmlDevInterface
+class XmlDevClient:public rts2image::DevClientWriteImage, public XmlDevInterface
 {
 	public:
 		XmlDevClient (rts2core::Connection *conn):rts2image::DevClientWriteImage (conn), XmlDevInterface () {}
@@ -145,7 +145,7 @@ class XmlDevClient:public rts2image::DevClientWriteImage, XmlDevInterface
  *
  * @addgroup XMLRPC
  */
-class XmlDevTelescopeClient:public rts2image::DevClientTelescopeImage, XmlDevInterface
+class XmlDevTelescopeClient:public rts2image::DevClientTelescopeImage, public XmlDevInterface
 {
 	public:
 		XmlDevTelescopeClient (rts2core::Connection *conn):rts2image::DevClientTelescopeImage (conn), XmlDevInterface () {}
@@ -179,7 +179,7 @@ class XmlDevTelescopeClient:public rts2image::DevClientTelescopeImage, XmlDevInt
  *
  * @addgroup XMLRPC
  */
-class XmlDevFocusClient:public rts2image::DevClientFocusImage, XmlDevInterface
+class XmlDevFocusClient:public rts2image::DevClientFocusImage, public XmlDevInterface
 {
 	public:
 		XmlDevFocusClient (rts2core::Connection *conn):rts2image::DevClientFocusImage (conn), XmlDevInterface () {}
@@ -211,7 +211,7 @@ class XmlDevFocusClient:public rts2image::DevClientFocusImage, XmlDevInterface
  *
  * @author Petr Kubanek <petr@kubanek.net>
  */
-class XmlDevCameraClient:public rts2script::DevClientCameraExec, rts2script::ScriptInterface, XmlDevInterface
+class XmlDevCameraClient:public rts2script::DevClientCameraExec, rts2script::ScriptInterface, public XmlDevInterface
 {
 	public:
 		XmlDevCameraClient (rts2core::Connection *conn);
@@ -392,12 +392,15 @@ class HttpD:public rts2core::Device, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 
 		virtual int setValue (rts2core::Value *old_value, rts2core::Value *new_value);
 
+		virtual void postEvent (rts2core::Event *event);
+
 		void stateChangedEvent (rts2core::Connection *conn, rts2core::ServerState *new_state);
 
 		void valueChangedEvent (rts2core::Connection *conn, rts2core::Value *new_value);
 
 		virtual void addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 		virtual void selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
+		virtual void pollSuccess (int fd, uint32_t events);
 
 		virtual void message (Message & msg);
 
@@ -453,6 +456,10 @@ class HttpD:public rts2core::Device, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 
 		virtual int getDefaultChannel () { return defchan; }
 
+#ifdef RTS2_HAVE_LIBJPEG
+		virtual rts2image::PreviewCache *getPreviewCache () { return previewCache.isEnabled () ? &previewCache : NULL; }
+#endif
+
 		rts2core::ConnNotify * getNotifyConnection () { return notifyConn; }
 
 		void scriptProgress (double start, double end);
@@ -476,6 +483,16 @@ class HttpD:public rts2core::Device, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 
 		virtual void addExecutedPage () { numRequests->inc (); }
 
+		virtual bool offloadRequest (rts2json::GetRequestAuthorized *request, XmlRpc::XmlRpcServerConnection *connection, const std::string &path, XmlRpc::HttpParams *params);
+
+		/**
+		 * Record statistics of get/getall API request.
+		 *
+		 * @param bytes   size of JSON response (before compression)
+		 * @param cpu     CPU time (in seconds) used to generate the response
+		 */
+		void valuesRequest (size_t bytes, double cpu);
+
 		/**
 		 * Called when BB information were succesfully transmitted.
 		 */
@@ -483,6 +500,11 @@ class HttpD:public rts2core::Device, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 
 #ifdef RTS2_HAVE_PGSQL
 		void confirmSchedule (rts2db::Plan &plan);
+
+		/**
+		 * Returns writer of value records.
+		 */
+		ValueRecorder *getValueRecorder () { return &valueRecorder; }
 #endif
 
 	protected:
@@ -528,6 +550,67 @@ class HttpD:public rts2core::Device, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 
 		rts2core::ValueInteger *messageBufferSize;
 
+		rts2core::ValueLong *valuesRequests;
+		rts2core::ValueDoubleStat *valuesBytes;
+		rts2core::ValueDoubleStat *valuesCPU;
+
+		rts2core::ValueInteger *compressMin;
+		rts2core::ValueLong *compressedResponses;
+		rts2core::ValueDouble *compressRatio;
+
+		rts2core::ValueDouble *pushInterval;
+		// true if timer for flushing WebSocket updates is running
+		bool pushFlushScheduled;
+
+		RequestPool requestPool;
+		// requests executed by worker threads, not yet returned to clients
+		std::list <OffloadedRequest *> offloaded;
+		// constraint files were modified while workers were running
+		bool constraintsModified;
+
+		rts2core::ValueInteger *workers;
+		rts2core::ValueInteger *workersQueue;
+		rts2core::ValueLong *offloadedRequests;
+
+#ifdef RTS2_HAVE_LIBJPEG
+		rts2image::PreviewCache previewCache;
+		// time of the next preview cache prune
+		double nextPreviewPrune;
+#endif
+
+		struct LatencyStat
+		{
+			rts2core::ValueDoubleStat *latency;
+			rts2core::IntegerArray *histogram;
+		};
+
+		// latency statistics of offloaded requests, indexed by request prefix
+		std::map <std::string, LatencyStat> latencies;
+
+		/**
+		 * Pass responses of requests finished by worker threads to
+		 * clients.
+		 */
+		void offloadedFinished ();
+
+		void addLatency (OffloadedRequest *req);
+
+#ifdef RTS2_HAVE_PGSQL
+		ValueRecorder valueRecorder;
+
+		rts2core::ValueInteger *recordQueue;
+		rts2core::ValueLong *recordWritten;
+		rts2core::ValueLong *recordDropped;
+		rts2core::ValueLong *recordBatches;
+		rts2core::ValueLong *recordErrors;
+		rts2core::ValueTime *recordLastWrite;
+		rts2core::ValueInteger *recordBatchSize;
+		rts2core::ValueDouble *recordBatchInterval;
+		rts2core::ValueInteger *recordQueueLimit;
+
+		void updateRecorderStatistics ();
+#endif
+
 #ifndef RTS2_HAVE_PGSQL
 		const char *config_file;
 
@@ -581,6 +664,7 @@ class HttpD:public rts2core::Device, XmlRpc::XmlRpcServer, rts2json::HTTPServer
 #ifdef RTS2_HAVE_LIBJPEG
 		rts2json::JpegImageRequest jpegRequest;
 		rts2json::JpegPreview jpegPreview;
+		rts2json::TileRequest tileRequest;
 		rts2json::DownloadRequest downloadRequest;
 		CurrentPosition current;
 #ifdef RTS2_HAVE_PGSQL
@@ -0,0 +1,269 @@
+/*
+ * Pool of threads executing HTTP requests.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "requestpool.h"
+#include "utilsfunc.h"
+
+#ifdef RTS2_HAVE_PGSQL
+#include "rts2db/devicedb.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace rts2xmlrpc;
+
+OffloadedRequest::OffloadedRequest (rts2json::GetRequestAuthorized *_request, XmlRpc::XmlRpcServerConnection *_connection, const std::string &_path, XmlRpc::HttpParams *_params):params (*_params)
+{
+	request = _request;
+	connection = _connection;
+	path = _path;
+
+	responseType = "text/plain";
+	response = NULL;
+	responseLength = 0;
+
+	failed = false;
+	jsonError = false;
+	errorCode = HTTP_BAD_REQUEST;
+
+	queued = getNow ();
+	started = NAN;
+	finished = NAN;
+}
+
+OffloadedRequest::~OffloadedRequest ()
+{
+	delete[] response;
+}
+
+void OffloadedRequest::execute ()
+{
+	started = getNow ();
+	// connection and request handler members belong to the main thread
+	XmlRpc::XmlRpcServerGetRequest::setThreadHeaders (&headers);
+	try
+	{
+		request->offloadedExecute (NULL, path, &params, responseType, response, responseLength);
+	}
+	catch (const XmlRpc::JSONException &ex)
+	{
+		failed = true;
+		jsonError = true;
+		errorCode = ex.getCode ();
+		errorMessage = ex.getMessage ();
+	}
+	catch (const std::exception &ex)
+	{
+		failed = true;
+		jsonError = false;
+		errorCode = HTTP_BAD_REQUEST;
+		errorMessage = ex.what ();
+	}
+	XmlRpc::XmlRpcServerGetRequest::setThreadHeaders (NULL);
+	finished = getNow ();
+}
+
+RequestPool::RequestPool (rts2core::Block *_master)
+{
+	master = _master;
+
+	pthread_mutex_init (&mutex, NULL);
+	pthread_cond_init (&cond, NULL);
+
+	if (pipe (notifyPipe))
+	{
+		logStream (MESSAGE_ERROR) << "cannot create request pool notification pipe: " << strerror (errno) << sendLog;
+		notifyPipe[0] = notifyPipe[1] = -1;
+	}
+	else
+	{
+		fcntl (notifyPipe[0], F_SETFL, O_NONBLOCK);
+		fcntl (notifyPipe[1], F_SETFL, O_NONBLOCK);
+	}
+
+	workers = 0;
+	stopRequest = false;
+	running = 0;
+}
+
+RequestPool::~RequestPool ()
+{
+	stop ();
+
+	if (notifyPipe[0] >= 0)
+	{
+		close (notifyPipe[0]);
+		close (notifyPipe[1]);
+	}
+
+	pthread_mutex_destroy (&mutex);
+	pthread_cond_destroy (&cond);
+}
+
+int RequestPool::setWorkers (int _workers)
+{
+	if (notifyPipe[0] < 0)
+		return -1;
+
+	pthread_mutex_lock (&mutex);
+	workers = _workers;
+	for (int i = 0; i < workers; i++)
+	{
+		if (i < (int) threads.size ())
+		{
+			if (threads[i].running)
+				continue;
+			// thread is finishing, or finished already
+			pthread_join (threads[i].thread, NULL);
+		}
+		else
+		{
+			Worker w;
+			w.running = false;
+			threads.push_back (w);
+		}
+
+		WorkerArg *arg = new WorkerArg;
+		arg->pool = this;
+		arg->index = i;
+		int ret = pthread_create (&(threads[i].thread), NULL, workerThread, (void *) arg);
+		if (ret)
+		{
+			delete arg;
+			threads.resize (i);
+			workers = i;
+			pthread_mutex_unlock (&mutex);
+			logStream (MESSAGE_ERROR) << "cannot start request worker thread: " << strerror (ret) << sendLog;
+			return -1;
+		}
+		threads[i].running = true;
+	}
+	// surplus threads will exit
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+	return 0;
+}
+
+void RequestPool::push (OffloadedRequest *req)
+{
+	pthread_mutex_lock (&mutex);
+	queue.push_back (req);
+	pthread_cond_signal (&cond);
+	pthread_mutex_unlock (&mutex);
+}
+
+void RequestPool::getFinished (std::list <OffloadedRequest *> &_finished)
+{
+	char buf[100];
+	while (read (notifyPipe[0], buf, sizeof (buf)) > 0)
+		;
+
+	pthread_mutex_lock (&mutex);
+	_finished.splice (_finished.end (), finished);
+	pthread_mutex_unlock (&mutex);
+}
+
+void RequestPool::stop ()
+{
+	pthread_mutex_lock (&mutex);
+	stopRequest = true;
+	pthread_cond_broadcast (&cond);
+	pthread_mutex_unlock (&mutex);
+
+	for (std::vector <Worker>::iterator iter = threads.begin (); iter != threads.end (); iter++)
+		pthread_join (iter->thread, NULL);
+	threads.clear ();
+
+	queue.clear ();
+	finished.clear ();
+}
+
+void RequestPool::getStatistics (int &_queued, int &_running)
+{
+	pthread_mutex_lock (&mutex);
+	_queued = queue.size ();
+	_running = running;
+	pthread_mutex_unlock (&mutex);
+}
+
+void *RequestPool::workerThread (void *arg)
+{
+	WorkerArg *wa = (WorkerArg *) arg;
+	wa->pool->worker (wa->index);
+	delete wa;
+	return NULL;
+}
+
+void RequestPool::worker (int index)
+{
+#ifdef RTS2_HAVE_PGSQL
+	char conn_name[20];
+	snprintf (conn_name, sizeof (conn_name), "worker_%d", index);
+	bool connected = false;
+#endif
+
+	pthread_mutex_lock (&mutex);
+	while (true)
+	{
+		while (!stopRequest && queue.empty () && index < workers)
+			pthread_cond_wait (&cond, &mutex);
+
+		// surplus threads help to empty queue before they finish
+		if (stopRequest || queue.empty ())
+			break;
+
+		OffloadedRequest *req = queue.front ();
+		queue.pop_front ();
+		running++;
+
+		pthread_mutex_unlock (&mutex);
+
+#ifdef RTS2_HAVE_PGSQL
+		if (!connected)
+		{
+			if (((rts2db::DeviceDb *) master)->connectDB (conn_name))
+				logStream (MESSAGE_ERROR) << "request worker " << index << " cannot connect to the database" << sendLog;
+			else
+				connected = true;
+		}
+#endif
+
+		req->execute ();
+
+		pthread_mutex_lock (&mutex);
+		running--;
+		finished.push_back (req);
+		// wake up main thread
+		char c = 0;
+		if (write (notifyPipe[1], &c, 1) != 1 && errno != EAGAIN)
+			logStream (MESSAGE_ERROR) << "cannot notify main thread about finished request: " << strerror (errno) << sendLog;
+	}
+	threads[index].running = false;
+	pthread_mutex_unlock (&mutex);
+
+#ifdef RTS2_HAVE_PGSQL
+	if (connected)
+		((rts2db::DeviceDb *) master)->disconnectDB ();
+#endif
+}
@@ -0,0 +1,160 @@
+/*
+ * Pool of threads executing HTTP requests.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_REQUESTPOOL__
+#define __RTS2_REQUESTPOOL__
+
+#include "block.h"
+#include "rts2json/httpreq.h"
+
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace rts2xmlrpc
+{
+
+/**
+ * Request executed by worker thread. Holds copy of request parameters, and
+ * request result.
+ */
+class OffloadedRequest
+{
+	public:
+		OffloadedRequest (rts2json::GetRequestAuthorized *_request, XmlRpc::XmlRpcServerConnection *_connection, const std::string &_path, XmlRpc::HttpParams *_params);
+		~OffloadedRequest ();
+
+		/**
+		 * Execute request. Called from worker thread.
+		 */
+		void execute ();
+
+		rts2json::GetRequestAuthorized *request;
+		// connection waiting for response, NULL if it was closed. Used only by the main thread
+		XmlRpc::XmlRpcServerConnection *connection;
+		std::string path;
+		XmlRpc::HttpParams params;
+
+		const char *responseType;
+		char *response;
+		size_t responseLength;
+		// extra headers added by request, passed to connection with the response
+		std::list <std::pair <const char *, std::string> > headers;
+
+		// filled if request execution failed
+		bool failed;
+		bool jsonError;
+		int errorCode;
+		std::string errorMessage;
+
+		double queued;
+		double started;
+		double finished;
+};
+
+/**
+ * Executes requests in worker threads. Requests are queued by the main
+ * thread, executed by the first free worker, and returned to the main
+ * thread, which is notified by data written to notify pipe. Each worker
+ * uses its own database connection.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class RequestPool
+{
+	public:
+		RequestPool (rts2core::Block *_master);
+		~RequestPool ();
+
+		/**
+		 * Set number of worker threads. Missing threads are started,
+		 * surplus threads finish after queue is empty.
+		 *
+		 * @return -1 if thread cannot be started
+		 */
+		int setWorkers (int _workers);
+
+		int getWorkers () { return workers; }
+
+		/**
+		 * Returns descriptor, which becomes readable when some
+		 * requests finished.
+		 */
+		int getNotifyFd () { return notifyPipe[0]; }
+
+		/**
+		 * Queue request for execution.
+		 */
+		void push (OffloadedRequest *req);
+
+		/**
+		 * Move finished requests to the list. Called from the main
+		 * thread, after notify descriptor becomes readable.
+		 */
+		void getFinished (std::list <OffloadedRequest *> &_finished);
+
+		/**
+		 * Stops all threads. Requests waiting in queue are not
+		 * executed. Requests are owned by the caller, which shall
+		 * delete them after pool is stopped.
+		 */
+		void stop ();
+
+		/**
+		 * Returns number of requests waiting in queue, and number of
+		 * requests being executed.
+		 */
+		void getStatistics (int &_queued, int &_running);
+
+	private:
+		struct Worker
+		{
+			pthread_t thread;
+			bool running;
+		};
+
+		struct WorkerArg
+		{
+			RequestPool *pool;
+			int index;
+		};
+
+		rts2core::Block *master;
+
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		int notifyPipe[2];
+
+		std::vector <Worker> threads;
+		int workers;
+		bool stopRequest;
+		int running;
+
+		std::deque <OffloadedRequest *> queue;
+		std::list <OffloadedRequest *> finished;
+
+		static void *workerThread (void *arg);
+		void worker (int index);
+};
+
+}
+
+#endif /* !__RTS2_REQUESTPOOL__ */
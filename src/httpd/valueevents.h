@@ -99,11 +99,9 @@ class ValueChangeRecord: public ValueChange
 		virtual void run (rts2core::Value *val, double validTime);
 #ifdef RTS2_HAVE_PGSQL
 	private:
-		std::map <const char *, int> dbValueIds;
-		int getRecvalId (const char *suffix, int recval_type);
-		void recordValueInteger (int recval_id, int val, double validTime);
-		void recordValueDouble (int recval_id, double val, double validTime);
-		void recordValueBoolean (int recval_id, bool val, double validTime);
+		// ValueRecorder slots, indexed by suffix
+		std::map <const char *, int> recorderSlots;
+		int getSlot (const char *suffix, int recval_type);
 #endif /* RTS2_HAVE_PGSQL */
 };
 
@@ -0,0 +1,198 @@
+/*
+ * Background writer of value changes records.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RTS2_VALUERECORDER__
+#define __RTS2_VALUERECORDER__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace rts2db
+{
+class DeviceDb;
+}
+
+namespace rts2xmlrpc
+{
+
+/**
+ * Writes value records to the database from a background thread. Records
+ * are queued in memory by the main thread, and written in batches of
+ * multi-row INSERTs, either when batch size is reached or when the oldest
+ * queued record is older than batch interval. The thread uses its own
+ * database connection.
+ *
+ * Queue is bounded - if the database cannot keep up with records, new
+ * records are dropped and counted, so the main thread is never blocked by
+ * the database.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+class ValueRecorder
+{
+	public:
+		ValueRecorder (rts2db::DeviceDb *_master);
+		~ValueRecorder ();
+
+		/**
+		 * Returns slot used to record value. Database recval ID is
+		 * resolved (and recvals entry created) in the writer thread.
+		 *
+		 * @param deviceName   device name
+		 * @param valueName    value name, including suffix
+		 * @param recval_type  recval type, used if recvals entry has to be created
+		 */
+		int getSlot (const char *deviceName, const char *valueName, int recval_type);
+
+		/**
+		 * Queue records. Returns false if record was dropped, as
+		 * queue is full.
+		 */
+		bool recordInteger (int slot, int val, double validTime) { return record (slot, RECORD_INTEGER, val, validTime); }
+		bool recordDouble (int slot, double val, double validTime) { return record (slot, RECORD_DOUBLE, val, validTime); }
+		bool recordBoolean (int slot, bool val, double validTime) { return record (slot, RECORD_BOOLEAN, val ? 1 : 0, validTime); }
+
+		/**
+		 * Set batching parameters.
+		 *
+		 * @param _batchSize      number of records which triggers write
+		 * @param _batchInterval  maximal time (in seconds) record waits in queue
+		 */
+		void setBatch (int _batchSize, double _batchInterval);
+
+		/**
+		 * Set maximal number of queued records.
+		 */
+		void setQueueLimit (int _queueLimit);
+
+		/**
+		 * Stops writer thread, after it writes all queued records.
+		 */
+		void stop ();
+
+		/**
+		 * Copy statistics. All values are counted since start.
+		 */
+		void getStatistics (int &_queued, long &_written, long &_dropped, long &_batches, long &_errors, double &_lastWrite);
+
+	private:
+		enum recordType {RECORD_INTEGER, RECORD_DOUBLE, RECORD_BOOLEAN};
+
+		struct Record
+		{
+			int slot;
+			recordType type;
+			double value;
+			double validTime;
+		};
+
+		struct Slot
+		{
+			std::string deviceName;
+			std::string valueName;
+			int recvalType;
+		};
+
+		rts2db::DeviceDb *master;
+
+		pthread_t thread;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		bool running;
+		bool stopRequest;
+
+		std::vector <Record> queue;
+		// time when the first record in queue was added
+		double queueStart;
+
+		std::vector <Slot> slots;
+		std::map <std::string, int> slotNames;
+
+		size_t batchSize;
+		double batchInterval;
+		size_t queueLimit;
+
+		long written;
+		long dropped;
+		long batches;
+		long errors;
+		double lastWrite;
+
+		// writer thread data
+		bool connected;
+		// copy of slots known to the writer thread
+		std::vector <Slot> knownSlots;
+		std::vector <int> recvalIds;
+
+		bool record (int slot, recordType type, double value, double validTime);
+
+		static void *writerThread (void *arg);
+		void writer ();
+
+		/**
+		 * Write records to database. Called from writer thread.
+		 * Records with the same recval and time are written only
+		 * once, the last value is kept. Records of slots whose recval
+		 * cannot be found or created are skipped.
+		 *
+		 * @param records   records to write
+		 * @param _written  number of records written to the database
+		 *
+		 * @return -1 on error, 0 on success
+		 */
+		int writeBatch (std::vector <Record> &records, size_t &_written);
+
+		/**
+		 * Insert rows into table. If multi-row INSERT fails on
+		 * duplicate key, rows are inserted one by one and
+		 * duplicates are skipped.
+		 *
+		 * @return number of inserted rows, -1 on error
+		 */
+		int insertRows (const char *table, std::vector <std::string> &rows);
+
+		/**
+		 * Execute and commit statement.
+		 *
+		 * @return 0 on success, -2 on unique key violation, -1 on other error
+		 */
+		int executeStatement (std::string stmt);
+
+		/**
+		 * Find or create recval for the slot.
+		 *
+		 * @return recval ID, -1 on error. On database error other than
+		 * unique key violation, connection is closed and connected is set to false.
+		 */
+		int getRecvalId (Slot &slot);
+
+		/**
+		 * Log recval error, rollback transaction and disconnect unless
+		 * the error was caused by concurrent creation of the recval.
+		 *
+		 * @return -1
+		 */
+		int recvalError (Slot &slot, const char *action);
+};
+
+}
+
+#endif /* !__RTS2_VALUERECORDER__ */
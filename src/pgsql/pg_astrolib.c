@@ -21,6 +21,7 @@
  */
 
 #include <libnova/libnova.h>
+#include "healpix.h"
 
 #include <math.h>
 #include <postgres.h>
@@ -31,6 +32,7 @@ PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1 (ln_angular_separation);
 PG_FUNCTION_INFO_V1 (ln_airmass);
+PG_FUNCTION_INFO_V1 (healpix_nest);
 
 Datum
 ln_angular_separation (PG_FUNCTION_ARGS)
@@ -69,3 +71,24 @@ ln_airmass (PG_FUNCTION_ARGS)
 
   PG_RETURN_FLOAT4 (ln_get_airmass (hrz.alt, 750));
 }
+
+Datum
+healpix_nest (PG_FUNCTION_ARGS)
+{
+  int32 order;
+  float8 ra, dec;
+  // order, ra, dec
+  if (PG_ARGISNULL (0) || PG_ARGISNULL (1) || PG_ARGISNULL (2))
+    PG_RETURN_NULL ();
+
+  order = PG_GETARG_INT32 (0);
+  if (order < 0 || order > HEALPIX_MAX_ORDER)
+    PG_RETURN_NULL ();
+
+  ra = PG_GETARG_FLOAT8 (1);
+  dec = PG_GETARG_FLOAT8 (2);
+  if (isnan (ra) || isnan (dec))
+    PG_RETURN_NULL ();
+
+  PG_RETURN_INT64 (healpix_ang2pix_nest (order, ra, dec));
+}
@@ -29,6 +29,8 @@
 #include "rts2script/execclidb.h"
 #include "rts2devcliphot.h"
 
+#include <iomanip>
+
 #define OPT_IGNORE_DAY    OPT_LOCAL + 100
 #define OPT_DONT_DARK     OPT_LOCAL + 101
 #define OPT_DISABLE_AUTO  OPT_LOCAL + 102
@@ -89,7 +91,7 @@ class Executor:public rts2db::DeviceDb
 		int setNextPlan (int nextPlanId);
 		int queueTarget (int nextId, double t_start = NAN, double t_end = NAN, int plan_id = -1);
 		int setNow (int nextId, int plan_id);
-		int setGrb (int grbId);
+		int setGrb (int grbId, double received = NAN);
 		int setShower ();
 
 		/**
@@ -115,6 +117,21 @@ class Executor:public rts2db::DeviceDb
 		rts2core::ValueDouble *grb_sep_limit;
 		rts2core::ValueDouble *grb_min_sep;
 
+		// GRB alert latency
+		int grbLatencyId;
+		rts2core::ValueTime *grbAlert;
+		rts2core::ValueTime *grbAccepted;
+		rts2core::ValueTime *grbMoveStart;
+		rts2core::ValueTime *grbFirstExposure;
+		rts2core::ValueDouble *grbLatency;
+
+		/**
+		 * Record time when GRB target was accepted for observation,
+		 * starts measurement of move and first exposure latency.
+		 */
+		void grbAccept (int tar_id, double received);
+		void grbLatencyEvent (int event_type);
+
 		rts2core::ValueBool *enabled;
 		rts2core::ValueBool *selectorNext;
 		bool selector_next_reported;
@@ -154,6 +171,11 @@ class Executor:public rts2db::DeviceDb
 
 		rts2core::ValueInteger *img_id;
 
+		rts2core::ValueInteger *writerQueue;
+		rts2core::ValueInteger *writerMaxQueue;
+		rts2core::ValueSelection *writerFsync;
+		rts2core::ValueDouble *writerThroughput;
+
 		rts2core::ConnNotify *notifyConn;
 };
 
@@ -215,6 +237,22 @@ Executor::Executor (int in_argc, char **in_argv):rts2db::DeviceDb (in_argc, in_a
 
 	createValue (img_id, "img_id", "ID of current image", false);
 
+	rts2image::ImageWriter *writer = rts2image::ImageWriter::instance ();
+
+	createValue (writerQueue, "writer_queue", "number of images waiting to be written to disk", false);
+	writerQueue->setValueInteger (0);
+
+	createValue (writerMaxQueue, "writer_max_queue", "maximal number of images waiting to be written, 0 to write images in the main thread", false, RTS2_VALUE_WRITABLE);
+	writerMaxQueue->setValueInteger (writer->getMaxQueue ());
+
+	createValue (writerFsync, "writer_fsync", "when written images are synced to disk", false, RTS2_VALUE_WRITABLE);
+	writerFsync->addSelVal ("none");
+	writerFsync->addSelVal ("data");
+	writerFsync->addSelVal ("full");
+	writerFsync->setValueInteger (writer->getFsync ());
+
+	createValue (writerThroughput, "writer_throughput", "[MB/s] write speed of the last written image", false);
+
 	createValue (doDarks, "do_darks", "if darks target should be picked by executor", false, RTS2_VALUE_WRITABLE);
 	doDarks->addSelVal ("not at all");
 	doDarks->addSelVal ("just from queue");
@@ -233,6 +271,13 @@ Executor::Executor (int in_argc, char **in_argv):rts2db::DeviceDb (in_argc, in_a
 	createValue (grb_min_sep, "grb_min_sep", "[deg] when GRB is below grb_min_sep degrees from current position, telescope will not be slewed", false, RTS2_VALUE_WRITABLE | RTS2_DT_DEG_DIST);
 	grb_min_sep->setValueDouble (0);
 
+	grbLatencyId = -1;
+	createValue (grbAlert, "grb_alert", "time when GCN packet of the last accepted GRB was received", false);
+	createValue (grbAccepted, "grb_accepted", "time when the last GRB was accepted by executor", false);
+	createValue (grbMoveStart, "grb_move_start", "time when telescope started to move to the last GRB", false);
+	createValue (grbFirstExposure, "grb_first_exposure", "time when the first exposure of the last GRB started", false);
+	createValue (grbLatency, "grb_latency", "[s] time from GCN packet (or GRB acceptance, if packet time is not known) to the first exposure", false);
+
 	addOption (OPT_IGNORE_DAY, "ignore-day", 0, "observe even during daytime");
 	addOption (OPT_DONT_DARK, "no-dark", 0, "do not take on its own dark frames");
 	addOption (OPT_DISABLE_AUTO, "no-auto", 0, "disable autolooping");
@@ -310,6 +355,18 @@ int Executor::setValue (rts2core::Value *oldValue, rts2core::Value *newValue)
 	{
 		return setNext (newValue->getValueInteger ()) ? 0 : -2;
 	}
+	if (oldValue == writerMaxQueue)
+	{
+		if (newValue->getValueInteger () < 0)
+			return -2;
+		rts2image::ImageWriter::instance ()->setMaxQueue (newValue->getValueInteger ());
+		return 0;
+	}
+	if (oldValue == writerFsync)
+	{
+		rts2image::ImageWriter::instance ()->setFsync (newValue->getValueInteger ());
+		return 0;
+	}
 	return rts2db::DeviceDb::setValue (oldValue, newValue);
 }
 
@@ -487,6 +544,10 @@ void Executor::postEvent (rts2core::Event * event)
 			*((int *) event->getArg ()) =
 				(currentTarget) ? currentTarget->getAcquired () : -2;
 			break;
+		case EVENT_TEL_MOVE_STARTED:
+		case EVENT_EXPOSURE_STARTED:
+			grbLatencyEvent (event->getType ());
+			break;
 	}
 	rts2db::DeviceDb::postEvent (event);
 }
@@ -542,6 +603,9 @@ int Executor::info ()
 		next_plan_id->setValueInteger (getActiveQueue ()->front ().plan_id);
 	}
 
+	writerQueue->setValueInteger (rts2image::ImageWriter::instance ()->getQueueDepth ());
+	writerThroughput->setValueDouble (rts2image::ImageWriter::instance ()->getThroughput ());
+
 	return rts2db::DeviceDb::info ();
 }
 
@@ -745,7 +809,7 @@ int Executor::setNow (rts2db::Target * newTarget, int plan_id)
 	return 0;
 }
 
-int Executor::setGrb (int grbId)
+int Executor::setGrb (int grbId, double received)
 {
 	rts2db::Target *grbTarget = NULL;
 	int ret;
@@ -795,6 +859,7 @@ int Executor::setGrb (int grbId)
 		}
 		if (!currentTarget)
 		{
+			grbAccept (grbId, received);
 			return setNow (grbTarget, -1);
 		}
 
@@ -815,6 +880,7 @@ int Executor::setGrb (int grbId)
 		ret = grbTarget->compareWithTarget (currentTarget, grb_sep_limit->getValueDouble ());
 		if (ret == 0)
 		{
+			grbAccept (grbId, received);
 			return setNow (grbTarget, -1);
 		}
 		// if that's only few arcsec update, don't change
@@ -830,6 +896,7 @@ int Executor::setGrb (int grbId)
 			return 0;
 		}
 		// otherwise set us as next target
+		grbAccept (grbId, received);
 		clearNextTargets ();
 		getActiveQueue ()->addTarget (grbTarget);
 		return 0;
@@ -842,6 +909,63 @@ int Executor::setGrb (int grbId)
 	}
 }
 
+void Executor::grbAccept (int tar_id, double received)
+{
+	grbLatencyId = tar_id;
+
+	grbAlert->setValueDouble (received);
+	grbAccepted->setValueDouble (getNow ());
+	grbMoveStart->setValueDouble (NAN);
+	grbFirstExposure->setValueDouble (NAN);
+	grbLatency->setValueDouble (NAN);
+
+	sendValueAll (grbAlert);
+	sendValueAll (grbAccepted);
+	sendValueAll (grbMoveStart);
+	sendValueAll (grbFirstExposure);
+	sendValueAll (grbLatency);
+
+	if (!isnan (received))
+		logStream (MESSAGE_INFO) << "accepted GRB target #" << tar_id << " " << std::fixed << std::setprecision (3) << (grbAccepted->getValueDouble () - received) << " s after GCN packet was received" << sendLog;
+}
+
+void Executor::grbLatencyEvent (int event_type)
+{
+	// only the first move and exposure of accepted GRB target are recorded
+	if (grbLatencyId < 0 || currentTarget == NULL || currentTarget->getTargetID () != grbLatencyId)
+		return;
+
+	double now = getNow ();
+
+	if (event_type == EVENT_TEL_MOVE_STARTED)
+	{
+		if (isnan (grbMoveStart->getValueDouble ()))
+		{
+			grbMoveStart->setValueDouble (now);
+			sendValueAll (grbMoveStart);
+		}
+		return;
+	}
+
+	grbFirstExposure->setValueDouble (now);
+	sendValueAll (grbFirstExposure);
+
+	double start = grbAlert->getValueDouble ();
+	if (isnan (start))
+		start = grbAccepted->getValueDouble ();
+
+	grbLatency->setValueDouble (now - start);
+	sendValueAll (grbLatency);
+
+	logStream (MESSAGE_INFO) << "GRB target #" << grbLatencyId << std::fixed << std::setprecision (3)
+		<< " alert " << grbAlert->getValueDouble ()
+		<< " accepted +" << (grbAccepted->getValueDouble () - start)
+		<< " s move start +" << (grbMoveStart->getValueDouble () - start)
+		<< " s first exposure +" << (now - start) << " s" << sendLog;
+
+	grbLatencyId = -1;
+}
+
 int Executor::setShower ()
 {
 	// is during night and ready?
@@ -1054,9 +1178,13 @@ int Executor::commandAuthorized (rts2core::Connection * conn)
 	if (conn->isCommand ("grb"))
 	{
 		// change observation if we are to far from GRB position..
-		if (conn->paramNextInteger (&tar_id) || !conn->paramEnd ())
+		// optional second parameter is ctime when GCN packet was received
+		double received = NAN;
+		if (conn->paramNextInteger (&tar_id))
+			return -2;
+		if (!conn->paramEnd () && (conn->paramNextDouble (&received) || !conn->paramEnd ()))
 			return -2;
-		return setGrb (tar_id);
+		return setGrb (tar_id, received);
 	}
 	else if (conn->isCommand ("shower"))
 	{
@@ -18,6 +18,7 @@
  */
 
 #include "status.h"
+#include "workerpool.h"
 #include "rts2script/connimgprocess.h"
 #include "rts2script/script.h"
 
@@ -42,6 +43,11 @@ namespace rts2plan
 /**
  * Image processor main class.
  *
+ * Runs up to workers processes in parallel. Waiting processes are kept in
+ * two lanes - images (que_image, only_process) are started before
+ * observation processing (que_obs) and images reprocessed from image_glob.
+ * Inside lane, the most recently queued process is started first.
+ *
  * @author Petr Kubanek <petr@kubanek.net>
  */
 #ifdef RTS2_HAVE_PGSQL
@@ -63,7 +69,13 @@ class ImageProc:public rts2core::Device
 
 		virtual int deleteConnection (rts2core::Connection * conn);
 
-		int que (ConnProcess * newProc);
+		/**
+		 * Queue process.
+		 *
+		 * @param newProc   process to queue
+		 * @param priority  if true, process is queued to the image lane, otherwise to the observation lane
+		 */
+		int que (ConnProcess * newProc, bool priority = true);
 
 		int queImage (const char *_path);
 		int doImage (const char *_path);
@@ -81,6 +93,8 @@ class ImageProc:public rts2core::Device
 
 		virtual int commandAuthorized (rts2core::Connection * conn);
 
+		virtual int setValue (rts2core::Value * old_value, rts2core::Value * new_value);
+
 	protected:
 		virtual int reloadConfig ();
 #ifndef RTS2_HAVE_PGSQL
@@ -96,8 +110,16 @@ class ImageProc:public rts2core::Device
 #ifndef RTS2_HAVE_PGSQL
 		const char *configFile;
 #endif
+		// image lane
 		std::list < ConnProcess * >imagesQue;
-		ConnProcess *runningImage;
+		// observation lane
+		std::list < ConnProcess * >obsQue;
+		// running processes, NULL for idle worker
+		std::vector < ConnProcess * >runningImages;
+
+		rts2core::ValueInteger *workers;
+		rts2core::ValueInteger *runningSize;
+		rts2core::StringArray *workerProcesses;
 
 		rts2core::ValueString *image_glob;
 
@@ -139,6 +161,34 @@ class ImageProc:public rts2core::Device
 		const char *last_processed_jpeg;
 		const char *last_good_jpeg;
 		const char *last_trash_jpeg;
+
+		/**
+		 * Returns index of idle worker, -1 if all workers are busy.
+		 */
+		int getFreeWorker ();
+
+		int getRunningCount ();
+
+		/**
+		 * Start queued processes on idle workers.
+		 *
+		 * @return number of started processes
+		 */
+		int startNext ();
+
+		/**
+		 * Start process on the worker.
+		 *
+		 * @return -1 if process cannot be started
+		 */
+		int startProcess (int worker, ConnProcess * newImage);
+
+		/**
+		 * Update statistics from finished process.
+		 */
+		void processFinished (ConnProcess * proc);
+
+		void updateQueueValues ();
 };
 
 };
@@ -152,8 +202,6 @@ ImageProc::ImageProc (int _argc, char **_argv)
 :rts2core::Device (_argc, _argv, DEVICE_TYPE_IMGPROC, "IMGP")
 #endif
 {
-	runningImage = NULL;
-
 	last_processed_jpeg = last_good_jpeg = last_trash_jpeg = NULL;
 
 	createValue (applyCorrections, "apply_corrections", "apply corrections from astrometry", false, RTS2_VALUE_WRITABLE);
@@ -181,6 +229,14 @@ ImageProc::ImageProc (int _argc, char **_argv)
 	createValue (queSize, "queue_size", "number of images waiting for processing", false);
 	queSize->setValueInteger (0);
 
+	createValue (workers, "workers", "maximal number of processes running in parallel", false, RTS2_VALUE_WRITABLE);
+	workers->setValueInteger (1);
+
+	createValue (runningSize, "running", "number of running processes", false);
+	runningSize->setValueInteger (0);
+
+	createValue (workerProcesses, "worker_processes", "processes running on workers", false);
+
 	createValue (lastRaDec, "last_radec", "last correct image coordinates", false);
 	createValue (lastCorrections, "last_corrections", "size of last corrections", false, RTS2_DT_DEG_DIST);
 
@@ -259,6 +315,11 @@ int ImageProc::reloadConfig ()
 
 	astrometryTimeout->setValueInteger (config->getAstrometryTimeout ());
 
+	int w = config->getIntegerDefault ("imgproc", "workers", 1);
+	if (w <= 0)
+		w = rts2core::WorkerPool::getOnlineCPUs ();
+	workers->setValueInteger (w);
+
 	return ret;
 }
 
@@ -305,13 +366,10 @@ void ImageProc::postEvent (rts2core::Event * event)
 
 int ImageProc::idle ()
 {
-	std::list < ConnProcess * >::iterator img_iter;
-	if (!runningImage && imagesQue.size () != 0)
+	if (startNext () > 0)
 	{
-		img_iter = imagesQue.begin ();
-		ConnProcess *newImage = *img_iter;
-		imagesQue.erase (img_iter);
-		changeRunning (newImage);
+		updateQueueValues ();
+		infoAll ();
 	}
 #ifdef RTS2_HAVE_PGSQL
 	return rts2db::DeviceDb::idle ();
@@ -322,8 +380,7 @@ int ImageProc::idle ()
 
 int ImageProc::info ()
 {
-	queSize->setValueInteger ((int) imagesQue.size () + (runningImage ? 1 : 0));
-	sendValueAll (queSize);
+	updateQueueValues ();
 #ifdef RTS2_HAVE_PGSQL
 	return rts2db::DeviceDb::info ();
 #else
@@ -364,7 +421,7 @@ void ImageProc::changeMasterState (rts2_status_t old_state, rts2_status_t new_st
 			if (strlen (image_glob->getValue ()))
 			{
 				reprocessingPossible = 1;
-				if (!runningImage && imagesQue.size () == 0)
+				if (getRunningCount () == 0 && imagesQue.size () == 0 && obsQue.size () == 0)
 					checkNotProcessed ();
 			}
 	}
@@ -391,98 +448,41 @@ int ImageProc::deleteConnection (rts2core::Connection * conn)
 			img_iter++;
 		}
 	}
-	queSize->setValueInteger (imagesQue.size ());
-	sendValueAll (queSize);
-	if (runningImage)
-		runningImage->deleteConnection (conn);
-	if (conn == runningImage)
+	for (img_iter = obsQue.begin (); img_iter != obsQue.end ();)
 	{
-		// que next image
-		// rts2core::Device::deleteConnection will delete runningImage
-		switch (runningImage->getAstrometryStat ())
+		(*img_iter)->deleteConnection (conn);
+		if (*img_iter == conn)
 		{
-			case NOT_ASTROMETRY:
-				break;	
-			case GET:
-				goodImages->inc ();
-				nightGoodImages->inc ();
-				lastRaDec->setValueRaDec (((ConnImgOnlyProcess *) runningImage)->getRa (), ((ConnImgOnlyProcess *) runningImage)->getDec ());
-				lastCorrections->setValueRaDec (((ConnImgOnlyProcess *) runningImage)->getRaErr (), ((ConnImgOnlyProcess *) runningImage)->getDecErr ());
-				sendValueAll (goodImages);
-				sendValueAll (nightGoodImages);
-				sendValueAll (lastRaDec);
-				sendValueAll (lastCorrections);
-				if (isnan (lastGood->getValueDouble ()) || runningImage->getExposureEnd () > lastGood->getValueDouble ())
-				{
-					lastGood->setValueDouble (runningImage->getExposureEnd ());
-					sendValueAll (lastGood);
-				}
-				break;
-			case TRASH:
-				trashImages->inc ();
-				nightTrashImages->inc ();
-				sendValueAll (trashImages);
-				sendValueAll (nightTrashImages);
-				if (isnan (lastTrash->getValueDouble ()) || runningImage->getExposureEnd () > lastTrash->getValueDouble ())
-				{
-					lastTrash->setValueDouble (runningImage->getExposureEnd ());
-					sendValueAll (lastTrash);
-				}
-				break;
-			case BAD:
-				badImages->inc ();
-				nightBadImages->inc ();
-				sendValueAll (badImages);
-				sendValueAll (nightBadImages);
-				lastBad->setValueDouble (getNow ());
-				sendValueAll (lastBad);
-				break;
-			case FLAT:
-				flatImages->inc ();
-				nightFlats->inc ();
-				sendValueAll (flatImages);
-				sendValueAll (nightFlats);
-				break;
-			case DARK:
-				darkImages->inc ();
-				nightDarks->inc ();
-				sendValueAll (darkImages);
-				sendValueAll (nightDarks);
-				break;
-			default:
-				logStream (MESSAGE_ERROR) << "wrong image state: " << runningImage->getAstrometryStat () << sendLog;
-				break;
+			img_iter = obsQue.erase (img_iter);
 		}
-		runningImage = NULL;
-		img_iter = imagesQue.begin ();
-		if (img_iter != imagesQue.end ())
+		else
 		{
-			ConnProcess *cp = *img_iter;
-			imagesQue.erase (img_iter);
-			changeRunning (cp);
+			img_iter++;
 		}
-		// still not image process running..
-		if (runningImage == NULL)
+	}
+	bool finished = false;
+	for (std::vector < ConnProcess * >::iterator iter = runningImages.begin (); iter != runningImages.end (); iter++)
+	{
+		if (*iter == NULL)
+			continue;
+		(*iter)->deleteConnection (conn);
+		if (*iter == conn)
 		{
-			maskState (DEVICE_ERROR_MASK | IMGPROC_MASK_RUN, IMGPROC_IDLE);
-			if (reprocessingPossible)
-			{
-				if (imageGlob.gl_pathc > 0)
-				{
-					globC++;
-					if (globC < imageGlob.gl_pathc)
-					{
-						queImage (imageGlob.gl_pathv[globC]);
-					}
-					else
-					{
-						globfree (&imageGlob);
-						imageGlob.gl_pathc = 0;
-					}
-				}
-			}
+			// rts2core::Device::deleteConnection will delete the process
+			processFinished (*iter);
+			*iter = NULL;
+			finished = true;
 		}
 	}
+	if (finished)
+	{
+		// que next image
+		startNext ();
+		// still not image process running..
+		if (getRunningCount () == 0)
+			maskState (DEVICE_ERROR_MASK | IMGPROC_MASK_RUN, IMGPROC_IDLE);
+	}
+	updateQueueValues ();
 #ifdef RTS2_HAVE_PGSQL
 	return rts2db::DeviceDb::deleteConnection (conn);
 #else
@@ -490,57 +490,207 @@ int ImageProc::deleteConnection (rts2core::Connection * conn)
 #endif
 }
 
-void ImageProc::changeRunning (ConnProcess * newImage)
+void ImageProc::processFinished (ConnProcess * proc)
 {
-	int ret;
-	if (runningImage)
+	switch (proc->getAstrometryStat ())
+	{
+		case NOT_ASTROMETRY:
+			break;	
+		case GET:
+			goodImages->inc ();
+			nightGoodImages->inc ();
+			lastRaDec->setValueRaDec (((ConnImgOnlyProcess *) proc)->getRa (), ((ConnImgOnlyProcess *) proc)->getDec ());
+			lastCorrections->setValueRaDec (((ConnImgOnlyProcess *) proc)->getRaErr (), ((ConnImgOnlyProcess *) proc)->getDecErr ());
+			sendValueAll (goodImages);
+			sendValueAll (nightGoodImages);
+			sendValueAll (lastRaDec);
+			sendValueAll (lastCorrections);
+			if (isnan (lastGood->getValueDouble ()) || proc->getExposureEnd () > lastGood->getValueDouble ())
+			{
+				lastGood->setValueDouble (proc->getExposureEnd ());
+				sendValueAll (lastGood);
+			}
+			break;
+		case TRASH:
+			trashImages->inc ();
+			nightTrashImages->inc ();
+			sendValueAll (trashImages);
+			sendValueAll (nightTrashImages);
+			if (isnan (lastTrash->getValueDouble ()) || proc->getExposureEnd () > lastTrash->getValueDouble ())
+			{
+				lastTrash->setValueDouble (proc->getExposureEnd ());
+				sendValueAll (lastTrash);
+			}
+			break;
+		case BAD:
+			badImages->inc ();
+			nightBadImages->inc ();
+			sendValueAll (badImages);
+			sendValueAll (nightBadImages);
+			lastBad->setValueDouble (getNow ());
+			sendValueAll (lastBad);
+			break;
+		case FLAT:
+			flatImages->inc ();
+			nightFlats->inc ();
+			sendValueAll (flatImages);
+			sendValueAll (nightFlats);
+			break;
+		case DARK:
+			darkImages->inc ();
+			nightDarks->inc ();
+			sendValueAll (darkImages);
+			sendValueAll (nightDarks);
+			break;
+		default:
+			logStream (MESSAGE_ERROR) << "wrong image state: " << proc->getAstrometryStat () << sendLog;
+			break;
+	}
+}
+
+int ImageProc::getFreeWorker ()
+{
+	for (int i = 0; i < workers->getValueInteger (); i++)
+	{
+		if ((size_t) i >= runningImages.size ())
+			runningImages.push_back (NULL);
+		if (runningImages[i] == NULL)
+			return i;
+	}
+	return -1;
+}
+
+int ImageProc::getRunningCount ()
+{
+	int ret = 0;
+	for (std::vector < ConnProcess * >::iterator iter = runningImages.begin (); iter != runningImages.end (); iter++)
+	{
+		if (*iter)
+			ret++;
+	}
+	return ret;
+}
+
+int ImageProc::startNext ()
+{
+	int started = 0;
+	while (true)
 	{
-		if (sendStop)
+		int worker = getFreeWorker ();
+		if (worker < 0)
+			break;
+		ConnProcess *cp;
+		if (imagesQue.size () > 0)
+		{
+			cp = imagesQue.front ();
+			imagesQue.pop_front ();
+		}
+		else if (obsQue.size () > 0)
 		{
-			runningImage->stop ();
-			imagesQue.push_front (runningImage);
+			cp = obsQue.front ();
+			obsQue.pop_front ();
+		}
+		// reprocess images from glob only if nothing else is waiting
+		else if (reprocessingPossible && imageGlob.gl_pathc > 0)
+		{
+			if (globC >= imageGlob.gl_pathc)
+			{
+				globfree (&imageGlob);
+				imageGlob.gl_pathc = 0;
+				break;
+			}
+			cp = new ConnImgProcess (this, defaultImgProcess.c_str (), imageGlob.gl_pathv[globC], astrometryTimeout->getValueInteger ());
+			globC++;
 		}
 		else
 		{
-			imagesQue.push_front (newImage);
-			infoAll ();
-			return;
+			break;
 		}
+		if (startProcess (worker, cp) == 0)
+			started++;
 	}
-	runningImage = newImage;
-	ret = runningImage->init ();
+	// drop workers above limit, if they are idle
+	while (runningImages.size () > (size_t) workers->getValueInteger () && runningImages.back () == NULL)
+		runningImages.pop_back ();
+	return started;
+}
+
+int ImageProc::startProcess (int worker, ConnProcess * newImage)
+{
+	int ret;
+	runningImages[worker] = newImage;
+	ret = newImage->init ();
 	if (ret < 0)
 	{
-		deleteConnection (runningImage);
-		delete runningImage;
-		runningImage = NULL;
-		maskState (DEVICE_ERROR_MASK | IMGPROC_MASK_RUN, DEVICE_ERROR_HW | IMGPROC_IDLE);
-		infoAll ();
-		if (reprocessingPossible)
-			checkNotProcessed ();
-		return;
+		runningImages[worker] = NULL;
+		processFinished (newImage);
+		delete newImage;
+		maskState (DEVICE_ERROR_MASK | IMGPROC_MASK_RUN, DEVICE_ERROR_HW | (getRunningCount () > 0 ? IMGPROC_RUN : IMGPROC_IDLE));
+		return -1;
 	}
 	else if (ret == 0)
 	{
 #ifdef RTS2_HAVE_LIBJPEG
-		if (isnan (lastGood->getValueDouble ()) || lastGood->getValueDouble () < runningImage->getExposureEnd ())
-			runningImage->setLastGoodJpeg (last_good_jpeg);
-		if (isnan (lastGood->getValueDouble ()) || lastTrash->getValueDouble() < runningImage->getExposureEnd ())
-			runningImage->setLastTrashJpeg (last_trash_jpeg);
+		if (isnan (lastGood->getValueDouble ()) || lastGood->getValueDouble () < newImage->getExposureEnd ())
+			newImage->setLastGoodJpeg (last_good_jpeg);
+		if (isnan (lastGood->getValueDouble ()) || lastTrash->getValueDouble() < newImage->getExposureEnd ())
+			newImage->setLastTrashJpeg (last_trash_jpeg);
 #endif
-		addConnection (runningImage);
-		processedImage->setValueCharArr (runningImage->getProcessArguments ());
+		addConnection (newImage);
+		processedImage->setValueCharArr (newImage->getProcessArguments ());
 	}
 	maskState (DEVICE_ERROR_MASK | IMGPROC_MASK_RUN, IMGPROC_RUN);
+	return 0;
+}
+
+void ImageProc::updateQueueValues ()
+{
+	int running = getRunningCount ();
+	queSize->setValueInteger ((int) (imagesQue.size () + obsQue.size ()) + running);
+	sendValueAll (queSize);
+	runningSize->setValueInteger (running);
+	sendValueAll (runningSize);
+
+	std::vector <std::string> wp;
+	for (std::vector < ConnProcess * >::iterator iter = runningImages.begin (); iter != runningImages.end (); iter++)
+		wp.push_back (*iter ? (*iter)->getProcessArguments () : "");
+	workerProcesses->setValueArray (wp);
+	sendValueAll (workerProcesses);
+}
+
+void ImageProc::changeRunning (ConnProcess * newImage)
+{
+	int worker = getFreeWorker ();
+	if (worker < 0)
+	{
+		if (sendStop && runningImages.size () > 0 && runningImages[0] != NULL)
+		{
+			runningImages[0]->stop ();
+			imagesQue.push_front (runningImages[0]);
+			runningImages[0] = NULL;
+			worker = 0;
+		}
+		else
+		{
+			imagesQue.push_front (newImage);
+			updateQueueValues ();
+			infoAll ();
+			return;
+		}
+	}
+	startProcess (worker, newImage);
+	updateQueueValues ();
 	infoAll ();
 }
 
-int ImageProc::que (ConnProcess * newProc)
+int ImageProc::que (ConnProcess * newProc, bool priority)
 {
-	if (runningImage)
+	if (priority)
 		imagesQue.push_front (newProc);
 	else
-		changeRunning (newProc);
+		obsQue.push_front (newProc);
+	startNext ();
+	updateQueueValues ();
 	infoAll ();
 	return 0;
 }
@@ -565,7 +715,7 @@ int ImageProc::queObs (int obsId)
 {
 	ConnObsProcess *newObsConn;
 	newObsConn = new ConnObsProcess (this, defaultObsProcess.c_str (), obsId, astrometryTimeout->getValueInteger ());
-	return que (newObsConn);
+	return que (newObsConn, false);
 }
 
 int ImageProc::checkNotProcessed ()
@@ -583,11 +733,32 @@ int ImageProc::checkNotProcessed ()
 	globC = 0;
 
 	// start files que..
-	if (imageGlob.gl_pathc > 0)
-		return queImage (imageGlob.gl_pathv[0]);
+	if (imageGlob.gl_pathc > 0 && startNext () > 0)
+	{
+		updateQueueValues ();
+		infoAll ();
+	}
 	return 0;
 }
 
+int ImageProc::setValue (rts2core::Value * old_value, rts2core::Value * new_value)
+{
+	if (old_value == workers)
+	{
+		if (new_value->getValueInteger () <= 0)
+			return -2;
+		workers->setValueInteger (new_value->getValueInteger ());
+		startNext ();
+		updateQueueValues ();
+		return 0;
+	}
+#ifdef RTS2_HAVE_PGSQL
+	return rts2db::DeviceDb::setValue (old_value, new_value);
+#else
+	return rts2core::Device::setValue (old_value, new_value);
+#endif
+}
+
 int ImageProc::commandAuthorized (rts2core::Connection * conn)
 {
 	if (conn->isCommand ("que_image"))
@@ -22,6 +22,8 @@
 #define __RTS2_SELECTOR__
 
 #include <algorithm>
+#include <map>
+#include <set>
 
 #include "askchoice.h"
 
@@ -32,6 +34,13 @@
 namespace rts2plan
 {
 
+class TargetEntry;
+
+/**
+ * Time (ctime) when target entry shall be re-evaluated.
+ */
+typedef std::multimap <double, TargetEntry *> recheck_t;
+
 /**
  * Holds target together with its bonus. Used to order targets by bonus for
  * selection.
@@ -41,11 +50,20 @@ namespace rts2plan
 class TargetEntry
 {
 	public:
-		TargetEntry (rts2db::Target *_target) { target = _target; bonus = NAN; }
+		TargetEntry (rts2db::Target *_target) { target = _target; bonus = NAN; ready = false; scheduled = false; round = 0; }
 		~TargetEntry () { delete target; }
 		rts2db::Target * target;
 		double bonus;
 		void updateBonus () { bonus = target->getBonus (); }
+		void updateBonus (double JD) { bonus = target->getBonus (JD); }
+
+		// true if the entry is in the ready index
+		bool ready;
+		// true if recheck holds valid position in recheck index
+		bool scheduled;
+		recheck_t::iterator recheck;
+		// selection round in which bonus was calculated
+		unsigned int round;
 };
 
 /**
@@ -58,10 +76,36 @@ struct bonusSort: public std::binary_function <TargetEntry *, TargetEntry *, boo
 	bool operator () (TargetEntry * t1, TargetEntry * t2) { return t1->bonus > t2->bonus; }
 };
 
+/**
+ * Strict ordering of TargetEntry by bonus and target ID, for ready index.
+ *
+ * @author Petr Kubanek <petr@kubanek.net>
+ */
+struct readySort: public std::binary_function <TargetEntry *, TargetEntry *, bool>
+{
+	bool operator () (TargetEntry * t1, TargetEntry * t2) const
+	{
+		if (t1->bonus != t2->bonus)
+			return t1->bonus > t2->bonus;
+		return t1->target->getTargetID () < t2->target->getTargetID ();
+	}
+};
+
 /**
  * Select next target. Traverse list of targets which are enabled and select
  * target with biggest priority.
  *
+ * Candidate targets are kept in memory. Targets which satisfy their
+ * constraints are held in index ordered by bonus, so selection picks the
+ * first target from the index and verifies it. Every target has time when
+ * it must be re-evaluated - when its constraints change, as found by
+ * Target::getSatisfiedDuration and Target::getSatisfiedIntervals, or after
+ * rescan interval. Bonuses of ready targets which change with time (see
+ * Target::hasConstantBonus) are updated on every selection. Targets table is
+ * queried on every selection only for new targets and targets which became
+ * observable since the last selection; full scan of the table is run every
+ * rescan interval, or when requested by rescan call.
+ *
  * @author Petr Kubanek <petr@kubanek.net>
  */
 class Selector
@@ -139,19 +183,88 @@ class Selector
 		void saveTargets ();
 
 		/**
-		 * Check after some constraint file was modified.
+		 * Check after some constraint file was modified. Targets
+		 * using the constraint file are re-evaluated on the next
+		 * selection.
 		 *
 		 * @param watch_id  ID of watch which was modified. Retrieved from notifi FD via read call.
 		 */
 		void revalidateConstraints (int watch_id);
 
+		/**
+		 * Request full scan of the targets table on the next selection.
+		 */
+		void rescan () { nextRescan = NAN; }
+
+		/**
+		 * Set interval between full scans of the targets table. This
+		 * is also the longest interval in which entry constraints are
+		 * searched for changes.
+		 *
+		 * @param interval  interval in seconds
+		 */
+		void setRescanInterval (double interval) { rescanInterval = interval; }
+
+		double getRescanInterval () { return rescanInterval; }
+
 	private:
+		// snapshot of candidate targets, sorted by bonus, for printPossible and disableTarget
 		std::vector < TargetEntry* > possibleTargets;
+
+		// all candidate targets, indexed by target ID
+		std::map <int, TargetEntry *> targetIndex;
+		// targets which satisfy constraints, ordered by bonus
+		std::set <TargetEntry *, readySort> readyTargets;
+		// times when targets must be re-evaluated
+		recheck_t recheckTargets;
+		// targets which bonus changes with time
+		std::set <TargetEntry *> variableBonus;
+
+		double rescanInterval;
+		// ctime of next full scan; NAN forces scan on next selection
+		double nextRescan;
+		// ctime of last scan of the targets table
+		double lastCheck;
+		// highest target ID found in the targets table
+		int lastTargetId;
+		// selection counter, used to update bonus at most once per selection
+		unsigned int selectRound;
+
 		void considerTarget (int consider_tar_id, double JD);
 		std::vector <char> nightDisabledTypes;
 		void checkTargetObservability ();
 		void checkTargetBonus ();
-		void findNewTargets ();
+		void findNewTargets (double JD);
+
+		/**
+		 * Query targets table only for new targets and targets which
+		 * became observable since the last check.
+		 */
+		void findChangedTargets (double JD);
+
+		/**
+		 * Returns true if all filters used in target scripts are available.
+		 */
+		bool checkFilters (rts2db::Target *tar);
+
+		/**
+		 * Calculate target entry bonus, and put it either to index of
+		 * ready targets or to recheck index. Entry must not be in any
+		 * index. Deletes entry of target which shall not be considered
+		 * for observation.
+		 *
+		 * @return false if the entry was deleted
+		 */
+		bool evaluateEntry (TargetEntry *te, double JD);
+
+		/**
+		 * Remove entry from ready and recheck indices.
+		 */
+		void unindexEntry (TargetEntry *te);
+
+		void deleteEntry (TargetEntry *te);
+
+		void updatePossibleTargets ();
 		int selectFlats ();
 		int selectDarks ();
 		struct ln_lnlat_posn *observer;
@@ -181,6 +294,7 @@ class Selector
 template <class Predicate> void Selector::printPossible (std::ostream &os, Predicate pred)
 {
 	os << "List of targets selected for observations. Sort from the one with the highest priority to lowest priorities" << std::endl << std::endl;  
+	updatePossibleTargets ();
 	std::vector <TargetEntry *>::iterator iter = possibleTargets.begin ();  
 	os << std::fixed;
 	for (int i = 1; iter != possibleTargets.end (); iter++)
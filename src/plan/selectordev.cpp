@@ -132,6 +132,8 @@ class SelectorDev:public rts2db::DeviceDb
 
 		rts2core::ValueString *nightDisabledTypes;
 
+		rts2core::ValueInteger *rescanInterval;
+
 		struct ln_lnlat_posn *observer;
 		double obs_altitude;
 		int last_auto_id;
@@ -277,6 +279,9 @@ SelectorDev::SelectorDev (int argc, char **argv):rts2db::DeviceDb (argc, argv, D
 
 	createValue (nightDisabledTypes, "night_disabled_types", "list of target types which will not be selected during night", false, RTS2_VALUE_WRITABLE);
 
+	createValue (rescanInterval, "rescan_interval", "interval between full scans of targets table", false, RTS2_VALUE_WRITABLE | RTS2_DT_TIMEINTERVAL);
+	rescanInterval->setValueInteger (1800);
+
 	createValue (simulExpected, "simul_expected", "[s] expected simulation duration", false, RTS2_DT_TIMEINTERVAL);
 	simulExpected->setValueDouble (60);
 
@@ -726,6 +731,13 @@ int SelectorDev::setValue (rts2core::Value * old_value, rts2core::Value * new_va
 		sel->setNightDisabledTypes (new_value->getValue ());
 		return 0;
 	}
+	if (old_value == rescanInterval)
+	{
+		if (new_value->getValueInteger () <= 0)
+			return -2;
+		sel->setRescanInterval (new_value->getValueInteger ());
+		return 0;
+	}
 
 	return rts2db::DeviceDb::setValue (old_value, new_value);
 }
@@ -970,6 +982,13 @@ int SelectorDev::commandAuthorized (rts2core::Connection * conn)
 		}
 		return 0;
 	}
+	else if (conn->isCommand ("rescan"))
+	{
+		if (!conn->paramEnd ())
+			return -2;
+		sel->rescan ();
+		return updateNext () == 0 ? 0 : -2;
+	}
 	else if (conn->isCommand ("simulate") || conn->isCommand ("simulate_night"))
 	{
 		double to;
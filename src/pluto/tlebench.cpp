@@ -0,0 +1,212 @@
+/*
+ * Benchmark of satellite position calculations.
+ * Copyright (C) 2013 Petr Kubanek <petr@kubanek.net>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * Compares calculation of satellite positions with model initialisation
+ * for every position, as it was done before TLEPropagator was introduced,
+ * with cached model parameters, batched time grid and batch of satellites
+ * at single epoch. Checks that all methods give the same positions and
+ * prints first pass of the satellites found by TLEPropagator::getRST. Run as
+ *
+ * tlebench [positions] [copies]
+ *
+ * where positions is number of positions on one minute grid calculated for
+ * every satellite, and copies is number of copies of the test satellites
+ * used for the batch of satellites.
+ */
+
+#include "pluto/tlepropagator.h"
+#include "pluto/observe.h"
+
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+
+static const char *tles[] = {
+	// near Earth test satellite of spacetrack report #3
+	"1 88888U          80275.98708465  .00073094  13844-3  66816-4 0    87",
+	"2 88888  72.8435 115.9689 0086731  52.6988 110.5714 16.05824518  1058",
+	// GOES 9
+	"1 23581U 95025A   01311.43599209 -.00000094  00000-0  00000+0 0  8214",
+	"2 23581   1.1236  93.7945 0005741 214.4722 151.5103  1.00270260 23672",
+	// Cosmos 1191
+	"1 11871U 80057A   01309.36911127 -.00000499 +00000-0 +10000-3 0 08380",
+	"2 11871 067.5731 001.8936 6344778 181.9632 173.2224 02.00993562062886",
+	// Molniya 3-19Rk
+	"1 13446U 82083E   01283.10818257  .00098407  45745-7  54864-3 0  6240",
+	"2 13446  62.1717  83.8458 7498877 273.9677 320.2568  2.06357523137203",
+	// Ariane Deb
+	"1 23246U 91015G   01311.70347086  .00004957  00000-0  43218-2 0  8190",
+	"2 23246   7.1648 263.6949 5661268 241.8299  50.5793  4.44333001129208",
+	NULL
+};
+
+// observer - Ondrejov
+static const double obs_lng = 14.78 * M_PI / 180.0;
+static const double obs_lat = 49.91 * M_PI / 180.0;
+static const double obs_alt = 528;
+
+double now ()
+{
+	struct timeval tv;
+	gettimeofday (&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// position calculation as it was done before - initialise model for every position
+void referencePosition (const tle_t *tle, int ephem, double JD, double &ra, double &dec, double &dist)
+{
+	double sat_params[N_SAT_PARAMS], observer_loc[3];
+	double sat_pos[3];
+	double r_c, r_s;
+
+	lat_alt_to_parallax (obs_lat, obs_alt, &r_c, &r_s);
+	observer_cartesian_coords (JD, obs_lng, r_c, r_s, observer_loc);
+
+	double t_since = (JD - tle->epoch) * 1440.;
+	switch (ephem)
+	{
+		case TLE_SGP:
+			SGP_init (sat_params, tle);
+			SGP (t_since, tle, sat_params, sat_pos, NULL);
+			break;
+		case TLE_SGP4:
+			SGP4_init (sat_params, tle);
+			SGP4 (t_since, tle, sat_params, sat_pos, NULL);
+			break;
+		case TLE_SGP8:
+			SGP8_init (sat_params, tle);
+			SGP8 (t_since, tle, sat_params, sat_pos, NULL);
+			break;
+		case TLE_SDP4:
+			SDP4_init (sat_params, tle);
+			SDP4 (t_since, tle, sat_params, sat_pos, NULL);
+			break;
+		case TLE_SDP8:
+			SDP8_init (sat_params, tle);
+			SDP8 (t_since, tle, sat_params, sat_pos, NULL);
+			break;
+	}
+	get_satellite_ra_dec_delta (observer_loc, sat_pos, &ra, &dec, &dist);
+}
+
+int main (int argc, char **argv)
+{
+	int positions = 1440;
+	int copies = 200;
+	if (argc > 1)
+		positions = atoi (argv[1]);
+	if (argc > 2)
+		copies = atoi (argv[2]);
+
+	std::vector <TLEPropagator> sats;
+	for (int i = 0; tles[i]; i += 2)
+	{
+		TLEPropagator p;
+		if (p.load (tles[i], tles[i + 1]))
+		{
+			std::cerr << "cannot parse " << tles[i] << std::endl;
+			return 1;
+		}
+		p.setObserver (obs_lng, obs_lat, obs_alt);
+		sats.push_back (p);
+	}
+
+	const double step = 1 / 1440.0;
+	int errors = 0;
+
+	std::cout << positions << " positions per satellite, times for per-call init / cached / time grid" << std::endl;
+
+	for (size_t s = 0; s < sats.size (); s++)
+	{
+		TLEPropagator &p = sats[s];
+		double JD = p.getTLE ()->epoch;
+
+		std::vector <double> ra1 (positions), dec1 (positions), dist1 (positions);
+		std::vector <double> ra2 (positions), dec2 (positions), dist2 (positions);
+		std::vector <double> ra3 (positions), dec3 (positions), dist3 (positions);
+
+		double t = now ();
+		for (int i = 0; i < positions; i++)
+			referencePosition (p.getTLE (), p.getEphem (), JD + i * step, ra1[i], dec1[i], dist1[i]);
+		double tRef = now () - t;
+
+		t = now ();
+		for (int i = 0; i < positions; i++)
+			p.getPosition (JD + i * step, ra2[i], dec2[i], dist2[i]);
+		double tCached = now () - t;
+
+		t = now ();
+		p.getPositions (JD, step, positions, &(ra3[0]), &(dec3[0]), &(dist3[0]), NULL);
+		double tGrid = now () - t;
+
+		double maxDiff = 0;
+		for (int i = 0; i < positions; i++)
+		{
+			maxDiff = fmax (maxDiff, fabs (ra1[i] - ra2[i]) + fabs (dec1[i] - dec2[i]));
+			maxDiff = fmax (maxDiff, fabs (ra1[i] - ra3[i]) + fabs (dec1[i] - dec3[i]));
+		}
+		if (maxDiff > 1e-12)
+			errors++;
+
+		double rise, set, transit;
+		int rst = p.getRST (JD, 0, rise, set, transit);
+
+		std::cout << p.getTLE ()->norad_number << (p.getEphem () >= TLE_SDP4 ? " SDP" : " SGP") << "\t" << tRef * 1000.0 << " / " << tCached * 1000.0 << " / " << tGrid * 1000.0 << " ms, max diff " << maxDiff
+			<< "\tRST " << rst << " rise " << (rise - JD) * 1440.0 << " transit " << (transit - JD) * 1440.0 << " set " << (set - JD) * 1440.0 << " min after epoch" << std::endl;
+	}
+
+	// many satellites at single epoch
+	std::vector <TLEPropagator *> many;
+	for (int c = 0; c < copies; c++)
+		for (size_t s = 0; s < sats.size (); s++)
+			many.push_back (&(sats[s]));
+
+	size_t n = many.size ();
+	std::vector <double> ra1 (n), dec1 (n), dist1 (n);
+	std::vector <double> ra2 (n), dec2 (n), dist2 (n);
+	// epoch of GOES 9, close to epochs of all but the first satellite
+	double JD = sats[1].getTLE ()->epoch;
+
+	double t = now ();
+	for (size_t i = 0; i < n; i++)
+		referencePosition (many[i]->getTLE (), many[i]->getEphem (), JD, ra1[i], dec1[i], dist1[i]);
+	double tRef = now () - t;
+
+	t = now ();
+	TLEPropagator::getPositions (&(many[0]), n, JD, &(ra2[0]), &(dec2[0]), &(dist2[0]), NULL);
+	double tBatch = now () - t;
+
+	double maxDiff = 0;
+	for (size_t i = 0; i < n; i++)
+		maxDiff = fmax (maxDiff, fabs (ra1[i] - ra2[i]) + fabs (dec1[i] - dec2[i]));
+	if (maxDiff > 1e-12)
+		errors++;
+
+	std::cout << n << " satellites at single epoch, per-call init / batch " << tRef * 1000.0 << " / " << tBatch * 1000.0 << " ms, max diff " << maxDiff << std::endl;
+
+	if (errors)
+	{
+		std::cerr << errors << " position calculations differ from per-call init" << std::endl;
+		return 1;
+	}
+	return 0;
+}
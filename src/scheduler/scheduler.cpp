@@ -25,6 +25,8 @@
 
 #define OPT_START_DATE		OPT_LOCAL + 210
 #define OPT_END_DATE		OPT_LOCAL + 211
+#define OPT_THREADS		OPT_LOCAL + 212
+#define OPT_SEED		OPT_LOCAL + 213
 
 /**
  * Class of the scheduler application.  Prepares schedule, and run
@@ -74,6 +76,13 @@ class Rts2ScheduleApp: public rts2db::AppDb
 		double startDate;
 		double endDate;
 
+		// number of threads used to evaluate merits
+		int threads;
+
+		// random seed
+		unsigned int seed;
+		bool seedSet;
+
 		/**
 		 * Print merit of given type.
 		 *
@@ -130,6 +139,10 @@ Rts2ScheduleApp::Rts2ScheduleApp (int argc, char ** argv): rts2db::AppDb (argc,
 	startDate = NAN;
 	endDate = NAN;
 
+	threads = 1;
+	seed = 0;
+	seedSet = false;
+
 	addOption ('v', NULL, 0, "verbosity level");
 	addOption ('g', NULL, 1, "number of generations");
 	addOption ('p', NULL, 1, "population size");
@@ -140,6 +153,8 @@ Rts2ScheduleApp::Rts2ScheduleApp (int argc, char ** argv): rts2db::AppDb (argc,
 
 	addOption (OPT_START_DATE, "start", 1, "produce schedule from this date");
 	addOption (OPT_END_DATE, "end", 1, "produce schedule till this date");
+	addOption (OPT_THREADS, "threads", 1, "number of threads used to evaluate merits (0 for number of CPUs, default to 1)");
+	addOption (OPT_SEED, "seed", 1, "random seed; for reproducible runs (default to current time)");
 }
 
 Rts2ScheduleApp::~Rts2ScheduleApp (void)
@@ -279,6 +294,20 @@ int Rts2ScheduleApp::processOption (int _opt)
 			return parseDate (optarg, startDate);
 		case OPT_END_DATE:
 			return parseDate (optarg, endDate);
+		case OPT_THREADS:
+			threads = atoi (optarg);
+			if (threads < 0)
+			{
+				logStream (MESSAGE_ERROR) << "Number of threads must not be negative " << optarg << sendLog;
+				return -1;
+			}
+			if (threads == 0)
+				threads = rts2core::WorkerPool::getOnlineCPUs ();
+			break;
+		case OPT_SEED:
+			seed = strtoul (optarg, NULL, 0);
+			seedSet = true;
+			break;
 		default:
 			return rts2db::AppDb::processOption (_opt);
 	}
@@ -292,7 +321,9 @@ int Rts2ScheduleApp::init ()
 	if (ret)
 		return ret;
 
-	srandom (time (NULL));
+	if (!seedSet)
+		seed = time (NULL);
+	srandom (seed);
 
 	// initialize schedules..
 	if (isnan (startDate))
@@ -313,6 +344,7 @@ int Rts2ScheduleApp::init ()
 		std::cout << "Generating schedule for night " << LibnovaDate (obsNight) << std::endl;
 
 		schedBag = new Rts2SchedBag (NAN, NAN);
+		schedBag->setThreads (threads);
 		ret = schedBag->constructSchedulesFromObsSet (popSize, obsNight);
 		if (ret)
 			return ret;
@@ -322,6 +354,7 @@ int Rts2ScheduleApp::init ()
 		std::cout << "Generating schedule from " << LibnovaDate (startDate) << " to " << LibnovaDate (endDate) << std::endl;
 
 		schedBag = new Rts2SchedBag (startDate, endDate);
+		schedBag->setThreads (threads);
 
 		ret = schedBag->constructSchedules (popSize);
 		if (ret)
@@ -66,6 +66,7 @@ class DavisUdp:public rts2core::ConnNoSend
 		virtual int init ();
 
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 		void setConnTimeout (int _ct) { conn_timeout = _ct; }
 	protected:
@@ -48,6 +48,7 @@ class ConnFramWeather:public rts2core::ConnNoSend
 		ConnFramWeather (int _weather_port, int _weather_timeout, FramWeather * _master);
 		virtual int init ();
 		virtual int receive (fd_set * set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 };
 
 }
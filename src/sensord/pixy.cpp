@@ -40,6 +40,7 @@ class Rts2ConnPixy:public rts2core::ConnSerial
 
 	protected:
 		virtual int receive (fd_set *set);
+		virtual int pollReady (int fd, uint32_t events) { return pollReadySelect (fd, events); }
 
 	private:
 		/**
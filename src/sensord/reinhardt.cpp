@@ -40,6 +40,9 @@ class Reinhardt:public SensorWeather
 		virtual void addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 		virtual void selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 
+		// sockets added in addSelectSocks are not registered with epoll
+		virtual bool canEventPoll () { return false; }
+
 	protected:
 		virtual int processOption (int opt);
 		virtual int initHardware ();
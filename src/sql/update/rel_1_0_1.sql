@@ -0,0 +1,19 @@
+CREATE OR REPLACE FUNCTION healpix_nest (int4, float8, float8)
+  RETURNS int8 AS 'pg_astrolib.so', 'healpix_nest' LANGUAGE 'c' IMMUTABLE;
+
+-- HEALPix nested pixel (order 10) of target position, used by cone searches
+ALTER TABLE targets ADD COLUMN tar_hpix int8;
+
+UPDATE targets SET tar_hpix = healpix_nest (10, tar_ra, tar_dec);
+
+CREATE INDEX targets_hpix ON targets (tar_hpix);
+
+CREATE OR REPLACE FUNCTION targets_hpix_update () RETURNS trigger AS $$
+BEGIN
+	NEW.tar_hpix := healpix_nest (10, NEW.tar_ra, NEW.tar_dec);
+	RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TRIGGER targets_hpix BEFORE INSERT OR UPDATE ON targets
+	FOR EACH ROW EXECUTE PROCEDURE targets_hpix_update ();
@@ -21,6 +21,8 @@
 #include "teld.h"
 #include "configuration.h"
 
+#include <deque>
+
 #define OPT_MOVE_FAST      OPT_LOCAL + 510
 
 /*!
@@ -58,6 +60,7 @@ class Dummy:public Telescope
 
 		virtual int info ()
 		{
+			followTrajectory ();
 			setTelRaDec (dummyPos.ra, dummyPos.dec);
 			julian_day->setValueDouble (ln_get_julian_from_sys ());
 			return Telescope::info ();
@@ -108,6 +111,10 @@ class Dummy:public Telescope
 
 		virtual void runTracking ();
 
+		virtual int startTrajectory (int32_t &ac, int32_t &dc);
+		virtual int sendTrajectory (const std::vector <TrajectoryPoint> &points);
+		virtual void stopTrajectory ();
+
 		virtual int sky2counts (double JD, struct ln_equ_posn *pos, int32_t &ac, int32_t &dc);
 
 	private:
@@ -124,6 +131,14 @@ class Dummy:public Telescope
 
 		rts2core::ValueLong *t_axRa;
 		rts2core::ValueLong *t_axDec;
+
+		// trajectory points waiting to be reached
+		std::deque <TrajectoryPoint> trajectoryBuffer;
+
+		/**
+		 * Simulate mount following the trajectory - interpolate axes target from trajectory points.
+		 */
+		void followTrajectory ();
 };
 
 }
@@ -147,6 +162,8 @@ Dummy::Dummy (int argc, char **argv):Telescope (argc, argv, true, true)
 	createValue (t_axRa, "T_AXRA", "RA axis target position", false);
 	createValue (t_axDec, "T_AXDEC", "DEC axis target position", false);
 
+	createTrajectory ();
+
 	dummyPos.ra = 0;
 	dummyPos.dec = 0;
 
@@ -243,6 +260,40 @@ void Dummy::runTracking ()
 	t_axDec->setValueLong (target.dec * 10000);
 }
 
+int Dummy::startTrajectory (int32_t &ac, int32_t &dc)
+{
+	trajectoryBuffer.clear ();
+	ac = t_axRa->getValueLong ();
+	dc = t_axDec->getValueLong ();
+	return 0;
+}
+
+int Dummy::sendTrajectory (const std::vector <TrajectoryPoint> &points)
+{
+	trajectoryBuffer.insert (trajectoryBuffer.end (), points.begin (), points.end ());
+	return 0;
+}
+
+void Dummy::stopTrajectory ()
+{
+	trajectoryBuffer.clear ();
+}
+
+void Dummy::followTrajectory ()
+{
+	double now = getNow ();
+	// keep the last point passed, to interpolate from it
+	while (trajectoryBuffer.size () > 1 && trajectoryBuffer[1].t <= now)
+		trajectoryBuffer.pop_front ();
+	if (trajectoryBuffer.empty () || trajectoryBuffer.front ().t > now)
+		return;
+
+	const TrajectoryPoint &p = trajectoryBuffer.front ();
+	double dt = now - p.t;
+	t_axRa->setValueLong (p.ac + p.ac_speed * dt);
+	t_axDec->setValueLong (p.dc + p.dc_speed * dt);
+}
+
 int Dummy::sky2counts (double JD, struct ln_equ_posn *pos, int32_t &ac, int32_t &dc)
 {
 	ac = pos->ra * 10000;
@@ -87,6 +87,9 @@ class Trencin:public Fork
 		virtual void addSelectSocks (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 		virtual void selectSuccess (fd_set &read_set, fd_set &write_set, fd_set &exp_set);
 
+		// sockets added in addSelectSocks are not registered with epoll
+		virtual bool canEventPoll () { return false; }
+
 	private:
 		const char *device_nameRa;
 		rts2core::ConnSerial *trencinConnRa;